@@ -54,6 +54,10 @@ ifeq "$(AVR_GCC_VERSION)" "1"
     CXXFLAGS += -fdiagnostics-color
 endif
 
+### STACK_FLAGS
+### The -D*_THREAD_STACK flags host/profile suggests, to size the thread working areas.
+CXXFLAGS += $(STACK_FLAGS)
+
 ### MONITOR_PORT
 ### The port your board is connected to. Using an '*' tries all the ports and finds the right one.
 MONITOR_PORT      = /dev/tty.usbmodem*
@@ -60,6 +60,10 @@ ifeq "$(AVR_GCC_VERSION)" "1"
     CXXFLAGS += -fdiagnostics-color
 endif
 
+### STACK_FLAGS
+### The -D*_THREAD_STACK flags host/profile suggests, to size the thread working areas.
+CXXFLAGS += $(STACK_FLAGS)
+
 ### don't touch this
 ### This is were you put the binaries you just compile using 'make'
 CURRENT_DIR       = $(shell basename $(CURDIR))
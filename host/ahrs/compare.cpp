@@ -0,0 +1,198 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file compare.cpp
+ * @brief Runs the float and fixed point AHRS kernels side by side on recorded traces
+ *
+ * Each trace line is "accX,accY,accZ,gyrX,gyrY,gyrZ" with the accelerometer in raw counts
+ * and the gyroscope in deg/s, as written by test/simulationMotor. The Euler angles of both
+ * kernels are compared after every step; the host timings only give a rough ratio, the AVR
+ * cycle counts come from test/AHRSBenchmark.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "MahonyAHRS.h"
+
+#define TWO_KP (2.0f * 0.5f)
+#define TWO_KI (2.0f * 0.1f)
+#define GYRO_LSB_PER_DEG 14.375f
+#define TIMING_REPEAT 200
+
+struct Line {
+	float acc[3];
+	float gyr[3];
+};
+
+static bool readTrace(const char* path, std::vector<Line>* lines) {
+	FILE* file = fopen(path, "r");
+	Line line;
+
+	if (file == NULL)
+		return false;
+
+	while (fscanf(file, "%f,%f,%f,%f,%f,%f", &line.acc[0], &line.acc[1], &line.acc[2],
+				&line.gyr[0], &line.gyr[1], &line.gyr[2]) == 6)
+		lines->push_back(line);
+
+	fclose(file);
+	return true;
+}
+
+/* Same formulas as FreeIMU::getEulerRad, in degrees */
+static void toEuler(const float* q, float* angles) {
+	angles[0] = atan2(2 * q[1] * q[2] - 2 * q[0] * q[3], 2 * q[0]*q[0] + 2 * q[1] * q[1] - 1);
+	angles[1] = -asin(2 * q[1] * q[3] + 2 * q[0] * q[2]);
+	angles[2] = atan2(2 * q[2] * q[3] - 2 * q[0] * q[1], 2 * q[0] * q[0] + 2 * q[3] * q[3] - 1);
+
+	for (int i = 0; i < 3; i++)
+		angles[i] *= 180.0f / M_PI;
+}
+
+static float angleError(float a, float b) {
+	float d = fmodf(a - b + 540.0f, 360.0f) - 180.0f;
+	return fabsf(d);
+}
+
+static int16_t toRaw(float value) {
+	return (int16_t)lrintf(value);
+}
+
+static double elapsedNs(const timespec& start, const timespec& end) {
+	return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static void compare(const char* path, const std::vector<Line>& lines, uint16_t dt) {
+	MahonyAHRS reference(TWO_KP, TWO_KI);
+	MahonyAHRSFixed fixed(TWO_KP, TWO_KI);
+	float maxError[3] = { 0.f, 0.f, 0.f };
+	double sumSquares[3] = { 0., 0., 0. };
+	float finalRef[3], finalFixed[3];
+
+	for (size_t n = 0; n < lines.size(); n++) {
+		const Line& l = lines[n];
+		float q[4], refAngles[3], fixedAngles[3];
+
+		reference.update(l.gyr[0] * M_PI / 180, l.gyr[1] * M_PI / 180, l.gyr[2] * M_PI / 180,
+				l.acc[0], l.acc[1], l.acc[2], dt / 1000000.0f);
+		fixed.update(toRaw(l.gyr[0] * GYRO_LSB_PER_DEG), toRaw(l.gyr[1] * GYRO_LSB_PER_DEG),
+				toRaw(l.gyr[2] * GYRO_LSB_PER_DEG), toRaw(l.acc[0]), toRaw(l.acc[1]), toRaw(l.acc[2]), dt);
+
+		reference.getQ(q);
+		toEuler(q, refAngles);
+		fixed.getQ(q);
+		toEuler(q, fixedAngles);
+
+		for (int i = 0; i < 3; i++) {
+			float e = angleError(refAngles[i], fixedAngles[i]);
+			if (e > maxError[i])
+				maxError[i] = e;
+			sumSquares[i] += e * e;
+			finalRef[i] = refAngles[i];
+			finalFixed[i] = fixedAngles[i];
+		}
+	}
+
+	printf("%s: %zu samples at %u us\n", path, lines.size(), dt);
+	printf("  %-6s %10s %10s %10s %10s\n", "angle", "max err", "rms err", "float end", "fixed end");
+
+	const char* names[3] = { "psi", "theta", "phi" };
+	for (int i = 0; i < 3; i++)
+		printf("  %-6s %10.4f %10.4f %10.3f %10.3f\n", names[i], maxError[i],
+				sqrt(sumSquares[i] / lines.size()), finalRef[i], finalFixed[i]);
+}
+
+static void timeKernels(const std::vector<Line>& lines, uint16_t dt) {
+	MahonyAHRS reference(TWO_KP, TWO_KI);
+	MahonyAHRSFixed fixed(TWO_KP, TWO_KI);
+	std::vector<int16_t> raw(lines.size() * 6);
+	timespec start, end;
+	float q[4];
+
+	for (size_t n = 0; n < lines.size(); n++) {
+		for (int i = 0; i < 3; i++) {
+			raw[n * 6 + i] = toRaw(lines[n].acc[i]);
+			raw[n * 6 + 3 + i] = toRaw(lines[n].gyr[i] * GYRO_LSB_PER_DEG);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int r = 0; r < TIMING_REPEAT; r++)
+		for (size_t n = 0; n < lines.size(); n++) {
+			const Line& l = lines[n];
+			reference.update(l.gyr[0] * (float)M_PI / 180, l.gyr[1] * (float)M_PI / 180,
+					l.gyr[2] * (float)M_PI / 180, l.acc[0], l.acc[1], l.acc[2], dt / 1000000.0f);
+		}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double floatNs = elapsedNs(start, end) / (TIMING_REPEAT * lines.size());
+	reference.getQ(q);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int r = 0; r < TIMING_REPEAT; r++)
+		for (size_t n = 0; n < lines.size(); n++) {
+			const int16_t* s = &raw[n * 6];
+			fixed.update(s[3], s[4], s[5], s[0], s[1], s[2], dt);
+		}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double fixedNs = elapsedNs(start, end) / (TIMING_REPEAT * lines.size());
+	fixed.getQ(q);
+
+	printf("host: float %.1f ns/update, fixed %.1f ns/update (AVR cycles: test/AHRSBenchmark)\n",
+			floatNs, fixedNs);
+}
+
+int main(int argc, char** argv) {
+	uint16_t dt = 50000;
+	std::vector<Line> all;
+	int first = 1;
+
+	if (argc > 2 && strcmp(argv[1], "-d") == 0) {
+		dt = (uint16_t)atoi(argv[2]);
+		first = 3;
+	}
+
+	if (first >= argc) {
+		fprintf(stderr, "usage: %s [-d dt_us] trace.txt...\n", argv[0]);
+		return 2;
+	}
+
+	for (int i = first; i < argc; i++) {
+		std::vector<Line> lines;
+
+		if (!readTrace(argv[i], &lines) || lines.empty()) {
+			fprintf(stderr, "%s: cannot read trace\n", argv[i]);
+			return 1;
+		}
+
+		compare(argv[i], lines, dt);
+		all.insert(all.end(), lines.begin(), lines.end());
+	}
+
+	timeKernels(all, dt);
+
+	return 0;
+}
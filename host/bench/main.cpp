@@ -0,0 +1,311 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file main.cpp
+ * @brief Times the kernels of test/KernelBenchmark/Kernels.h and compares them to a baseline
+ *
+ * On the host, every kernel runs -n times in a row for its throughput (avg, in ns per
+ * call), then -n times one call at a time for its latency (min, 99.9th percentile and max,
+ * less what reading the clock costs). With -a it reads instead what test/KernelBenchmark
+ * printed on the ATmega2560, or on simavr, in cycles.
+ *
+ *     bench [-a avr-output] [-b baseline] [-w baseline] [-t tolerance] [-n runs]
+ *
+ * -b fails (exit 1) when a kernel is slower than the baseline by more than -t percent:
+ * its avg, and its max in cycles (the host max is what the scheduler makes of it).
+ * -w writes the results as a baseline. Both use the lines of the AVR sketch:
+ *     name min X avg Y max Z unit
+ */
+
+#include <getopt.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+
+#include "Kernels.h"
+
+#define BENCH_DEFAULT_RUNS 100000
+#define BENCH_WARMUP_RUNS 1000
+#define BENCH_TOLERANCE_CYCLES 2.0	// %, the simulator counts the same every time
+#define BENCH_TOLERANCE_NS 15.0		// %
+
+typedef struct {
+	std::string name;
+	double minimum;
+	double average;
+	double maximum;
+	double p999;	// host only
+	std::string unit;
+} Result;
+
+static double elapsedNs(const timespec& start, const timespec& end) {
+	return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+/**
+ * @brief Gets what timing nothing costs, the least of many tries
+ * @return the cost (in ns)
+ */
+static double clockOverhead(void) {
+	double overhead = 1e9;
+	timespec start, end;
+
+	for (int i = 0; i < BENCH_WARMUP_RUNS; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		overhead = min(overhead, elapsedNs(start, end));
+	}
+
+	return overhead;
+}
+
+static Result benchmark(const Kernel& kernel, uint32_t runs, double overhead) {
+	std::vector<double> latencies(runs);
+	timespec start, end;
+	Result result;
+
+	for (uint32_t i = 0; i < BENCH_WARMUP_RUNS; i++)
+		kernel.run((uint8_t)i);
+
+	// Throughput
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (uint32_t i = 0; i < runs; i++)
+		kernel.run((uint8_t)i);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	result.average = elapsedNs(start, end) / runs;
+
+	// Latency
+	for (uint32_t i = 0; i < runs; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		kernel.run((uint8_t)i);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		latencies[i] = max(0., elapsedNs(start, end) - overhead);
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+
+	result.name = kernel.name;
+	result.minimum = latencies.front();
+	result.maximum = latencies.back();
+	result.p999 = latencies[(size_t)(runs * 0.999)];
+	result.unit = "ns";
+
+	return result;
+}
+
+/**
+ * @brief Reads results in the lines of the AVR sketch, other lines are skipped
+ * @param path the file
+ * @param results vector that will receive them
+ * @return false if the file cannot be read
+ */
+static bool readResults(const char* path, std::vector<Result>* results) {
+	FILE* file = fopen(path, "r");
+	char line[256];
+
+	if (file == NULL)
+		return false;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char name[128], unit[16];
+		double minimum, average, maximum;
+
+		if (sscanf(line, "%127s min %lf avg %lf max %lf %15s", name, &minimum, &average, &maximum,
+				unit) != 5)
+			continue;
+
+		Result result = { name, minimum, average, maximum, -1., unit };
+
+		results->push_back(result);
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+static bool writeResults(const char* path, const std::vector<Result>& results) {
+	FILE* file = fopen(path, "w");
+
+	if (file == NULL)
+		return false;
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+
+		int decimals = r.unit == "ns" ? 1 : 0;
+
+		fprintf(file, "%s min %.*f avg %.*f max %.*f %s\n", r.name.c_str(), decimals, r.minimum,
+				decimals, r.average, decimals, r.maximum, r.unit.c_str());
+	}
+
+	return fclose(file) == 0;
+}
+
+static const Result* findResult(const std::vector<Result>& results, const std::string& name) {
+	for (size_t i = 0; i < results.size(); i++)
+		if (results[i].name == name)
+			return &results[i];
+
+	return NULL;
+}
+
+static void printResults(const std::vector<Result>& results) {
+	printf("  %-32s %10s %10s %10s %10s\n", "kernel", "min", "avg", "p99.9", "max");
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+
+		if (r.p999 < 0.)
+			printf("  %-32s %10.0f %10.0f %10s %10.0f %s\n", r.name.c_str(), r.minimum, r.average, "-",
+					r.maximum, r.unit.c_str());
+		else
+			printf("  %-32s %10.1f %10.1f %10.1f %10.1f %s\n", r.name.c_str(), r.minimum, r.average,
+					r.p999, r.maximum, r.unit.c_str());
+	}
+}
+
+static bool isSlower(double value, double reference, double tolerance) {
+	return value > reference * (1. + tolerance / 100.) + 0.5;
+}
+
+/**
+ * @brief Compares the results to a baseline and prints the changes
+ * @param tolerance the slow down allowed (in %), negative for the default of the unit
+ * @return the number of regressions
+ */
+static unsigned compare(const std::vector<Result>& results, const std::vector<Result>& baseline,
+		double tolerance) {
+	unsigned regressions = 0;
+
+	printf("\n  %-32s %10s %10s %8s\n", "kernel", "baseline", "avg", "change");
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		const Result* b = findResult(baseline, r.name);
+
+		if (b == NULL || b->unit != r.unit) {
+			printf("  %-32s %10s %10.0f %8s\n", r.name.c_str(), "-", r.average, "new");
+			continue;
+		}
+
+		bool isCycles = r.unit == "cycles";
+		double allowed = tolerance >= 0. ? tolerance : isCycles ? BENCH_TOLERANCE_CYCLES : BENCH_TOLERANCE_NS;
+		bool isRegression = isSlower(r.average, b->average, allowed) ||
+				(isCycles && isSlower(r.maximum, b->maximum, allowed));
+
+		int decimals = isCycles ? 0 : 1;
+
+		printf("  %-32s %10.*f %10.*f %+7.1f%%%s\n", r.name.c_str(), decimals, b->average, decimals, r.average,
+				b->average > 0. ? (r.average / b->average - 1.) * 100. : 0.,
+				isRegression ? "  REGRESSION" : "");
+
+		if (isRegression)
+			regressions++;
+	}
+
+	return regressions;
+}
+
+static void usage(void) {
+	fprintf(stderr, "usage: bench [-a avr-output] [-b baseline] [-w baseline] [-t tolerance] [-n runs]\n");
+	exit(2);
+}
+
+int main(int argc, char** argv) {
+	const char* avrOutput = NULL;
+	const char* baselinePath = NULL;
+	const char* writePath = NULL;
+	double tolerance = -1.;
+	uint32_t runs = BENCH_DEFAULT_RUNS;
+	int c;
+
+	while ((c = getopt(argc, argv, "a:b:w:t:n:")) != -1) {
+		switch (c) {
+			case 'a': avrOutput = optarg; break;
+			case 'b': baselinePath = optarg; break;
+			case 'w': writePath = optarg; break;
+			case 't': tolerance = atof(optarg); break;
+			case 'n': runs = (uint32_t)atol(optarg); break;
+			default: usage();
+		}
+	}
+
+	if (optind != argc || runs == 0)
+		usage();
+
+	std::vector<Result> results;
+
+	if (avrOutput != NULL) {
+		if (!readResults(avrOutput, &results) || results.empty()) {
+			fprintf(stderr, "bench: no results in %s\n", avrOutput);
+			return 1;
+		}
+
+		printf("%s: %zu kernels on the ATmega2560\n\n", avrOutput, results.size());
+	}
+	else {
+		double overhead = clockOverhead();
+
+		printf("%zu kernels x %u runs on the host, clock overhead %.0f ns\n\n", KERNELS_COUNT, runs,
+				overhead);
+
+		for (size_t k = 0; k < KERNELS_COUNT; k++)
+			results.push_back(benchmark(_kernels[k], runs, overhead));
+	}
+
+	printResults(results);
+
+	if (writePath != NULL) {
+		if (!writeResults(writePath, results)) {
+			fprintf(stderr, "bench: cannot write %s\n", writePath);
+			return 1;
+		}
+
+		printf("\nbaseline written to %s\n", writePath);
+	}
+
+	if (baselinePath != NULL) {
+		std::vector<Result> baseline;
+
+		if (!readResults(baselinePath, &baseline)) {
+			fprintf(stderr, "bench: cannot read %s, make it with -w\n", baselinePath);
+			return 1;
+		}
+
+		unsigned regressions = compare(results, baseline, tolerance);
+
+		if (regressions > 0) {
+			printf("\n%u kernel(s) slower than %s\n", regressions, baselinePath);
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,185 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_HOST_ARDUINO_H_
+#define LEKA_MOTI_HOST_ARDUINO_H_
+
+/**
+ * @file Arduino.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief Host replacement for the Arduino core, used to build lib/ natively on Linux.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "binary.h"
+
+#ifndef ARDUINO
+#define ARDUINO 105
+#endif
+#define MOTI_HOST 1
+
+#ifndef F_CPU
+#define F_CPU 16000000L
+#endif
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define abs(x) ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define round(x) ((x)>=0?(long)((x)+0.5):(long)((x)-0.5))
+#define radians(deg) ((deg)*DEG_TO_RAD)
+#define degrees(rad) ((rad)*RAD_TO_DEG)
+#define sq(x) ((x)*(x))
+
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+
+#define _BV(bit) (1 << (bit))
+#define _SFR_BYTE(sfr) (sfr)
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef unsigned int word;
+
+// AVR registers touched directly by the drivers
+extern volatile uint8_t PORTC, PORTD, TWBR;
+
+void init(void);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+
+void noInterrupts(void);
+void interrupts(void);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned int seed);
+
+#ifdef __cplusplus
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+/**
+ * @class HardwareSerial
+ * @brief Writes to a stdio stream (stdout by default, NULL to discard) and reads from a buffer fed by the host.
+ */
+class HardwareSerial {
+	public:
+		explicit HardwareSerial(FILE* stream);
+
+		void setStream(FILE* stream);
+
+		void begin(unsigned long baud);
+		void end(void);
+		void flush(void);
+
+		int available(void);
+		int read(void);
+		int peek(void);
+		void feed(const uint8_t* data, size_t length);
+
+		size_t write(uint8_t c);
+		size_t write(const uint8_t* buffer, size_t size);
+
+		size_t print(const __FlashStringHelper* s);
+		size_t print(const char* s);
+		size_t print(char c);
+		size_t print(unsigned char n, int base = DEC);
+		size_t print(int n, int base = DEC);
+		size_t print(unsigned int n, int base = DEC);
+		size_t print(long n, int base = DEC);
+		size_t print(unsigned long n, int base = DEC);
+		size_t print(double n, int digits = 2);
+
+		size_t println(void);
+		size_t println(const __FlashStringHelper* s);
+		size_t println(const char* s);
+		size_t println(char c);
+		size_t println(unsigned char n, int base = DEC);
+		size_t println(int n, int base = DEC);
+		size_t println(unsigned int n, int base = DEC);
+		size_t println(long n, int base = DEC);
+		size_t println(unsigned long n, int base = DEC);
+		size_t println(double n, int digits = 2);
+
+		operator bool() { return true; }
+
+	private:
+		size_t printNumber(unsigned long n, int base);
+
+		FILE* _stream;
+		uint8_t _rx[256];
+		uint16_t _rxHead, _rxTail;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif // __cplusplus
+
+#endif
@@ -0,0 +1,263 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_HOST_CHIBIOS_AVR_H_
+#define LEKA_MOTI_HOST_CHIBIOS_AVR_H_
+
+/**
+ * @file ChibiOS_AVR.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief Host port of the ChibiOS/RT subset used by lib/, built on pthreads.
+ *
+ * Only the calls the modules actually make are provided. Types keep their
+ * AVR widths (systime_t is 16 bits, eventmask_t 8 bits) so that wrap-around
+ * and mask exhaustion behave as they do on the Mega.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CHIBIOS_AVR_VERSION 20140811
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+typedef bool     bool_t;
+typedef uint8_t  tmode_t;
+typedef uint8_t  tstate_t;
+typedef uint8_t  tprio_t;
+typedef int16_t  msg_t;
+typedef uint8_t  eventid_t;
+typedef uint8_t  eventmask_t;
+typedef uint8_t  flagsmask_t;
+typedef uint16_t systime_t;
+typedef int8_t   cnt_t;
+typedef uint8_t  stkalign_t;
+
+typedef msg_t (*tfunc_t)(void*);
+
+#define CH_FREQUENCY 1000
+#define CH_DBG_THREADS_PROFILING TRUE
+#define CH_DBG_FILL_THREADS TRUE
+#define CH_USE_REGISTRY TRUE
+#define CH_STACK_FILL_VALUE 0x55
+
+#define IDLEPRIO   1
+#define LOWPRIO    2
+#define NORMALPRIO 64
+#define HIGHPRIO   127
+#define ABSPRIO    255
+
+#define TIME_IMMEDIATE ((systime_t)0)
+#define TIME_INFINITE  ((systime_t)-1)
+
+#define RDY_OK      0
+#define RDY_TIMEOUT -1
+#define RDY_RESET   -2
+
+#define THD_STATE_READY    0
+#define THD_STATE_CURRENT  1
+#define THD_STATE_WTSEM    3
+#define THD_STATE_WTMTX    4
+#define THD_STATE_SLEEPING 6
+#define THD_STATE_WTOREVT  8
+#define THD_STATE_FINAL    14
+
+#define THD_TERMINATE 4
+
+#define S2ST(sec)    ((systime_t)((sec) * CH_FREQUENCY))
+#define MS2ST(msec)  ((systime_t)(((((uint32_t)(msec)) * ((uint32_t)CH_FREQUENCY) - 1UL) / 1000UL) + 1UL))
+#define US2ST(usec)  ((systime_t)(((((uint32_t)(usec)) * ((uint32_t)CH_FREQUENCY) - 1UL) / 1000000UL) + 1UL))
+
+struct HostThread;
+
+typedef struct Thread Thread;
+typedef struct Mutex Mutex;
+
+struct Thread {
+	tprio_t            p_prio;
+	const char*        p_name;
+	tstate_t           p_state;
+	tmode_t            p_flags;
+	volatile systime_t p_time;
+	Thread*            p_newer;
+	Thread*            p_older;
+	Mutex*             p_mtxlist;
+	eventmask_t        p_epending;
+	msg_t              p_exitcode;
+	struct HostThread* p_host;
+	void*              p_wsp;
+	size_t             p_wsize;
+};
+
+struct Mutex {
+	Thread* m_owner;
+	Mutex*  m_next;
+};
+
+typedef struct {
+	volatile cnt_t s_cnt;
+} Semaphore;
+
+typedef struct {
+	Semaphore bs_sem;
+} BinarySemaphore;
+
+typedef struct EventListener EventListener;
+
+struct EventListener {
+	EventListener* el_next;
+	Thread*        el_listener;
+	eventmask_t    el_mask;
+	flagsmask_t    el_flags;
+};
+
+typedef struct EventSource {
+	EventListener* es_next;
+} EventSource;
+
+#define THD_WA_SIZE(n) (sizeof(Thread) + (n))
+#define WORKING_AREA(s, n) stkalign_t s[THD_WA_SIZE(n) / sizeof(stkalign_t)]
+
+#define _MUTEX_DATA(name) {NULL, NULL}
+#define MUTEX_DECL(name) Mutex name = _MUTEX_DATA(name)
+
+#define _SEMAPHORE_DATA(name, n) {n}
+#define SEMAPHORE_DECL(name, n) Semaphore name = _SEMAPHORE_DATA(name, n)
+
+#define _BSEMAPHORE_DATA(name, taken) {_SEMAPHORE_DATA(name.bs_sem, ((taken) ? 0 : 1))}
+#define BSEMAPHORE_DECL(name, taken) BinarySemaphore name = _BSEMAPHORE_DATA(name, taken)
+
+#define _EVENTSOURCE_DATA(name) {NULL}
+#define EVENTSOURCE_DECL(name) EventSource name = _EVENTSOURCE_DATA(name)
+
+#define ALL_EVENTS      ((eventmask_t)-1)
+#define EVENT_MASK(eid) ((eventmask_t)(1 << (eid)))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// System
+	void chBegin(void (*mainThread)());
+	void chSysInit(void);
+	void chSysLock(void);
+	void chSysUnlock(void);
+	void chSchRescheduleS(void);
+	systime_t chTimeNow(void);
+	size_t chHeapMainSize(void);
+	size_t chUnusedHeapMain(void);
+	size_t chUnusedStack(void* wsp, size_t size);
+
+	// Threads
+	Thread* chThdCreateStatic(void* wsp, size_t size, tprio_t prio, tfunc_t pf, void* arg);
+	Thread* chThdSelf(void);
+	tprio_t chThdSetPriority(tprio_t newprio);
+	void chThdTerminate(Thread* tp);
+	void chThdSleep(systime_t time);
+	void chThdSleepS(systime_t time);
+	void chThdSleepUntil(systime_t time);
+	void chThdYield(void);
+	void chThdExit(msg_t msg);
+	msg_t chThdWait(Thread* tp);
+	Thread* chRegFirstThread(void);
+	Thread* chRegNextThread(Thread* tp);
+
+	// Mutexes
+	void chMtxInit(Mutex* mp);
+	void chMtxLock(Mutex* mp);
+	bool_t chMtxTryLock(Mutex* mp);
+	Mutex* chMtxUnlock(void);
+	void chMtxUnlockAll(void);
+
+	// Semaphores
+	void chSemInit(Semaphore* sp, cnt_t n);
+	void chSemReset(Semaphore* sp, cnt_t n);
+	void chSemResetI(Semaphore* sp, cnt_t n);
+	msg_t chSemWait(Semaphore* sp);
+	msg_t chSemWaitTimeout(Semaphore* sp, systime_t time);
+	void chSemSignal(Semaphore* sp);
+	void chSemSignalI(Semaphore* sp);
+
+	// Binary semaphores
+	void chBSemInit(BinarySemaphore* bsp, bool_t taken);
+	msg_t chBSemWait(BinarySemaphore* bsp);
+	msg_t chBSemWaitTimeout(BinarySemaphore* bsp, systime_t time);
+	void chBSemReset(BinarySemaphore* bsp, bool_t taken);
+	void chBSemSignal(BinarySemaphore* bsp);
+	void chBSemSignalI(BinarySemaphore* bsp);
+
+	// Events
+	void chEvtInit(EventSource* esp);
+	void chEvtRegisterMask(EventSource* esp, EventListener* elp, eventmask_t mask);
+	void chEvtUnregister(EventSource* esp, EventListener* elp);
+	eventmask_t chEvtGetAndClearEvents(eventmask_t mask);
+	eventmask_t chEvtAddEvents(eventmask_t mask);
+	flagsmask_t chEvtGetAndClearFlags(EventListener* elp);
+	void chEvtSignal(Thread* tp, eventmask_t mask);
+	void chEvtSignalI(Thread* tp, eventmask_t mask);
+	void chEvtBroadcastFlags(EventSource* esp, flagsmask_t flags);
+	void chEvtBroadcastFlagsI(EventSource* esp, flagsmask_t flags);
+	eventmask_t chEvtWaitOneTimeout(eventmask_t mask, systime_t time);
+	eventmask_t chEvtWaitAnyTimeout(eventmask_t mask, systime_t time);
+	eventmask_t chEvtWaitAllTimeout(eventmask_t mask, systime_t time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define chSysLockFromIsr()   chSysLock()
+#define chSysUnlockFromIsr() chSysUnlock()
+#define CH_IRQ_PROLOGUE()
+#define CH_IRQ_EPILOGUE()
+
+#define chTimeElapsedSince(start) ((systime_t)(chTimeNow() - (start)))
+#define chTimeIsWithin(start, end) \
+	((systime_t)(chTimeNow() - (start)) < (systime_t)((end) - (start)))
+
+#define chThdGetPriority() (chThdSelf()->p_prio)
+#define chThdGetTicks(tp) ((tp)->p_time)
+#define chThdTerminated(tp) ((tp)->p_state == THD_STATE_FINAL)
+#define chThdShouldTerminate() (chThdSelf()->p_flags & THD_TERMINATE)
+#define chThdSleepSeconds(sec) chThdSleep(S2ST(sec))
+#define chThdSleepMilliseconds(msec) chThdSleep(MS2ST(msec))
+#define chThdSleepMicroseconds(usec) chThdSleep(US2ST(usec))
+
+#define chRegSetThreadName(p) (chThdSelf()->p_name = (p))
+#define chRegGetThreadName(tp) ((tp)->p_name)
+
+#define chSemGetCounterI(sp) ((sp)->s_cnt)
+#define chBSemGetStateI(bsp) ((bsp)->bs_sem.s_cnt > 0 ? FALSE : TRUE)
+
+#define chEvtRegister(esp, elp, eid) chEvtRegisterMask(esp, elp, EVENT_MASK(eid))
+#define chEvtIsListeningI(esp) ((void*)(esp)->es_next != NULL)
+#define chEvtBroadcast(esp) chEvtBroadcastFlags(esp, 0)
+#define chEvtBroadcastI(esp) chEvtBroadcastFlagsI(esp, 0)
+#define chEvtWaitOne(mask) chEvtWaitOneTimeout(mask, TIME_INFINITE)
+#define chEvtWaitAny(mask) chEvtWaitAnyTimeout(mask, TIME_INFINITE)
+#define chEvtWaitAll(mask) chEvtWaitAllTimeout(mask, TIME_INFINITE)
+
+#endif
@@ -0,0 +1,151 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_HOST_HOST_H_
+#define LEKA_MOTI_HOST_HOST_H_
+
+/**
+ * @file Host.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief Controls for the host platform layer: clock, interrupts, EEPROM and stub I2C devices.
+ */
+
+#include <Arduino.h>
+
+namespace Host {
+
+	// Clock
+	uint64_t nowMicros(void);
+	void sleepMicros(uint64_t us);
+
+	// Manual clock: frozen until set, sleeping moves it forward at once. Only for programs
+	// that drive the modules from a single thread, see host/replay
+	void setManualClock(bool manual);
+	bool isManualClock(void);
+	void setMicros(uint64_t us);
+
+	// Virtual clock: the threads run one at a time, in ChibiOS priority order, and the clock
+	// jumps to the next timeout whenever all of them are blocked. Set it before creating
+	// any thread and keep it for the whole run. A thread that never blocks stops the others
+	void setVirtualClock(bool enabled);
+	bool isVirtualClock(void);
+
+	// External interrupts
+	void raiseInterrupt(uint8_t interruptNum);
+	bool isInterruptAttached(uint8_t interruptNum);
+
+	// Pins
+	int getPinValue(uint8_t pin);
+
+	// EEPROM, erased (0xFF) at start
+	uint8_t* getEeprom(void);
+	void eraseEeprom(void);
+
+	/**
+	 * @class I2CDevice
+	 * @brief Register-level model of an I2C slave, plugged into the host I2C layer.
+	 */
+	class I2CDevice {
+		public:
+			explicit I2CDevice(uint8_t address);
+			virtual ~I2CDevice();
+
+			uint8_t getAddress(void) const;
+
+			virtual uint8_t readRegister(uint8_t reg);
+			virtual void writeRegister(uint8_t reg, uint8_t value);
+
+			/** Called once per register read burst, before the first byte */
+			virtual void beginRead(uint8_t reg);
+
+		protected:
+			uint8_t _address;
+			uint8_t _registers[256];
+	};
+
+	void attachDevice(I2CDevice* device);
+	void detachDevice(I2CDevice* device);
+	I2CDevice* getDevice(uint8_t address);
+
+	/**
+	 * @class ADXL345Device
+	 * @brief ADXL345 model: register file, DATA_READY, a settable sample, the 32 samples FIFO
+	 * and FREE_FALL.
+	 *
+	 * Outside of bypass mode every setSample goes into the FIFO and every read of the data
+	 * registers pops the oldest entry, as on the part. FREE_FALL is set, when enabled, once the
+	 * samples have all stayed under THRESH_FF for TIME_FF on the clock, and cleared by reading
+	 * INT_SOURCE.
+	 */
+	class ADXL345Device : public I2CDevice {
+		public:
+			explicit ADXL345Device(uint8_t address = 0x53);
+
+			void setSample(int16_t x, int16_t y, int16_t z);
+
+			uint8_t readRegister(uint8_t reg);
+			void writeRegister(uint8_t reg, uint8_t value);
+			void beginRead(uint8_t reg);
+
+		private:
+			void updateFifoStatus(void);
+			void updateFreeFall(void);
+
+			int16_t _sample[3];
+			uint64_t _freeFallSince; // clock time the samples went under THRESH_FF, UINT64_MAX above
+
+			int16_t _fifo[32][3];
+			uint8_t _fifoHead; // oldest entry
+			uint8_t _fifoCount;
+	};
+
+	/**
+	 * @class ITG3200Device
+	 * @brief ITG3200 model: big-endian data registers and RAW_DATA_RDY status.
+	 */
+	class ITG3200Device : public I2CDevice {
+		public:
+			explicit ITG3200Device(uint8_t address = 0x68);
+
+			void setSample(int16_t x, int16_t y, int16_t z);
+			void setTemperature(float celsius);
+
+			uint8_t readRegister(uint8_t reg);
+			void beginRead(uint8_t reg);
+
+		private:
+			int16_t _sample[3];
+	};
+
+	/** The IMU shield devices, attached to the bus by default */
+	ADXL345Device& accelerometer(void);
+	ITG3200Device& gyroscope(void);
+
+	/**
+	 * @brief Sets the raw IMU sample the stub devices will report
+	 * @param acc accelerometer counts (256 LSB/g)
+	 * @param gyr gyroscope rate in deg/s (converted to 14.375 LSB/(deg/s))
+	 */
+	void setImuSample(const int16_t acc[3], const float gyr[3]);
+
+}
+
+#endif
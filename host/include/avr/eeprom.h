@@ -0,0 +1,43 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_HOST_AVR_EEPROM_H_
+#define LEKA_MOTI_HOST_AVR_EEPROM_H_
+
+/**
+ * @file eeprom.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief Host replacement for avr-libc's EEPROM calls, backed by Host::getEeprom().
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*! Last EEPROM address of the ATmega2560 (4 KB) */
+#define E2END 0xFFF
+
+void eeprom_read_block(void* dst, const void* src, size_t n);
+void eeprom_update_block(const void* src, void* dst, size_t n);
+void eeprom_write_block(const void* src, void* dst, size_t n);
+uint8_t eeprom_read_byte(const uint8_t* p);
+void eeprom_update_byte(uint8_t* p, uint8_t value);
+
+#endif
@@ -0,0 +1,174 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file main.cpp
+ * @brief Reads the CPU load reports of the firmware from a serial capture and tells what each
+ * thread takes
+ *
+ * The firmware sends a C,window;name,load;name,load... line (Communication::sendLoadData)
+ * every time SystemStats samples the threads, the loads in per mille of the window. Every
+ * other line of the capture is skipped. At the end of the capture it prints, per thread, the
+ * mean, min, max and last load; (other) is what no thread of the report got, the ticks of
+ * threads SystemStats had no room for.
+ *
+ *     load [-l] [capture.txt]
+ *
+ * reads the standard input when no capture is given (cat /dev/ttyUSB0 | load -l), -l also
+ * prints each report as it comes.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#define LOAD_LINE_LENGTH 512
+#define LOAD_OTHER "(other)"
+
+typedef struct {
+	double sum;
+	int min;
+	int max;
+	int last;
+	int reports;
+} ThreadLoad;
+
+/**
+ * @brief Parses a report line
+ * @param line the line, C,window;name,load...
+ * @param window receives the window (in ms)
+ * @param loads receives the name and load of each thread, (other) last
+ * @return false if it is not a report
+ */
+static bool parseReport(const char* line, unsigned long* window, std::vector<std::pair<std::string, int> >* loads) {
+	char name[LOAD_LINE_LENGTH];
+	int load, length, total = 0;
+
+	if (strncmp(line, "C,", 2) != 0 || sscanf(line + 2, "%lu%n", window, &length) != 1)
+		return false;
+
+	loads->clear();
+	line += 2 + length;
+
+	while (sscanf(line, ";%[^,;\r\n],%d%n", name, &load, &length) == 2) {
+		loads->push_back(std::make_pair(std::string(name), load));
+		total += load;
+		line += length;
+	}
+
+	loads->push_back(std::make_pair(std::string(LOAD_OTHER), total < 1000 ? 1000 - total : 0));
+
+	return true;
+}
+
+static void usage(void) {
+	fprintf(stderr, "usage: load [-l] [capture.txt]\n");
+	exit(2);
+}
+
+int main(int argc, char** argv) {
+	bool live = false;
+	int c;
+
+	while ((c = getopt(argc, argv, "l")) != -1) {
+		switch (c) {
+			case 'l': live = true; break;
+			default: usage();
+		}
+	}
+
+	if (argc - optind > 1)
+		usage();
+
+	FILE* file = optind < argc ? fopen(argv[optind], "r") : stdin;
+
+	if (file == NULL) {
+		fprintf(stderr, "load: cannot read %s\n", argv[optind]);
+		return 1;
+	}
+
+	std::map<std::string, ThreadLoad> threads;
+	std::vector<std::string> order;		// as the threads first show up
+	std::vector<std::pair<std::string, int> > loads;
+	char line[LOAD_LINE_LENGTH];
+	unsigned long window = 0;
+	int reports = 0;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (!parseReport(line, &window, &loads))
+			continue;
+
+		reports++;
+
+		if (live)
+			printf("%8lu ms", window);
+
+		for (size_t i = 0; i < loads.size(); i++) {
+			const std::string& name = loads[i].first;
+			int load = loads[i].second;
+
+			if (threads.find(name) == threads.end()) {
+				ThreadLoad first = { 0., load, load, load, 0 };
+
+				threads[name] = first;
+				order.push_back(name);
+			}
+
+			ThreadLoad& thread = threads[name];
+
+			thread.sum += load;
+			thread.min = load < thread.min ? load : thread.min;
+			thread.max = load > thread.max ? load : thread.max;
+			thread.last = load;
+			thread.reports++;
+
+			if (live)
+				printf("  %s %.1f%%", name.c_str(), load / 10.);
+		}
+
+		if (live)
+			printf("\n");
+	}
+
+	if (file != stdin)
+		fclose(file);
+
+	if (reports == 0) {
+		fprintf(stderr, "load: no C, report in the capture\n");
+		return 1;
+	}
+
+	printf("%d reports, last window %lu ms\n", reports, window);
+	printf("\n  %-24s %8s %8s %8s %8s\n", "thread", "mean", "min", "max", "last");
+
+	for (size_t i = 0; i < order.size(); i++) {
+		const ThreadLoad& thread = threads[order[i]];
+
+		printf("  %-24.24s %7.1f%% %7.1f%% %7.1f%% %7.1f%%\n", order[i].c_str(), thread.sum / thread.reports / 10.,
+				thread.min / 10., thread.max / 10., thread.last / 10.);
+	}
+
+	return 0;
+}
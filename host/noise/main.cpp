@@ -0,0 +1,571 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file main.cpp
+ * @brief Fits the NoiseModel of the IMU on recorded traces, or generates traces from one
+ *
+ * The recordings are mostly of the robot moving: only the still parts are kept, runs of at
+ * least NOISE_MIN_WINDOWS windows of NOISE_WINDOW where no axis moves more than
+ * NOISE_STILL_ACC or NOISE_STILL_GYR (standard deviation). Their overlapping Allan variance
+ * is pooled over the still parts, for every cluster time with at least NOISE_MIN_CLUSTERS
+ * clusters, and the four terms of NoiseModel.h are fitted on it: least squares on the
+ * relative error, none of the terms negative. The quantization is the most common step
+ * between two readings.
+ *
+ *     noise [-p period] [-o model.txt] trace...
+ *     noise -g model.txt [-f rate] [-t seconds] [-r seed] -o trace.txt
+ *
+ * -p sets the sample period of the CSV traces (in us, TRACE_DEFAULT_PERIOD by default).
+ * The first form prints the Allan deviation of every axis and the fit, and writes the model
+ * with -o. The second one writes a CSV trace of the IMU at rest, mean and noise of the model
+ * at -f Hz for -t seconds: fitting it again gives the model back, up to the longest cluster
+ * time the model was fitted on. Past it the random walk and the ramp are extrapolated.
+ */
+
+#include <getopt.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "NoiseModel.h"
+#include "Trace.h"
+
+/*! Still detection: window length (in s) and the largest standard deviations in it */
+#define NOISE_WINDOW 1.0
+#define NOISE_STILL_ACC 3.0		// ADXL345 counts
+#define NOISE_STILL_GYR 0.3		// deg/s
+#define NOISE_MIN_WINDOWS 2
+
+/*! Cluster times kept: at least that many non overlapping clusters in the still parts */
+#define NOISE_MIN_CLUSTERS 9
+
+/*! Cluster sizes, in samples, grow by about that factor */
+#define NOISE_TAU_STEP 1.3
+
+/*! The terms of the Allan variance, fitted as AVAR = c0 / tau + c1 + c2 tau + c3 tau^2 */
+#define NOISE_TERMS 4
+
+/*! Generated traces */
+#define NOISE_DEFAULT_DURATION 60.0	// s
+#define NOISE_DEFAULT_SEED 1
+
+typedef std::vector<float> Segment;	// one axis of one still part
+
+typedef struct {
+	double tau;						// (s)
+	double avar[NOISE_AXES];
+	size_t clusters;				// non overlapping, in all the still parts
+} AllanPoint;
+
+static uint32_t _period = TRACE_DEFAULT_PERIOD;
+
+static double getValue(const TraceSample& sample, int axis) {
+	if (axis < NOISE_GYR_X)
+		return sample.acc[axis - NOISE_ACC_X];
+
+	return sample.gyr[axis - NOISE_GYR_X] / TRACE_GYR_LSB_PER_DEG;
+}
+
+static bool isStill(const Trace& trace, size_t start, size_t length) {
+	for (int axis = 0; axis < NOISE_AXES; axis++) {
+		double sum = 0., squares = 0.;
+
+		for (size_t i = start; i < start + length; i++) {
+			double value = getValue(trace[i], axis);
+
+			sum += value;
+			squares += value * value;
+		}
+
+		double mean = sum / length;
+		double deviation = sqrt(std::max(0., squares / length - mean * mean));
+
+		if (deviation > (axis < NOISE_GYR_X ? NOISE_STILL_ACC : NOISE_STILL_GYR))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Cuts the still parts out of a trace
+ * @param trace the trace
+ * @param segments vector that will receive the still parts, NOISE_AXES segments each
+ * @return how many samples are still
+ */
+static size_t findStill(const Trace& trace, std::vector<Segment>* segments) {
+	size_t window = std::max((size_t)2, (size_t)lround(NOISE_WINDOW * 1e6 / _period));
+	size_t still = 0;
+	size_t i = 0;
+
+	while (i + window <= trace.size()) {
+		size_t end = i;
+
+		while (end + window <= trace.size() && isStill(trace, end, window))
+			end += window;
+
+		if (end - i < NOISE_MIN_WINDOWS * window) {
+			i = end + window;
+			continue;
+		}
+
+		for (int axis = 0; axis < NOISE_AXES; axis++) {
+			Segment segment;
+
+			for (size_t k = i; k < end; k++)
+				segment.push_back((float)getValue(trace[k], axis));
+
+			segments->push_back(segment);
+		}
+
+		still += end - i;
+		i = end;
+	}
+
+	return still;
+}
+
+/**
+ * @brief Overlapping Allan variance of every axis, pooled over the still parts
+ * @param segments the still parts, NOISE_AXES segments each
+ * @return the cluster times with enough clusters
+ */
+static std::vector<AllanPoint> computeAllan(const std::vector<Segment>& segments) {
+	std::vector<AllanPoint> points;
+	double tau0 = _period / 1e6;
+
+	for (size_t m = 1;; m = std::max(m + 1, (size_t)lround(m * NOISE_TAU_STEP))) {
+		AllanPoint point;
+		bool isLong = false;
+
+		point.tau = m * tau0;
+		point.clusters = 0;
+
+		for (int axis = 0; axis < NOISE_AXES; axis++) {
+			double sum = 0.;
+			size_t terms = 0;
+
+			for (size_t s = axis; s < segments.size(); s += NOISE_AXES) {
+				const Segment& y = segments[s];
+
+				if (y.size() < 2 * m)
+					continue;
+
+				if (axis == 0)
+					point.clusters += y.size() / m;
+
+				// Running sums of the clusters starting at k and k + m
+				double first = 0., second = 0.;
+
+				for (size_t k = 0; k < m; k++) {
+					first += y[k];
+					second += y[k + m];
+				}
+
+				for (size_t k = 0;; k++) {
+					double difference = (second - first) / m;
+
+					sum += difference * difference;
+					terms++;
+
+					if (k + 2 * m >= y.size())
+						break;
+
+					first += y[k + m] - y[k];
+					second += y[k + 2 * m] - y[k + m];
+				}
+
+				isLong = true;
+			}
+
+			point.avar[axis] = terms > 0 ? sum / (2. * terms) : 0.;
+		}
+
+		if (!isLong || point.clusters < NOISE_MIN_CLUSTERS)
+			break;
+
+		points.push_back(point);
+	}
+
+	return points;
+}
+
+static double getTerm(int term, double tau) {
+	return pow(tau, term - 1);
+}
+
+/**
+ * @brief Solves a small linear system in place by Gauss elimination with partial pivoting
+ * @return false if it is singular
+ */
+static bool solve(double a[NOISE_TERMS][NOISE_TERMS], double* b, int n) {
+	for (int c = 0; c < n; c++) {
+		int pivot = c;
+
+		for (int r = c + 1; r < n; r++)
+			if (fabs(a[r][c]) > fabs(a[pivot][c]))
+				pivot = r;
+
+		if (fabs(a[pivot][c]) < 1e-300)
+			return false;
+
+		for (int k = 0; k < n; k++)
+			std::swap(a[c][k], a[pivot][k]);
+
+		std::swap(b[c], b[pivot]);
+
+		for (int r = c + 1; r < n; r++) {
+			double f = a[r][c] / a[c][c];
+
+			for (int k = c; k < n; k++)
+				a[r][k] -= f * a[c][k];
+
+			b[r] -= f * b[c];
+		}
+	}
+
+	for (int c = n - 1; c >= 0; c--) {
+		for (int k = c + 1; k < n; k++)
+			b[c] -= a[c][k] * b[k];
+
+		b[c] /= a[c][c];
+	}
+
+	return true;
+}
+
+/**
+ * @brief Fits the terms of one axis: every subset of them by least squares on the relative
+ * error, the best one with no negative term wins
+ * @param points the Allan variance
+ * @param axis the axis
+ * @param coefficients array that will receive c0 to c3
+ * @return the RMS relative error of the fitted Allan deviation
+ */
+static double fitAxis(const std::vector<AllanPoint>& points, int axis, double* coefficients) {
+	double best = INFINITY;
+
+	memset(coefficients, 0, NOISE_TERMS * sizeof(double));
+
+	for (int subset = 1; subset < (1 << NOISE_TERMS); subset++) {
+		int terms[NOISE_TERMS];
+		int n = 0;
+
+		for (int t = 0; t < NOISE_TERMS; t++)
+			if (subset & (1 << t))
+				terms[n++] = t;
+
+		if ((size_t)n > points.size())
+			continue;
+
+		double a[NOISE_TERMS][NOISE_TERMS] = { { 0. } };
+		double b[NOISE_TERMS] = { 0. };
+
+		for (size_t p = 0; p < points.size(); p++) {
+			double weight = points[p].avar[axis] > 0. ? 1. / points[p].avar[axis] : 0.;
+
+			for (int i = 0; i < n; i++) {
+				double row = getTerm(terms[i], points[p].tau) * weight;
+
+				for (int j = 0; j < n; j++)
+					a[i][j] += row * getTerm(terms[j], points[p].tau) * weight;
+
+				b[i] += row * points[p].avar[axis] * weight;
+			}
+		}
+
+		if (!solve(a, b, n))
+			continue;
+
+		bool isPositive = true;
+
+		for (int i = 0; i < n; i++)
+			isPositive = isPositive && b[i] >= 0.;
+
+		if (!isPositive)
+			continue;
+
+		double error = 0.;
+
+		for (size_t p = 0; p < points.size(); p++) {
+			double fitted = 0.;
+
+			for (int i = 0; i < n; i++)
+				fitted += b[i] * getTerm(terms[i], points[p].tau);
+
+			double relative = points[p].avar[axis] > 0. ? sqrt(fitted / points[p].avar[axis]) - 1. : 0.;
+
+			error += relative * relative;
+		}
+
+		error = sqrt(error / points.size());
+
+		if (error < best) {
+			best = error;
+			memset(coefficients, 0, NOISE_TERMS * sizeof(double));
+
+			for (int i = 0; i < n; i++)
+				coefficients[terms[i]] = b[i];
+		}
+	}
+
+	return best;
+}
+
+/**
+ * @brief Most common step between the distinct readings of an axis
+ */
+static float findQuantization(const std::vector<Segment>& segments, int axis) {
+	std::vector<float> values;
+	std::map<long, size_t> steps;	// in 1e-4 units
+
+	for (size_t s = axis; s < segments.size(); s += NOISE_AXES)
+		values.insert(values.end(), segments[s].begin(), segments[s].end());
+
+	std::sort(values.begin(), values.end());
+	values.erase(std::unique(values.begin(), values.end()), values.end());
+
+	for (size_t i = 1; i < values.size(); i++)
+		steps[lround((values[i] - values[i - 1]) * 1e4)]++;
+
+	long step = 0;
+	size_t count = 0;
+
+	for (std::map<long, size_t>::const_iterator it = steps.begin(); it != steps.end(); ++it) {
+		if (it->second > count) {
+			step = it->first;
+			count = it->second;
+		}
+	}
+
+	return step / 1e4f;
+}
+
+static int fit(char** paths, int count, const char* output) {
+	std::vector<Segment> segments;
+	size_t samples = 0;
+	size_t still = 0;
+
+	for (int i = 0; i < count; i++) {
+		Trace trace;
+
+		if (!trace.read(paths[i])) {
+			fprintf(stderr, "noise: cannot read %s\n", paths[i]);
+			return 1;
+		}
+
+		if (trace.getPeriod() == TRACE_DEFAULT_PERIOD)
+			trace.setPeriod(_period);
+
+		if (trace.getPeriod() != _period) {
+			fprintf(stderr, "noise: %s is at %u us, not %u us\n", paths[i], trace.getPeriod(), _period);
+			return 1;
+		}
+
+		size_t parts = segments.size();
+		size_t length = findStill(trace, &segments);
+
+		printf("%s: %zu samples, %zu still parts, %.1f s still\n", paths[i], trace.size(),
+				(segments.size() - parts) / NOISE_AXES, length * _period / 1e6);
+
+		samples += trace.size();
+		still += length;
+	}
+
+	std::vector<AllanPoint> points = computeAllan(segments);
+
+	if (points.size() < 2) {
+		fprintf(stderr, "noise: not enough still parts to fit a model\n");
+		return 1;
+	}
+
+	printf("\nAllan deviation, %zu still parts, %.1f s of %.1f s\n\n  %8s", segments.size() / NOISE_AXES,
+			still * _period / 1e6, samples * _period / 1e6, "tau s");
+
+	for (int axis = 0; axis < NOISE_AXES; axis++)
+		printf(" %9s", NoiseModel::getAxisName(axis));
+
+	printf(" %9s\n", "clusters");
+
+	for (size_t p = 0; p < points.size(); p++) {
+		printf("  %8.3f", points[p].tau);
+
+		for (int axis = 0; axis < NOISE_AXES; axis++)
+			printf(" %9.4f", sqrt(points[p].avar[axis]));
+
+		printf(" %9zu\n", points[p].clusters);
+	}
+
+	NoiseModel model;
+
+	printf("\n  %-5s %9s %9s %9s %9s %9s %9s %9s %7s\n", "axis", "mean", "N", "B", "biasTime", "K", "R",
+			"quant", "error");
+
+	for (int axis = 0; axis < NOISE_AXES; axis++) {
+		NoiseAxisModel& a = model.axes[axis];
+		double c[NOISE_TERMS];
+		double sum = 0.;
+		size_t n = 0;
+
+		for (size_t s = axis; s < segments.size(); s += NOISE_AXES) {
+			for (size_t k = 0; k < segments[s].size(); k++)
+				sum += segments[s][k];
+
+			n += segments[s].size();
+		}
+
+		double error = fitAxis(points, axis, c);
+
+		a.mean = (float)(sum / n);
+		a.density = (float)sqrt(c[0]);
+		a.biasInstability = (float)sqrt(c[1] * M_PI / (2. * M_LN2));
+		a.randomWalk = (float)sqrt(3. * c[2]);
+		a.ramp = (float)sqrt(2. * c[3]);
+		a.quantization = findQuantization(segments, axis);
+
+		// Where the fitted deviation bottoms out, within what was measured
+		a.biasTime = 0.f;
+
+		if (c[1] > 0.) {
+			double lowest = INFINITY;
+
+			for (size_t p = 0; p < points.size(); p++) {
+				double tau = points[p].tau;
+				double fitted = c[0] / tau + c[1] + c[2] * tau + c[3] * tau * tau;
+
+				if (fitted < lowest) {
+					lowest = fitted;
+					a.biasTime = (float)tau;
+				}
+			}
+		}
+
+		printf("  %-5s %9.3f %9.4f %9.4f %9.3f %9.4f %9.5f %9.4f %6.1f%%\n", NoiseModel::getAxisName(axis),
+				a.mean, a.density, a.biasInstability, a.biasTime, a.randomWalk, a.ramp, a.quantization,
+				error * 100.);
+	}
+
+	if (output != NULL) {
+		char comment[128];
+
+		snprintf(comment, sizeof(comment), "host/noise on %d trace(s), %.1f s still, tau %.2f to %.2f s",
+				count, still * _period / 1e6, points.front().tau, points.back().tau);
+
+		if (!model.write(output, comment)) {
+			fprintf(stderr, "noise: cannot write %s\n", output);
+			return 1;
+		}
+
+		printf("\nmodel written to %s\n", output);
+	}
+
+	return 0;
+}
+
+static int generate(const char* path, const char* output, double rate, double duration, uint32_t seed) {
+	NoiseModel model;
+	NoiseGenerator generator;
+
+	if (!model.read(path)) {
+		fprintf(stderr, "noise: cannot read %s\n", path);
+		return 1;
+	}
+
+	FILE* file = fopen(output, "w");
+
+	if (file == NULL) {
+		fprintf(stderr, "noise: cannot write %s\n", output);
+		return 1;
+	}
+
+	generator.setModel(model, (float)rate, seed);
+
+	size_t count = (size_t)(duration * rate);
+
+	for (size_t i = 0; i < count; i++) {
+		float noise[NOISE_AXES];
+		float values[NOISE_AXES];
+
+		generator.step((float)(1. / rate));
+		generator.getNoise(noise);
+
+		for (int axis = 0; axis < NOISE_AXES; axis++)
+			values[axis] = generator.quantize(axis, model.axes[axis].mean + noise[axis]);
+
+		fprintf(file, "%.0f,%.0f,%.0f,%.3f,%.3f,%.3f\n", values[0], values[1], values[2], values[3], values[4],
+				values[5]);
+	}
+
+	if (fclose(file) != 0) {
+		fprintf(stderr, "noise: cannot write %s\n", output);
+		return 1;
+	}
+
+	printf("%zu samples at %.0f Hz written to %s\n", count, rate, output);
+
+	return 0;
+}
+
+static void usage(void) {
+	fprintf(stderr, "usage: noise [-p period] [-o model.txt] trace...\n"
+			"       noise -g model.txt [-f rate] [-t seconds] [-r seed] -o trace.txt\n");
+	exit(2);
+}
+
+int main(int argc, char** argv) {
+	const char* modelPath = NULL;
+	const char* output = NULL;
+	double rate = 0.;
+	double duration = NOISE_DEFAULT_DURATION;
+	uint32_t seed = NOISE_DEFAULT_SEED;
+	int c;
+
+	while ((c = getopt(argc, argv, "p:o:g:f:t:r:")) != -1) {
+		switch (c) {
+			case 'p': _period = (uint32_t)atol(optarg); break;
+			case 'o': output = optarg; break;
+			case 'g': modelPath = optarg; break;
+			case 'f': rate = atof(optarg); break;
+			case 't': duration = atof(optarg); break;
+			case 'r': seed = (uint32_t)atol(optarg); break;
+			default: usage();
+		}
+	}
+
+	if (_period == 0)
+		usage();
+
+	if (modelPath != NULL) {
+		if (optind != argc || output == NULL || duration <= 0.)
+			usage();
+
+		return generate(modelPath, output, rate > 0. ? rate : 1e6 / _period, duration, seed);
+	}
+
+	if (optind == argc)
+		usage();
+
+	return fit(argv + optind, argc - optind, output);
+}
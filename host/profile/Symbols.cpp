@@ -0,0 +1,200 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file Symbols.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cxxabi.h>
+
+#include <algorithm>
+
+#include "Symbols.h"
+
+static bool byAddress(const Symbol& a, const Symbol& b) {
+	return a.address < b.address;
+}
+
+static std::string demangle(const char* name) {
+	int status;
+	char* demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+
+	if (demangled == NULL)
+		return name;
+
+	std::string result(demangled);
+
+	free(demangled);
+
+	return result;
+}
+
+/**
+ * @brief Reads the symbol table of an ELF32 little endian file, as avr-gcc writes them
+ * @param path the file
+ * @return false if it could not be read or has no symbol table (a stripped file)
+ */
+bool Symbols::read(const char* path) {
+	FILE* file = fopen(path, "rb");
+	std::vector<uint8_t> image;
+
+	if (file == NULL)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	image.resize(ftell(file));
+	rewind(file);
+
+	bool ok = fread(image.data(), 1, image.size(), file) == image.size();
+
+	fclose(file);
+
+	if (!ok || image.size() < sizeof(Elf32_Ehdr))
+		return false;
+
+	const Elf32_Ehdr* header = (const Elf32_Ehdr*)image.data();
+
+	if (memcmp(header->e_ident, ELFMAG, SELFMAG) != 0 || header->e_ident[EI_CLASS] != ELFCLASS32 ||
+			header->e_shoff + header->e_shnum * sizeof(Elf32_Shdr) > image.size())
+		return false;
+
+	const Elf32_Shdr* sections = (const Elf32_Shdr*)(image.data() + header->e_shoff);
+
+	_functions.clear();
+	_objects.clear();
+
+	for (int s = 0; s < header->e_shnum; s++) {
+		if (sections[s].sh_type != SHT_SYMTAB || sections[s].sh_link >= header->e_shnum)
+			continue;
+
+		const Elf32_Sym* symbols = (const Elf32_Sym*)(image.data() + sections[s].sh_offset);
+		const char* names = (const char*)(image.data() + sections[sections[s].sh_link].sh_offset);
+		size_t count = sections[s].sh_size / sizeof(Elf32_Sym);
+
+		for (size_t i = 0; i < count; i++) {
+			const Elf32_Sym& symbol = symbols[i];
+			uint8_t type = ELF32_ST_TYPE(symbol.st_info);
+
+			if (symbol.st_name == 0 || symbol.st_shndx == SHN_UNDEF || symbol.st_shndx >= header->e_shnum)
+				continue;
+
+			Symbol entry = { symbol.st_value, symbol.st_size, demangle(names + symbol.st_name) };
+
+			const Elf32_Shdr& section = sections[symbol.st_shndx];
+
+			// Assembler labels (the ChibiOS port) have no type nor size: they run until the next
+			// function, or the end of their section
+			if (type == STT_FUNC || (type == STT_NOTYPE && (section.sh_flags & SHF_EXECINSTR))) {
+				if (entry.size == 0 && entry.address < section.sh_addr + section.sh_size)
+					entry.size = section.sh_addr + section.sh_size - entry.address;
+
+				_functions.push_back(entry);
+			}
+			else if (type == STT_OBJECT && entry.address >= SYMBOLS_DATA_OFFSET) {
+				entry.address -= SYMBOLS_DATA_OFFSET;
+				_objects.push_back(entry);
+			}
+		}
+	}
+
+	std::stable_sort(_functions.begin(), _functions.end(), byAddress);
+	std::sort(_objects.begin(), _objects.end(), byAddress);
+
+	// One function per address, the sized one, and none running over the next one
+	std::vector<Symbol> functions;
+
+	for (size_t i = 0; i < _functions.size(); i++) {
+		if (!functions.empty() && functions.back().address == _functions[i].address) {
+			if (functions.back().size < _functions[i].size)
+				functions.back() = _functions[i];
+			continue;
+		}
+
+		functions.push_back(_functions[i]);
+	}
+
+	for (size_t i = 0; i < functions.size(); i++) {
+		uint32_t next = i + 1 < functions.size() ? functions[i + 1].address : UINT32_MAX;
+
+		if (functions[i].address + functions[i].size > next)
+			functions[i].size = next - functions[i].address;
+	}
+
+	_functions.swap(functions);
+
+	return !_functions.empty();
+}
+
+/**
+ * @brief Finds the function holding an instruction
+ * @param pc the address of the instruction (in bytes)
+ * @return its index, -1 outside of every function
+ */
+int Symbols::findFunction(uint32_t pc) const {
+	Symbol key = { pc, 0, std::string() };
+	std::vector<Symbol>::const_iterator it = std::upper_bound(_functions.begin(), _functions.end(), key,
+			byAddress);
+
+	if (it == _functions.begin())
+		return -1;
+
+	--it;
+
+	if (pc - it->address >= it->size)
+		return -1;
+
+	return (int)(it - _functions.begin());
+}
+
+const Symbol& Symbols::getFunction(int index) const {
+	return _functions[index];
+}
+
+size_t Symbols::getFunctionCount(void) const {
+	return _functions.size();
+}
+
+/**
+ * @brief Finds the variable holding a data address, a thread working area for instance
+ * @param address the address in the data space
+ * @return the variable, NULL if none holds it
+ */
+const Symbol* Symbols::findObject(uint16_t address) const {
+	for (size_t i = 0; i < _objects.size(); i++)
+		if (address >= _objects[i].address && address < _objects[i].address + _objects[i].size)
+			return &_objects[i];
+
+	return NULL;
+}
+
+const Symbol* Symbols::getObject(const char* name) const {
+	for (size_t i = 0; i < _objects.size(); i++)
+		if (_objects[i].name == name)
+			return &_objects[i];
+
+	return NULL;
+}
@@ -0,0 +1,69 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_HOST_SYMBOLS_H_
+#define LEKA_MOTI_HOST_SYMBOLS_H_
+
+/**
+ * @file Symbols.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief The functions and variables of an avr-gcc ELF, from its symbol table.
+ *
+ * Functions are at their flash byte address, as the simulator program counter. Variables are
+ * at their data space address: avr-gcc links the SRAM at 0x800000, which is taken off. C++
+ * names are demangled.
+ */
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/*! Where avr-gcc puts the data space in the ELF address space */
+#define SYMBOLS_DATA_OFFSET 0x800000
+
+typedef struct {
+	uint32_t address;
+	uint32_t size;
+	std::string name;
+} Symbol;
+
+/**
+ * @class Symbols
+ * @brief Looks up the function at a program counter and the variable at a data address
+ */
+class Symbols {
+	public:
+		bool read(const char* path);
+
+		int findFunction(uint32_t pc) const;
+		const Symbol& getFunction(int index) const;
+		size_t getFunctionCount(void) const;
+
+		const Symbol* findObject(uint16_t address) const;
+		const Symbol* getObject(const char* name) const;
+
+	private:
+		std::vector<Symbol> _functions;	// sorted by address, without overlaps
+		std::vector<Symbol> _objects;	// sorted by address
+};
+
+#endif
@@ -0,0 +1,106 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file TwiDevice.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include "TwiDevice.h"
+
+static const char* _irqNames[] = { "8<twi.in", "8>twi.out" };
+
+TwiDevice::TwiDevice(Host::I2CDevice* device) {
+	_device = device;
+	_irq = NULL;
+	_address = 0;
+	_isSelected = false;
+	_hasRegister = false;
+	_register = 0;
+}
+
+/**
+ * @brief Plugs the device on the bus of the MCU
+ * @param avr the MCU
+ * @param twi the TWI of the MCU, the only one of the ATmega2560 by default
+ */
+void TwiDevice::attach(avr_t* avr, uint32_t twi) {
+	_irq = avr_alloc_irq(&avr->irq_pool, 0, 2, _irqNames);
+
+	avr_irq_register_notify(_irq + TWI_IRQ_OUTPUT, onMessage, this);
+
+	avr_connect_irq(_irq + TWI_IRQ_INPUT, avr_io_getirq(avr, twi, TWI_IRQ_INPUT));
+	avr_connect_irq(avr_io_getirq(avr, twi, TWI_IRQ_OUTPUT), _irq + TWI_IRQ_OUTPUT);
+}
+
+void TwiDevice::onMessage(struct avr_irq_t* irq, uint32_t value, void* param) {
+	(void)irq;
+
+	((TwiDevice*)param)->receive(value);
+}
+
+void TwiDevice::reply(uint8_t condition, uint8_t data) {
+	avr_raise_irq(_irq + TWI_IRQ_INPUT, avr_twi_irq_msg(condition, _address, data));
+}
+
+void TwiDevice::receive(uint32_t value) {
+	avr_twi_msg_irq_t message;
+
+	message.u.v = value;
+
+	if (message.u.twi.msg & TWI_COND_STOP)
+		_isSelected = false;
+
+	// A start, or a repeated start, carries the address and the read bit
+	if (message.u.twi.msg & TWI_COND_START) {
+		_isSelected = (message.u.twi.addr >> 1) == _device->getAddress();
+
+		if (!_isSelected)
+			return;
+
+		_address = message.u.twi.addr;
+
+		if (_address & 0x01)
+			_device->beginRead(_register);
+		else
+			_hasRegister = false;
+
+		reply(TWI_COND_ACK, 1);
+	}
+
+	if (!_isSelected)
+		return;
+
+	if (message.u.twi.msg & TWI_COND_WRITE) {
+		reply(TWI_COND_ACK, 1);
+
+		if (!_hasRegister) {
+			_register = message.u.twi.data;
+			_hasRegister = true;
+		}
+		else {
+			_device->writeRegister(_register++, message.u.twi.data);
+		}
+	}
+
+	if (message.u.twi.msg & TWI_COND_READ)
+		reply(TWI_COND_READ, _device->readRegister(_register++));
+}
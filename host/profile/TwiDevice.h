@@ -0,0 +1,67 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_HOST_TWIDEVICE_H_
+#define LEKA_MOTI_HOST_TWIDEVICE_H_
+
+/**
+ * @file TwiDevice.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief Puts a register model of the host layer (Host::ADXL345Device, Host::ITG3200Device)
+ * on the simavr TWI bus, so that the firmware I2C driver talks to it as to the real chip.
+ *
+ * The first byte written after the address is the register pointer, the next ones are
+ * written from it on. A read starts at the register pointer, which moves on after each byte.
+ */
+
+// simavr is C
+extern "C" {
+#include "sim_avr.h"
+#include "avr_twi.h"
+}
+
+#include "Host.h"
+
+/**
+ * @class TwiDevice
+ * @brief One I2C slave on the simulated bus
+ */
+class TwiDevice {
+	public:
+		explicit TwiDevice(Host::I2CDevice* device);
+
+		void attach(avr_t* avr, uint32_t twi = AVR_IOCTL_TWI_GETIRQ(0));
+
+	private:
+		static void onMessage(struct avr_irq_t* irq, uint32_t value, void* param);
+		void receive(uint32_t value);
+		void reply(uint8_t condition, uint8_t data);
+
+		Host::I2CDevice* _device;
+		avr_irq_t* _irq;
+
+		uint8_t _address;	// as on the bus, with the read bit
+		bool _isSelected;
+		bool _hasRegister;	// the pointer has been written in this transaction
+		uint8_t _register;
+};
+
+#endif
@@ -0,0 +1,470 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file main.cpp
+ * @brief Runs a firmware ELF (src/moti, src/Discovery...) on simavr and tells where its cycles go
+ *
+ * The ATmega2560 runs at 16 MHz with the ADXL345 and the ITG3200 of the host layer on its
+ * TWI bus, fed from recorded traces as the simulated time goes. Every instruction is counted
+ * against the function holding it, from the ELF symbols, and against the ChibiOS thread
+ * running it, rlist.r_current. Interrupt handlers count against the thread they interrupt
+ * in the thread table and under their own name in the flat profile; the CPU asleep counts
+ * as (sleep).
+ *
+ * Prints the flat profile (the -n most expensive functions), the load of each thread and
+ * the high-water mark of its stack, with the WORKING_AREA size that fits it and the
+ * -D*_THREAD_STACK build flags that apply those sizes, and with -o
+ * writes the timeline: one "start_us,duration_us,thread" line each time a thread gets the
+ * CPU.
+ *
+ *     profile [-d duration] [-p period] [-n top] [-o timeline.csv] firmware.elf trace...
+ *
+ * -d stops after that many seconds (the traces, played once, by default), -p sets the
+ * sample period of the CSV traces (in us, TRACE_DEFAULT_PERIOD by default).
+ */
+
+#include <ctype.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+// simavr is C
+extern "C" {
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "avr_twi.h"
+}
+
+#include "Symbols.h"
+#include "Trace.h"
+#include "TwiDevice.h"
+
+#define PROFILE_MCU "atmega2560"
+#define PROFILE_FREQUENCY 16000000
+#define PROFILE_DEFAULT_TOP 30
+#define PROFILE_NAME_LENGTH 24
+#define PROFILE_DEBUG_OFF_NAME 15	// of cf_off_name in chdebug_t
+#define PROFILE_DEBUG_THREAD_SIZE 10	// of ch_threadsize in chdebug_t
+#define PROFILE_STACK_FILL 0x55		// CH_STACK_FILL_VALUE
+#define PROFILE_STACK_MARGIN 32		// STACK_MONITOR_MARGIN
+/*! What THD_WA_SIZE(n) adds to n on top of the Thread on the ATmega2560: the intctx and extctx,
+ * less one byte each, and PORT_INT_REQUIRED_STACK */
+#define PROFILE_STACK_OVERHEAD 71
+
+typedef struct {
+	uint64_t cycles;
+	uint64_t runs;	// times it got the CPU
+} ThreadLoad;
+
+typedef struct {
+	uint64_t start;	// cycle
+	uint16_t thread;
+} Slice;
+
+static avr_t* _avr = NULL;
+static Symbols _symbols;
+
+// Offsets of the ChibiOS structures, from rlist and ch_debug (see chregistry.h)
+static uint16_t _currentThread = 0;	// address of rlist.r_current
+static uint16_t _debug = 0;			// address of ch_debug
+
+static uint16_t readWord(uint16_t address) {
+	return _avr->data[address] | (_avr->data[address + 1] << 8);
+}
+
+/**
+ * @brief Names a thread: its registry name when it has one (main, idle), else the working
+ * area holding it, as in Sensors::sensorsThreadArea
+ * @param thread the Thread structure address, 0 before chSysInit
+ * @return the name
+ */
+static std::string threadName(uint16_t thread) {
+	char name[PROFILE_NAME_LENGTH + 1];
+
+	if (thread == 0)
+		return "(boot)";
+
+	if (_debug != 0) {
+		uint16_t pointer = readWord(thread + _avr->data[_debug + PROFILE_DEBUG_OFF_NAME]);
+
+		if (pointer != 0 && pointer + PROFILE_NAME_LENGTH <= _avr->ramend) {
+			for (int i = 0; i < PROFILE_NAME_LENGTH; i++) {
+				name[i] = _avr->data[pointer + i];
+				name[i + 1] = '\0';
+
+				if (name[i] == '\0')
+					break;
+			}
+
+			if (name[0] != '\0')
+				return name;
+		}
+	}
+
+	const Symbol* area = _symbols.findObject(thread);
+
+	if (area != NULL)
+		return area->name;
+
+	snprintf(name, sizeof(name), "0x%04x", thread);
+
+	return name;
+}
+
+static bool byCycles(const std::pair<std::string, uint64_t>& a, const std::pair<std::string, uint64_t>& b) {
+	return a.second > b.second;
+}
+
+static void printProfile(const std::vector<uint64_t>& functions, uint64_t sleeping, uint64_t unknown,
+		uint64_t total, size_t top) {
+	std::vector<std::pair<std::string, uint64_t> > rows;
+
+	for (size_t i = 0; i < functions.size(); i++)
+		if (functions[i] > 0)
+			rows.push_back(std::make_pair(_symbols.getFunction((int)i).name, functions[i]));
+
+	if (sleeping > 0)
+		rows.push_back(std::make_pair(std::string("(sleep)"), sleeping));
+	if (unknown > 0)
+		rows.push_back(std::make_pair(std::string("(no symbol)"), unknown));
+
+	std::sort(rows.begin(), rows.end(), byCycles);
+
+	printf("\n  %-48s %14s %8s\n", "function", "cycles", "%");
+
+	for (size_t i = 0; i < rows.size() && i < top; i++)
+		printf("  %-48.48s %14llu %7.2f%%\n", rows[i].first.c_str(), (unsigned long long)rows[i].second,
+				100. * rows[i].second / total);
+
+	if (rows.size() > top)
+		printf("  ... %zu more\n", rows.size() - top);
+}
+
+static void printThreads(const std::map<uint16_t, ThreadLoad>& threads, uint64_t total) {
+	printf("\n  %-48s %14s %8s %10s\n", "thread", "cycles", "%", "runs");
+
+	for (std::map<uint16_t, ThreadLoad>::const_iterator it = threads.begin(); it != threads.end(); ++it)
+		printf("  %-48.48s %14llu %7.2f%% %10llu\n", threadName(it->first).c_str(),
+				(unsigned long long)it->second.cycles, 100. * it->second.cycles / total,
+				(unsigned long long)it->second.runs);
+}
+
+/**
+ * @brief Gets the macro that sizes a working area: the name of the area without ThreadArea,
+ * in capitals, then _THREAD_STACK, as Sensors::sensorsThreadArea and SENSORS_THREAD_STACK
+ * @param area the name of the working area symbol
+ * @return the macro, empty when the area is not named that way
+ */
+static std::string stackMacro(const std::string& area) {
+	static const std::string suffix = "ThreadArea";
+
+	size_t start = area.rfind("::");
+	start = start == std::string::npos ? 0 : start + 2;
+
+	if (area.size() <= start + suffix.size() || area.compare(area.size() - suffix.size(), suffix.size(), suffix) != 0)
+		return "";
+
+	std::string macro;
+
+	for (size_t i = start; i < area.size() - suffix.size(); i++) {
+		if (isupper(area[i]) && !macro.empty())
+			macro += '_';
+
+		macro += toupper(area[i]);
+	}
+
+	return macro + "_THREAD_STACK";
+}
+
+/**
+ * @brief Prints how deep the stack of each thread went, counting the fill pattern ChibiOS left
+ * at the bottom of its working area, and the n of WORKING_AREA(name, n) that would leave it
+ * PROFILE_STACK_MARGIN bytes. Threads whose Thread is not at the start of a working area
+ * symbol (main, on the C stack) are left out.
+ *
+ * Then the build flags that give each area the suggested size, for the areas sized by a
+ * *_THREAD_STACK macro (SENSORS_THREAD_STACK...).
+ * @param threads the threads seen during the run
+ */
+static void printStacks(const std::map<uint16_t, ThreadLoad>& threads) {
+	if (_debug == 0)
+		return;
+
+	uint8_t threadSize = _avr->data[_debug + PROFILE_DEBUG_THREAD_SIZE];
+
+	std::string flags;
+
+	printf("\n  %-48s %8s %8s %8s %10s\n", "stack", "size", "used", "free", "suggested");
+
+	for (std::map<uint16_t, ThreadLoad>::const_iterator it = threads.begin(); it != threads.end(); ++it) {
+		const Symbol* area = _symbols.findObject(it->first);
+
+		if (area == NULL || area->address != it->first || area->size <= threadSize)
+			continue;
+
+		uint32_t size = area->size - threadSize;
+		uint32_t unused = 0;
+
+		while (unused < size && _avr->data[area->address + threadSize + unused] == PROFILE_STACK_FILL)
+			unused++;
+
+		uint32_t used = size - unused;
+		uint32_t needed = used + PROFILE_STACK_MARGIN;
+
+		uint32_t suggested = needed > PROFILE_STACK_OVERHEAD ? needed - PROFILE_STACK_OVERHEAD : 0;
+		std::string macro = stackMacro(area->name);
+
+		printf("  %-48.48s %8u %8u %8u %10u%s\n", threadName(it->first).c_str(), size, used, unused,
+				suggested, unused < PROFILE_STACK_MARGIN ? "  LOW" : "");
+
+		if (!macro.empty()) {
+			char flag[64];
+
+			snprintf(flag, sizeof(flag), " -D%s=%u", macro.c_str(), suggested);
+			flags += flag;
+		}
+	}
+
+	if (!flags.empty())
+		printf("\n  build flags:%s\n", flags.c_str());
+}
+
+static bool writeTimeline(const char* path, const std::vector<Slice>& slices, uint64_t end) {
+	FILE* file = fopen(path, "w");
+	std::map<uint16_t, std::string> names;
+
+	if (file == NULL)
+		return false;
+
+	fprintf(file, "start_us,duration_us,thread\n");
+
+	for (size_t i = 0; i < slices.size(); i++) {
+		uint64_t stop = i + 1 < slices.size() ? slices[i + 1].start : end;
+
+		if (names.find(slices[i].thread) == names.end())
+			names[slices[i].thread] = threadName(slices[i].thread);
+
+		fprintf(file, "%.2f,%.2f,%s\n", slices[i].start * 1e6 / PROFILE_FREQUENCY,
+				(stop - slices[i].start) * 1e6 / PROFILE_FREQUENCY, names[slices[i].thread].c_str());
+	}
+
+	return fclose(file) == 0;
+}
+
+static void usage(void) {
+	fprintf(stderr, "usage: profile [-d duration] [-p period] [-n top] [-o timeline.csv] firmware.elf trace...\n");
+	exit(2);
+}
+
+int main(int argc, char** argv) {
+	double duration = 0.;
+	uint32_t period = TRACE_DEFAULT_PERIOD;
+	size_t top = PROFILE_DEFAULT_TOP;
+	const char* timelinePath = NULL;
+	int c;
+
+	while ((c = getopt(argc, argv, "d:p:n:o:")) != -1) {
+		switch (c) {
+			case 'd': duration = atof(optarg); break;
+			case 'p': period = (uint32_t)atol(optarg); break;
+			case 'n': top = (size_t)atol(optarg); break;
+			case 'o': timelinePath = optarg; break;
+			default: usage();
+		}
+	}
+
+	if (argc - optind < 2 || period == 0)
+		usage();
+
+	const char* elfPath = argv[optind++];
+
+	// Traces, back to back
+	std::vector<TraceSample> samples;
+
+	for (int i = optind; i < argc; i++) {
+		Trace trace;
+
+		trace.setPeriod(period);
+
+		if (!trace.read(argv[i])) {
+			fprintf(stderr, "profile: cannot read %s\n", argv[i]);
+			return 1;
+		}
+
+		period = trace.getPeriod();
+
+		for (size_t n = 0; n < trace.size(); n++)
+			samples.push_back(trace[n]);
+	}
+
+	if (duration <= 0.)
+		duration = samples.size() * (period / 1e6);
+
+	// Firmware
+	elf_firmware_t firmware;
+
+	memset(&firmware, 0, sizeof(firmware));
+
+	if (elf_read_firmware(elfPath, &firmware) != 0 || !_symbols.read(elfPath)) {
+		fprintf(stderr, "profile: cannot read %s, or it has no symbols\n", elfPath);
+		return 1;
+	}
+
+	strcpy(firmware.mmcu, PROFILE_MCU);
+	firmware.frequency = PROFILE_FREQUENCY;
+
+	_avr = avr_make_mcu_by_name(PROFILE_MCU);
+
+	if (_avr == NULL || avr_init(_avr) != 0) {
+		fprintf(stderr, "profile: simavr does not know the %s\n", PROFILE_MCU);
+		return 1;
+	}
+
+	avr_load_firmware(_avr, &firmware);
+
+	const Symbol* rlist = _symbols.getObject("rlist");
+	const Symbol* debug = _symbols.getObject("ch_debug");
+
+	if (rlist == NULL || rlist->size < 2) {
+		fprintf(stderr, "profile: no rlist in %s, it does not run ChibiOS\n", elfPath);
+		return 1;
+	}
+
+	_currentThread = rlist->address + rlist->size - 2;	// r_current is the last field
+	_debug = debug != NULL ? debug->address : 0;
+
+	// IMU shield
+	Host::ADXL345Device accelerometer;
+	Host::ITG3200Device gyroscope;
+	TwiDevice accelerometerBus(&accelerometer);
+	TwiDevice gyroscopeBus(&gyroscope);
+
+	accelerometerBus.attach(_avr);
+	gyroscopeBus.attach(_avr);
+
+	// Run
+	const uint64_t end = (uint64_t)(duration * PROFILE_FREQUENCY);
+	const uint64_t cyclesPerSample = (uint64_t)period * (PROFILE_FREQUENCY / 1000000);
+
+	std::vector<uint64_t> functions(_symbols.getFunctionCount(), 0);
+	std::map<uint16_t, ThreadLoad> threads;
+	std::vector<Slice> slices;
+	uint64_t sleeping = 0, unknown = 0;
+	size_t sample = SIZE_MAX;
+
+	int function = -1;
+	uint32_t functionStart = 1, functionEnd = 0;
+	uint16_t thread = 0xFFFF;
+	ThreadLoad* load = NULL;
+	int state = cpu_Running;
+
+	timespec start, stop;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (_avr->cycle < end && state != cpu_Done && state != cpu_Crashed) {
+		size_t next = (size_t)(_avr->cycle / cyclesPerSample) % samples.size();
+
+		if (next != sample) {
+			sample = next;
+			accelerometer.setSample(samples[sample].acc[0], samples[sample].acc[1], samples[sample].acc[2]);
+			gyroscope.setSample(samples[sample].gyr[0], samples[sample].gyr[1], samples[sample].gyr[2]);
+		}
+
+		uint16_t current = readWord(_currentThread);
+
+		if (current != thread) {
+			Slice slice = { _avr->cycle, current };
+
+			thread = current;
+			load = &threads[thread];
+			load->runs++;
+			slices.push_back(slice);
+		}
+
+		uint32_t pc = _avr->pc;
+		bool isSleeping = _avr->state == cpu_Sleeping;
+		uint64_t before = _avr->cycle;
+
+		state = avr_run(_avr);
+
+		uint64_t cycles = _avr->cycle - before;
+
+		load->cycles += cycles;
+
+		if (isSleeping) {
+			sleeping += cycles;
+			continue;
+		}
+
+		if (pc < functionStart || pc >= functionEnd) {
+			function = _symbols.findFunction(pc);
+
+			if (function >= 0) {
+				functionStart = _symbols.getFunction(function).address;
+				functionEnd = functionStart + _symbols.getFunction(function).size;
+			}
+			else {
+				functionStart = 1;
+				functionEnd = 0;
+			}
+		}
+
+		if (function >= 0)
+			functions[function] += cycles;
+		else
+			unknown += cycles;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	uint64_t total = _avr->cycle;
+	double simulated = (double)total / PROFILE_FREQUENCY;
+	double wall = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("%s: %.1f s simulated in %.1f s (x%.2f), %llu cycles, %zu trace samples\n", elfPath, simulated,
+			wall, simulated / wall, (unsigned long long)total, samples.size());
+
+	if (state == cpu_Crashed)
+		printf("the firmware crashed at pc 0x%05x\n", _avr->pc);
+
+	printProfile(functions, sleeping, unknown, total, top);
+	printThreads(threads, total);
+	printStacks(threads);
+
+	if (timelinePath != NULL) {
+		if (!writeTimeline(timelinePath, slices, total)) {
+			fprintf(stderr, "profile: cannot write %s\n", timelinePath);
+			return 1;
+		}
+
+		printf("\n%zu slices written to %s\n", slices.size(), timelinePath);
+	}
+
+	return state == cpu_Crashed ? 1 : 0;
+}
@@ -0,0 +1,74 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+
+/**
+ * @file Score.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include "Score.h"
+
+/**
+ * @brief Scores a detector against the label of one sample
+ * @param score the score of the detector, zeroed before the first sample
+ * @param now the clock time of the sample (in us)
+ * @param period the time the sample lasts (in us)
+ * @param labelled true if the sample has the label the detector follows
+ * @param active true if the detector is active, once updated for the sample
+ * @param fired true if the detector has just become active
+ * @return true if it is a false positive
+ */
+bool scoreSample(Score* score, uint64_t now, uint32_t period, bool labelled, bool active, bool fired) {
+	if (labelled && !score->isLabelled) {
+		score->events++;
+		score->onset = now;
+		score->isCaught = false;
+	}
+
+	if (!labelled && score->isLabelled)
+		score->end = now;
+
+	score->isLabelled = labelled;
+
+	if (labelled && active && !score->isCaught) {
+		uint64_t latency = now - score->onset;
+
+		score->isCaught = true;
+		score->caught++;
+		score->latencyUs += latency;
+
+		if (latency > score->maxLatencyUs)
+			score->maxLatencyUs = latency;
+	}
+
+	if (labelled)
+		return false;
+
+	score->quietUs += period;
+
+	if (fired && (score->events == 0 || now - score->end > SCORE_LABEL_GRACE)) {
+		score->falsePositives++;
+		return true;
+	}
+
+	return false;
+}
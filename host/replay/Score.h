@@ -0,0 +1,56 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+
+#ifndef LEKA_MOTI_HOST_SCORE_H_
+#define LEKA_MOTI_HOST_SCORE_H_
+
+/**
+ * @file Score.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief A Moti detector scored against the labels of a trace, sample after sample.
+ *
+ * A labelled event is caught when the detector is active at some point during it, its
+ * latency runs from the onset of the event. Firing with no event going on is a false
+ * positive, except in the SCORE_LABEL_GRACE that follows the end of an event.
+ */
+
+#include <stdint.h>
+
+/*! How long a detector may still fire after the end of a labelled event (in us) */
+#define SCORE_LABEL_GRACE 1000000
+
+typedef struct {
+	bool isLabelled;	// an event is going on
+	bool isCaught;		// and the detector fired during it
+	uint64_t onset;		// clock time of the event start (in us)
+	uint64_t end;		// clock time of the last event end (in us)
+	uint32_t events;
+	uint32_t caught;
+	uint64_t latencyUs;
+	uint64_t maxLatencyUs;
+	uint32_t falsePositives;
+	uint64_t quietUs;	// time without any event
+} Score;
+
+bool scoreSample(Score* score, uint64_t now, uint32_t period, bool labelled, bool active, bool fired);
+
+#endif
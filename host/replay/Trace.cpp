@@ -0,0 +1,182 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file Trace.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Trace.h"
+
+Trace::Trace(void) {
+	_period = TRACE_DEFAULT_PERIOD;
+}
+
+/**
+ * @brief Reads a trace, binary if it starts with TRACE_MAGIC and CSV otherwise
+ * @param path the file
+ * @return false if it could not be opened or holds no sample
+ */
+bool Trace::read(const char* path) {
+	FILE* file = fopen(path, "rb");
+	char magic[4];
+	bool ok;
+
+	if (file == NULL)
+		return false;
+
+	_samples.clear();
+	_labels.clear();
+
+	if (fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, TRACE_MAGIC, 4) == 0) {
+		rewind(file);
+		ok = readBinary(file);
+	}
+	else {
+		rewind(file);
+		ok = readCsv(file);
+	}
+
+	fclose(file);
+
+	return ok && !_samples.empty();
+}
+
+/**
+ * @brief Writes the trace in the binary format
+ * @param path the file
+ * @return false if it could not be written
+ */
+bool Trace::write(const char* path) const {
+	FILE* file = fopen(path, "wb");
+	TraceHeader header;
+
+	if (file == NULL)
+		return false;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRACE_MAGIC, 4);
+	header.version = TRACE_VERSION;
+	header.period = _period;
+	header.count = (uint32_t)_samples.size();
+
+	if (hasLabels())
+		header.flags |= TRACE_FLAG_LABELS;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(_samples.data(), sizeof(TraceSample), _samples.size(), file) == _samples.size()
+		&& fwrite(_labels.data(), 1, _labels.size(), file) == _labels.size();
+
+	return fclose(file) == 0 && ok;
+}
+
+uint32_t Trace::getPeriod(void) const {
+	return _period;
+}
+
+/**
+ * @brief Sets the time between two samples, the CSV traces do not record it
+ * @param period the period (in us)
+ */
+void Trace::setPeriod(uint32_t period) {
+	_period = period;
+}
+
+size_t Trace::size(void) const {
+	return _samples.size();
+}
+
+const TraceSample& Trace::operator[](size_t index) const {
+	return _samples[index];
+}
+
+bool Trace::hasLabels(void) const {
+	return !_labels.empty();
+}
+
+/**
+ * @brief Gets what was happening during a sample
+ * @param index the sample
+ * @return the TRACE_LABEL_ bits, 0 for a trace without labels
+ */
+uint8_t Trace::getLabels(size_t index) const {
+	return _labels.empty() ? 0 : _labels[index];
+}
+
+bool Trace::readBinary(FILE* file) {
+	TraceHeader header;
+
+	if (fread(&header, sizeof(header), 1, file) != 1 || header.version != TRACE_VERSION)
+		return false;
+
+	_period = header.period;
+	_samples.resize(header.count);
+
+	if (fread(_samples.data(), sizeof(TraceSample), header.count, file) != header.count)
+		return false;
+
+	if (header.flags & TRACE_FLAG_LABELS) {
+		_labels.resize(header.count);
+
+		return fread(_labels.data(), 1, header.count, file) == header.count;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Reads CSV lines up to the first one that is not a sample, the first sample tells
+ * whether the trace is labelled
+ */
+bool Trace::readCsv(FILE* file) {
+	float acc[3], gyr[3];
+	int labels[4];
+	char line[256];
+	TraceSample sample;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		int fields = sscanf(line, "%f,%f,%f,%f,%f,%f,%d,%d,%d,%d", &acc[0], &acc[1], &acc[2], &gyr[0],
+				&gyr[1], &gyr[2], &labels[0], &labels[1], &labels[2], &labels[3]);
+
+		if (fields != 6 && fields != 10)
+			break;
+
+		if (!_samples.empty() && (fields == 10) != hasLabels())
+			return false;
+
+		for (int i = 0; i < 3; i++) {
+			sample.acc[i] = (int16_t)lrintf(acc[i]);
+			sample.gyr[i] = (int16_t)lrintf(gyr[i] * TRACE_GYR_LSB_PER_DEG);
+		}
+
+		_samples.push_back(sample);
+
+		if (fields == 10)
+			_labels.push_back((labels[0] ? TRACE_LABEL_SHAKEN : 0) | (labels[1] ? TRACE_LABEL_SPINNING : 0)
+					| (labels[2] ? TRACE_LABEL_STUCK : 0) | (labels[3] ? TRACE_LABEL_FALLING : 0));
+	}
+
+	return true;
+}
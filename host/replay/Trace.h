@@ -0,0 +1,107 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_HOST_TRACE_H_
+#define LEKA_MOTI_HOST_TRACE_H_
+
+/**
+ * @file Trace.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief Recorded IMU traces, as CSV or as the compact binary equivalent.
+ *
+ * A CSV trace has one "accX,accY,accZ,gyrX,gyrY,gyrZ" line per sample, the accelerometer in
+ * raw counts and the gyroscope in deg/s, as written by test/simulationMotor. A binary trace
+ * is a TraceHeader followed by one TraceSample per sample, both little endian: 12 bytes per
+ * sample instead of about 40.
+ *
+ * A labelled trace also tells what was happening to the robot, for host/replay to score the
+ * Moti detectors: four more CSV columns "shaken,spinning,stuck,falling", 0 or 1, and in
+ * the binary format TRACE_FLAG_LABELS and one TRACE_LABEL_ byte per sample after the samples.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+/*! First bytes of a binary trace */
+#define TRACE_MAGIC "MTRC"
+#define TRACE_VERSION 1
+
+/*! TraceHeader flags */
+#define TRACE_FLAG_LABELS 0x01
+
+/*! What was happening during a sample, as many as there are */
+#define TRACE_LABEL_SHAKEN   0x01
+#define TRACE_LABEL_SPINNING 0x02
+#define TRACE_LABEL_STUCK    0x04
+#define TRACE_LABEL_FALLING  0x08
+
+/*! Sample period of the test/simulationMotor recordings (in us) */
+#define TRACE_DEFAULT_PERIOD 50000
+
+/*! ITG3200 counts per deg/s, the binary traces keep the raw gyroscope readings */
+#define TRACE_GYR_LSB_PER_DEG 14.375f
+
+typedef struct {
+	char magic[4];
+	uint8_t version;
+	uint8_t flags;
+	uint8_t reserved[2];
+	uint32_t period; // between two samples (in us)
+	uint32_t count;
+} TraceHeader;
+
+typedef struct {
+	int16_t acc[3]; // ADXL345 counts
+	int16_t gyr[3]; // ITG3200 counts
+} TraceSample;
+
+/**
+ * @class Trace
+ * @brief A whole trace in memory, read from either format
+ */
+class Trace {
+	public:
+		Trace(void);
+
+		bool read(const char* path);
+		bool write(const char* path) const;
+
+		uint32_t getPeriod(void) const;
+		void setPeriod(uint32_t period);
+
+		size_t size(void) const;
+		const TraceSample& operator[](size_t index) const;
+
+		bool hasLabels(void) const;
+		uint8_t getLabels(size_t index) const;
+
+	private:
+		bool readBinary(FILE* file);
+		bool readCsv(FILE* file);
+
+		uint32_t _period;
+		std::vector<TraceSample> _samples;
+		std::vector<uint8_t> _labels;	// empty when it has none
+};
+
+#endif
@@ -0,0 +1,343 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file main.cpp
+ * @brief Replays recorded IMU traces through the firmware modules and reports what they cost
+ *
+ * Every trace sample is put on the stub accelerometer and gyroscope and runs one
+ * Sensors::step, then the Moti detectors and Stabilization::step run at the period of
+ * their threads. All of it happens on one thread: by default on a manual clock that
+ * jumps from sample to sample (as fast as the host goes), with -r on the real clock (as
+ * fast as the robot goes). On the manual clock a module sleeping in its step
+ * (Stabilization::wiggle) only delays its own next step, as if it had its own thread; on
+ * the real clock it holds the replay back, which catches up afterwards.
+ *
+ * Reports, per module, the host time spent per call and per trace sample, and for each
+ * detector how often and how long it fired. With labelled traces (see Trace.h, sim -s events
+ * writes some) it also scores each detector against its label: how many labelled events it
+ * caught and how late after their onset, and how often it fired with no event going on,
+ * SCORE_LABEL_GRACE after the end of one excepted (see Score.h).
+ *
+ *     replay [-r] [-e] [-n repeat] [-p period] [-o output.mtr] trace...
+ *
+ * -e prints every detector change, -n plays the traces that many times back to back,
+ * -p sets the sample period of the CSV traces (in us, TRACE_DEFAULT_PERIOD by default),
+ * -o writes the traces to one binary trace instead of playing them.
+ */
+
+#include <getopt.h>
+#include <time.h>
+
+#include "Score.h"
+#include "Trace.h"
+
+#include <Arduino.h>
+#include "ChibiOS_AVR.h"
+#include "Host.h"
+
+#include "Sensors.h"
+#include "Moti.h"
+#include "DriveSystem.h"
+#include "Stabilization.h"
+
+/*! Periods of the module threads (in us), see _threadDelay in Moti.cpp and Stabilization.h */
+#define REPLAY_MOTI_PERIOD 100000
+#define REPLAY_STABILIZATION_PERIOD 100000
+
+typedef struct {
+	const char* name;
+	void (*step)(void);
+	uint32_t period;	// between two steps (in us), 0 for every sample
+	uint64_t next;		// clock time of the next step (in us)
+	uint64_t calls;
+	double totalNs;
+	double maxNs;
+} Module;
+
+typedef struct {
+	const char* name;
+	bool (*state)(void);
+	uint8_t label;		// the TRACE_LABEL_ it should follow, 0 for none
+	bool active;
+	uint64_t since;		// clock time it became active (in us)
+	uint32_t count;
+	uint64_t activeUs;
+} Detector;
+
+static bool isDriving(void) {
+	return DriveSystem::getRightMotorSpeed() != 0 || DriveSystem::getLeftMotorSpeed() != 0;
+}
+
+static Module modules[] = {
+	{ "Sensors::step", Sensors::step, 0, 0, 0, 0., 0. },
+	{ "Moti::detectStuck", Moti::detectStuck, REPLAY_MOTI_PERIOD, 0, 0, 0., 0. },
+	{ "Moti::detectSpin", Moti::detectSpin, REPLAY_MOTI_PERIOD, 0, 0, 0., 0. },
+	{ "Moti::detectShake", Moti::detectShake, REPLAY_MOTI_PERIOD, 0, 0, 0., 0. },
+	{ "Moti::detectFall", Moti::detectFall, REPLAY_MOTI_PERIOD, 0, 0, 0., 0. },
+	{ "Stabilization::step", Stabilization::step, REPLAY_STABILIZATION_PERIOD, 0, 0, 0., 0. }
+};
+
+static Detector detectors[] = {
+	{ "stuck", Moti::isStuck, TRACE_LABEL_STUCK, false, 0, 0, 0 },
+	{ "spinning", Moti::isSpinning, TRACE_LABEL_SPINNING, false, 0, 0, 0 },
+	{ "shaken", Moti::isShaken, TRACE_LABEL_SHAKEN, false, 0, 0, 0 },
+	{ "falling", Moti::isFalling, TRACE_LABEL_FALLING, false, 0, 0, 0 },
+	{ "driving", isDriving, 0, false, 0, 0, 0 }
+};
+
+static const size_t N_MODULES = sizeof(modules) / sizeof(modules[0]);
+static const size_t N_DETECTORS = sizeof(detectors) / sizeof(detectors[0]);
+
+static Score scores[N_DETECTORS];
+
+static bool _printEvents = false;
+
+static double elapsedNs(const timespec& start, const timespec& end) {
+	return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+/**
+ * @brief Runs one step of a module and times it, the clock is then put back where it was
+ * @param module the module
+ * @param now the clock time of the sample (in us)
+ */
+static void runModule(Module* module, uint64_t now) {
+	timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	module->step();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double ns = elapsedNs(start, end);
+
+	module->calls++;
+	module->totalNs += ns;
+
+	if (ns > module->maxNs)
+		module->maxNs = ns;
+
+	// What the step slept delays its next step only
+	uint64_t slept = Host::nowMicros() - now;
+
+	if (Host::isManualClock())
+		Host::setMicros(now);
+
+	module->next = now + slept + module->period;
+}
+
+static void scoreDetector(const Detector& detector, Score* score, uint64_t now, uint32_t period,
+		uint8_t labels, bool fired) {
+	bool labelled = (labels & detector.label) != 0;
+
+	if (scoreSample(score, now, period, labelled, detector.active, fired) && _printEvents)
+		printf("%10.3f s  %-9s false positive\n", now / 1e6, detector.name);
+}
+
+static void watchDetectors(uint64_t now, uint32_t period, bool isLabelled, uint8_t labels) {
+	for (size_t i = 0; i < N_DETECTORS; i++) {
+		Detector* detector = &detectors[i];
+		bool active = detector->state();
+		bool fired = active && !detector->active;
+
+		if (active == detector->active) {
+			if (isLabelled && detector->label != 0)
+				scoreDetector(*detector, &scores[i], now, period, labels, false);
+
+			continue;
+		}
+
+		if (active) {
+			detector->count++;
+			detector->since = now;
+		}
+		else {
+			detector->activeUs += now - detector->since;
+		}
+
+		detector->active = active;
+
+		if (_printEvents)
+			printf("%10.3f s  %-9s %s\n", now / 1e6, detector->name, active ? "on" : "off");
+
+		if (isLabelled && detector->label != 0)
+			scoreDetector(*detector, &scores[i], now, period, labels, fired);
+	}
+}
+
+static void setSample(const TraceSample& sample) {
+	Host::accelerometer().setSample(sample.acc[0], sample.acc[1], sample.acc[2]);
+	Host::gyroscope().setSample(sample.gyr[0], sample.gyr[1], sample.gyr[2]);
+}
+
+static void usage(void) {
+	fprintf(stderr, "usage: replay [-r] [-e] [-n repeat] [-p period] [-o output.mtr] trace...\n");
+	exit(2);
+}
+
+int main(int argc, char** argv) {
+	bool realTime = false;
+	unsigned repeat = 1;
+	uint32_t period = TRACE_DEFAULT_PERIOD;
+	const char* output = NULL;
+	int c;
+
+	while ((c = getopt(argc, argv, "ren:p:o:")) != -1) {
+		switch (c) {
+			case 'r': realTime = true; break;
+			case 'e': _printEvents = true; break;
+			case 'n': repeat = (unsigned)atoi(optarg); break;
+			case 'p': period = (uint32_t)atol(optarg); break;
+			case 'o': output = optarg; break;
+			default: usage();
+		}
+	}
+
+	if (optind >= argc || repeat == 0 || period == 0)
+		usage();
+
+	std::vector<Trace> traces(argc - optind);
+	size_t samples = 0;
+	size_t labelled = 0;
+
+	for (int i = optind; i < argc; i++) {
+		Trace* trace = &traces[i - optind];
+
+		trace->setPeriod(period);
+
+		if (!trace->read(argv[i])) {
+			fprintf(stderr, "replay: cannot read %s\n", argv[i]);
+			return 1;
+		}
+
+		samples += trace->size();
+
+		if (trace->hasLabels())
+			labelled++;
+	}
+
+	// Scores only mean something over the whole replay
+	bool isLabelled = labelled == traces.size();
+
+	if (labelled > 0 && !isLabelled)
+		fprintf(stderr, "replay: %zu of %zu traces are labelled, the detectors are not scored\n", labelled,
+				traces.size());
+
+	if (output != NULL) {
+		if (traces.size() != 1 || !traces[0].write(output)) {
+			fprintf(stderr, "replay: -o takes one trace, and %s must be writable\n", output);
+			return 1;
+		}
+
+		printf("%s: %zu samples, %zu bytes\n", output, traces[0].size(),
+				sizeof(TraceHeader) + traces[0].size() * sizeof(TraceSample));
+		return 0;
+	}
+
+	Serial.setStream(NULL);
+	Host::setManualClock(!realTime);
+
+	// The gyroscope is zeroed on the first sample, as it is at boot
+	setSample(traces[0][0]);
+
+	Sensors::setup();
+	Stabilization::start();
+
+	uint64_t now = Host::nowMicros();
+	timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (unsigned r = 0; r < repeat; r++) {
+		for (size_t t = 0; t < traces.size(); t++) {
+			const Trace& trace = traces[t];
+
+			for (size_t n = 0; n < trace.size(); n++) {
+				now += trace.getPeriod();
+
+				if (realTime) {
+					uint64_t clock = Host::nowMicros();
+
+					if (now > clock)
+						Host::sleepMicros(now - clock);
+				}
+				else {
+					Host::setMicros(now);
+				}
+
+				setSample(trace[n]);
+
+				for (size_t i = 0; i < N_MODULES; i++)
+					if (now >= modules[i].next)
+						runModule(&modules[i], now);
+
+				watchDetectors(now, trace.getPeriod(), isLabelled, trace.getLabels(n));
+			}
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double wall = elapsedNs(start, end) / 1e9;
+	double played = (double)samples * repeat * traces[0].getPeriod() / 1e6;
+
+	printf("%zu samples x %u, %.1f s of trace in %.3f s (x%.0f)\n", samples, repeat, played, wall,
+			played / wall);
+
+	printf("\n  %-22s %10s %12s %12s %14s\n", "module", "calls", "ns/call", "max ns", "ns/sample");
+
+	for (size_t i = 0; i < N_MODULES; i++) {
+		const Module& module = modules[i];
+
+		printf("  %-22s %10llu %12.0f %12.0f %14.1f\n", module.name, (unsigned long long)module.calls,
+				module.calls ? module.totalNs / module.calls : 0., module.maxNs,
+				module.totalNs / (samples * repeat));
+	}
+
+	printf("\n  %-22s %10s %12s\n", "detector", "count", "active s");
+
+	for (size_t i = 0; i < N_DETECTORS; i++) {
+		Detector* detector = &detectors[i];
+
+		if (detector->active)
+			detector->activeUs += now - detector->since;
+
+		printf("  %-22s %10u %12.1f\n", detector->name, detector->count, detector->activeUs / 1e6);
+	}
+
+	if (!isLabelled)
+		return 0;
+
+	printf("\n  %-22s %10s %10s %12s %12s %10s %10s\n", "against labels", "events", "caught", "latency ms",
+			"max ms", "false", "false/min");
+
+	for (size_t i = 0; i < N_DETECTORS; i++) {
+		const Score& score = scores[i];
+
+		if (detectors[i].label == 0)
+			continue;
+
+		printf("  %-22s %10u %10u %12.0f %12.0f %10u %10.2f\n", detectors[i].name, score.events, score.caught,
+				score.caught ? score.latencyUs / 1e3 / score.caught : 0., score.maxLatencyUs / 1e3,
+				score.falsePositives, score.quietUs ? score.falsePositives * 60e6 / score.quietUs : 0.);
+	}
+
+	return 0;
+}
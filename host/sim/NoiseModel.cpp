@@ -0,0 +1,204 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file NoiseModel.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "NoiseModel.h"
+
+/*! Allan deviation of a Gauss-Markov process: it peaks at NOISE_MARKOV_PEAK sigma for
+ * tau = NOISE_MARKOV_PEAK_TIME Tc. The bias instability floor is at sqrt(2 ln2 / pi) B */
+#define NOISE_MARKOV_PEAK 0.6174f
+#define NOISE_MARKOV_PEAK_TIME 1.89f
+#define NOISE_FLICKER_FLOOR 0.6643f
+
+static const char* _axisNames[NOISE_AXES] = { "accX", "accY", "accZ", "gyrX", "gyrY", "gyrZ" };
+
+NoiseModel::NoiseModel(void) {
+	memset(axes, 0, sizeof(axes));
+}
+
+/**
+ * @brief Reads a model file, the axes it leaves out have no noise
+ * @param path the file
+ * @return false if it cannot be read or a line is not an axis
+ */
+bool NoiseModel::read(const char* path) {
+	FILE* file = fopen(path, "r");
+	char line[256];
+	bool ok = true;
+
+	if (file == NULL)
+		return false;
+
+	memset(axes, 0, sizeof(axes));
+
+	while (ok && fgets(line, sizeof(line), file) != NULL) {
+		char name[16];
+		NoiseAxisModel a;
+
+		char* comment = strchr(line, '#');
+
+		if (comment != NULL)
+			*comment = '\0';
+
+		if (sscanf(line, "%15s", name) != 1)
+			continue;
+
+		int axis = 0;
+
+		while (axis < NOISE_AXES && strcmp(name, _axisNames[axis]) != 0)
+			axis++;
+
+		ok = axis < NOISE_AXES && sscanf(line, "%*s %f %f %f %f %f %f %f", &a.mean, &a.density,
+				&a.biasInstability, &a.biasTime, &a.randomWalk, &a.ramp, &a.quantization) == 7;
+
+		if (ok)
+			axes[axis] = a;
+	}
+
+	fclose(file);
+
+	return ok;
+}
+
+/**
+ * @brief Writes the model file
+ * @param path the file
+ * @param comment written first as # lines, where the model comes from for instance, or NULL
+ * @return false if it could not be written
+ */
+bool NoiseModel::write(const char* path, const char* comment) const {
+	FILE* file = fopen(path, "w");
+
+	if (file == NULL)
+		return false;
+
+	if (comment != NULL)
+		fprintf(file, "# %s\n", comment);
+
+	fprintf(file, "# axis mean N B biasTime K R quantization\n");
+	fprintf(file, "# acc in ADXL345 counts, gyr in deg/s; N /sqrt(Hz), K /sqrt(s), R /s, biasTime s\n");
+
+	for (int i = 0; i < NOISE_AXES; i++) {
+		const NoiseAxisModel& a = axes[i];
+
+		fprintf(file, "%s %.4g %.4g %.4g %.4g %.4g %.4g %.4g\n", _axisNames[i], a.mean, a.density,
+				a.biasInstability, a.biasTime, a.randomWalk, a.ramp, a.quantization);
+	}
+
+	return fclose(file) == 0;
+}
+
+const char* NoiseModel::getAxisName(int axis) {
+	return _axisNames[axis];
+}
+
+NoiseGenerator::NoiseGenerator(void) {
+	setModel(NoiseModel(), 1.f, 1);
+}
+
+/**
+ * @brief Starts the noise of a model over, all the slow terms at zero
+ * @param model the model
+ * @param rate how often the readings are taken (in Hz): the white noise of one reading is N sqrt(rate),
+ * less the quantization noise that rounding it adds
+ * @param seed of the generator, the same seed gives the same noise
+ */
+void NoiseGenerator::setModel(const NoiseModel& model, float rate, uint32_t seed) {
+	std::uniform_int_distribution<int> coin(0, 1);
+
+	_model = model;
+	_random.seed(seed);
+	_time = 0.f;
+
+	for (int i = 0; i < NOISE_AXES; i++) {
+		const NoiseAxisModel& a = _model.axes[i];
+
+		float white = a.density * a.density * rate - a.quantization * a.quantization / 12.f;
+
+		_white[i] = white > 0.f ? sqrtf(white) : 0.f;
+		_markovSigma[i] = a.biasInstability * NOISE_FLICKER_FLOOR / NOISE_MARKOV_PEAK;
+		_slope[i] = coin(_random) ? a.ramp : -a.ramp;
+
+		_markov[i] = 0.f;
+		_walk[i] = 0.f;
+	}
+}
+
+const NoiseModel& NoiseGenerator::getModel(void) const {
+	return _model;
+}
+
+/**
+ * @brief Moves the slow terms forward
+ * @param dt the time since the previous step (in s)
+ */
+void NoiseGenerator::step(float dt) {
+	std::normal_distribution<float> normal(0.f, 1.f);
+
+	for (int i = 0; i < NOISE_AXES; i++) {
+		const NoiseAxisModel& a = _model.axes[i];
+
+		if (_markovSigma[i] > 0.f && a.biasTime > 0.f) {
+			float decay = expf(-dt * NOISE_MARKOV_PEAK_TIME / a.biasTime);
+
+			_markov[i] = decay * _markov[i] + _markovSigma[i] * sqrtf(1.f - decay * decay) * normal(_random);
+		}
+
+		if (a.randomWalk > 0.f)
+			_walk[i] += a.randomWalk * sqrtf(dt) * normal(_random);
+	}
+
+	_time += dt;
+}
+
+/**
+ * @brief Gets the noise of one reading, mean excluded
+ * @param noise array that will receive every axis, in the NoiseAxis order
+ */
+void NoiseGenerator::getNoise(float* noise) {
+	std::normal_distribution<float> normal(0.f, 1.f);
+
+	for (int i = 0; i < NOISE_AXES; i++)
+		noise[i] = _white[i] * normal(_random) + _markov[i] + _walk[i] + _slope[i] * _time;
+}
+
+/**
+ * @brief Rounds a reading to the quantization of its axis
+ * @param axis the NoiseAxis
+ * @param value the reading
+ * @return the rounded reading
+ */
+float NoiseGenerator::quantize(int axis, float value) const {
+	float step = _model.axes[axis].quantization;
+
+	if (step <= 0.f)
+		return value;
+
+	return roundf(value / step) * step;
+}
@@ -0,0 +1,117 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_HOST_NOISE_MODEL_H_
+#define LEKA_MOTI_HOST_NOISE_MODEL_H_
+
+/**
+ * @file NoiseModel.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief Noise of the ADXL345 and ITG3200 at rest, per axis, and a generator of it.
+ *
+ * Each axis has the usual four terms of its Allan variance, as host/noise fits them on
+ * recordings:
+ *
+ *     AVAR(tau) = N^2 / tau + B^2 * 2 ln2 / pi + K^2 * tau / 3 + R^2 * tau^2 / 2
+ *
+ * white noise of density N, bias instability B (the flat floor, reached around tau = biasTime),
+ * rate random walk K and rate ramp R. The generator makes the white noise at the rate it is
+ * sampled, the bias instability with a first order Gauss-Markov process whose Allan deviation
+ * peaks at B around biasTime, the random walk by integration and the ramp as a constant
+ * slope of random sign.
+ *
+ * The model file has one line per axis, # starts a comment:
+ *
+ *     axis mean N B biasTime K R quantization
+ *
+ * the accelerometer in ADXL345 counts and the gyroscope in deg/s, N in unit/sqrt(Hz), K in
+ * unit/sqrt(s), R in unit/s, biasTime in s.
+ */
+
+#include <stdint.h>
+
+#include <random>
+
+/*! The axes, in the order of the model file */
+enum NoiseAxis {
+	NOISE_ACC_X,
+	NOISE_ACC_Y,
+	NOISE_ACC_Z,
+	NOISE_GYR_X,
+	NOISE_GYR_Y,
+	NOISE_GYR_Z,
+	NOISE_AXES
+};
+
+typedef struct {
+	float mean;				// at rest, in the recording orientation
+	float density;			// N, white noise (unit/sqrt(Hz))
+	float biasInstability;	// B (unit)
+	float biasTime;			// where the Allan deviation reaches B (s)
+	float randomWalk;		// K (unit/sqrt(s))
+	float ramp;				// R (unit/s)
+	float quantization;		// step of the readings (unit), 0 for none
+} NoiseAxisModel;
+
+/**
+ * @class NoiseModel
+ * @brief The model of every axis, read from and written to the model file
+ */
+class NoiseModel {
+	public:
+		NoiseModel(void);
+
+		bool read(const char* path);
+		bool write(const char* path, const char* comment) const;
+
+		static const char* getAxisName(int axis);
+
+		NoiseAxisModel axes[NOISE_AXES];
+};
+
+/**
+ * @class NoiseGenerator
+ * @brief Noise on every axis of a NoiseModel, for readings taken at a given rate
+ */
+class NoiseGenerator {
+	public:
+		NoiseGenerator(void);
+
+		void setModel(const NoiseModel& model, float rate, uint32_t seed);
+		const NoiseModel& getModel(void) const;
+
+		void step(float dt);
+		void getNoise(float* noise);
+		float quantize(int axis, float value) const;
+
+	private:
+		NoiseModel _model;
+		std::mt19937 _random;
+		float _white[NOISE_AXES];		// standard deviation of one reading
+		float _markovSigma[NOISE_AXES];	// stationary standard deviation of the bias instability
+		float _slope[NOISE_AXES];		// the ramp, with its sign
+
+		float _markov[NOISE_AXES];
+		float _walk[NOISE_AXES];
+		float _time;					// since setModel (s)
+};
+
+#endif
@@ -0,0 +1,293 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file Sphere.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include <math.h>
+
+#include "Sphere.h"
+
+#define SPHERE_GRAVITY 9.81f
+#define SPHERE_ACC_LSB_PER_G 256.f
+
+Sphere::Sphere(void) {
+	SphereNoise noise = { 0.f, 0.f, { 0.f, 0.f, 0.f }, 1 };
+
+	setParameters(defaultParameters());
+	setNoise(noise);
+	setNoiseModel(NULL, 1.f);
+
+	_left = _right = 0.f;
+	_isBlocked = false;
+	_handRate = 0.f;
+	_handAcc[0] = _handAcc[1] = _handAcc[2] = 0.f;
+	_isFalling = false;
+
+	_alpha = _alphaRate = _alphaAcc = 0.f;
+	_theta = _thetaRate = 0.f;
+	_yaw = _yawRate = 0.f;
+	_x = _y = 0.f;
+}
+
+/**
+ * @brief Gets the parameters of the robot as far as we know them
+ * @return the parameters
+ */
+SphereParameters Sphere::defaultParameters(void) {
+	SphereParameters p;
+
+	p.motorRpm = 260.f;
+	p.wheelRadius = 0.02f;
+	p.wheelOffset = 0.06f;
+	p.shellRadius = 0.09f;
+
+	p.shellMass = 0.15f;
+	p.pendulumMass = 0.6f;
+	p.pendulumLength = 0.03f;
+	p.pendulumInertia = 0.0004f;
+
+	p.stallTorque = 0.04f;
+	p.rollingFriction = 0.002f;
+	p.internalFriction = 0.001f;
+	p.yawTimeConstant = 0.1f;
+
+	return p;
+}
+
+void Sphere::setParameters(const SphereParameters& parameters) {
+	_p = parameters;
+}
+
+void Sphere::setNoise(const SphereNoise& noise) {
+	_noise = noise;
+	_random.seed(noise.seed);
+}
+
+/**
+ * @brief Makes the IMU noise the one of a fitted model (see host/noise) instead of the white
+ * noise of setNoise, whose bias still adds up. Seeded with the seed of setNoise, call it after.
+ * @param model the model, NULL to go back to the white noise
+ * @param rate how often the firmware reads the IMU (in Hz), for the white noise of one reading
+ *
+ * The gyroscope mean of the model is added, an offset that Sensors takes off at boot as the
+ * real one. The accelerometer mean is not: it is gravity in the orientation of the recording.
+ */
+void Sphere::setNoiseModel(const NoiseModel* model, float rate) {
+	_hasNoiseModel = model != NULL;
+
+	if (_hasNoiseModel)
+		_generator.setModel(*model, rate, _noise.seed);
+}
+
+/**
+ * @brief Sets the motor commands, as DriveSystem gives them
+ * @param left the left motor, -1 (BACKWARD at 255) to 1 (FORWARD at 255)
+ * @param right the right motor
+ */
+void Sphere::setMotors(float left, float right) {
+	_left = left;
+	_right = right;
+}
+
+/**
+ * @brief Blocks the shell, against a wall for instance: the pendulum still swings and spins
+ * @param blocked true to block it
+ */
+void Sphere::setBlocked(bool blocked) {
+	_isBlocked = blocked;
+
+	if (blocked)
+		_alphaRate = _alphaAcc = 0.f;
+}
+
+/**
+ * @brief Turns the robot by hand: the spin rate follows the hand instead of the motors
+ * @param yawRate the rate (in rad/s), 0 to let go
+ */
+void Sphere::setHandRate(float yawRate) {
+	_handRate = yawRate;
+}
+
+/**
+ * @brief Shakes the robot by hand: the IMU feels this on top of the rest
+ * @param x the acceleration along the IMU X axis (in m/s^2)
+ * @param y along Y
+ * @param z along Z
+ */
+void Sphere::setHandAcceleration(float x, float y, float z) {
+	_handAcc[0] = x;
+	_handAcc[1] = y;
+	_handAcc[2] = z;
+}
+
+/**
+ * @brief Drops the robot: the IMU feels no specific force, gravity included, until it lands
+ * @param falling true while in the air
+ */
+void Sphere::setFalling(bool falling) {
+	_isFalling = falling;
+}
+
+/**
+ * @brief Moves the model forward (semi-implicit Euler), dt of 1 ms or less
+ * @param dt the time step (in s)
+ */
+void Sphere::step(float dt) {
+	if (_hasNoiseModel)
+		_generator.step(dt);
+
+	const float R = _p.shellRadius;
+	const float L = _p.pendulumLength;
+	const float mp = _p.pendulumMass;
+	const float ratio = _p.wheelOffset / _p.wheelRadius;
+	const float maxWheelRate = _p.motorRpm * 2.f * M_PI / 60.f;
+
+	// Forward: the wheels turn at the shell rate relative to the pendulum, times d / r
+	float relativeRate = _alphaRate - _thetaRate;
+	float wheelRate = relativeRate * ratio;
+	float wheelTorque = _p.stallTorque * (_left + _right) - 2.f * _p.stallTorque * wheelRate / maxWheelRate;
+	float torque = wheelTorque * ratio;
+	float friction = _p.internalFriction * (_thetaRate - _alphaRate);
+
+	float shellInertia = 5.f / 3.f * _p.shellMass * R * R; // thin shell rolling on the floor
+	float a11 = shellInertia + mp * R * R;
+	float a12 = mp * R * L * cosf(_theta);
+	float a22 = mp * L * L + _p.pendulumInertia;
+	float f1 = torque - _p.rollingFriction * _alphaRate + friction + mp * R * L * sinf(_theta) * _thetaRate * _thetaRate;
+	float f2 = -torque - mp * SPHERE_GRAVITY * L * sinf(_theta) - friction;
+	float thetaAcc;
+
+	if (_isBlocked) {
+		_alphaAcc = 0.f;
+		thetaAcc = f2 / a22;
+	}
+	else {
+		float det = a11 * a22 - a12 * a12;
+
+		_alphaAcc = (f1 * a22 - f2 * a12) / det;
+		thetaAcc = (a11 * f2 - a12 * f1) / det;
+	}
+
+	_alphaRate += _alphaAcc * dt;
+	_thetaRate += thetaAcc * dt;
+	_alpha += _alphaRate * dt;
+	_theta += _thetaRate * dt;
+
+	// Spin: the wheel speed difference, first order
+	float spinRate = (_right - _left) * maxWheelRate / (2.f * ratio);
+
+	if (_handRate != 0.f)
+		_yawRate = _handRate;
+	else
+		_yawRate += (spinRate - _yawRate) * dt / _p.yawTimeConstant;
+
+	_yaw += _yawRate * dt;
+
+	float velocity = _alphaRate * R;
+
+	_x += velocity * cosf(_yaw) * dt;
+	_y += velocity * sinf(_yaw) * dt;
+}
+
+/**
+ * @brief Gets what the IMU reads, noise and bias included
+ * @param acc array that will receive the ADXL345 X, Y, Z (in counts)
+ * @param gyr array that will receive the ITG3200 X, Y, Z (in deg/s)
+ */
+void Sphere::getImu(int16_t* acc, float* gyr) {
+	std::normal_distribution<float> normal(0.f, 1.f);
+	float noise[NOISE_AXES];
+
+	if (_hasNoiseModel) {
+		_generator.getNoise(noise);
+
+		for (int i = 0; i < 3; i++)
+			noise[NOISE_GYR_X + i] += _generator.getModel().axes[NOISE_GYR_X + i].mean;
+	}
+	else {
+		for (int i = 0; i < 3; i++) {
+			noise[NOISE_ACC_X + i] = _noise.accNoise * normal(_random);
+			noise[NOISE_GYR_X + i] = _noise.gyrNoise * normal(_random);
+		}
+	}
+
+	// The IMU pitches with the pendulum: nose down when it swings back
+	float pitch = -_theta;
+	float pitchRate = -_thetaRate;
+
+	// Specific force in the yaw frame, then in the IMU frame
+	float forward = _alphaAcc * _p.shellRadius;
+	float lateral = _alphaRate * _p.shellRadius * _yawRate;
+	float force[3] = {
+		cosf(pitch) * forward - sinf(pitch) * SPHERE_GRAVITY,
+		lateral,
+		sinf(pitch) * forward + cosf(pitch) * SPHERE_GRAVITY
+	};
+	float rates[3] = {
+		-_yawRate * sinf(pitch),
+		pitchRate,
+		_yawRate * cosf(pitch)
+	};
+
+	for (int i = 0; i < 3; i++) {
+		// Nothing pushes on a falling IMU, not even the floor
+		float specific = _isFalling ? 0.f : force[i] + _handAcc[i];
+		float counts = specific / SPHERE_GRAVITY * SPHERE_ACC_LSB_PER_G + noise[NOISE_ACC_X + i];
+
+		acc[i] = (int16_t)lrintf(counts);
+		gyr[i] = rates[i] * 180.f / M_PI + _noise.gyrBias[i] + noise[NOISE_GYR_X + i];
+	}
+}
+
+float Sphere::getX(void) const {
+	return _x;
+}
+
+float Sphere::getY(void) const {
+	return _y;
+}
+
+/**
+ * @brief Gets the spin angle, positive to the left (counterclockwise seen from above)
+ * @return the angle (in rad), unwrapped
+ */
+float Sphere::getYaw(void) const {
+	return _yaw;
+}
+
+/**
+ * @brief Gets the pitch of the IMU, positive nose down
+ * @return the angle (in rad)
+ */
+float Sphere::getPitch(void) const {
+	return -_theta;
+}
+
+float Sphere::getVelocity(void) const {
+	return _alphaRate * _p.shellRadius;
+}
+
+float Sphere::getYawRate(void) const {
+	return _yawRate;
+}
@@ -0,0 +1,127 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_HOST_SPHERE_H_
+#define LEKA_MOTI_HOST_SPHERE_H_
+
+/**
+ * @file Sphere.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief Rigid body model of the shell and its internal two wheels pendulum.
+ *
+ * The geometry is the one of test/OscillationCorr (PWMtoLinVel): 260 RPM motors, wheels of
+ * radius r = 0.02 m at d = 0.06 m from the center, shell of radius R = 0.09 m, so that the
+ * shell rolls at V = R * r * w / d for a wheel rate w. The masses, torques and frictions are
+ * estimates, to be fitted on recordings.
+ *
+ * Forward motion is the planar shell + pendulum system: the shell rolls without slipping
+ * (angle alpha), the pendulum swings around the axle (angle theta from the vertical, positive
+ * forward) and the motors apply their torque between the two. Spinning is first order: the
+ * wheel speed difference turns the pendulum, and the IMU with it, around the vertical.
+ *
+ * The IMU sits at the center on the pendulum: X forward, Y left (the axle), Z up at rest.
+ */
+
+#include <stdint.h>
+
+#include <random>
+
+#include "NoiseModel.h"
+
+typedef struct {
+	// Geometry, from test/OscillationCorr
+	float motorRpm;			// no load speed at PWM 255
+	float wheelRadius;		// r (m)
+	float wheelOffset;		// d, wheels to center (m)
+	float shellRadius;		// R (m)
+
+	// Masses
+	float shellMass;		// thin shell (kg)
+	float pendulumMass;		// motors, batteries and boards (kg)
+	float pendulumLength;	// center to the pendulum center of mass (m)
+	float pendulumInertia;	// around its center of mass (kg.m^2)
+
+	// Motors and losses
+	float stallTorque;		// per motor, at the wheel (N.m)
+	float rollingFriction;	// shell on the floor (N.m.s)
+	float internalFriction;	// pendulum on the shell (N.m.s)
+	float yawTimeConstant;	// of the spin rate (s)
+} SphereParameters;
+
+typedef struct {
+	float accNoise;			// standard deviation (in ADXL345 counts)
+	float gyrNoise;			// standard deviation (in deg/s)
+	float gyrBias[3];		// added to the rates (in deg/s)
+	uint32_t seed;
+} SphereNoise;
+
+/**
+ * @class Sphere
+ * @brief The plant: motor commands in, ADXL345 and ITG3200 readings out
+ */
+class Sphere {
+	public:
+		Sphere(void);
+
+		static SphereParameters defaultParameters(void);
+
+		void setParameters(const SphereParameters& parameters);
+		void setNoise(const SphereNoise& noise);
+		void setNoiseModel(const NoiseModel* model, float rate);
+
+		void setMotors(float left, float right);
+		void setBlocked(bool blocked);
+		void setHandRate(float yawRate);
+		void setHandAcceleration(float x, float y, float z);
+		void setFalling(bool falling);
+
+		void step(float dt);
+
+		void getImu(int16_t* acc, float* gyr);
+
+		// State
+		float getX(void) const;
+		float getY(void) const;
+		float getYaw(void) const;
+		float getPitch(void) const;
+		float getVelocity(void) const;
+		float getYawRate(void) const;
+
+	private:
+		SphereParameters _p;
+		SphereNoise _noise;
+		std::mt19937 _random;
+		bool _hasNoiseModel;
+		NoiseGenerator _generator;
+
+		float _left, _right;	// commands, -1 (BACKWARD at 255) to 1 (FORWARD at 255)
+		bool _isBlocked;
+		float _handRate;		// (rad/s), 0 when nobody holds it
+		float _handAcc[3];		// in the IMU frame (m/s^2)
+		bool _isFalling;
+
+		float _alpha, _alphaRate, _alphaAcc;	// shell roll (rad)
+		float _theta, _thetaRate;				// pendulum swing (rad)
+		float _yaw, _yawRate;					// (rad)
+		float _x, _y;							// on the floor (m)
+};
+
+#endif
@@ -0,0 +1,586 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file main.cpp
+ * @brief Runs the firmware modules closed loop on the Sphere model
+ *
+ * DriveSystem's speeds and directions drive the model, the model's IMU readings go to the
+ * stub ADXL345 and ITG3200, every SIM_PLANT_PERIOD.
+ *
+ *   stabilize  Stabilization holds the robot still, after -k seconds a hand turns it by -y
+ *              degrees in SIM_TURN_DURATION. Reports how long it took to come back under
+ *              Stabilization's threshold, the overshoot and the motor effort. Runs on one
+ *              thread on the manual clock, as fast as the host goes.
+ *   spin       -n Motion::spinDeg of -y degrees, alternately left and right, at speed -v.
+ *              Reports the angle each spin stopped the motors at, which must be within
+ *              SIM_SPIN_TOLERANCE of -y, and the angle turned once the robot coasted.
+ *   wander     Wander drives around in a square arena, walls -w meters away from the start.
+ *              Reports when Moti::isStuck fired and how the robot got away.
+ *   events     No firmware: every SIM_EVENTS_CYCLE the robot is spun by hand, shaken, driven
+ *              against a wall at speed -v and dropped, to record a labelled trace with -o.
+ *              The direction and the shaken axis change from cycle to cycle.
+ *
+ * spin and wander run the module threads, Light and Heart included for wander, on the
+ * virtual clock: as fast as the host goes and the same run every time. With -R they run
+ * on the real clock, as fast as the robot goes.
+ *
+ *     sim [-s scenario] [-R] [-t seconds] [-a acc noise] [-g gyr noise] [-b gyr bias] [-r seed]
+ *         [-N model.txt] [-k kick time] [-y degrees] [-n spins] [-v speed] [-w wall] [-c] [-o trace.txt]
+ *
+ * -a in ADXL345 counts, -g and -b in deg/s, -N replaces the noise of -a and -g with a model
+ * that host/noise fitted (test/simulationMotor/noise/imu.txt), -c prints the state every SIM_PRINT_PERIOD as CSV,
+ * -o writes the IMU every TRACE_DEFAULT_PERIOD as a labelled trace (see replay/Trace.h): spun
+ * and shaken by the hand of the scenario, stuck while the motors push against a wall.
+ * Exits with 0 when the scenario reached its goal.
+ */
+
+#include <getopt.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "Sphere.h"
+#include "Trace.h"
+
+#include <Arduino.h>
+#include "ChibiOS_AVR.h"
+#include "Host.h"
+
+#include "Sensors.h"
+#include "Moti.h"
+#include "Motion.h"
+#include "DriveSystem.h"
+#include "Stabilization.h"
+#include "Light.h"
+#include "Heart.h"
+#include "Wander.h"
+
+/*! Model step and IMU update (in us) */
+#define SIM_PLANT_PERIOD 1000
+
+/*! Periods of the module threads (in us), see Sensors.cpp and Stabilization.h */
+#define SIM_SENSORS_PERIOD 50000
+#define SIM_STABILIZATION_PERIOD 100000
+
+/*! Largest error of the angle a spin stops the motors at, as a share of the angle asked. The
+ * coast that follows, about a yaw time constant, is reported but not checked */
+#define SIM_SPIN_TOLERANCE 0.25f
+
+/*! How long the hand takes to turn the robot in stabilize (in us) */
+#define SIM_TURN_DURATION 500000
+
+/*! Period of the -c output (in us) */
+#define SIM_PRINT_PERIOD 50000
+
+/*! The events scenario (in s from the start of each cycle, and SI units) */
+#define SIM_EVENTS_CYCLE 23.f
+#define SIM_EVENTS_SPIN_START 3.f
+#define SIM_EVENTS_SPIN_END 5.f
+#define SIM_EVENTS_SPIN_RATE (2.f * M_PI)
+#define SIM_EVENTS_SHAKE_START 8.f
+#define SIM_EVENTS_SHAKE_END 10.f
+#define SIM_EVENTS_SHAKE_AMPLITUDE 15.f
+#define SIM_EVENTS_SHAKE_FREQUENCY 4.f
+#define SIM_EVENTS_PUSH_START 13.f
+#define SIM_EVENTS_PUSH_END 16.f
+#define SIM_EVENTS_DROP_START 19.f
+#define SIM_EVENTS_DROP_END 19.4f
+
+/*! Stabilization acts on yaw errors above PI / 9, see Stabilization::step */
+#define SIM_YAW_THRESHOLD (M_PI / 9)
+
+typedef struct {
+	const char* scenario;
+	float duration;		// (s)
+	float kickTime;		// (s)
+	float angle;		// kick or spin (deg)
+	unsigned spins;
+	uint8_t speed;
+	float wall;			// (m)
+	bool realTime;
+	bool csv;
+	const char* trace;
+} Options;
+
+static Options _options = { "stabilize", 0.f, 3.f, 60.f, 4, 125, 1.f, false, false, NULL };
+
+static Sphere _sphere;
+static NoiseModel _noiseModel;
+static uint64_t _plantTime = 0;	// model time (in us)
+static float _effort = 0.f;		// integral of the squared commands (in s at full PWM)
+static bool _isBlocked = false;
+static uint8_t _handLabels = 0;		// TRACE_LABEL_ of what the hand of the scenario does
+static FILE* _trace = NULL;
+static int _status = 1;
+
+static int getLeftSpeed(void) {
+	int speed = DriveSystem::getLeftMotorSpeed();
+
+	return DriveSystem::getLeftMotorDirection() == FORWARD ? speed : -speed;
+}
+
+static int getRightSpeed(void) {
+	int speed = DriveSystem::getRightMotorSpeed();
+
+	return DriveSystem::getRightMotorDirection() == FORWARD ? speed : -speed;
+}
+
+static void printState(void) {
+	printf("%.3f,%.4f,%.4f,%.2f,%.2f,%.3f,%d,%d,%.2f\n", _plantTime / 1e6, _sphere.getX(), _sphere.getY(),
+			_sphere.getYaw() * 180.f / M_PI, _sphere.getPitch() * 180.f / M_PI, _sphere.getVelocity(),
+			getLeftSpeed(), getRightSpeed(), Sensors::getHeadingDeg());
+}
+
+/**
+ * @brief Moves the model one SIM_PLANT_PERIOD forward with the current motor commands and
+ * puts its IMU readings on the stub devices
+ */
+static void stepPlant(void) {
+
+	float left = getLeftSpeed() / 255.f;
+	float right = getRightSpeed() / 255.f;
+	float dt = SIM_PLANT_PERIOD / 1e6f;
+
+	_sphere.setMotors(left, right);
+	_sphere.step(dt);
+	_effort += (left * left + right * right) * dt;
+	_plantTime += SIM_PLANT_PERIOD;
+
+	int16_t acc[3];
+	float gyr[3];
+
+	_sphere.getImu(acc, gyr);
+	Host::setImuSample(acc, gyr);
+
+	if (_options.csv && _plantTime % SIM_PRINT_PERIOD == 0)
+		printState();
+
+	if (_trace != NULL && _plantTime % TRACE_DEFAULT_PERIOD == 0) {
+		bool isStuck = _isBlocked && (left != 0.f || right != 0.f);
+
+		fprintf(_trace, "%d,%d,%d,%.2f,%.2f,%.2f,%d,%d,%d,%d\n", acc[0], acc[1], acc[2], gyr[0], gyr[1], gyr[2],
+				(_handLabels & TRACE_LABEL_SHAKEN) != 0, (_handLabels & TRACE_LABEL_SPINNING) != 0, isStuck,
+				(_handLabels & TRACE_LABEL_FALLING) != 0);
+	}
+
+}
+
+static float wrapPi(float angle) {
+	return atan2f(sinf(angle), cosf(angle));
+}
+
+/**
+ * @brief stabilize: every module on this thread, the clock jumps from model step to model step
+ *
+ * As in host/replay, a module sleeping in its step (Stabilization::wiggle) only delays its
+ * own next step, and the model keeps the last commands while it sleeps.
+ */
+static void runStabilize(void) {
+
+	uint64_t end = (uint64_t)((_options.duration > 0.f ? _options.duration : 15.f) * 1e6);
+	uint64_t kickAt = (uint64_t)(_options.kickTime * 1e6);
+	float kick = _options.angle * M_PI / 180.f;
+
+	Host::setManualClock(true);
+	Host::setMicros(0);
+
+	stepPlant();
+	Sensors::setup();
+
+	// Setup sleeps through the gyroscope calibration: the firmware clock carries on from there
+	uint64_t clockStart = Host::nowMicros() - _plantTime;
+
+	Stabilization::start();
+
+	uint64_t nextSensors = 0;
+	uint64_t nextStabilization = 0;
+	uint64_t settledAt = 0;
+	bool kicked = false;
+	float maxError = 0.f;
+	float overshoot = 0.f;
+	float effortAtKick = 0.f;
+
+	while (_plantTime < end) {
+		stepPlant();
+
+		uint64_t now = _plantTime;
+
+		Host::setMicros(clockStart + now);
+
+		if (!kicked && now >= kickAt) {
+			_sphere.setHandRate(kick * 1e6f / SIM_TURN_DURATION);
+			_handLabels = TRACE_LABEL_SPINNING;
+			effortAtKick = _effort;
+			kicked = true;
+		}
+
+		if (now == kickAt + SIM_TURN_DURATION) {
+			_sphere.setHandRate(0.f);
+			_handLabels = 0;
+		}
+
+		if (now >= nextSensors) {
+			Sensors::step();
+			nextSensors = now + SIM_SENSORS_PERIOD;
+		}
+
+		if (now >= nextStabilization) {
+			Stabilization::step();
+
+			nextStabilization = Host::nowMicros() - clockStart + SIM_STABILIZATION_PERIOD;
+			Host::setMicros(clockStart + now);
+		}
+
+		if (!kicked)
+			continue;
+
+		float error = wrapPi(_sphere.getYaw());
+
+		if (fabs(error) > maxError)
+			maxError = fabs(error);
+
+		// Past zero, against the kick
+		if (error * kick < 0.f && fabs(error) > overshoot)
+			overshoot = fabs(error);
+
+		if (fabs(error) > SIM_YAW_THRESHOLD)
+			settledAt = 0;
+		else if (settledAt == 0)
+			settledAt = now;
+	}
+
+	float finalError = wrapPi(_sphere.getYaw()) * 180.f / M_PI;
+
+	printf("kick: %.1f deg at %.1f s, largest error: %.1f deg\n", _options.angle, _options.kickTime,
+			maxError * 180.f / M_PI);
+
+	if (settledAt != 0)
+		printf("settled: %.2f s after the kick, ", (settledAt - kickAt) / 1e6);
+	else
+		printf("not settled, ");
+
+	printf("overshoot: %.1f deg, final error: %.1f deg, effort: %.2f s\n", overshoot * 180.f / M_PI,
+			finalError, _effort - effortAtKick);
+
+	if (settledAt != 0 && fabs(finalError) < SIM_YAW_THRESHOLD * 180.f / M_PI)
+		_status = 0;
+
+}
+
+static bool isBetween(float t, float start, float end) {
+	return t >= start && t < end;
+}
+
+/**
+ * @brief events: the model alone, on this thread, for -o
+ */
+static void runEvents(void) {
+
+	uint64_t end = (uint64_t)((_options.duration > 0.f ? _options.duration : 2.f * SIM_EVENTS_CYCLE) * 1e6);
+	bool wasPushing = false;
+
+	Host::setManualClock(true);
+	Host::setMicros(0);
+
+	while (_plantTime < end) {
+		float t = fmodf(_plantTime / 1e6f, SIM_EVENTS_CYCLE);
+		unsigned cycle = (unsigned)(_plantTime / 1e6f / SIM_EVENTS_CYCLE);
+		float sign = cycle % 2 == 0 ? 1.f : -1.f;
+
+		bool isSpun = isBetween(t, SIM_EVENTS_SPIN_START, SIM_EVENTS_SPIN_END);
+		bool isShaken = isBetween(t, SIM_EVENTS_SHAKE_START, SIM_EVENTS_SHAKE_END);
+		bool isPushing = isBetween(t, SIM_EVENTS_PUSH_START, SIM_EVENTS_PUSH_END);
+		bool isDropped = isBetween(t, SIM_EVENTS_DROP_START, SIM_EVENTS_DROP_END);
+
+		float shake = isShaken ? SIM_EVENTS_SHAKE_AMPLITUDE * sinf(2.f * M_PI * SIM_EVENTS_SHAKE_FREQUENCY * t) : 0.f;
+
+		_sphere.setHandRate(isSpun ? sign * SIM_EVENTS_SPIN_RATE : 0.f);
+		_sphere.setHandAcceleration(cycle % 3 == 0 ? shake : 0.f, cycle % 3 == 1 ? shake : 0.f,
+				cycle % 3 == 2 ? shake : 0.f);
+		_sphere.setFalling(isDropped);
+
+		if (isPushing != wasPushing) {
+			_sphere.setBlocked(isPushing);
+			_isBlocked = isPushing;
+
+			if (isPushing)
+				DriveSystem::go(sign > 0.f ? FORWARD : BACKWARD, _options.speed);
+			else
+				DriveSystem::stop();
+
+			wasPushing = isPushing;
+		}
+
+		_handLabels = (isSpun ? TRACE_LABEL_SPINNING : 0) | (isShaken ? TRACE_LABEL_SHAKEN : 0)
+				| (isDropped ? TRACE_LABEL_FALLING : 0);
+
+		stepPlant();
+		Host::setMicros(_plantTime);
+	}
+
+	printf("%u cycles of events\n", (unsigned)((end + (uint64_t)(SIM_EVENTS_CYCLE * 1e6f) - 1)
+			/ (uint64_t)(SIM_EVENTS_CYCLE * 1e6f)));
+
+	_status = 0;
+
+}
+
+static WORKING_AREA(plantThreadArea, 256);
+
+/**
+ * @brief Runs the model at the pace of the clock
+ */
+static msg_t plantThread(void* arg) {
+
+	(void) arg;
+
+	while (!chThdShouldTerminate()) {
+		uint64_t now = Host::nowMicros();
+
+		while (_plantTime + SIM_PLANT_PERIOD <= now)
+			stepPlant();
+
+		if (_options.wall > 0.f) {
+			// Against a wall only while heading into it
+			float x = _sphere.getX();
+			float y = _sphere.getY();
+			float dx = cosf(_sphere.getYaw());
+			float dy = sinf(_sphere.getYaw());
+			bool blocked = (x >= _options.wall && dx > 0.f) || (x <= -_options.wall && dx < 0.f)
+					|| (y >= _options.wall && dy > 0.f) || (y <= -_options.wall && dy < 0.f);
+
+			if (blocked != _isBlocked) {
+				_sphere.setBlocked(blocked);
+				_isBlocked = blocked;
+			}
+		}
+
+		chThdSleepMilliseconds(1);
+	}
+
+	return (msg_t)0;
+}
+
+static void runSpin(void) {
+
+	float turned = 0.f;
+	float worst = 0.f;
+	unsigned guarded = 0;
+
+	chThdSleepMilliseconds(1000);
+
+	for (unsigned i = 0; i < _options.spins; i++) {
+		Rotation rotation = i % 2 == 0 ? LEFT : RIGHT;
+		float start = _sphere.getYaw();
+		uint32_t startTime = millis();
+
+		Motion::spinDeg(rotation, _options.speed, _options.angle);
+
+		do {
+			chThdSleepMilliseconds(10);
+		} while (Motion::getState() != NONE);
+
+		uint32_t duration = millis() - startTime;
+		float stopped = (_sphere.getYaw() - start) * 180.f / M_PI;
+
+		// Let it coast before measuring
+		chThdSleepMilliseconds(500);
+
+		turned = (_sphere.getYaw() - start) * 180.f / M_PI;
+
+		if (rotation == RIGHT) {
+			turned = -turned;
+			stopped = -stopped;
+		}
+
+		if (fabs(stopped - _options.angle) > worst)
+			worst = fabs(stopped - _options.angle);
+
+		// The 2500 ms security of Motion::moduleThread
+		if (duration >= 2500)
+			guarded++;
+
+		printf("spin %u %-5s stopped at %6.1f deg (asked %.1f) in %u ms, %6.1f deg after coasting%s\n", i,
+				rotation == LEFT ? "left" : "right", stopped, _options.angle, duration, turned,
+				duration >= 2500 ? ", stopped by the time limit" : "");
+	}
+
+	printf("worst error when stopping: %.1f deg (at most %.1f), %u of %u spins stopped by the time limit\n",
+			worst, SIM_SPIN_TOLERANCE * _options.angle, guarded, _options.spins);
+
+	if (guarded == 0 && worst <= SIM_SPIN_TOLERANCE * _options.angle)
+		_status = 0;
+
+}
+
+static void runWander(void) {
+
+	uint32_t end = millis() + (uint32_t)((_options.duration > 0.f ? _options.duration : 30.f) * 1000);
+	uint32_t blockedSince = 0;
+	uint32_t escapes = 0;
+	uint32_t longest = 0;
+	bool wasStuck = false;
+	bool wasBlocked = false;
+
+	Moti::start();
+	Wander::start();
+
+	while (millis() < end) {
+		chThdSleepMilliseconds(10);
+
+		bool stuck = Moti::isStuck();
+
+		if (stuck != wasStuck)
+			printf("%7.2f s  stuck %s, at %.2f, %.2f m\n", millis() / 1e3, stuck ? "on" : "off", _sphere.getX(),
+					_sphere.getY());
+
+		if (_isBlocked && !wasBlocked)
+			blockedSince = millis();
+
+		if (!_isBlocked && wasBlocked) {
+			escapes++;
+
+			if (millis() - blockedSince > longest)
+				longest = millis() - blockedSince;
+		}
+
+		wasStuck = stuck;
+		wasBlocked = _isBlocked;
+	}
+
+	Wander::stop();
+	Motion::stopNow();
+
+	printf("escaped the walls %u times, longest against one: %.1f s\n", escapes, longest / 1e3);
+
+	if (escapes > 0)
+		_status = 0;
+
+}
+
+void chSetup(void) {
+
+	stepPlant();
+
+	Sensors::init();
+	Sensors::start();
+	Motion::init();
+	Moti::init();
+
+	if (strcmp(_options.scenario, "wander") == 0) {
+		Light::init();
+		Heart::init();
+		Heart::start();
+		Wander::init();
+	}
+
+	(void)chThdCreateStatic(plantThreadArea, sizeof(plantThreadArea), NORMALPRIO + 2, plantThread, NULL);
+
+	if (strcmp(_options.scenario, "spin") == 0)
+		runSpin();
+	else
+		runWander();
+
+}
+
+static void usage(void) {
+	fprintf(stderr, "usage: sim [-s stabilize|spin|wander|events] [-R] [-t seconds] [-a acc noise] [-g gyr noise] "
+			"[-b gyr bias] [-r seed] [-N model.txt] [-k kick time] [-y degrees] [-n spins] [-v speed] [-w wall] [-c] "
+			"[-o trace.txt]\n");
+	exit(2);
+}
+
+int main(int argc, char** argv) {
+	SphereNoise noise = { 0.f, 0.f, { 0.f, 0.f, 0.f }, 1 };
+	const char* noiseModel = NULL;
+	int c;
+
+	while ((c = getopt(argc, argv, "s:Rt:a:g:b:r:N:k:y:n:v:w:co:")) != -1) {
+		switch (c) {
+			case 's': _options.scenario = optarg; break;
+			case 'R': _options.realTime = true; break;
+			case 't': _options.duration = atof(optarg); break;
+			case 'a': noise.accNoise = atof(optarg); break;
+			case 'g': noise.gyrNoise = atof(optarg); break;
+			case 'b': noise.gyrBias[0] = noise.gyrBias[1] = noise.gyrBias[2] = atof(optarg); break;
+			case 'r': noise.seed = (uint32_t)atol(optarg); break;
+			case 'N': noiseModel = optarg; break;
+			case 'k': _options.kickTime = atof(optarg); break;
+			case 'y': _options.angle = atof(optarg); break;
+			case 'n': _options.spins = (unsigned)atoi(optarg); break;
+			case 'v': _options.speed = (uint8_t)atoi(optarg); break;
+			case 'w': _options.wall = atof(optarg); break;
+			case 'c': _options.csv = true; break;
+			case 'o': _options.trace = optarg; break;
+			default: usage();
+		}
+	}
+
+	if (strcmp(_options.scenario, "stabilize") != 0 && strcmp(_options.scenario, "spin") != 0
+			&& strcmp(_options.scenario, "wander") != 0 && strcmp(_options.scenario, "events") != 0)
+		usage();
+
+	if (noiseModel != NULL && !_noiseModel.read(noiseModel)) {
+		fprintf(stderr, "sim: cannot read %s\n", noiseModel);
+		return 1;
+	}
+
+	if (_options.trace != NULL && (_trace = fopen(_options.trace, "w")) == NULL) {
+		fprintf(stderr, "sim: cannot write %s\n", _options.trace);
+		return 1;
+	}
+
+	Serial.setStream(NULL);
+	_sphere.setNoise(noise);
+	_sphere.setNoiseModel(noiseModel != NULL ? &_noiseModel : NULL, Sensors::getFusionRate());
+	srand(noise.seed);
+
+	if (_options.csv)
+		printf("t,x,y,yaw,pitch,velocity,left,right,heading\n");
+
+	timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (strcmp(_options.scenario, "stabilize") == 0) {
+		runStabilize();
+	}
+	else if (strcmp(_options.scenario, "events") == 0) {
+		runEvents();
+	}
+	else {
+		Host::setVirtualClock(!_options.realTime);
+		chBegin(chSetup);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("%.1f s simulated in %.3f s (x%.0f)\n", _plantTime / 1e6, wall, _plantTime / 1e6 / wall);
+
+	if (_trace != NULL)
+		fclose(_trace);
+
+	printf("%s\n", _status == 0 ? "OK" : "FAILED");
+
+	return _status;
+}
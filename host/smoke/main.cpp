@@ -0,0 +1,113 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file main.cpp
+ * @brief Boots the firmware threads on the host platform layer and spins the stub IMU
+ *
+ * The IMU lies flat and turns at SMOKE_RATE deg/s around Z for SMOKE_DURATION ms. The
+ * sensors thread must keep publishing and the yaw must follow the rotation, which takes
+ * the threads, the I2C devices, the EEPROM and the fusion through a full run.
+ * With -v it runs on the virtual clock. Exits with 0 on success.
+ *
+ * SystemStats samples the threads after each phase and the C, load reports go to Serial1
+ * (stdout), then the P, report of the periodic loops. The C reports only check the report
+ * path: the host threads take far less than a tick of CPU, so every load reads 0.
+ */
+
+#include <string.h>
+
+#include <Arduino.h>
+#include "ChibiOS_AVR.h"
+#include "Host.h"
+
+#include "Sensors.h"
+#include "Moti.h"
+#include "Motion.h"
+#include "Light.h"
+#include "SystemStats.h"
+#include "Communication.h"
+
+#define SMOKE_RATE 90.0f
+#define SMOKE_DURATION 1500
+#define SMOKE_TOLERANCE 20.0f
+
+int _status = 1;
+
+void chSetup(void) {
+
+	const int16_t acc[3] = { 0, 0, 256 };
+	const float still[3] = { 0.f, 0.f, 0.f };
+	const float spinning[3] = { 0.f, 0.f, SMOKE_RATE };
+
+	Host::setImuSample(acc, still);
+
+	Sensors::init();
+	Sensors::start();
+	Light::init();
+	Motion::init();
+	Moti::init();
+
+	SystemStats::update();
+	chThdSleepMilliseconds(500);
+	SystemStats::update();
+	Communication::sendLoadData();
+
+	uint16_t sequence = Sensors::getSequence();
+	float yaw = Sensors::getGyrYDeg();
+
+	Host::setImuSample(acc, spinning);
+	chThdSleepMilliseconds(SMOKE_DURATION);
+	Host::setImuSample(acc, still);
+
+	SystemStats::update();
+	Communication::sendLoadData();
+	Communication::sendPeriodData();
+
+	float turned = fabs(Sensors::getGyrYDeg() - yaw);
+
+	if (turned > 180.f)
+		turned = 360.f - turned;
+
+	float expected = SMOKE_RATE * SMOKE_DURATION / 1000.f;
+	uint16_t samples = Sensors::getSequence() - sequence;
+
+	printf("samples: %u, turned: %.1f deg (expected %.1f), I2C errors: %u\n", samples, turned, expected,
+			I2C::getErrorCount());
+
+	if (samples > 0 && fabs(turned - expected) < SMOKE_TOLERANCE && I2C::getErrorCount() == 0)
+		_status = 0;
+
+}
+
+int main(int argc, char** argv) {
+
+	Serial.setStream(NULL);
+
+	if (argc > 1 && strcmp(argv[1], "-v") == 0)
+		Host::setVirtualClock(true);
+
+	chBegin(chSetup);
+
+	printf("%s\n", _status == 0 ? "OK" : "FAILED");
+
+	return _status;
+
+}
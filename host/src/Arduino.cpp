@@ -0,0 +1,360 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file Arduino.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include <time.h>
+
+#include "Arduino.h"
+#include "ChibiOS_AVR.h"
+#include "Host.h"
+
+volatile uint8_t PORTC = 0, PORTD = 0, TWBR = 72;
+
+namespace {
+
+	const uint8_t N_INTERRUPTS = 8;
+	const uint8_t N_PINS = 70;
+
+	void (*_isr[N_INTERRUPTS])(void) = { NULL };
+	int _pins[N_PINS] = { 0 };
+
+	uint64_t monotonicMicros(void) {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+	}
+
+	const uint64_t _epoch = monotonicMicros();
+
+	bool _isManualClock = false;
+	volatile uint64_t _manualMicros = 0;
+
+}
+
+/*
+ * Host controls
+ */
+
+uint64_t Host::nowMicros(void) {
+	return _isManualClock || Host::isVirtualClock() ? _manualMicros : monotonicMicros() - _epoch;
+}
+
+void Host::sleepMicros(uint64_t us) {
+	if (Host::isVirtualClock()) {
+		// The calling thread gives way, to the next tick as chThdSleep does
+		if (us > 0)
+			chThdSleep(US2ST(us));
+
+		return;
+	}
+
+	if (_isManualClock) {
+		_manualMicros += us;
+		return;
+	}
+
+	struct timespec ts;
+	ts.tv_sec = us / 1000000ULL;
+	ts.tv_nsec = (us % 1000000ULL) * 1000;
+	nanosleep(&ts, NULL);
+}
+
+void Host::setManualClock(bool manual) {
+	if (manual && !_isManualClock)
+		_manualMicros = nowMicros();
+
+	_isManualClock = manual;
+}
+
+bool Host::isManualClock(void) {
+	return _isManualClock;
+}
+
+void Host::setMicros(uint64_t us) {
+	_manualMicros = us;
+}
+
+void Host::raiseInterrupt(uint8_t interruptNum) {
+	if (interruptNum < N_INTERRUPTS && _isr[interruptNum] != NULL)
+		_isr[interruptNum]();
+}
+
+bool Host::isInterruptAttached(uint8_t interruptNum) {
+	return interruptNum < N_INTERRUPTS && _isr[interruptNum] != NULL;
+}
+
+int Host::getPinValue(uint8_t pin) {
+	return pin < N_PINS ? _pins[pin] : 0;
+}
+
+/*
+ * Arduino core
+ */
+
+void init(void) {
+}
+
+unsigned long millis(void) {
+	return (unsigned long)(Host::nowMicros() / 1000ULL);
+}
+
+unsigned long micros(void) {
+	return (unsigned long)Host::nowMicros();
+}
+
+void delay(unsigned long ms) {
+	Host::sleepMicros((uint64_t)ms * 1000ULL);
+}
+
+void delayMicroseconds(unsigned int us) {
+	Host::sleepMicros(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	(void)pin;
+	(void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+	if (pin < N_PINS)
+		_pins[pin] = val;
+}
+
+int digitalRead(uint8_t pin) {
+	return Host::getPinValue(pin);
+}
+
+int analogRead(uint8_t pin) {
+	return Host::getPinValue(pin);
+}
+
+void analogWrite(uint8_t pin, int val) {
+	if (pin < N_PINS)
+		_pins[pin] = val;
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode) {
+	(void)mode;
+
+	if (interruptNum < N_INTERRUPTS)
+		_isr[interruptNum] = userFunc;
+}
+
+void detachInterrupt(uint8_t interruptNum) {
+	if (interruptNum < N_INTERRUPTS)
+		_isr[interruptNum] = NULL;
+}
+
+void noInterrupts(void) {
+}
+
+void interrupts(void) {
+}
+
+long random(long howbig) {
+	return howbig == 0 ? 0 : rand() % howbig;
+}
+
+long random(long howsmall, long howbig) {
+	return howsmall >= howbig ? howsmall : random(howbig - howsmall) + howsmall;
+}
+
+void randomSeed(unsigned int seed) {
+	if (seed != 0)
+		srand(seed);
+}
+
+/*
+ * Serial
+ */
+
+HardwareSerial Serial(stdout);
+HardwareSerial Serial1(stdout);
+
+HardwareSerial::HardwareSerial(FILE* stream) {
+	_stream = stream;
+	_rxHead = _rxTail = 0;
+}
+
+void HardwareSerial::setStream(FILE* stream) {
+	_stream = stream;
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+	(void)baud;
+}
+
+void HardwareSerial::end(void) {
+}
+
+void HardwareSerial::flush(void) {
+	if (_stream != NULL)
+		fflush(_stream);
+}
+
+int HardwareSerial::available(void) {
+	return (_rxHead - _rxTail + sizeof(_rx)) % sizeof(_rx);
+}
+
+int HardwareSerial::read(void) {
+	if (_rxHead == _rxTail)
+		return -1;
+
+	uint8_t c = _rx[_rxTail];
+	_rxTail = (_rxTail + 1) % sizeof(_rx);
+
+	return c;
+}
+
+int HardwareSerial::peek(void) {
+	return _rxHead == _rxTail ? -1 : _rx[_rxTail];
+}
+
+void HardwareSerial::feed(const uint8_t* data, size_t length) {
+	for (size_t i = 0; i < length; ++i) {
+		uint16_t next = (_rxHead + 1) % sizeof(_rx);
+
+		if (next == _rxTail)
+			break;
+
+		_rx[_rxHead] = data[i];
+		_rxHead = next;
+	}
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+	if (_stream != NULL)
+		fputc(c, _stream);
+
+	return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+	if (_stream != NULL)
+		fwrite(buffer, 1, size, _stream);
+
+	return size;
+}
+
+size_t HardwareSerial::print(const __FlashStringHelper* s) {
+	return print(reinterpret_cast<const char*>(s));
+}
+
+size_t HardwareSerial::print(const char* s) {
+	size_t n = strlen(s);
+	return write((const uint8_t*)s, n);
+}
+
+size_t HardwareSerial::print(char c) {
+	return write((uint8_t)c);
+}
+
+size_t HardwareSerial::print(unsigned char n, int base) {
+	return print((unsigned long)n, base);
+}
+
+size_t HardwareSerial::print(int n, int base) {
+	return print((long)n, base);
+}
+
+size_t HardwareSerial::print(unsigned int n, int base) {
+	return print((unsigned long)n, base);
+}
+
+size_t HardwareSerial::print(long n, int base) {
+	if (base == DEC && n < 0)
+		return print('-') + printNumber((unsigned long)-n, base);
+
+	return printNumber((unsigned long)n, base);
+}
+
+size_t HardwareSerial::print(unsigned long n, int base) {
+	return printNumber(n, base);
+}
+
+size_t HardwareSerial::print(double n, int digits) {
+	char buffer[32];
+	int length = snprintf(buffer, sizeof(buffer), "%.*f", digits, n);
+	return write((const uint8_t*)buffer, length);
+}
+
+size_t HardwareSerial::printNumber(unsigned long n, int base) {
+	char buffer[8 * sizeof(long) + 1];
+	char* str = &buffer[sizeof(buffer) - 1];
+
+	*str = '\0';
+
+	if (base < 2)
+		base = 10;
+
+	do {
+		unsigned long m = n;
+		n /= base;
+		char c = m - base * n;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+	} while (n);
+
+	return print(str);
+}
+
+size_t HardwareSerial::println(void) {
+	return print("\r\n");
+}
+
+size_t HardwareSerial::println(const __FlashStringHelper* s) {
+	return print(s) + println();
+}
+
+size_t HardwareSerial::println(const char* s) {
+	return print(s) + println();
+}
+
+size_t HardwareSerial::println(char c) {
+	return print(c) + println();
+}
+
+size_t HardwareSerial::println(unsigned char n, int base) {
+	return print(n, base) + println();
+}
+
+size_t HardwareSerial::println(int n, int base) {
+	return print(n, base) + println();
+}
+
+size_t HardwareSerial::println(unsigned int n, int base) {
+	return print(n, base) + println();
+}
+
+size_t HardwareSerial::println(long n, int base) {
+	return print(n, base) + println();
+}
+
+size_t HardwareSerial::println(unsigned long n, int base) {
+	return print(n, base) + println();
+}
+
+size_t HardwareSerial::println(double n, int digits) {
+	return print(n, digits) + println();
+}
@@ -0,0 +1,877 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file ChibiOS_Host.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief pthreads implementation of the ChibiOS/RT calls used by lib/.
+ *
+ * Every kernel object is protected by a single recursive lock, and every
+ * blocked thread waits on a single condition variable that is broadcast
+ * whenever a semaphore, mutex or event changes. This is slow compared to
+ * a real scheduler but trivially correct for the handful of threads the
+ * firmware runs.
+ *
+ * On the virtual clock (Host::setVirtualClock) the threads take turns instead:
+ * only the thread holding the turn runs, and it hands it over when it blocks,
+ * exits, yields or wakes a higher priority thread, as the ChibiOS scheduler
+ * would. The next thread is the highest priority ready one, first come first
+ * served within a priority. When no thread is ready the clock jumps to the
+ * earliest timeout. Every run of a program is then the same run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <sched.h>
+
+#include <functional>
+
+#include "ChibiOS_AVR.h"
+#include "Host.h"
+
+// Sketches define it, host programs may not: chBegin then returns after mainThread
+extern void loop() __attribute__((weak));
+
+struct HostThread {
+	pthread_t handle;
+	tfunc_t func;
+	void* arg;
+
+	// Virtual clock
+	pthread_cond_t turn;			// signaled when the thread gets the turn
+	std::function<bool()> ready;	// set while blocked
+	uint64_t wakeAt;				// timeout of the block (in us)
+	bool isReady;					// waiting for the turn
+	int64_t order;					// in the ready list, lowest first
+};
+
+namespace {
+
+	pthread_mutex_t _kernel;
+	pthread_cond_t _changed;
+	pthread_once_t _once = PTHREAD_ONCE_INIT;
+
+	Thread* _newest = NULL;
+	__thread Thread* _current = NULL;
+
+	int _depth = 0; // of the kernel lock
+
+	// Virtual clock
+	bool _isVirtual = false;
+	bool _reschedule = false;	// a thread may have been woken since the last check
+	Thread* _running = NULL;	// holds the turn
+	int64_t _order = 0;
+
+	void preempt(void);
+
+	void initKernel(void) {
+		pthread_mutexattr_t mattr;
+		pthread_mutexattr_init(&mattr);
+		pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_RECURSIVE);
+		pthread_mutex_init(&_kernel, &mattr);
+
+		pthread_condattr_t cattr;
+		pthread_condattr_init(&cattr);
+		pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+		pthread_cond_init(&_changed, &cattr);
+	}
+
+	void lock(void) {
+		pthread_once(&_once, initKernel);
+		pthread_mutex_lock(&_kernel);
+		_depth++;
+	}
+
+	/**
+	 * @brief Releases the kernel, on the virtual clock the outermost release is where a woken
+	 * higher priority thread takes over, as at the end of a ChibiOS system call
+	 */
+	void unlock(void) {
+		if (_depth == 1 && _isVirtual && _reschedule && _running == _current) {
+			_reschedule = false;
+			preempt();
+		}
+
+		_depth--;
+		pthread_mutex_unlock(&_kernel);
+	}
+
+	void notify(void) {
+		pthread_cond_broadcast(&_changed);
+		_reschedule = true;
+	}
+
+	/**
+	 * @brief Waits on a condition variable with the kernel locked exactly once
+	 * @return the pthread_cond_(timed)wait result
+	 */
+	int waitCondition(pthread_cond_t* cond, const struct timespec* deadline) {
+		int depth = _depth;
+		int result;
+
+		_depth = 0;
+
+		if (deadline == NULL)
+			result = pthread_cond_wait(cond, &_kernel);
+		else
+			result = pthread_cond_timedwait(cond, &_kernel, deadline);
+
+		_depth = depth;
+
+		return result;
+	}
+
+	HostThread* newHostThread(void) {
+		HostThread* host = new HostThread();
+
+		pthread_cond_init(&host->turn, NULL);
+		host->wakeAt = UINT64_MAX;
+
+		return host;
+	}
+
+	void registerThread(Thread* tp) {
+		tp->p_older = _newest;
+		tp->p_newer = NULL;
+		if (_newest != NULL)
+			_newest->p_newer = tp;
+		_newest = tp;
+	}
+
+	void updateTicks(Thread* tp) {
+		if (tp->p_host == NULL)
+			return;
+
+		clockid_t cid;
+		struct timespec ts;
+
+		if (pthread_getcpuclockid(tp->p_host->handle, &cid) == 0 && clock_gettime(cid, &ts) == 0)
+			tp->p_time = (systime_t)(ts.tv_sec * CH_FREQUENCY + ts.tv_nsec / (1000000000L / CH_FREQUENCY));
+	}
+
+	Thread* self(void) {
+		if (_current == NULL) {
+			Thread* tp = new Thread();
+			tp->p_prio = NORMALPRIO;
+			tp->p_name = "main";
+			tp->p_state = THD_STATE_CURRENT;
+			tp->p_host = newHostThread();
+			tp->p_host->handle = pthread_self();
+
+			lock();
+			registerThread(tp);
+			unlock();
+
+			_current = tp;
+		}
+
+		return _current;
+	}
+
+	Thread* oldest(void) {
+		Thread* tp = _newest;
+
+		while (tp != NULL && tp->p_older != NULL)
+			tp = tp->p_older;
+
+		return tp;
+	}
+
+	/**
+	 * @brief Puts a thread in the ready list
+	 * @param ahead true for the head of its priority (a preempted thread), false for the tail
+	 */
+	void makeReady(Thread* tp, bool ahead) {
+		tp->p_host->isReady = true;
+		tp->p_host->order = ahead ? -(++_order) : ++_order;
+	}
+
+	/**
+	 * @brief Readies the blocked threads that can go on and picks the next thread to run
+	 * @return the thread, NULL if none is ready
+	 */
+	Thread* pickNext(void) {
+		uint64_t now = Host::nowMicros();
+		Thread* next = NULL;
+
+		for (Thread* tp = oldest(); tp != NULL; tp = tp->p_newer) {
+			HostThread* host = tp->p_host;
+
+			if (host == NULL || tp->p_state == THD_STATE_FINAL)
+				continue;
+
+			if (!host->isReady && host->ready && (host->wakeAt <= now || host->ready()))
+				makeReady(tp, false);
+
+			if (host->isReady && (next == NULL || tp->p_prio > next->p_prio
+					|| (tp->p_prio == next->p_prio && host->order < next->p_host->order)))
+				next = tp;
+		}
+
+		return next;
+	}
+
+	void giveTurn(Thread* tp) {
+		tp->p_host->isReady = false;
+		_running = tp;
+		pthread_cond_signal(&tp->p_host->turn);
+	}
+
+	void waitTurn(Thread* tp) {
+		while (_running != tp)
+			waitCondition(&tp->p_host->turn, NULL);
+	}
+
+	/**
+	 * @brief Hands the turn to the next thread, moving the clock to the earliest timeout if
+	 * none is ready
+	 * @note The caller is blocked, ready or exiting, and holds the kernel exactly once.
+	 */
+	void runNext(void) {
+		Thread* next;
+
+		while ((next = pickNext()) == NULL) {
+			uint64_t wakeAt = UINT64_MAX;
+
+			for (Thread* tp = oldest(); tp != NULL; tp = tp->p_newer)
+				if (tp->p_host != NULL && tp->p_state != THD_STATE_FINAL && tp->p_host->wakeAt < wakeAt)
+					wakeAt = tp->p_host->wakeAt;
+
+			if (wakeAt == UINT64_MAX) {
+				fprintf(stderr, "virtual clock: every thread is blocked for good at %llu us\n",
+						(unsigned long long)Host::nowMicros());
+				exit(1);
+			}
+
+			Host::setMicros(wakeAt);
+		}
+
+		giveTurn(next);
+	}
+
+	/**
+	 * @brief Lets a woken thread of higher priority run first, the caller stays at the head
+	 * of the ready list
+	 */
+	void preempt(void) {
+		Thread* tp = _current;
+		Thread* next = pickNext();
+
+		if (next == NULL || next->p_prio <= tp->p_prio)
+			return;
+
+		makeReady(tp, true);
+		tp->p_state = THD_STATE_READY;
+
+		giveTurn(next);
+		waitTurn(tp);
+
+		tp->p_state = THD_STATE_CURRENT;
+	}
+
+	/**
+	 * @brief Blocks the caller until ready() holds or the timeout expires
+	 * @note Must be called with the kernel locked exactly once.
+	 * @return true if ready() holds, false on timeout
+	 */
+	template<typename Predicate>
+	bool waitFor(Predicate ready, systime_t timeout, tstate_t state) {
+		if (ready())
+			return true;
+
+		if (timeout == TIME_IMMEDIATE)
+			return false;
+
+		Thread* tp = self();
+
+		if (_isVirtual) {
+			HostThread* host = tp->p_host;
+			bool result;
+
+			host->ready = ready;
+			host->wakeAt = timeout == TIME_INFINITE ? UINT64_MAX
+					: Host::nowMicros() + (uint64_t)timeout * (1000000ULL / CH_FREQUENCY);
+			tp->p_state = state;
+
+			for (;;) {
+				runNext();
+				waitTurn(tp);
+
+				if (ready()) {
+					result = true;
+					break;
+				}
+
+				if (Host::nowMicros() >= host->wakeAt) {
+					result = false;
+					break;
+				}
+			}
+
+			host->ready = nullptr;
+			host->wakeAt = UINT64_MAX;
+			tp->p_state = THD_STATE_CURRENT;
+
+			return result;
+		}
+
+		struct timespec deadline;
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+		uint64_t ns = (uint64_t)timeout * (1000000000ULL / CH_FREQUENCY);
+		deadline.tv_sec += ns / 1000000000ULL;
+		deadline.tv_nsec += ns % 1000000000ULL;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		tp->p_state = state;
+
+		while (!ready()) {
+			if (timeout == TIME_INFINITE) {
+				waitCondition(&_changed, NULL);
+			}
+			else if (waitCondition(&_changed, &deadline) == ETIMEDOUT) {
+				bool result = ready();
+				tp->p_state = THD_STATE_CURRENT;
+				return result;
+			}
+		}
+
+		tp->p_state = THD_STATE_CURRENT;
+		updateTicks(tp);
+
+		return true;
+	}
+
+	void* trampoline(void* arg) {
+		Thread* tp = (Thread*)arg;
+		_current = tp;
+
+		if (_isVirtual) {
+			lock();
+			waitTurn(tp);
+			unlock();
+		}
+
+		tp->p_state = THD_STATE_CURRENT;
+
+		msg_t msg = tp->p_host->func(tp->p_host->arg);
+		chThdExit(msg);
+
+		return NULL;
+	}
+
+}
+
+/*
+ * Host controls
+ */
+
+void Host::setVirtualClock(bool enabled) {
+	lock();
+
+	// Starts at 0, as the robot's clock at boot
+	if (enabled && !_isVirtual) {
+		Host::setMicros(0);
+		_running = self();
+	}
+
+	_isVirtual = enabled;
+
+	unlock();
+}
+
+bool Host::isVirtualClock(void) {
+	return _isVirtual;
+}
+
+/*
+ * System
+ */
+
+void chSysInit(void) {
+	pthread_once(&_once, initKernel);
+	(void)self();
+}
+
+void chBegin(void (*mainThread)()) {
+	chSysInit();
+
+	if (mainThread)
+		mainThread();
+
+	while (loop)
+		loop();
+}
+
+void chSysLock(void) {
+	lock();
+}
+
+void chSysUnlock(void) {
+	notify();
+	unlock();
+}
+
+void chSchRescheduleS(void) {
+	notify();
+}
+
+systime_t chTimeNow(void) {
+	return (systime_t)(Host::nowMicros() * CH_FREQUENCY / 1000000ULL);
+}
+
+size_t chHeapMainSize(void) {
+	return 0;
+}
+
+size_t chUnusedHeapMain(void) {
+	return 0;
+}
+
+size_t chUnusedStack(void* wsp, size_t size) {
+	size_t n = 0;
+	uint8_t* startp = (uint8_t*)wsp + sizeof(Thread);
+	uint8_t* endp = (uint8_t*)wsp + size;
+
+	while (startp < endp) {
+		if (*startp++ != CH_STACK_FILL_VALUE)
+			break;
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * Threads
+ */
+
+Thread* chThdCreateStatic(void* wsp, size_t size, tprio_t prio, tfunc_t pf, void* arg) {
+	Thread* tp = (Thread*)wsp;
+	memset(tp, 0, sizeof(Thread));
+	memset((uint8_t*)wsp + sizeof(Thread), CH_STACK_FILL_VALUE, size - sizeof(Thread));
+
+	tp->p_prio = prio;
+	tp->p_state = THD_STATE_READY;
+	tp->p_wsp = wsp;
+	tp->p_wsize = size;
+	tp->p_host = newHostThread();
+	tp->p_host->func = pf;
+	tp->p_host->arg = arg;
+
+	lock();
+	registerThread(tp);
+
+	if (_isVirtual) {
+		makeReady(tp, false);
+		notify();
+	}
+
+	pthread_create(&tp->p_host->handle, NULL, trampoline, tp);
+	pthread_detach(tp->p_host->handle);
+	unlock();
+
+	return tp;
+}
+
+Thread* chThdSelf(void) {
+	return self();
+}
+
+tprio_t chThdSetPriority(tprio_t newprio) {
+	Thread* tp = self();
+	tprio_t oldprio = tp->p_prio;
+	tp->p_prio = newprio;
+	return oldprio;
+}
+
+void chThdTerminate(Thread* tp) {
+	lock();
+	tp->p_flags |= THD_TERMINATE;
+	unlock();
+}
+
+void chThdSleep(systime_t time) {
+	lock();
+	chThdSleepS(time);
+	unlock();
+}
+
+void chThdSleepS(systime_t time) {
+	if (!_isVirtual && Host::isManualClock()) {
+		Host::sleepMicros((uint64_t)time * 1000000ULL / CH_FREQUENCY);
+		return;
+	}
+
+	waitFor([]() { return false; }, time, THD_STATE_SLEEPING);
+}
+
+void chThdSleepUntil(systime_t time) {
+	chSysLock();
+
+	// As on the AVR: a deadline already in the past is one a wrap of systime_t ahead
+	if ((time -= chTimeNow()) > 0)
+		chThdSleepS(time);
+
+	chSysUnlock();
+}
+
+void chThdYield(void) {
+	if (!_isVirtual) {
+		sched_yield();
+		return;
+	}
+
+	Thread* tp = self();
+
+	lock();
+	makeReady(tp, false);
+	tp->p_state = THD_STATE_READY;
+	runNext();
+	waitTurn(tp);
+	tp->p_state = THD_STATE_CURRENT;
+	unlock();
+}
+
+void chThdExit(msg_t msg) {
+	Thread* tp = self();
+
+	lock();
+	updateTicks(tp);
+	chMtxUnlockAll();
+	tp->p_exitcode = msg;
+	tp->p_state = THD_STATE_FINAL;
+	notify();
+
+	if (_isVirtual)
+		runNext();
+
+	unlock();
+
+	pthread_exit(NULL);
+}
+
+msg_t chThdWait(Thread* tp) {
+	lock();
+	waitFor([tp]() { return tp->p_state == THD_STATE_FINAL; }, TIME_INFINITE, THD_STATE_READY);
+	msg_t msg = tp->p_exitcode;
+	unlock();
+
+	return msg;
+}
+
+Thread* chRegFirstThread(void) {
+	lock();
+	Thread* tp = _newest;
+	while (tp != NULL && tp->p_older != NULL)
+		tp = tp->p_older;
+	if (tp != NULL)
+		updateTicks(tp);
+	unlock();
+
+	return tp;
+}
+
+Thread* chRegNextThread(Thread* tp) {
+	lock();
+	Thread* next = tp->p_newer;
+	if (next != NULL)
+		updateTicks(next);
+	unlock();
+
+	return next;
+}
+
+/*
+ * Mutexes
+ */
+
+void chMtxInit(Mutex* mp) {
+	mp->m_owner = NULL;
+	mp->m_next = NULL;
+}
+
+void chMtxLock(Mutex* mp) {
+	Thread* tp = self();
+
+	lock();
+	waitFor([mp]() { return mp->m_owner == NULL; }, TIME_INFINITE, THD_STATE_WTMTX);
+	mp->m_owner = tp;
+	mp->m_next = tp->p_mtxlist;
+	tp->p_mtxlist = mp;
+	unlock();
+}
+
+bool_t chMtxTryLock(Mutex* mp) {
+	Thread* tp = self();
+	bool_t locked = FALSE;
+
+	lock();
+	if (mp->m_owner == NULL) {
+		mp->m_owner = tp;
+		mp->m_next = tp->p_mtxlist;
+		tp->p_mtxlist = mp;
+		locked = TRUE;
+	}
+	unlock();
+
+	return locked;
+}
+
+Mutex* chMtxUnlock(void) {
+	Thread* tp = self();
+
+	lock();
+	Mutex* mp = tp->p_mtxlist;
+	if (mp != NULL) {
+		tp->p_mtxlist = mp->m_next;
+		mp->m_owner = NULL;
+		mp->m_next = NULL;
+		notify();
+	}
+	unlock();
+
+	return mp;
+}
+
+void chMtxUnlockAll(void) {
+	lock();
+	while (self()->p_mtxlist != NULL)
+		chMtxUnlock();
+	unlock();
+}
+
+/*
+ * Semaphores
+ */
+
+void chSemInit(Semaphore* sp, cnt_t n) {
+	sp->s_cnt = n;
+}
+
+void chSemReset(Semaphore* sp, cnt_t n) {
+	lock();
+	chSemResetI(sp, n);
+	notify();
+	unlock();
+}
+
+void chSemResetI(Semaphore* sp, cnt_t n) {
+	sp->s_cnt = n;
+}
+
+msg_t chSemWait(Semaphore* sp) {
+	return chSemWaitTimeout(sp, TIME_INFINITE);
+}
+
+msg_t chSemWaitTimeout(Semaphore* sp, systime_t time) {
+	lock();
+	bool ok = waitFor([sp]() { return sp->s_cnt > 0; }, time, THD_STATE_WTSEM);
+	if (ok)
+		sp->s_cnt--;
+	unlock();
+
+	return ok ? RDY_OK : RDY_TIMEOUT;
+}
+
+void chSemSignal(Semaphore* sp) {
+	lock();
+	chSemSignalI(sp);
+	unlock();
+}
+
+void chSemSignalI(Semaphore* sp) {
+	lock();
+	sp->s_cnt++;
+	notify();
+	unlock();
+}
+
+/*
+ * Binary semaphores
+ */
+
+void chBSemInit(BinarySemaphore* bsp, bool_t taken) {
+	chSemInit(&bsp->bs_sem, taken ? 0 : 1);
+}
+
+msg_t chBSemWait(BinarySemaphore* bsp) {
+	return chSemWait(&bsp->bs_sem);
+}
+
+msg_t chBSemWaitTimeout(BinarySemaphore* bsp, systime_t time) {
+	return chSemWaitTimeout(&bsp->bs_sem, time);
+}
+
+void chBSemReset(BinarySemaphore* bsp, bool_t taken) {
+	chSemReset(&bsp->bs_sem, taken ? 0 : 1);
+}
+
+void chBSemSignal(BinarySemaphore* bsp) {
+	lock();
+	chBSemSignalI(bsp);
+	unlock();
+}
+
+void chBSemSignalI(BinarySemaphore* bsp) {
+	lock();
+	if (bsp->bs_sem.s_cnt < 1)
+		bsp->bs_sem.s_cnt = 1;
+	notify();
+	unlock();
+}
+
+/*
+ * Events
+ */
+
+void chEvtInit(EventSource* esp) {
+	esp->es_next = NULL;
+}
+
+void chEvtRegisterMask(EventSource* esp, EventListener* elp, eventmask_t mask) {
+	lock();
+	elp->el_next = esp->es_next;
+	esp->es_next = elp;
+	elp->el_listener = self();
+	elp->el_mask = mask;
+	elp->el_flags = 0;
+	unlock();
+}
+
+void chEvtUnregister(EventSource* esp, EventListener* elp) {
+	lock();
+	EventListener** p = &esp->es_next;
+	while (*p != NULL) {
+		if (*p == elp) {
+			*p = elp->el_next;
+			break;
+		}
+		p = &(*p)->el_next;
+	}
+	unlock();
+}
+
+eventmask_t chEvtGetAndClearEvents(eventmask_t mask) {
+	Thread* tp = self();
+
+	lock();
+	eventmask_t m = tp->p_epending & mask;
+	tp->p_epending &= ~mask;
+	unlock();
+
+	return m;
+}
+
+eventmask_t chEvtAddEvents(eventmask_t mask) {
+	Thread* tp = self();
+
+	lock();
+	eventmask_t m = (tp->p_epending |= mask);
+	unlock();
+
+	return m;
+}
+
+flagsmask_t chEvtGetAndClearFlags(EventListener* elp) {
+	lock();
+	flagsmask_t flags = elp->el_flags;
+	elp->el_flags = 0;
+	unlock();
+
+	return flags;
+}
+
+void chEvtSignal(Thread* tp, eventmask_t mask) {
+	chEvtSignalI(tp, mask);
+}
+
+void chEvtSignalI(Thread* tp, eventmask_t mask) {
+	lock();
+	tp->p_epending |= mask;
+	notify();
+	unlock();
+}
+
+void chEvtBroadcastFlags(EventSource* esp, flagsmask_t flags) {
+	chEvtBroadcastFlagsI(esp, flags);
+}
+
+void chEvtBroadcastFlagsI(EventSource* esp, flagsmask_t flags) {
+	lock();
+	for (EventListener* elp = esp->es_next; elp != NULL; elp = elp->el_next) {
+		elp->el_flags |= flags;
+		elp->el_listener->p_epending |= elp->el_mask;
+	}
+	notify();
+	unlock();
+}
+
+eventmask_t chEvtWaitOneTimeout(eventmask_t mask, systime_t time) {
+	Thread* tp = self();
+	eventmask_t m = 0;
+
+	lock();
+	if (waitFor([tp, mask]() { return (tp->p_epending & mask) != 0; }, time, THD_STATE_WTOREVT)) {
+		m = tp->p_epending & mask;
+		m &= -m;
+		tp->p_epending &= ~m;
+	}
+	unlock();
+
+	return m;
+}
+
+eventmask_t chEvtWaitAnyTimeout(eventmask_t mask, systime_t time) {
+	Thread* tp = self();
+	eventmask_t m = 0;
+
+	lock();
+	if (waitFor([tp, mask]() { return (tp->p_epending & mask) != 0; }, time, THD_STATE_WTOREVT)) {
+		m = tp->p_epending & mask;
+		tp->p_epending &= ~m;
+	}
+	unlock();
+
+	return m;
+}
+
+eventmask_t chEvtWaitAllTimeout(eventmask_t mask, systime_t time) {
+	Thread* tp = self();
+	eventmask_t m = 0;
+
+	lock();
+	if (waitFor([tp, mask]() { return (tp->p_epending & mask) == mask; }, time, THD_STATE_WTOREVT)) {
+		m = mask;
+		tp->p_epending &= ~mask;
+	}
+	unlock();
+
+	return m;
+}
@@ -0,0 +1,291 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file Devices.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief Stub I2C devices for the IMU shield.
+ */
+
+#include "Host.h"
+
+namespace Host {
+
+	const uint8_t MAX_DEVICES = 8;
+	I2CDevice* _devices[MAX_DEVICES] = { NULL };
+
+	ADXL345Device _accelerometer;
+	ITG3200Device _gyroscope;
+
+	struct DefaultDevices {
+		DefaultDevices(void) {
+			attachDevice(&_accelerometer);
+			attachDevice(&_gyroscope);
+		}
+	} _defaultDevices;
+
+}
+
+/*
+ * Bus
+ */
+
+void Host::attachDevice(I2CDevice* device) {
+	for (uint8_t i = 0; i < MAX_DEVICES; ++i) {
+		if (_devices[i] == NULL || _devices[i]->getAddress() == device->getAddress()) {
+			_devices[i] = device;
+			return;
+		}
+	}
+}
+
+void Host::detachDevice(I2CDevice* device) {
+	for (uint8_t i = 0; i < MAX_DEVICES; ++i)
+		if (_devices[i] == device)
+			_devices[i] = NULL;
+}
+
+Host::I2CDevice* Host::getDevice(uint8_t address) {
+	for (uint8_t i = 0; i < MAX_DEVICES; ++i)
+		if (_devices[i] != NULL && _devices[i]->getAddress() == address)
+			return _devices[i];
+
+	return NULL;
+}
+
+Host::ADXL345Device& Host::accelerometer(void) {
+	return _accelerometer;
+}
+
+Host::ITG3200Device& Host::gyroscope(void) {
+	return _gyroscope;
+}
+
+void Host::setImuSample(const int16_t acc[3], const float gyr[3]) {
+	_accelerometer.setSample(acc[0], acc[1], acc[2]);
+	_gyroscope.setSample((int16_t)lroundf(gyr[0] * 14.375f),
+			(int16_t)lroundf(gyr[1] * 14.375f),
+			(int16_t)lroundf(gyr[2] * 14.375f));
+}
+
+/*
+ * Generic register file
+ */
+
+Host::I2CDevice::I2CDevice(uint8_t address) {
+	_address = address;
+	memset(_registers, 0, sizeof(_registers));
+}
+
+Host::I2CDevice::~I2CDevice() {
+}
+
+uint8_t Host::I2CDevice::getAddress(void) const {
+	return _address;
+}
+
+uint8_t Host::I2CDevice::readRegister(uint8_t reg) {
+	return _registers[reg];
+}
+
+void Host::I2CDevice::writeRegister(uint8_t reg, uint8_t value) {
+	_registers[reg] = value;
+}
+
+void Host::I2CDevice::beginRead(uint8_t reg) {
+	(void)reg;
+}
+
+/*
+ * ADXL345
+ */
+
+Host::ADXL345Device::ADXL345Device(uint8_t address) : I2CDevice(address) {
+	_registers[0x00] = 0xE5; // DEVID
+	_registers[0x2C] = 0x0A; // BW_RATE: 100 Hz
+	_registers[0x38] = 0x00; // FIFO_CTL: bypass
+
+	_fifoHead = 0;
+	_fifoCount = 0;
+	updateFifoStatus();
+
+	_freeFallSince = UINT64_MAX;
+
+	setSample(0, 0, 256);
+}
+
+void Host::ADXL345Device::setSample(int16_t x, int16_t y, int16_t z) {
+	_sample[0] = x;
+	_sample[1] = y;
+	_sample[2] = z;
+
+	_registers[0x30] |= 0x80; // DATA_READY
+
+	updateFreeFall();
+
+	uint8_t mode = _registers[0x38] >> 6;
+
+	if (mode != 0x00) {
+		if (_fifoCount == 32) {
+			if (mode != 0x02)
+				return; // FIFO mode stops when full, only stream mode keeps the newest
+
+			_fifoHead = (_fifoHead + 1) % 32;
+			_fifoCount--;
+			_registers[0x30] |= 0x01; // OVERRUN
+		}
+
+		uint8_t tail = (_fifoHead + _fifoCount) % 32;
+
+		for (uint8_t i = 0; i < 3; ++i)
+			_fifo[tail][i] = _sample[i];
+
+		_fifoCount++;
+		updateFifoStatus();
+	}
+}
+
+void Host::ADXL345Device::beginRead(uint8_t reg) {
+	if (reg >= 0x32 && reg <= 0x37) {
+		const int16_t* sample = _sample;
+
+		if (_fifoCount > 0) {
+			sample = _fifo[_fifoHead];
+			_fifoHead = (_fifoHead + 1) % 32;
+			_fifoCount--;
+			updateFifoStatus();
+		}
+
+		for (uint8_t i = 0; i < 3; ++i) {
+			_registers[0x32 + 2 * i] = (uint8_t)(sample[i] & 0xFF);
+			_registers[0x33 + 2 * i] = (uint8_t)((sample[i] >> 8) & 0xFF);
+		}
+
+		if (_fifoCount == 0)
+			_registers[0x30] &= ~0x80;
+	}
+}
+
+uint8_t Host::ADXL345Device::readRegister(uint8_t reg) {
+	uint8_t value = _registers[reg];
+
+	if (reg == 0x30)
+		_registers[0x30] &= ~0x04; // FREE_FALL
+
+	return value;
+}
+
+void Host::ADXL345Device::writeRegister(uint8_t reg, uint8_t value) {
+	if (reg == 0x30 || reg == 0x00 || reg == 0x39)
+		return; // read-only
+
+	_registers[reg] = value;
+
+	// Bypass mode empties the FIFO
+	if (reg == 0x38 && (value >> 6) == 0x00) {
+		_fifoHead = 0;
+		_fifoCount = 0;
+		_registers[0x30] &= ~0x01;
+	}
+
+	if (reg == 0x38)
+		updateFifoStatus();
+}
+
+void Host::ADXL345Device::updateFifoStatus(void) {
+	_registers[0x39] = _fifoCount;
+
+	uint8_t watermark = _registers[0x38] & 0x1F;
+
+	if (_fifoCount > 0 && _fifoCount >= watermark)
+		_registers[0x30] |= 0x02; // WATERMARK
+	else
+		_registers[0x30] &= ~0x02;
+}
+
+void Host::ADXL345Device::updateFreeFall(void) {
+	// THRESH_FF in 62.5 mg, 16 counts at 256 counts per g
+	int16_t threshold = _registers[0x28] * 16;
+	bool isUnder = true;
+
+	for (uint8_t i = 0; i < 3; ++i)
+		if (abs(_sample[i]) >= threshold)
+			isUnder = false;
+
+	if (!isUnder || threshold == 0) {
+		_freeFallSince = UINT64_MAX;
+		return;
+	}
+
+	uint64_t now = nowMicros();
+
+	if (_freeFallSince == UINT64_MAX)
+		_freeFallSince = now;
+
+	// TIME_FF in 5 ms
+	if ((_registers[0x2E] & 0x04) && now - _freeFallSince >= _registers[0x29] * 5000ULL)
+		_registers[0x30] |= 0x04;
+}
+
+/*
+ * ITG3200
+ */
+
+Host::ITG3200Device::ITG3200Device(uint8_t address) : I2CDevice(address) {
+	_registers[0x00] = address & 0x7E; // WHO_AM_I
+	_registers[0x3E] = 0x00;
+
+	setSample(0, 0, 0);
+	setTemperature(25.0f);
+}
+
+void Host::ITG3200Device::setSample(int16_t x, int16_t y, int16_t z) {
+	_sample[0] = x;
+	_sample[1] = y;
+	_sample[2] = z;
+
+	_registers[0x1A] |= 0x01; // RAW_DATA_RDY
+}
+
+void Host::ITG3200Device::setTemperature(float celsius) {
+	int16_t raw = (int16_t)lroundf((celsius - 35.0f) * 280.0f - 13200.0f);
+	_registers[0x1B] = (uint8_t)((raw >> 8) & 0xFF);
+	_registers[0x1C] = (uint8_t)(raw & 0xFF);
+}
+
+void Host::ITG3200Device::beginRead(uint8_t reg) {
+	if (reg >= 0x1D && reg <= 0x22) {
+		for (uint8_t i = 0; i < 3; ++i) {
+			_registers[0x1D + 2 * i] = (uint8_t)((_sample[i] >> 8) & 0xFF);
+			_registers[0x1E + 2 * i] = (uint8_t)(_sample[i] & 0xFF);
+		}
+	}
+}
+
+uint8_t Host::ITG3200Device::readRegister(uint8_t reg) {
+	uint8_t value = _registers[reg];
+
+	// Latched interrupt is cleared by reading the status (or any register, if INT_ANYRD_2CLEAR)
+	if (reg == 0x1A || (_registers[0x17] & 0x10))
+		_registers[0x1A] &= ~0x01;
+
+	return value;
+}
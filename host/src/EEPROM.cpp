@@ -0,0 +1,77 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file EEPROM.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief In-memory EEPROM, addresses past E2END are ignored on write and read as 0xFF.
+ */
+
+#include <avr/eeprom.h>
+
+#include "Host.h"
+
+namespace {
+
+	uint8_t _eeprom[E2END + 1];
+
+	struct ErasedEeprom {
+		ErasedEeprom(void) {
+			Host::eraseEeprom();
+		}
+	} _erasedEeprom;
+
+	size_t address(const void* p) {
+		return (size_t)(uintptr_t)p;
+	}
+
+}
+
+uint8_t* Host::getEeprom(void) {
+	return _eeprom;
+}
+
+void Host::eraseEeprom(void) {
+	memset(_eeprom, 0xFF, sizeof(_eeprom));
+}
+
+uint8_t eeprom_read_byte(const uint8_t* p) {
+	return address(p) <= E2END ? _eeprom[address(p)] : 0xFF;
+}
+
+void eeprom_update_byte(uint8_t* p, uint8_t value) {
+	if (address(p) <= E2END)
+		_eeprom[address(p)] = value;
+}
+
+void eeprom_read_block(void* dst, const void* src, size_t n) {
+	for (size_t i = 0; i < n; ++i)
+		((uint8_t*)dst)[i] = eeprom_read_byte((const uint8_t*)src + i);
+}
+
+void eeprom_update_block(const void* src, void* dst, size_t n) {
+	for (size_t i = 0; i < n; ++i)
+		eeprom_update_byte((uint8_t*)dst + i, ((const uint8_t*)src)[i]);
+}
+
+void eeprom_write_block(const void* src, void* dst, size_t n) {
+	eeprom_update_block(src, dst, n);
+}
@@ -0,0 +1,122 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file I2C.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief Host replacement for lib/FreeIMU/I2C.cpp: transactions complete at once on the
+ * Host::I2CDevice models, a missing device NACKs.
+ */
+
+#include "I2C.h"
+#include "Host.h"
+
+namespace I2C {
+
+	uint16_t _errorCount = 0;
+	uint16_t _recoveryCount = 0;
+
+}
+
+void I2C::init(uint32_t frequency) {
+	setFrequency(frequency);
+	recover();
+}
+
+void I2C::setFrequency(uint32_t frequency) {
+	(void)frequency;
+}
+
+void I2C::submit(I2CTransaction* transaction) {
+	Host::I2CDevice* device = Host::getDevice(transaction->address);
+
+	transaction->next = NULL;
+	chBSemInit(&transaction->done, TRUE);
+
+	if (device == NULL) {
+		_errorCount++;
+		transaction->index = 0;
+		transaction->status = I2C_NACK;
+		chBSemSignal(&transaction->done);
+		return;
+	}
+
+	uint8_t reg = transaction->reg;
+
+	if (transaction->read)
+		device->beginRead(reg);
+
+	for (transaction->index = 0; transaction->index < transaction->length; transaction->index++) {
+		if (transaction->read)
+			transaction->data[transaction->index] = device->readRegister(reg++);
+		else
+			device->writeRegister(reg++, transaction->data[transaction->index]);
+	}
+
+	transaction->status = I2C_OK;
+	chBSemSignal(&transaction->done);
+}
+
+I2CStatus I2C::wait(I2CTransaction* transaction, uint16_t timeout) {
+	chBSemWaitTimeout(&transaction->done, MS2ST(timeout));
+
+	return transaction->status;
+}
+
+I2CStatus I2C::readRegisters(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length) {
+	I2CTransaction transaction;
+
+	transaction.address = address;
+	transaction.reg = reg;
+	transaction.data = data;
+	transaction.length = length;
+	transaction.read = true;
+
+	submit(&transaction);
+
+	return wait(&transaction);
+}
+
+I2CStatus I2C::writeRegister(uint8_t address, uint8_t reg, uint8_t value) {
+	I2CTransaction transaction;
+
+	transaction.address = address;
+	transaction.reg = reg;
+	transaction.data = &value;
+	transaction.length = 1;
+	transaction.read = false;
+
+	submit(&transaction);
+
+	return wait(&transaction);
+}
+
+void I2C::recover(void) {
+	_recoveryCount++;
+}
+
+uint16_t I2C::getErrorCount(void) {
+	return _errorCount;
+}
+
+uint16_t I2C::getRecoveryCount(void) {
+	return _recoveryCount;
+}
@@ -0,0 +1,1024 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file main.cpp
+ * @brief Sweeps the fusion gains, the Stabilization gains and period and the Moti thresholds,
+ * and ranks them
+ *
+ * Every combination of the -p values runs:
+ *
+ *   closed loop  the stabilize scenario of host/sim, on its Sphere model with IMU noise: after
+ *                SWEEP_KICK_TIME a hand turns the robot by -y degrees. Gives how long it took to
+ *                come back under Stabilization's threshold, the overshoot, the final and RMS yaw
+ *                errors, the RMS tilt error of the fusion against the model, the motor effort and
+ *                the host time Sensors::step and Stabilization::step took per second of run. Without
+ *                a magnetometer the gains don't act on the heading, only on the tilt: a large twoKp
+ *                lets the accelerometer noise in, a small one the gyroscope noise and bias (-b).
+ *                Stabilization steps every _threadDelay, as its thread does, and the motors get
+ *                its commands -D ms late. Both threads wake up to -J us early or late.
+ *   detectors    the labelled traces given, as host/replay plays them: every labelled event of
+ *                every Moti detector caught or missed, false positives and latency (see Score.h).
+ *
+ * With -m, the closed loop runs that many times per combination, each seed drawing its own
+ * noise, bias and delay (uniformly, up to -a, -g, +/- -b and -D) and kick direction. -N
+ * replaces the noise of -a and -g with a model that host/noise fitted, that each seed draws
+ * its own noise of. The table
+ * then gives, per combination, how many runs settled, the 50th and 95th percentiles of the
+ * settling time and overshoot, and the 5th to 95th of the motor effort: -m 1000 -p
+ * period=100:300:25 -s settle shows how far the control period can be relaxed.
+ *
+ * The modules keep their state in globals, so every run gets a process of its own, forked
+ * from this one once the traces are read: -j of them at a time, one per CPU by default. A new
+ * run starts as soon as any ends, so a slow combination only holds one CPU back. The results
+ * go to shared memory, the parent then ranks them.
+ *
+ *     sweep [-p name=values]... [-m seeds] [-j jobs] [-s key] [-n top] [-o results.csv]
+ *           [-t seconds] [-y degrees] [-a acc noise] [-g gyr noise] [-b gyr bias] [-J jitter]
+ *           [-D delay] [-r seed] [-N model.txt] [trace...]
+ *
+ * values is v1,v2,... or start:stop:step. Each -p replaces the firmware default of a parameter:
+ *   twoKp twoKi                  Sensors::setFusionGains (FreeIMU twoKpDef, twoKiDef)
+ *   psiKp psiKi psiKd            Stabilization _filterPsi
+ *   thetaKp thetaKi thetaKd      Stabilization _filterTheta
+ *   period                       Stabilization _threadDelay (ms)
+ *   stuck stuckTime shake spin   Moti::setStuckThreshold, setShakeThreshold, setSpinThreshold
+ *
+ * Keys: settle (default), overshoot, final, rms, fusion, effort, cpu, detect (fewest missed
+ * events, then fewest false positives, then latency). Runs that did not settle, or did not
+ * finish, rank last; with -m, the combinations with the fewest of them first, then by the 95th
+ * percentile (50th for fusion, effort and cpu). -o writes every run as CSV. The cpu column is
+ * host time, and the runs share the CPUs: compare it between rows of one sweep only.
+ */
+
+#include <getopt.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Score.h"
+#include "Sphere.h"
+#include "Trace.h"
+
+#include <Arduino.h>
+#include "ChibiOS_AVR.h"
+#include "Host.h"
+
+#include "Sensors.h"
+#include "Moti.h"
+#include "DriveSystem.h"
+#include "Stabilization.h"
+
+/*! Model step and IMU update (in us) */
+#define SWEEP_PLANT_PERIOD 1000
+
+/*! Periods of the module threads (in us), see Sensors.cpp and Moti.cpp */
+#define SWEEP_SENSORS_PERIOD 50000
+#define SWEEP_MOTI_PERIOD 100000
+
+/*! The kick of the closed loop run, as sim -s stabilize gives it (in s, then us) */
+#define SWEEP_KICK_TIME 3.f
+#define SWEEP_TURN_DURATION 500000
+
+/*! IMU noise of the closed loop run, the one test/simulationMotor/labelled was made with */
+#define SWEEP_DEFAULT_ACC_NOISE 2.f
+#define SWEEP_DEFAULT_GYR_NOISE 0.3f
+
+/*! Stabilization acts on yaw errors above PI / 9, see Stabilization::step */
+#define SWEEP_YAW_THRESHOLD (M_PI / 9)
+
+/*! Beyond that, narrow the ranges down (closed loop runs) */
+#define SWEEP_MAX_RUNS 1000000
+
+typedef enum {
+	PARAMETER_TWO_KP,
+	PARAMETER_TWO_KI,
+	PARAMETER_PSI_KP,
+	PARAMETER_PSI_KI,
+	PARAMETER_PSI_KD,
+	PARAMETER_THETA_KP,
+	PARAMETER_THETA_KI,
+	PARAMETER_THETA_KD,
+	PARAMETER_PERIOD,
+	PARAMETER_STUCK,
+	PARAMETER_STUCK_TIME,
+	PARAMETER_SHAKE,
+	PARAMETER_SPIN,
+	PARAMETERS_COUNT
+} ParameterIndex;
+
+typedef struct {
+	const char* name;
+	float value;	// the firmware default
+} Parameter;
+
+static const Parameter _parameters[PARAMETERS_COUNT] = {
+	{ "twoKp", twoKpDef },
+	{ "twoKi", twoKiDef },
+	{ "psiKp", 60.f },
+	{ "psiKi", 0.f },
+	{ "psiKd", 3.f },
+	{ "thetaKp", 100.f },
+	{ "thetaKi", 0.f },
+	{ "thetaKd", 5.f },
+	{ "period", 100.f },
+	{ "stuck", 120.f },
+	{ "stuckTime", 750.f },
+	{ "shake", 120.f },
+	{ "spin", 15.f }
+};
+
+/*! What a closed loop run drew and measured, in shared memory: plain data only */
+typedef struct {
+	bool isDone;			// false if the run crashed
+	uint32_t seed;
+	SphereNoise noise;
+	float delay;			// of the motor commands (ms)
+	float kick;				// (deg)
+
+	bool isSettled;
+	float settle;			// after the kick (s)
+	float overshoot;		// past zero, against the kick (deg)
+	float finalError;		// yaw at the end (deg)
+	float rmsError;			// yaw, from the end of the kick (deg)
+	float fusionError;		// RMS of the fused tilt - model tilt (deg)
+	float effort;			// integral of the squared commands, from the kick (s at full PWM)
+	float cpuUs;			// host time of Sensors::step and Stabilization::step per run second (us)
+} LoopResult;
+
+/*! What the detectors run of a combination measured, in shared memory */
+typedef struct {
+	bool isDone;			// false without traces, or if the run crashed
+	uint32_t events;
+	uint32_t caught;
+	uint32_t falsePositives;
+	float latencyMs;		// mean over the caught events
+} DetectorResult;
+
+/*! The closed loop runs of a combination, in the parent */
+typedef struct {
+	uint32_t failed;		// did not settle, or crashed
+	float settle[3];		// 50th, 95th percentiles and max, of the settled runs (s)
+	float overshoot[2];		// 50th, 95th (deg)
+	float finalError;		// 95th, of the absolute error (deg)
+	float rmsError;			// 95th (deg)
+	float fusionError;		// 50th (deg)
+	float effort[3];		// 5th, 50th, 95th (s at full PWM)
+	float cpuUs;			// 50th
+} Summary;
+
+typedef struct {
+	float duration;		// of the closed loop run (s)
+	float angle;		// kick (deg)
+	SphereNoise noise;	// with -m, the largest drawn
+	float jitter;		// of the thread wake ups, +/- (us)
+	float delay;		// of the motor commands (ms)
+	uint32_t seeds;		// closed loop runs per combination
+} Options;
+
+static Options _options = { 15.f, 60.f, { SWEEP_DEFAULT_ACC_NOISE, SWEEP_DEFAULT_GYR_NOISE, { 0.f, 0.f, 0.f }, 1 },
+		0.f, 0.f, 1 };
+
+static std::vector<float> _values[PARAMETERS_COUNT];	// the sweep, one value for the defaults
+static std::vector<Trace> _traces;
+static NoiseModel _noiseModel;
+static bool _hasNoiseModel = false;
+static LoopResult* _loops = NULL;					// combination * seeds + seed
+static DetectorResult* _detectors = NULL;			// combination
+static std::vector<Summary> _summaries;
+static const char* _rankKey = "settle";
+
+static Sphere _sphere;
+static uint64_t _plantTime = 0;	// model time (in us)
+static float _effort = 0.f;
+static std::vector<float> _commands;	// left and right, the last delay + 1 model steps
+static size_t _commandIndex = 0;
+
+static double elapsedNs(const timespec& start, const timespec& end) {
+	return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static float wrapPi(float angle) {
+	return atan2f(sinf(angle), cosf(angle));
+}
+
+/**
+ * @brief Parses the values of a -p: v1,v2,... or start:stop:step
+ * @param text what follows name=
+ * @param values vector that will receive them
+ * @return false if it is neither
+ */
+static bool parseValues(const char* text, std::vector<float>* values) {
+	float start, stop, step;
+	char end;
+
+	values->clear();
+
+	if (sscanf(text, "%f:%f:%f%c", &start, &stop, &step, &end) == 3) {
+		if (step <= 0.f || stop < start)
+			return false;
+
+		// Some slack against rounding, for stop to be part of it
+		for (int i = 0; start + i * step <= stop + step / 1000.f; i++)
+			values->push_back(start + i * step);
+
+		return true;
+	}
+
+	const char* p = text;
+
+	while (*p != '\0') {
+		char* next;
+		float value = strtof(p, &next);
+
+		if (next == p || (*next != ',' && *next != '\0'))
+			return false;
+
+		values->push_back(value);
+		p = *next == ',' ? next + 1 : next;
+	}
+
+	return !values->empty();
+}
+
+static bool parseParameter(const char* text) {
+	const char* equal = strchr(text, '=');
+
+	if (equal == NULL)
+		return false;
+
+	std::string name(text, equal - text);
+
+	for (int i = 0; i < PARAMETERS_COUNT; i++)
+		if (name == _parameters[i].name)
+			return parseValues(equal + 1, &_values[i]);
+
+	return false;
+}
+
+static size_t getCombinationCount(void) {
+	size_t count = 1;
+
+	for (int i = 0; i < PARAMETERS_COUNT; i++)
+		count *= _values[i].size();
+
+	return count;
+}
+
+/**
+ * @brief Gets the parameter values of a combination, the first parameter changing fastest
+ * @param combination its index
+ * @param values array of PARAMETERS_COUNT that will receive them
+ */
+static void getCombination(size_t combination, float* values) {
+	for (int i = 0; i < PARAMETERS_COUNT; i++) {
+		values[i] = _values[i][combination % _values[i].size()];
+		combination /= _values[i].size();
+	}
+}
+
+static bool isDefault(size_t combination) {
+	float values[PARAMETERS_COUNT];
+
+	getCombination(combination, values);
+
+	for (int i = 0; i < PARAMETERS_COUNT; i++)
+		if (values[i] != _parameters[i].value)
+			return false;
+
+	return true;
+}
+
+static void applyParameters(const float* values) {
+	Sensors::setFusionGains(values[PARAMETER_TWO_KP], values[PARAMETER_TWO_KI]);
+
+	Stabilization::_filterPsi.SetGains(values[PARAMETER_PSI_KP], values[PARAMETER_PSI_KI],
+			values[PARAMETER_PSI_KD]);
+	Stabilization::_filterTheta.SetGains(values[PARAMETER_THETA_KP], values[PARAMETER_THETA_KI],
+			values[PARAMETER_THETA_KD]);
+	Stabilization::_threadDelay = (uint16_t)constrain(values[PARAMETER_PERIOD], 1.f, 65535.f);
+
+	Moti::setStuckThreshold((uint8_t)constrain(values[PARAMETER_STUCK], 0.f, 255.f),
+			(uint16_t)constrain(values[PARAMETER_STUCK_TIME], 0.f, 65535.f));
+	Moti::setShakeThreshold(values[PARAMETER_SHAKE]);
+	Moti::setSpinThreshold(values[PARAMETER_SPIN]);
+}
+
+static int getSpeed(uint8_t speed, Direction direction) {
+	return direction == FORWARD ? speed : -(int)speed;
+}
+
+/**
+ * @brief Moves the model one SWEEP_PLANT_PERIOD forward with the motor commands of the delay
+ * before and puts its IMU readings on the stub devices, as in host/sim
+ */
+static void stepPlant(void) {
+
+	_commands[_commandIndex] = getSpeed(DriveSystem::getLeftMotorSpeed(), DriveSystem::getLeftMotorDirection()) / 255.f;
+	_commands[_commandIndex + 1] = getSpeed(DriveSystem::getRightMotorSpeed(),
+			DriveSystem::getRightMotorDirection()) / 255.f;
+	_commandIndex = (_commandIndex + 2) % _commands.size();
+
+	// The oldest of the buffer
+	float left = _commands[_commandIndex];
+	float right = _commands[_commandIndex + 1];
+	float dt = SWEEP_PLANT_PERIOD / 1e6f;
+
+	_sphere.setMotors(left, right);
+	_sphere.step(dt);
+	_effort += (left * left + right * right) * dt;
+	_plantTime += SWEEP_PLANT_PERIOD;
+
+	int16_t acc[3];
+	float gyr[3];
+
+	_sphere.getImu(acc, gyr);
+	Host::setImuSample(acc, gyr);
+
+}
+
+/**
+ * @brief Draws what a closed loop run gets: the options themselves without -m
+ * @param result where to put it
+ * @param random the generator of the run
+ */
+static void drawRun(LoopResult* result, std::mt19937* random) {
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+	result->noise = _options.noise;
+	result->noise.seed = result->seed;
+	result->delay = _options.delay;
+	result->kick = _options.angle;
+
+	if (_options.seeds == 1)
+		return;
+
+	result->noise.accNoise = _options.noise.accNoise * unit(*random);
+	result->noise.gyrNoise = _options.noise.gyrNoise * unit(*random);
+
+	for (int i = 0; i < 3; i++)
+		result->noise.gyrBias[i] = _options.noise.gyrBias[i] * (2.f * unit(*random) - 1.f);
+
+	// Whole model steps
+	result->delay = floorf(_options.delay * unit(*random) * 1000.f / SWEEP_PLANT_PERIOD) * SWEEP_PLANT_PERIOD / 1000.f;
+
+	if (unit(*random) < 0.5f)
+		result->kick = -result->kick;
+}
+
+/**
+ * @brief The closed loop run: sim -s stabilize, on the manual clock
+ */
+static void runClosedLoop(LoopResult* result) {
+
+	std::mt19937 random(result->seed);
+	std::uniform_real_distribution<float> jitter(-_options.jitter, _options.jitter);
+
+	drawRun(result, &random);
+
+	uint64_t end = (uint64_t)(_options.duration * 1e6);
+	uint64_t kickAt = (uint64_t)(SWEEP_KICK_TIME * 1e6);
+	float kick = result->kick * M_PI / 180.f;
+
+	_sphere.setNoise(result->noise);
+	_sphere.setNoiseModel(_hasNoiseModel ? &_noiseModel : NULL, 1e6f / SWEEP_SENSORS_PERIOD);
+	_commands.assign(2 * ((size_t)(result->delay * 1000.f / SWEEP_PLANT_PERIOD + 0.5f) + 1), 0.f);
+
+	Host::setManualClock(true);
+	Host::setMicros(0);
+
+	stepPlant();
+	Sensors::setup();
+
+	// Setup sleeps through the gyroscope calibration: the firmware clock carries on from there
+	uint64_t clockStart = Host::nowMicros() - _plantTime;
+
+	Stabilization::start();
+
+	uint64_t nextSensors = 0;
+	uint64_t nextStabilization = 0;
+	uint64_t settledAt = 0;
+	bool kicked = false;
+	float overshoot = 0.f;
+	float effortAtKick = 0.f;
+	double squaredError = 0., squaredFusionError = 0., cpuNs = 0.;
+	uint32_t errorSamples = 0, fusionSamples = 0;
+	timespec start, stop;
+
+	while (_plantTime < end) {
+		stepPlant();
+
+		uint64_t now = _plantTime;
+
+		Host::setMicros(clockStart + now);
+
+		if (!kicked && now >= kickAt) {
+			_sphere.setHandRate(kick * 1e6f / SWEEP_TURN_DURATION);
+			effortAtKick = _effort;
+			kicked = true;
+		}
+
+		if (now == kickAt + SWEEP_TURN_DURATION)
+			_sphere.setHandRate(0.f);
+
+		if (now >= nextSensors) {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			Sensors::step();
+			clock_gettime(CLOCK_MONOTONIC, &stop);
+
+			cpuNs += elapsedNs(start, stop);
+			nextSensors = now + SWEEP_SENSORS_PERIOD + (int64_t)jitter(random);
+
+			// The model pitch is the other way round, and it does not roll
+			float pitchError = Sensors::getGyrP() + _sphere.getPitch();
+			float rollError = Sensors::getGyrR();
+
+			squaredFusionError += pitchError * pitchError + rollError * rollError;
+			fusionSamples++;
+		}
+
+		if (now >= nextStabilization) {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			Stabilization::step();
+			clock_gettime(CLOCK_MONOTONIC, &stop);
+
+			// What the step slept delays the next one, as in the thread
+			cpuNs += elapsedNs(start, stop);
+			nextStabilization = Host::nowMicros() - clockStart + Stabilization::_threadDelay * 1000UL
+					+ (int64_t)jitter(random);
+			Host::setMicros(clockStart + now);
+		}
+
+		if (!kicked)
+			continue;
+
+		float error = wrapPi(_sphere.getYaw());
+
+		if (error * kick < 0.f && fabs(error) > overshoot)
+			overshoot = fabs(error);
+
+		if (fabs(error) > SWEEP_YAW_THRESHOLD)
+			settledAt = 0;
+		else if (settledAt == 0)
+			settledAt = now;
+
+		if (now >= kickAt + SWEEP_TURN_DURATION) {
+			squaredError += error * error;
+			errorSamples++;
+		}
+	}
+
+	result->isSettled = settledAt != 0;
+	result->settle = settledAt != 0 ? (settledAt - kickAt) / 1e6f : 0.f;
+	result->overshoot = overshoot * 180.f / M_PI;
+	result->finalError = wrapPi(_sphere.getYaw()) * 180.f / M_PI;
+	result->rmsError = errorSamples ? sqrt(squaredError / errorSamples) * 180.f / M_PI : 0.f;
+	result->fusionError = fusionSamples ? sqrt(squaredFusionError / fusionSamples) * 180.f / M_PI : 0.f;
+	result->effort = _effort - effortAtKick;
+	result->cpuUs = cpuNs / 1e3 / (_plantTime / 1e6);
+
+	result->isDone = true;
+
+}
+
+/**
+ * @brief The detectors run: the traces one after the other through Sensors and Moti, as in
+ * host/replay
+ */
+static void runDetectors(DetectorResult* result) {
+	static bool (* const states[])(void) = { Moti::isStuck, Moti::isSpinning, Moti::isShaken, Moti::isFalling };
+	static const uint8_t labels[] = { TRACE_LABEL_STUCK, TRACE_LABEL_SPINNING, TRACE_LABEL_SHAKEN,
+			TRACE_LABEL_FALLING };
+	static const size_t N_DETECTORS = sizeof(labels) / sizeof(labels[0]);
+
+	Score scores[N_DETECTORS];
+	bool active[N_DETECTORS];
+
+	memset(scores, 0, sizeof(scores));
+	memset(active, 0, sizeof(active));
+
+	Host::setManualClock(true);
+
+	// The gyroscope is zeroed on the first sample, as it is at boot
+	Host::accelerometer().setSample(_traces[0][0].acc[0], _traces[0][0].acc[1], _traces[0][0].acc[2]);
+	Host::gyroscope().setSample(_traces[0][0].gyr[0], _traces[0][0].gyr[1], _traces[0][0].gyr[2]);
+
+	Sensors::setup();
+
+	uint64_t now = Host::nowMicros();
+	uint64_t nextMoti = 0;
+
+	for (size_t t = 0; t < _traces.size(); t++) {
+		const Trace& trace = _traces[t];
+
+		for (size_t n = 0; n < trace.size(); n++) {
+			now += trace.getPeriod();
+			Host::setMicros(now);
+
+			Host::accelerometer().setSample(trace[n].acc[0], trace[n].acc[1], trace[n].acc[2]);
+			Host::gyroscope().setSample(trace[n].gyr[0], trace[n].gyr[1], trace[n].gyr[2]);
+
+			Sensors::step();
+
+			if (now >= nextMoti) {
+				Moti::detectStuck();
+				Moti::detectSpin();
+				Moti::detectShake();
+				Moti::detectFall();
+
+				nextMoti = now + SWEEP_MOTI_PERIOD;
+			}
+
+			for (size_t i = 0; i < N_DETECTORS; i++) {
+				bool isActive = states[i]();
+
+				scoreSample(&scores[i], now, trace.getPeriod(), (trace.getLabels(n) & labels[i]) != 0, isActive,
+						isActive && !active[i]);
+				active[i] = isActive;
+			}
+		}
+	}
+
+	uint64_t latencyUs = 0;
+
+	for (size_t i = 0; i < N_DETECTORS; i++) {
+		result->events += scores[i].events;
+		result->caught += scores[i].caught;
+		result->falsePositives += scores[i].falsePositives;
+		latencyUs += scores[i].latencyUs;
+	}
+
+	result->latencyMs = result->caught ? latencyUs / 1e3f / result->caught : 0.f;
+
+	result->isDone = true;
+
+}
+
+/**
+ * @brief Runs one job in this process: the closed loop runs of every combination, then
+ * their detectors runs
+ */
+static void runJob(size_t job, size_t runs) {
+	float values[PARAMETERS_COUNT];
+	size_t combination = job < runs ? job / _options.seeds : job - runs;
+
+	getCombination(combination, values);
+	applyParameters(values);
+
+	if (job < runs)
+		runClosedLoop(&_loops[job]);
+	else
+		runDetectors(&_detectors[combination]);
+}
+
+/**
+ * @brief Runs every job, each in a process of its own, at most workers at a time
+ * @param runs the closed loop runs, the jobs after them are detectors runs
+ * @return the number of runs that did not end normally
+ */
+static unsigned runJobs(size_t jobs, size_t runs, unsigned workers) {
+	unsigned running = 0, failed = 0;
+	size_t next = 0;
+
+	// Nothing buffered must be written twice
+	fflush(stdout);
+
+	while (next < jobs || running > 0) {
+		while (running < workers && next < jobs) {
+			pid_t pid = fork();
+
+			if (pid < 0) {
+				perror("sweep: fork");
+				break;
+			}
+
+			if (pid == 0) {
+				runJob(next, runs);
+				_exit(0);
+			}
+
+			running++;
+			next++;
+		}
+
+		if (running == 0)
+			break;
+
+		int status;
+
+		if (wait(&status) < 0) {
+			perror("sweep: wait");
+			break;
+		}
+
+		running--;
+
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			failed++;
+	}
+
+	return failed;
+}
+
+/**
+ * @brief Gets a percentile by the nearest rank
+ * @param values the values, sorted
+ * @param percent the percentile
+ */
+static float getPercentile(const std::vector<float>& values, float percent) {
+	if (values.empty())
+		return 0.f;
+
+	size_t rank = (size_t)ceilf(percent / 100.f * values.size());
+
+	return values[rank > 0 ? rank - 1 : 0];
+}
+
+static Summary summarize(size_t combination) {
+	std::vector<float> settle, overshoot, finalError, rmsError, fusionError, effort, cpuUs;
+	Summary summary;
+
+	memset(&summary, 0, sizeof(summary));
+
+	for (uint32_t s = 0; s < _options.seeds; s++) {
+		const LoopResult& r = _loops[combination * _options.seeds + s];
+
+		if (!r.isDone) {
+			summary.failed++;
+			continue;
+		}
+
+		if (r.isSettled)
+			settle.push_back(r.settle);
+		else
+			summary.failed++;
+
+		overshoot.push_back(r.overshoot);
+		finalError.push_back(fabs(r.finalError));
+		rmsError.push_back(r.rmsError);
+		fusionError.push_back(r.fusionError);
+		effort.push_back(r.effort);
+		cpuUs.push_back(r.cpuUs);
+	}
+
+	std::vector<float>* all[] = { &settle, &overshoot, &finalError, &rmsError, &fusionError, &effort, &cpuUs };
+
+	for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++)
+		std::sort(all[i]->begin(), all[i]->end());
+
+	summary.settle[0] = getPercentile(settle, 50.f);
+	summary.settle[1] = getPercentile(settle, 95.f);
+	summary.settle[2] = getPercentile(settle, 100.f);
+	summary.overshoot[0] = getPercentile(overshoot, 50.f);
+	summary.overshoot[1] = getPercentile(overshoot, 95.f);
+	summary.finalError = getPercentile(finalError, 95.f);
+	summary.rmsError = getPercentile(rmsError, 95.f);
+	summary.fusionError = getPercentile(fusionError, 50.f);
+	summary.effort[0] = getPercentile(effort, 5.f);
+	summary.effort[1] = getPercentile(effort, 50.f);
+	summary.effort[2] = getPercentile(effort, 95.f);
+	summary.cpuUs = getPercentile(cpuUs, 50.f);
+
+	return summary;
+}
+
+static bool isDetectorKey(void) {
+	return strcmp(_rankKey, "detect") == 0;
+}
+
+static float getRankValue(const Summary& s) {
+	if (strcmp(_rankKey, "overshoot") == 0)
+		return s.overshoot[1];
+	if (strcmp(_rankKey, "final") == 0)
+		return s.finalError;
+	if (strcmp(_rankKey, "rms") == 0)
+		return s.rmsError;
+	if (strcmp(_rankKey, "fusion") == 0)
+		return s.fusionError;
+	if (strcmp(_rankKey, "effort") == 0)
+		return s.effort[1];
+	if (strcmp(_rankKey, "cpu") == 0)
+		return s.cpuUs;
+
+	return s.settle[1];
+}
+
+/**
+ * @brief Orders two combinations by _rankKey, the ones it does not apply to last
+ */
+static bool isBetter(size_t a, size_t b) {
+	if (isDetectorKey()) {
+		const DetectorResult& ra = _detectors[a];
+		const DetectorResult& rb = _detectors[b];
+
+		if (ra.isDone != rb.isDone)
+			return ra.isDone;
+
+		uint32_t missedA = ra.events - ra.caught, missedB = rb.events - rb.caught;
+
+		if (missedA != missedB)
+			return missedA < missedB;
+		if (ra.falsePositives != rb.falsePositives)
+			return ra.falsePositives < rb.falsePositives;
+
+		return ra.latencyMs < rb.latencyMs;
+	}
+
+	const Summary& sa = _summaries[a];
+	const Summary& sb = _summaries[b];
+
+	if (sa.failed != sb.failed)
+		return sa.failed < sb.failed;
+
+	if (getRankValue(sa) != getRankValue(sb))
+		return getRankValue(sa) < getRankValue(sb);
+
+	return sa.finalError < sb.finalError;
+}
+
+static void printHeader(const std::vector<int>& swept) {
+	printf("  %6s", "rank");
+
+	for (size_t i = 0; i < swept.size(); i++)
+		printf(" %9s", _parameters[swept[i]].name);
+
+	if (_options.seeds == 1)
+		printf(" %8s %9s %7s %7s %7s %7s %8s", "settle s", "overshoot", "final", "rms", "fusion", "effort", "cpu us/s");
+	else
+		printf(" %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s", "settled", "settle50", "settle95", "settle m",
+				"over50", "over95", "final95", "effort5", "effort50", "effort95", "cpu us/s");
+
+	if (!_traces.empty())
+		printf(" %10s %6s %8s", "caught", "false", "late ms");
+
+	printf("\n");
+}
+
+static void printRow(size_t rankIndex, size_t combination, const std::vector<int>& swept) {
+	const LoopResult& r = _loops[combination * _options.seeds];
+	const Summary& s = _summaries[combination];
+	const DetectorResult& d = _detectors[combination];
+	float values[PARAMETERS_COUNT];
+
+	getCombination(combination, values);
+
+	printf("  %5zu%c", rankIndex + 1, isDefault(combination) ? '*' : ' ');
+
+	for (size_t i = 0; i < swept.size(); i++)
+		printf(" %9g", values[swept[i]]);
+
+	if (_options.seeds > 1)
+		printf(" %7.1f%% %8.2f %8.2f %8.2f %8.1f %8.1f %8.1f %8.2f %8.2f %8.2f %8.0f",
+				100.f * (_options.seeds - s.failed) / _options.seeds, s.settle[0], s.settle[1], s.settle[2],
+				s.overshoot[0], s.overshoot[1], s.finalError, s.effort[0], s.effort[1], s.effort[2], s.cpuUs);
+	else if (!r.isDone)
+		printf(" %8s %9s %7s %7s %7s %7s %8s", "failed", "-", "-", "-", "-", "-", "-");
+	else if (!r.isSettled)
+		printf(" %8s %9.1f %7.1f %7.1f %7.2f %7.2f %8.0f", "no", r.overshoot, r.finalError, r.rmsError,
+				r.fusionError, r.effort, r.cpuUs);
+	else
+		printf(" %8.2f %9.1f %7.1f %7.1f %7.2f %7.2f %8.0f", r.settle, r.overshoot, r.finalError, r.rmsError,
+				r.fusionError, r.effort, r.cpuUs);
+
+	if (d.isDone)
+		printf(" %6u/%-3u %6u %8.0f", d.caught, d.events, d.falsePositives, d.latencyMs);
+
+	printf("\n");
+}
+
+/**
+ * @brief Writes every closed loop run as CSV, with the detectors results of its combination
+ */
+static bool writeResults(const char* path, size_t count) {
+	FILE* file = fopen(path, "w");
+
+	if (file == NULL)
+		return false;
+
+	for (int i = 0; i < PARAMETERS_COUNT; i++)
+		fprintf(file, "%s,", _parameters[i].name);
+
+	fprintf(file, "seed,accNoise,gyrNoise,biasX,biasY,biasZ,delay,kick,"
+			"settled,settle,overshoot,final,rms,fusion,effort,cpu,events,caught,false,latency\n");
+
+	for (size_t c = 0; c < count; c++) {
+		const DetectorResult& d = _detectors[c];
+		float values[PARAMETERS_COUNT];
+
+		getCombination(c, values);
+
+		for (uint32_t s = 0; s < _options.seeds; s++) {
+			const LoopResult& r = _loops[c * _options.seeds + s];
+
+			for (int i = 0; i < PARAMETERS_COUNT; i++)
+				fprintf(file, "%g,", values[i]);
+
+			if (r.isDone)
+				fprintf(file, "%u,%.2f,%.3f,%.3f,%.3f,%.3f,%.0f,%.0f,%d,%.3f,%.2f,%.2f,%.2f,%.2f,%.3f,%.1f,", r.seed,
+						r.noise.accNoise, r.noise.gyrNoise, r.noise.gyrBias[0], r.noise.gyrBias[1], r.noise.gyrBias[2],
+						r.delay, r.kick, r.isSettled, r.settle, r.overshoot, r.finalError, r.rmsError, r.fusionError,
+						r.effort, r.cpuUs);
+			else
+				fprintf(file, "%u,,,,,,,,,,,,,,,,", r.seed);
+
+			if (d.isDone)
+				fprintf(file, "%u,%u,%u,%.0f\n", d.events, d.caught, d.falsePositives, d.latencyMs);
+			else
+				fprintf(file, ",,,\n");
+		}
+	}
+
+	return fclose(file) == 0;
+}
+
+static void usage(void) {
+	fprintf(stderr, "usage: sweep [-p name=v1,v2|start:stop:step]... [-m seeds] [-j jobs] [-s key] [-n top] "
+			"[-o results.csv] [-t seconds] [-y degrees] [-a acc noise] [-g gyr noise] [-b gyr bias] [-J jitter] "
+			"[-D delay] [-r seed] [-N model.txt] [trace...]\nparameters:");
+
+	for (int i = 0; i < PARAMETERS_COUNT; i++)
+		fprintf(stderr, " %s", _parameters[i].name);
+
+	fprintf(stderr, "\nkeys: settle overshoot final rms fusion effort cpu detect\n");
+	exit(2);
+}
+
+int main(int argc, char** argv) {
+	unsigned workers = (unsigned)max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+	const char* output = NULL;
+	const char* noiseModel = NULL;
+	size_t top = 20;
+	int c;
+
+	for (int i = 0; i < PARAMETERS_COUNT; i++)
+		_values[i].push_back(_parameters[i].value);
+
+	while ((c = getopt(argc, argv, "p:m:j:s:n:o:t:y:a:g:b:J:D:r:N:")) != -1) {
+		switch (c) {
+			case 'p': if (!parseParameter(optarg)) usage(); break;
+			case 'm': _options.seeds = (uint32_t)atol(optarg); break;
+			case 'j': workers = (unsigned)atoi(optarg); break;
+			case 's': _rankKey = optarg; break;
+			case 'n': top = (size_t)atol(optarg); break;
+			case 'o': output = optarg; break;
+			case 't': _options.duration = atof(optarg); break;
+			case 'y': _options.angle = atof(optarg); break;
+			case 'a': _options.noise.accNoise = atof(optarg); break;
+			case 'g': _options.noise.gyrNoise = atof(optarg); break;
+			case 'b': _options.noise.gyrBias[0] = _options.noise.gyrBias[1] = _options.noise.gyrBias[2] = atof(optarg); break;
+			case 'J': _options.jitter = atof(optarg); break;
+			case 'D': _options.delay = atof(optarg); break;
+			case 'r': _options.noise.seed = (uint32_t)atol(optarg); break;
+			case 'N': noiseModel = optarg; break;
+			default: usage();
+		}
+	}
+
+	const char* keys[] = { "settle", "overshoot", "final", "rms", "fusion", "effort", "cpu", "detect" };
+	bool isKnownKey = false;
+
+	for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+		isKnownKey |= strcmp(_rankKey, keys[i]) == 0;
+
+	if (!isKnownKey || workers == 0 || _options.seeds == 0 || _options.duration <= SWEEP_KICK_TIME ||
+			_options.jitter < 0.f || _options.jitter >= SWEEP_SENSORS_PERIOD || _options.delay < 0.f)
+		usage();
+
+	if (noiseModel != NULL && !_noiseModel.read(noiseModel)) {
+		fprintf(stderr, "sweep: cannot read %s\n", noiseModel);
+		return 1;
+	}
+
+	_hasNoiseModel = noiseModel != NULL;
+	_traces.resize(argc - optind);
+
+	for (int i = optind; i < argc; i++) {
+		if (!_traces[i - optind].read(argv[i]) || !_traces[i - optind].hasLabels()) {
+			fprintf(stderr, "sweep: cannot read %s, or it has no labels\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (isDetectorKey() && _traces.empty()) {
+		fprintf(stderr, "sweep: -s detect needs labelled traces\n");
+		return 1;
+	}
+
+	size_t count = getCombinationCount();
+	size_t runs = count * _options.seeds;
+
+	if (count > SWEEP_MAX_RUNS || runs > SWEEP_MAX_RUNS) {
+		fprintf(stderr, "sweep: %zu closed loop runs, at most %d\n", runs, SWEEP_MAX_RUNS);
+		return 1;
+	}
+
+	size_t size = runs * sizeof(LoopResult) + count * sizeof(DetectorResult);
+	void* shared = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (shared == MAP_FAILED) {
+		perror("sweep: mmap");
+		return 1;
+	}
+
+	memset(shared, 0, size);
+
+	_loops = (LoopResult*)shared;
+	_detectors = (DetectorResult*)(_loops + runs);
+
+	for (size_t r = 0; r < runs; r++)
+		_loops[r].seed = _options.noise.seed + (uint32_t)(r % _options.seeds);
+
+	Serial.setStream(NULL);
+
+	std::vector<int> swept;
+
+	for (int i = 0; i < PARAMETERS_COUNT; i++)
+		if (_values[i].size() > 1 || _values[i][0] != _parameters[i].value)
+			swept.push_back(i);
+
+	printf("%zu combinations x %u closed loop run%s%s on %u process%s\n", count, _options.seeds,
+			_options.seeds > 1 ? "s" : "", _traces.empty() ? "" : " and detectors", workers, workers > 1 ? "es" : "");
+	if (_hasNoiseModel)
+		printf("kick of %.0f deg, noise of %s, bias %.2f deg/s, jitter %.0f us, delay %.0f ms%s\n", _options.angle,
+				noiseModel, _options.noise.gyrBias[0], _options.jitter, _options.delay,
+				_options.seeds > 1 ? ", drawn up to" : "");
+	else
+		printf("kick of %.0f deg, acc noise %.1f counts, gyr noise %.2f deg/s, bias %.2f deg/s, jitter %.0f us, "
+				"delay %.0f ms%s\n", _options.angle, _options.noise.accNoise, _options.noise.gyrNoise,
+				_options.noise.gyrBias[0], _options.jitter, _options.delay, _options.seeds > 1 ? ", drawn up to" : "");
+
+	timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	unsigned failed = runJobs(runs + (_traces.empty() ? 0 : count), runs, workers);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double wall = elapsedNs(start, end) / 1e9;
+
+	printf("%.2f s, %.0f runs/s%s\n\n", wall, (runs + (_traces.empty() ? 0 : count)) / wall,
+			failed ? ", some runs failed" : "");
+
+	_summaries.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+		_summaries[i] = summarize(i);
+
+	std::vector<size_t> order(count);
+
+	for (size_t i = 0; i < count; i++)
+		order[i] = i;
+
+	std::stable_sort(order.begin(), order.end(), isBetter);
+
+	printHeader(swept);
+
+	bool isDefaultShown = false;
+
+	for (size_t i = 0; i < order.size() && i < top; i++) {
+		printRow(i, order[i], swept);
+		isDefaultShown |= isDefault(order[i]);
+	}
+
+	// Where the firmware defaults stand, when they are part of the sweep
+	for (size_t i = top; i < order.size() && !isDefaultShown; i++) {
+		if (isDefault(order[i])) {
+			printf("  %6s\n", "...");
+			printRow(i, order[i], swept);
+			isDefaultShown = true;
+		}
+	}
+
+	if (output != NULL && !writeResults(output, count)) {
+		fprintf(stderr, "sweep: cannot write %s\n", output);
+		return 1;
+	}
+
+	return failed ? 1 : 0;
+}
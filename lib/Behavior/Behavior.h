@@ -3,18 +3,19 @@
 
 #include <Arduino.h>
 #include "ChibiOS_AVR.h"
+#include "Tasks.h"
 
 namespace BehaviorName {
 
-	// Thread methods
-	static WORKING_AREA(behaviorThreadArea, 256);
-	static msg_t thread(void* arg);
+	// Task methods
+	static uint32_t tick(Task* task);
 
-	void init(void* arg = NULL, tprio_t priority = NORMALPRIO);
+	void init(void);
 	void start(void);
 	void stop(void);
 
 	// Variables
+	Task _task;
 	bool _isInitialized = false;
 	bool _isStarted = false;
 	uint16_t _behaviorThreadDelay = 50;
@@ -24,14 +25,14 @@ namespace BehaviorName {
 
 }
 
-void BehaviorName::init(void* arg, tprio_t priority) {
+void BehaviorName::init(void) {
 	if (!_isInitialized) {
 		_isInitialized = true;
 		_isStarted = false;
 
-		(void)chThdCreateStatic(behaviorThreadArea,
-				sizeof(behaviorThreadArea),
-				priority, thread, arg);
+		Tasks::init();
+		Tasks::create(&_task, "behavior", tick);
+		Tasks::start(&_task);
 	}
 }
 
@@ -51,21 +52,22 @@ void BehaviorName::stop(void) {
 	chMtxUnlock();
 }
 
-msg_t BehaviorName::thread(void* arg) {
+uint32_t BehaviorName::tick(Task* task) {
 
-	(void) arg;
+	TASK_BEGIN(task);
 
-	while (!chThdShouldTerminate()) {
+	while (TRUE) {
 
 		if (_isStarted) {
 
-			// do things here
+			// do things here, TASK_WAIT_MS(task, ms) instead of waitMs
 
 		}
 
-		waitMs(_behaviorThreadDelay);
+		TASK_WAIT_MS(task, _behaviorThreadDelay);
 	}
-	return (msg_t)0;
+
+	TASK_END(task);
 }
 
 #endif
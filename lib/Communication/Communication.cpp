@@ -66,18 +66,25 @@ namespace Communication {
 	 * @brief Writes sensors data to the serial
 	 */
 	void sendSensorData(void) {
+		Sensors::Sample sample;
+		Sensors::getSample(&sample);
+
+		float ypr[3];
+		Sensors::computeAngles(&sample.orientation, ORIENTATION_HEADING | ORIENTATION_PITCH_ROLL);
+		sample.orientation.getYawPitchRollRad(ypr);
+
 		Serial.print(F("S,"));
-		Serial.print(Sensors::getAccX());
+		Serial.print(sample.acc[0]);
 		Serial.print(F(","));
-		Serial.print(Sensors::getAccY());
+		Serial.print(sample.acc[1]);
 		Serial.print(F(","));
-		Serial.print(Sensors::getAccZ());
+		Serial.print(sample.acc[2]);
 		Serial.print(F(","));
-		Serial.print(Sensors::getGyrYDeg());
+		Serial.print(Sensors::radToDeg(ypr[0]));
 		Serial.print(F(","));
-		Serial.print(Sensors::getGyrPDeg());
+		Serial.print(Sensors::radToDeg(ypr[1]));
 		Serial.print(F(","));
-		Serial.println(Sensors::getGyrRDeg());
+		Serial.println(Sensors::radToDeg(ypr[2]));
 	}
 
 
@@ -97,4 +104,85 @@ namespace Communication {
 		serial.println(F(""));
 		serial.flush();
 	}
+
+
+	/**
+	 * @brief Writes the stack of every thread StackMonitor watches to the serial, one line each:
+	 * W,name,size,used,free,suggested and ,LOW when the thread is short of stack
+	 */
+	void sendStackData(void) {
+		StackMonitor::update();
+
+		for (uint8_t i = 0; i < StackMonitor::getCount(); i++) {
+			serial.print(F("W,")); /* W like Working area */
+			serial.print(StackMonitor::getName(i));
+			serial.print(F(","));
+			serial.print(StackMonitor::getSize(i));
+			serial.print(F(","));
+			serial.print(StackMonitor::getUsed(i));
+			serial.print(F(","));
+			serial.print(StackMonitor::getFree(i));
+			serial.print(F(","));
+			serial.print(StackMonitor::getSuggested(i));
+
+			if (StackMonitor::isLow(i))
+				serial.print(F(",LOW"));
+
+			serial.println(F(""));
+		}
+
+		serial.flush();
+	}
+
+
+	/**
+	 * @brief Writes the CPU load of every thread SystemStats saw to the serial:
+	 * C,window;name,load;name,load... with the window in ms and the loads in per mille
+	 */
+	void sendLoadData(void) {
+		serial.print(F("C,")); /* C like CPU */
+		serial.print(SystemStats::getWindow());
+
+		for (uint8_t i = 0; i < SystemStats::getCount(); i++) {
+			serial.print(F(";"));
+			serial.print(SystemStats::getName(i));
+			serial.print(F(","));
+			serial.print(SystemStats::getLoad(i));
+		}
+
+		serial.println(F(""));
+		serial.flush();
+	}
+
+
+	/**
+	 * @brief Writes how well every periodic loop keeps its period to the serial, one line each:
+	 * P,name,period,cycles,overruns,maxLateness,histogram... with the times in ms and the
+	 * PERIODIC_BINS bins of the lateness histogram last
+	 */
+	void sendPeriodData(void) {
+		for (uint8_t i = 0; i < Periodic::getCount(); i++) {
+			PeriodicLoop* loop = Periodic::get(i);
+
+			serial.print(F("P,")); /* P like Period */
+			serial.print(loop->name);
+			serial.print(F(","));
+			serial.print(Periodic::getPeriod(loop));
+			serial.print(F(","));
+			serial.print(loop->cycles);
+			serial.print(F(","));
+			serial.print(loop->overruns);
+			serial.print(F(","));
+			serial.print(Periodic::getMaxLateness(loop));
+
+			for (uint8_t j = 0; j < PERIODIC_BINS; j++) {
+				serial.print(F(","));
+				serial.print(loop->histogram[j]);
+			}
+
+			serial.println(F(""));
+		}
+
+		serial.flush();
+	}
 }
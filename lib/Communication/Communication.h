@@ -32,6 +32,9 @@
 #include "Light.h"
 #include "DriveSystem.h"
 #include "Sensors.h"
+#include "StackMonitor.h"
+#include "SystemStats.h"
+#include "Periodic.h"
 
 namespace Communication {
 
@@ -39,6 +42,9 @@ namespace Communication {
 	void sendLedData(void);
 	void sendSensorData(void);
 	void sendAllData(void);
+	void sendStackData(void);
+	void sendLoadData(void);
+	void sendPeriodData(void);
 
 }
 
@@ -12,7 +12,7 @@ PID logic:
 
 PID::~PID()
 {
-	_ErrorTracker.~RunningAverage();
+	// _ErrorTracker is destroyed with the PID, destroying it here too freed its buffer twice
 }
 
 PID::PID():_ErrorTracker(3)
@@ -77,6 +77,12 @@ float PID::GetInitialAngle(){
 	return _InitialAngle;
 }
 
+void PID::SetGains(const float Kp, const float Ki, const float Kd){
+	_Kp = Kp;
+	_Ki = Ki;
+	_Kd = Kd;
+}
+
 float PID::CalculatePID(const float currentAngle)
 {
 	
@@ -24,6 +24,8 @@ class PID
 	//Impact Initial Angle
 	void SetInitialAngle(const float);
 	float GetInitialAngle();
+	//Tuning
+	void SetGains(const float, const float, const float);
 
 	private:
 
@@ -14,7 +14,7 @@
  ***************************************************************************/
 
 #include "ADXL345.h"
-#include <Wire.h>
+#include "I2C.h"
 
 #define TO_READ (6)	  // num of bytes we are going to read each time (two bytes for each axis)
 
@@ -50,9 +50,29 @@ void ADXL345::readAccel(int *x, int *y, int *z) {
 
 	// each axis reading comes in 10 bit resolution, ie 2 bytes.  Least Significat Byte first!!
 	// thus we are converting both bytes in to one int
-	*x = (((int)_buff[1]) << 8) | _buff[0];
-	*y = (((int)_buff[3]) << 8) | _buff[2];
-	*z = (((int)_buff[5]) << 8) | _buff[4];
+	*x = (int16_t)((((int)_buff[1]) << 8) | _buff[0]);
+	*y = (int16_t)((((int)_buff[3]) << 8) | _buff[2]);
+	*z = (int16_t)((((int)_buff[5]) << 8) | _buff[4]);
+}
+
+// Drains up to maxSamples XYZ samples from the FIFO into out (3 values per sample, oldest first)
+// and returns how many were read. Only what the FIFO held when called is read, so the loop ends
+// even if samples keep coming. The part does not roll over from DATAZ1 to the next entry, so each
+// entry is its own 6 bytes read, back to back.
+uint8_t ADXL345::readAccelFifo(int16_t* out, uint8_t maxSamples) {
+	uint8_t n = getFifoEntries();
+
+	if (n > maxSamples)
+		n = maxSamples;
+
+	for (uint8_t i = 0; i < n; i++) {
+		readFrom(ADXL345_DATAX0, TO_READ, _buff);
+		out[3 * i]     = (((int16_t)_buff[1]) << 8) | _buff[0];
+		out[3 * i + 1] = (((int16_t)_buff[3]) << 8) | _buff[2];
+		out[3 * i + 2] = (((int16_t)_buff[5]) << 8) | _buff[4];
+	}
+
+	return n;
 }
 
 void ADXL345::get_Gxyz(float *xyz){
@@ -66,32 +86,18 @@ void ADXL345::get_Gxyz(float *xyz){
 
 // Writes val to address register on device
 void ADXL345::writeTo(byte address, byte val) {
-	Wire.beginTransmission(_dev_address); // start transmission to device
-	Wire.write(address);			 // send register address
-	Wire.write(val);				 // send value to write
-	Wire.endTransmission();		 // end transmission
+	if(I2C::writeRegister(_dev_address, address, val) != I2C_OK) {
+		status = ADXL345_ERROR;
+		error_code = ADXL345_WRITE_ERROR;
+	}
 }
 
 // Reads num bytes starting from address register on device in to _buff array
 void ADXL345::readFrom(byte address, int num, byte _buff[]) {
-	Wire.beginTransmission(_dev_address); // start transmission to device
-	Wire.write(address);			 // sends address to read from
-	Wire.endTransmission();		 // end transmission
-	
-	Wire.beginTransmission(_dev_address); // start transmission to device
-	Wire.requestFrom(_dev_address, num);	// request 6 bytes from device
-
-	int i = 0;
-	while(Wire.available())	{	 // device may send less than requested (abnormal)
-		_buff[i] = Wire.read();	// receive a byte
-		i++;
-	}
-	if(i != num) {
+	if(I2C::readRegisters(_dev_address, address, _buff, num) != I2C_OK) {
 		status = ADXL345_ERROR;
 		error_code = ADXL345_READ_ERROR;
 	}
-	
-	Wire.endTransmission();		 // end transmission
 }
 
 // Gets the range setting and return it into rangeSetting
@@ -577,6 +583,41 @@ bool ADXL345::getRegisterBit(byte regAdress, int bitPos) {
 	return ((_b >> bitPos) & 1);
 }
 
+// Sets the FIFO mode: ADXL345_FIFO_BYPASS, ADXL345_FIFO_FIFO, ADXL345_FIFO_STREAM or ADXL345_FIFO_TRIGGER
+void ADXL345::setFifoMode(byte mode) {
+	byte _b;
+	readFrom(ADXL345_FIFO_CTL, 1, &_b);
+	_b = (_b & B00111111) | (mode << 6);
+	writeTo(ADXL345_FIFO_CTL, _b);
+}
+
+byte ADXL345::getFifoMode() {
+	byte _b;
+	readFrom(ADXL345_FIFO_CTL, 1, &_b);
+	return _b >> 6;
+}
+
+// Sets how many samples raise the watermark interrupt, from 0 to 31
+void ADXL345::setFifoWatermark(byte samples) {
+	byte _b;
+	readFrom(ADXL345_FIFO_CTL, 1, &_b);
+	_b = (_b & B11100000) | (samples & B00011111);
+	writeTo(ADXL345_FIFO_CTL, _b);
+}
+
+byte ADXL345::getFifoWatermark() {
+	byte _b;
+	readFrom(ADXL345_FIFO_CTL, 1, &_b);
+	return _b & B00011111;
+}
+
+// Gets how many samples wait in the FIFO
+byte ADXL345::getFifoEntries() {
+	byte _b;
+	readFrom(ADXL345_FIFO_STATUS, 1, &_b);
+	return _b & B00111111;
+}
+
 // print all register value to the serial ouptut, which requires it to be setup
 // this can be used to manually to check the current configuration of the device
 void ADXL345::printAllRegister() {
@@ -54,6 +54,16 @@
 #define ADXL345_FIFO_CTL 0x38
 #define ADXL345_FIFO_STATUS 0x39
 
+/*
+ FIFO modes (FIFO_CTL D7:D6)
+ */
+#define ADXL345_FIFO_BYPASS  0x00
+#define ADXL345_FIFO_FIFO    0x01 // stops when full
+#define ADXL345_FIFO_STREAM  0x02 // keeps the 32 newest samples
+#define ADXL345_FIFO_TRIGGER 0x03
+
+#define ADXL345_FIFO_SIZE 32
+
 #define ADXL345_BW_1600 0xF // 1111
 #define ADXL345_BW_800  0xE // 1110
 #define ADXL345_BW_400  0xD // 1101
@@ -91,6 +101,7 @@
 
 #define ADXL345_NO_ERROR   0 // initial state
 #define ADXL345_READ_ERROR 1 // problem reading accel
+#define ADXL345_WRITE_ERROR 2 // problem writing a register
 #define ADXL345_BAD_ARG	2 // bad method argument
 
 class ADXL345
@@ -192,6 +203,13 @@ public:
   void setFullResBit(bool fullResBit);
   bool getJustifyBit();
   void setJustifyBit(bool justifyBit);
+
+  void setFifoMode(byte mode);
+  byte getFifoMode();
+  void setFifoWatermark(byte samples);
+  byte getFifoWatermark();
+  byte getFifoEntries();
+  uint8_t readAccelFifo(int16_t* out, uint8_t maxSamples);
   void printAllRegister();
   void writeTo(byte address, byte val);
 
@@ -30,20 +30,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 //#include "vector_math.h"
 
-FreeIMU::FreeIMU() {
+FreeIMU::FreeIMU() : ahrs(twoKpDef, twoKiDef) {
 	gyro = ITG3200();
 
-	// initialize quaternion
-	q0 = 1.0f;
-	q1 = 0.0f;
-	q2 = 0.0f;
-	q3 = 0.0f;
-	exInt = 0.0;
-	eyInt = 0.0;
-	ezInt = 0.0;
-	twoKp = twoKpDef;
-	twoKi = twoKiDef;
-	integralFBx = 0.0f,  integralFBy = 0.0f, integralFBz = 0.0f;
+	accFifo = false;
 	lastUpdate = 0;
 	now = 0;
 
@@ -85,35 +75,36 @@ void FreeIMU::init(bool fastmode) {
  * Initialize the FreeIMU I2C bus, sensors and performs gyro offsets calibration
 */
 void FreeIMU::init(int acc_addr, int gyro_addr, bool fastmode) {
-	delay(5);
+	init(acc_addr, gyro_addr, fastmode, true);
+}
 
-	// disable internal pullups of the ATMEGA which Wire enable by default
-	#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega8__) || defined(__AVR_ATmega328P__)
-	// deactivate internal pull-ups for twi
-	// as per note from atmega8 manual pg167
-	cbi(PORTC, 4);
-	cbi(PORTC, 5);
-	#else
-	// deactivate internal pull-ups for twi
-	// as per note from atmega128 manual pg204
-	cbi(PORTD, 0);
-	cbi(PORTD, 1);
-	#endif
 
-	if(fastmode) { // switch to 400KHz I2C - eheheh
-	 TWBR = ((F_CPU / 400000L) - 16) / 2; // see twi_init in Wire/utility/twi.c
-	}
+/**
+ * Initialize the FreeIMU I2C bus and sensors. Without zero, the gyro offsets calibration
+ * (and the second it waits for the gyro to settle) is skipped: the caller sets known offsets.
+*/
+void FreeIMU::init(int acc_addr, int gyro_addr, bool fastmode, bool zero) {
+	delay(5);
+
+	// interrupt driven I2C, 400KHz unless told otherwise
+	I2C::init(fastmode ? I2C_DEFAULT_FREQUENCY : 100000L);
 
 	acc.init(acc_addr);
 
 	// init ITG3200
 	gyro.init(gyro_addr);
-	delay(1000);
-	// calibrate the ITG3200
-	gyro.zeroCalibrate(128,5);
 
-	// zero gyro
-	zeroGyro();
+	if (zero) {
+		delay(1000);
+		// calibrate the ITG3200
+		gyro.zeroCalibrate(128,5);
+
+		// zero gyro
+		zeroGyro();
+	}
+
+	// the first update integrates from here, not from boot
+	lastUpdate = micros();
 }
 
 /**
@@ -130,7 +121,7 @@ void FreeIMU::getRawValues(int * raw_values) {
 */
 void FreeIMU::getValues(float * values) {
 	int accval[3];
-	acc.readAccel(&accval[0], &accval[1], &accval[2]);
+	readAcc(accval);
 	values[0] = (float) accval[0];
 	values[1] = (float) accval[1];
 	values[2] = (float) accval[2];
@@ -145,6 +136,62 @@ void FreeIMU::getValues(float * values) {
 }
 
 
+/**
+ * Chooses where the accelerometer readings come from: the data registers, or the average of
+ * every sample waiting in the FIFO (which the caller has put in stream mode)
+*/
+void FreeIMU::setAccFifo(bool fifo) {
+	accFifo = fifo;
+}
+
+
+/**
+ * Sets the gains of the AHRS filter, twoKpDef and twoKiDef by default
+ *
+ * @param twoKp 2 * proportional gain
+ * @param twoKi 2 * integral gain
+*/
+void FreeIMU::setGains(float twoKp, float twoKi) {
+	ahrs.setGains(twoKp, twoKi);
+}
+
+
+/**
+ * Reads the accelerometer, averaging the FIFO if enabled. Drains by small chunks to keep the stack small.
+*/
+void FreeIMU::readAcc(int * xyz) {
+	int16_t chunk[4 * 3];
+	int32_t sum[3] = { 0, 0, 0 };
+	uint8_t count = 0;
+	uint8_t n;
+
+	if (!accFifo) {
+		acc.readAccel(xyz);
+		return;
+	}
+
+	do {
+		n = acc.readAccelFifo(chunk, 4);
+
+		for (uint8_t i = 0; i < n; i++) {
+			sum[0] += chunk[3 * i];
+			sum[1] += chunk[3 * i + 1];
+			sum[2] += chunk[3 * i + 2];
+		}
+
+		count += n;
+	} while (n == 4 && count < ADXL345_FIFO_SIZE);
+
+	if (count == 0) {
+		acc.readAccel(xyz);
+		return;
+	}
+
+	for (uint8_t i = 0; i < 3; i++)
+		xyz[i] = (sum[i] + (sum[i] >= 0 ? count / 2 : -(count / 2))) / count;
+}
+
+
 /**
  * Computes gyro offsets
 */
@@ -167,147 +214,72 @@ void FreeIMU::zeroGyro() {
 
 
 /**
- * Quaternion implementation of the 'DCM filter' [Mayhony et al].  Incorporates the magnetic distortion
- * compensation algorithms from Sebastian Madgwick's filter which eliminates the need for a reference
- * direction of flux (bx bz) to be predefined and limits the effect of magnetic distortions to yaw
- * axis only.
+ * Reads the sensors once and runs one step of the AHRS filter. The new quaternion goes to
+ * orientation, whose angles are only computed when asked for.
  *
- * @see: http://www.x-io.co.uk/node/8#open_source_ahrs_and_imu_algorithms
+ * @param values populated like getValues does, with the readings the filter step used
 */
-void  FreeIMU::AHRSupdate(float gx, float gy, float gz, float ax, float ay, float az) {
-	float recipNorm;
-	float q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;
-	float halfex = 0.0f, halfey = 0.0f, halfez = 0.0f;
-	float qa, qb, qc;
-
-	// Auxiliary variables to avoid repeated arithmetic
-	q0q0 = q0 * q0;
-	q0q1 = q0 * q1;
-	q0q2 = q0 * q2;
-	q0q3 = q0 * q3;
-	q1q1 = q1 * q1;
-	q1q2 = q1 * q2;
-	q1q3 = q1 * q3;
-	q2q2 = q2 * q2;
-	q2q3 = q2 * q3;
-	q3q3 = q3 * q3;
-
-	// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
-	if((ax != 0.0f) && (ay != 0.0f) && (az != 0.0f)) {
-	float halfvx, halfvy, halfvz;
-
-	// Normalise accelerometer measurement
-	recipNorm = invSqrt(ax * ax + ay * ay + az * az);
-	ax *= recipNorm;
-	ay *= recipNorm;
-	az *= recipNorm;
-
-	// Estimated direction of gravity
-	halfvx = q1q3 - q0q2;
-	halfvy = q0q1 + q2q3;
-	halfvz = q0q0 - 0.5f + q3q3;
-
-	// Error is sum of cross product between estimated direction and measured direction of field vectors
-	halfex += (ay * halfvz - az * halfvy);
-	halfey += (az * halfvx - ax * halfvz);
-	halfez += (ax * halfvy - ay * halfvx);
-	}
+void FreeIMU::update(float * values) {
+	float q[4];
 
-	// Apply feedback only when valid data has been gathered from the accelerometer or magnetometer
-	if(halfex != 0.0f && halfey != 0.0f && halfez != 0.0f) {
-	// Compute and apply integral feedback if enabled
-	if(twoKi > 0.0f) {
-		integralFBx += twoKi * halfex * (1.0f / sampleFreq);  // integral error scaled by Ki
-		integralFBy += twoKi * halfey * (1.0f / sampleFreq);
-		integralFBz += twoKi * halfez * (1.0f / sampleFreq);
-		gx += integralFBx;  // apply integral feedback
-		gy += integralFBy;
-		gz += integralFBz;
-	}
-	else {
-		integralFBx = 0.0f; // prevent integral windup
-		integralFBy = 0.0f;
-		integralFBz = 0.0f;
-	}
+	#ifdef FREEIMU_FIXED_POINT
+	int raw[6];
+	readAcc(&raw[0]);
+	gyro.readGyroRawCal(&raw[3]);
 
-	// Apply proportional feedback
-	gx += twoKp * halfex;
-	gy += twoKp * halfey;
-	gz += twoKp * halfez;
-	}
+	now = micros();
+	ahrs.update(raw[3], raw[4], raw[5], raw[0] - acc_off_x, raw[1] - acc_off_y, raw[2] - acc_off_z,
+			(uint16_t)min(now - lastUpdate, (unsigned long)MAHONY_FIXED_MAX_DT));
+	lastUpdate = now;
+
+	values[0] = (raw[0] - acc_off_x) / acc_scale_x;
+	values[1] = (raw[1] - acc_off_y) / acc_scale_y;
+	values[2] = (raw[2] - acc_off_z) / acc_scale_z;
+	values[3] = raw[3] / gyro.scalefactor[0];
+	values[4] = raw[4] / gyro.scalefactor[1];
+	values[5] = raw[5] / gyro.scalefactor[2];
+	#else
+	getValues(values);
+
+	now = micros();
+	ahrs.update(values[3] * M_PI/180, values[4] * M_PI/180, values[5] * M_PI/180, values[0], values[1], values[2],
+			(now - lastUpdate) / 1000000.0);
+	lastUpdate = now;
+	#endif
 
-	// Integrate rate of change of quaternion
-	gx *= (0.5f * (1.0f / sampleFreq));   // pre-multiply common factors
-	gy *= (0.5f * (1.0f / sampleFreq));
-	gz *= (0.5f * (1.0f / sampleFreq));
-	qa = q0;
-	qb = q1;
-	qc = q2;
-	q0 += (-qb * gx - qc * gy - q3 * gz);
-	q1 += (qa * gx + qc * gz - q3 * gy);
-	q2 += (qa * gy - qb * gz + q3 * gx);
-	q3 += (qa * gz + qb * gy - qc * gx);
-
-	// Normalise quaternion
-	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
-	q0 *= recipNorm;
-	q1 *= recipNorm;
-	q2 *= recipNorm;
-	q3 *= recipNorm;
+	ahrs.getQ(q);
+	orientation.setQ(q);
 }
 
 
 /**
- * Populates array q with a quaternion representing the IMU orientation with respect to the Earth
+ * Reads the sensors, runs one step of the AHRS filter and populates array q with
+ * a quaternion representing the IMU orientation with respect to the Earth
  *
  * @param q the quaternion to populate
 */
 void FreeIMU::getQ(float * q) {
-	float val[9] = { 0.f };
-	getValues(val);
-
-	/*DEBUG_PRINT(val[3] * M_PI/180);
-	DEBUG_PRINT(val[4] * M_PI/180);
-	DEBUG_PRINT(val[5] * M_PI/180);
-	DEBUG_PRINT(val[0]);
-	DEBUG_PRINT(val[1]);
-	DEBUG_PRINT(val[2]);
-	DEBUG_PRINT(val[6]);
-	DEBUG_PRINT(val[7]);
-	DEBUG_PRINT(val[8]);*/
-
-	now = micros();
-	sampleFreq = 1.0 / ((now - lastUpdate) / 1000000.0);
-	lastUpdate = now;
-
-	AHRSupdate(val[3] * M_PI/180, val[4] * M_PI/180, val[5] * M_PI/180, val[0], val[1], val[2]);
+	float val[6];
+	update(val);
 
-	q[0] = q0;
-	q[1] = q1;
-	q[2] = q2;
-	q[3] = q3;
+	orientation.getQ(q);
 }
 
 
 /**
- * Returns the Euler angles in radians defined in the Aerospace sequence.
+ * Returns the Euler angles in radians defined in the Aerospace sequence, for the last update.
  * See Sebastian O.H. Madwick report "An efficient orientation filter for
  * inertial and intertial/magnetic sensor arrays" Chapter 2 Quaternion representation
  *
  * @param angles three floats array which will be populated by the Euler angles in radians
 */
 void FreeIMU::getEulerRad(float * angles) {
-	float q[4]; // quaternion
-	getQ(q);
-
-	angles[0] = atan2(2 * q[1] * q[2] - 2 * q[0] * q[3], 2 * q[0]*q[0] + 2 * q[1] * q[1] - 1); // psi
-	angles[1] = -asin(2 * q[1] * q[3] + 2 * q[0] * q[2]); // theta
-	angles[2] = atan2(2 * q[2] * q[3] - 2 * q[0] * q[1], 2 * q[0] * q[0] + 2 * q[3] * q[3] - 1); // phi
+	orientation.getEulerRad(angles);
 }
 
 
 /**
- * Returns the Euler angles in degrees defined with the Aerospace sequence.
+ * Returns the Euler angles in degrees defined with the Aerospace sequence, for the last update.
  * See Sebastian O.H. Madwick report "An efficient orientation filter for
  * inertial and intertial/magnetic sensor arrays" Chapter 2 Quaternion representation
  *
@@ -320,9 +292,9 @@ void FreeIMU::getEuler(float * angles) {
 
 
 /**
- * Returns the yaw pitch and roll angles, respectively defined as the angles in radians between
- * the Earth North and the IMU X axis (yaw), the Earth ground plane and the IMU X axis (pitch)
- * and the Earth ground plane and the IMU Y axis.
+ * Returns the yaw pitch and roll angles of the last update, respectively defined as the angles
+ * in radians between the Earth North and the IMU X axis (yaw), the Earth ground plane and the
+ * IMU X axis (pitch) and the Earth ground plane and the IMU Y axis.
  *
  * @note This is not an Euler representation: the rotations aren't consecutive rotations but only
  * angles from Earth and the IMU. For Euler representation Yaw, Pitch and Roll see FreeIMU::getEuler
@@ -330,35 +302,12 @@ void FreeIMU::getEuler(float * angles) {
  * @param ypr three floats array which will be populated by Yaw, Pitch and Roll angles in radians
 */
 void FreeIMU::getYawPitchRollRad(float * ypr) {
-	float q[4]; // quaternion
-	float gx, gy, gz; // estimated gravity direction
-	getQ(q);
-
-	gx = 2 * (q[1]*q[3] - q[0]*q[2]);
-	gy = 2 * (q[0]*q[1] + q[2]*q[3]);
-	gz = q[0]*q[0] - q[1]*q[1] - q[2]*q[2] + q[3]*q[3];
-
-	ypr[0] = atan2(2 * q[1] * q[2] - 2 * q[0] * q[3], 2 * q[0]*q[0] + 2 * q[1] * q[1] - 1);
-	ypr[1] = atan(gx / sqrt(gy*gy + gz*gz));
-	ypr[2] = atan(gy / sqrt(gx*gx + gz*gz));
+	orientation.getYawPitchRollRad(ypr);
 }
 
 void FreeIMU::getYawPitchRollEulerRad(float * ypr, float * euler) {
-	float q[4]; // quaternion
-	float gx, gy, gz; // estimated gravity direction
-	getQ(q);
-
-	gx = 2 * (q[1]*q[3] - q[0]*q[2]);
-	gy = 2 * (q[0]*q[1] + q[2]*q[3]);
-	gz = q[0]*q[0] - q[1]*q[1] - q[2]*q[2] + q[3]*q[3];
-
-	ypr[0] = atan2(2 * q[1] * q[2] - 2 * q[0] * q[3], 2 * q[0]*q[0] + 2 * q[1] * q[1] - 1); // yaw
-	ypr[1] = atan(gx / sqrt(gy*gy + gz*gz)); // pitch
-	ypr[2] = atan(gy / sqrt(gx*gx + gz*gz)); // roll
-
-	euler[0] = atan2(2 * q[1] * q[2] - 2 * q[0] * q[3], 2 * q[0]*q[0] + 2 * q[1] * q[1] - 1); // psi
-	euler[1] = -asin(2 * q[1] * q[3] + 2 * q[0] * q[2]); // theta
-	euler[2] = atan2(2 * q[2] * q[3] - 2 * q[0] * q[1], 2 * q[0] * q[0] + 2 * q[3] * q[3] - 1); // phi
+	orientation.getYawPitchRollRad(ypr);
+	orientation.getEulerRad(euler);
 }
 
 
@@ -379,32 +328,31 @@ void FreeIMU::getYawPitchRoll(float * ypr) {
 
 
 /**
- * Converts a 3 elements array arr of angles expressed in radians into degrees
+ * Removes gravity from accelerometer readings, leaving the linear acceleration
+ *
+ * @param acc the acceleration in g, compensated in place
+ * @param q the quaternion of the orientation the readings were taken at
 */
-void arr3_rad_to_deg(float * arr) {
-	arr[0] *= 180.0f / M_PI;
-	arr[1] *= 180.0f / M_PI;
-	arr[2] *= 180.0f / M_PI;
+void FreeIMU::gravityCompensateAcc(float * acc, float * q) {
+	float g[3];
+
+	// get expected direction of gravity in the sensor frame
+	g[0] = 2 * (q[1] * q[3] - q[0] * q[2]);
+	g[1] = 2 * (q[0] * q[1] + q[2] * q[3]);
+	g[2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+
+	// compensate accelerometer readings with the expected direction of gravity
+	acc[0] = acc[0] - g[0];
+	acc[1] = acc[1] - g[1];
+	acc[2] = acc[2] - g[2];
 }
 
 
 /**
- * Fast inverse square root implementation
- * @see http://en.wikipedia.org/wiki/Fast_inverse_square_root
+ * Converts a 3 elements array arr of angles expressed in radians into degrees
 */
-float invSqrt(float number) {
-	volatile long i;
-	volatile float x, y;
-	volatile const float f = 1.5f;
-
-	x = number * 0.5f;
-	y = number;
-	i = * ( long * ) &y;
-	i = 0x5f375a86 - ( i >> 1 );
-	y = * ( float * ) &i;
-	y = y * ( f - ( x * y * y ) );
-	return y;
+void arr3_rad_to_deg(float * arr) {
+	arr[0] *= 180.0f / M_PI;
+	arr[1] *= 180.0f / M_PI;
+	arr[2] *= 180.0f / M_PI;
 }
-
-
-
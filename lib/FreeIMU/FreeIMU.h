@@ -33,6 +33,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //#define FREEIMU_v035_BMP
 #define FREEIMU_v04
 
+// Uncomment to run the AHRS filter in fixed point instead of software emulated float
+//#define FREEIMU_FIXED_POINT
+
 // 3rd party boards. Please consider donating or buying a FreeIMU board to support this library development.
 #define SEN_10121 //IMU Digital Combo Board - 6 Degrees of Freedom ITG3200/ADXL345 SEN-10121 http://www.sparkfun.com/products/10121
 
@@ -55,9 +58,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define HAS_ADXL345() (defined(FREEIMU_v01) || defined(FREEIMU_v02) || defined(FREEIMU_v03) || defined(SEN_10121) || defined(SEN_10736) || defined(SEN_10724) || defined(SEN_10183))
 #define IS_6DOM() (defined(SEN_10121) /*|| defined(GEN_MPU6050*/)
 
-#include <Wire.h>
 #include "Arduino.h"
+#include "I2C.h"
 #include "calibration.h"
+#include "MahonyAHRS.h"
+#include "Orientation.h"
 
 #include <ADXL345.h>
 // default I2C 7-bit addresses of the sensors
@@ -84,9 +89,13 @@ class FreeIMU
 	void init();
 	void init(bool fastmode);
 	void init(int acc_addr, int gyro_addr, bool fastmode);
+	void init(int acc_addr, int gyro_addr, bool fastmode, bool zero);
 	void zeroGyro();
+	void setAccFifo(bool fifo);
+	void setGains(float twoKp, float twoKi);
 	void getRawValues(int * raw_values);
 	void getValues(float * values);
+	void update(float * values);
 	void getQ(float * q);
 	void getEuler(float * angles);
 	void getYawPitchRoll(float * ypr);
@@ -98,6 +107,7 @@ class FreeIMU
 
 	ADXL345 acc;
 	ITG3200 gyro;
+	Orientation orientation; // of the last update
 	
 	int* raw_acc, raw_gyro, raw_magn;
 	// calibration parameters
@@ -106,20 +116,17 @@ class FreeIMU
 	float acc_scale_x, acc_scale_y, acc_scale_z, magn_scale_x, magn_scale_y, magn_scale_z;
 
   private:
-	void AHRSupdate(float gx, float gy, float gz, float ax, float ay, float az);
-
-	//float q0, q1, q2, q3; // quaternion elements representing the estimated orientation
-	float iq0, iq1, iq2, iq3;
-	float exInt, eyInt, ezInt;  // scaled integral error
-	volatile float twoKp;	  // 2 * proportional gain (Kp)
-	volatile float twoKi;	  // 2 * integral gain (Ki)
-	volatile float q0, q1, q2, q3; // quaternion of sensor frame relative to auxiliary frame
-	volatile float integralFBx,  integralFBy, integralFBz;
-	unsigned long lastUpdate, now; // sample period expressed in milliseconds
-	float sampleFreq; // half the sample period expressed in seconds
+	void readAcc(int * xyz);
+
+	bool accFifo; // readings average what waits in the ADXL345 FIFO
+	#ifdef FREEIMU_FIXED_POINT
+	MahonyAHRSFixed ahrs;
+	#else
+	MahonyAHRS ahrs;
+	#endif
+	unsigned long lastUpdate, now; // sample period expressed in microseconds
 };
 
-float invSqrt(float number);
 void arr3_rad_to_deg(float * arr);
 
 
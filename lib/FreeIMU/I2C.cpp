@@ -0,0 +1,448 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com> and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include "I2C.h"
+
+#include <util/twi.h>
+
+/**
+ * @file I2C.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+/*! TWI enabled, interrupt on TWINT */
+#define I2C_TWCR (_BV(TWEN) | _BV(TWIE))
+
+/*! Half period of the recovery clock, 100 kHz */
+#define I2C_RECOVERY_DELAY 5
+
+namespace I2C {
+
+	// Queue, _head is the transaction on the bus
+	I2CTransaction* volatile _head = NULL;
+	I2CTransaction* volatile _tail = NULL;
+	volatile bool _recovering = false;
+
+	// Statistics
+	volatile uint16_t _errorCount = 0;
+	uint16_t _recoveryCount = 0;
+
+	void releaseBus(void);
+	void startI(void);
+	void stopI(I2CStatus status);
+	void finishI(I2CStatus status);
+	void abortI(void);
+	void removeI(I2CTransaction* transaction);
+
+}
+
+/**
+ * @brief Sets the bus up, frees it if a slave still holds SDA and enables the TWI interrupt
+ *
+ * Replaces Wire.begin(): nothing else must drive the TWI peripheral. Must be called once,
+ * from a ChibiOS thread, before the first transaction.
+ * @param frequency the SCL frequency (in Hz), 400 kHz by default
+ */
+void I2C::init(uint32_t frequency) {
+
+	// The IMU board has its own pull-ups, the ATmega ones would pull SDA and SCL to 5V
+	pinMode(SDA, INPUT);
+	pinMode(SCL, INPUT);
+	digitalWrite(SDA, LOW);
+	digitalWrite(SCL, LOW);
+
+	TWSR = 0; // prescaler 1
+	setFrequency(frequency);
+
+	// A reset in the middle of a read leaves the slave waiting for clocks
+	recover();
+
+}
+
+/**
+ * @brief Changes the SCL frequency, effective from the next START
+ * @param frequency the frequency (in Hz), 100 kHz or 400 kHz for the IMU
+ */
+void I2C::setFrequency(uint32_t frequency) {
+
+	TWBR = (uint8_t)((F_CPU / frequency - 16) / 2);
+
+}
+
+/**
+ * @brief Queues a transaction and returns at once, the TWI interrupt carries it out
+ *
+ * The CPU is free until I2C::wait is called; several transactions (to the accelerometer
+ * and the gyroscope for instance) can be queued before waiting for the first one.
+ * @param transaction the transaction, address, reg, data, length and read set by the caller
+ */
+void I2C::submit(I2CTransaction* transaction) {
+
+	transaction->status = I2C_PENDING;
+	transaction->index = 0;
+	transaction->next = NULL;
+	chBSemInit(&transaction->done, TRUE);
+
+	chSysLock();
+
+	if (_tail != NULL)
+		_tail->next = transaction;
+	else
+		_head = transaction;
+
+	_tail = transaction;
+
+	if (_head == transaction)
+		startI();
+
+	chSysUnlock();
+
+}
+
+/**
+ * @brief Sleeps until a submitted transaction completes or the timeout runs out
+ *
+ * On timeout the transaction is taken off the queue, or off the bus by recovering it,
+ * so that the next ones go on and the caller can reuse its buffer right away.
+ * @param transaction the transaction given to I2C::submit
+ * @param timeout the longest wait (in ms)
+ * @return the transaction status, I2C_OK if every byte went through
+ */
+I2CStatus I2C::wait(I2CTransaction* transaction, uint16_t timeout) {
+
+	if (chBSemWaitTimeout(&transaction->done, MS2ST(timeout)) != RDY_TIMEOUT)
+		return transaction->status;
+
+	chSysLock();
+
+	if (transaction->status != I2C_PENDING) {
+		chSysUnlock();
+		return transaction->status;
+	}
+
+	if (transaction != _head) {
+		removeI(transaction);
+		chSysUnlock();
+		return I2C_TIMEOUT;
+	}
+
+	// Stuck on the bus, most likely a slave holding SDA low
+	abortI();
+
+	chSysUnlock();
+
+	releaseBus();
+
+	return I2C_TIMEOUT;
+
+}
+
+/**
+ * @brief Reads consecutive registers and waits for them
+ * @param address the slave address
+ * @param reg the first register
+ * @param data buffer that will receive the bytes
+ * @param length the number of bytes to read
+ * @return the transaction status
+ */
+I2CStatus I2C::readRegisters(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length) {
+
+	I2CTransaction transaction;
+
+	transaction.address = address;
+	transaction.reg = reg;
+	transaction.data = data;
+	transaction.length = length;
+	transaction.read = true;
+
+	submit(&transaction);
+
+	return wait(&transaction);
+
+}
+
+/**
+ * @brief Writes one register and waits for it
+ * @param address the slave address
+ * @param reg the register
+ * @param value the value to write
+ * @return the transaction status
+ */
+I2CStatus I2C::writeRegister(uint8_t address, uint8_t reg, uint8_t value) {
+
+	I2CTransaction transaction;
+
+	transaction.address = address;
+	transaction.reg = reg;
+	transaction.data = &value;
+	transaction.length = 1;
+	transaction.read = false;
+
+	submit(&transaction);
+
+	return wait(&transaction);
+
+}
+
+/**
+ * @brief Frees the bus: clocks SCL until the slaves release SDA, then sends a STOP
+ *
+ * The transaction on the bus, if any, fails with I2C_TIMEOUT and the queued ones are
+ * started again afterwards.
+ */
+void I2C::recover(void) {
+
+	chSysLock();
+
+	abortI();
+	chSchRescheduleS();
+
+	chSysUnlock();
+
+	releaseBus();
+
+}
+
+/**
+ * @brief Bus recovery proper, the TWI being off: clocks, STOP, then TWI back on
+ */
+void I2C::releaseBus(void) {
+
+	// SDA and SCL are open drain, pull-ups off: INPUT releases the line, OUTPUT pulls it down
+	pinMode(SDA, INPUT);
+	pinMode(SCL, INPUT);
+	digitalWrite(SDA, LOW);
+	digitalWrite(SCL, LOW);
+
+	// A slave in the middle of a byte lets go of SDA after at most 9 clocks
+	for (uint8_t i = 0; i < 9 && digitalRead(SDA) == LOW; i++) {
+		pinMode(SCL, OUTPUT);
+		delayMicroseconds(I2C_RECOVERY_DELAY);
+		pinMode(SCL, INPUT);
+		delayMicroseconds(I2C_RECOVERY_DELAY);
+	}
+
+	// STOP: SDA rises while SCL is high
+	pinMode(SCL, OUTPUT);
+	pinMode(SDA, OUTPUT);
+	delayMicroseconds(I2C_RECOVERY_DELAY);
+	pinMode(SCL, INPUT);
+	delayMicroseconds(I2C_RECOVERY_DELAY);
+	pinMode(SDA, INPUT);
+	delayMicroseconds(I2C_RECOVERY_DELAY);
+
+	chSysLock();
+
+	TWCR = I2C_TWCR;
+	_recovering = false;
+	_recoveryCount++;
+	startI();
+
+	chSysUnlock();
+
+}
+
+/**
+ * @brief Gets the number of transactions that did not complete
+ * @return the count since boot
+ */
+uint16_t I2C::getErrorCount(void) {
+
+	return _errorCount;
+
+}
+
+/**
+ * @brief Gets the number of bus recoveries, the first one done by I2C::init
+ * @return the count since boot
+ */
+uint16_t I2C::getRecoveryCount(void) {
+
+	return _recoveryCount;
+
+}
+
+/**
+ * @brief Sends the START of the transaction at the head of the queue, if the bus is free
+ */
+void I2C::startI(void) {
+
+	if (_head != NULL && !_recovering)
+		TWCR = I2C_TWCR | _BV(TWINT) | _BV(TWSTA);
+
+}
+
+/**
+ * @brief Completes the transaction on the bus with a STOP, followed by the next START if any
+ * @param status the status of the completed transaction
+ */
+void I2C::stopI(I2CStatus status) {
+
+	finishI(status);
+
+	TWCR = I2C_TWCR | _BV(TWINT) | _BV(TWSTO) | (_head != NULL ? _BV(TWSTA) : 0);
+
+}
+
+/**
+ * @brief Takes the transaction at the head of the queue off and wakes its thread up
+ * @param status the status of the transaction
+ */
+void I2C::finishI(I2CStatus status) {
+
+	I2CTransaction* transaction = _head;
+
+	_head = transaction->next;
+
+	if (_head == NULL)
+		_tail = NULL;
+
+	if (status != I2C_OK)
+		_errorCount++;
+
+	transaction->status = status;
+	chBSemSignalI(&transaction->done);
+
+}
+
+/**
+ * @brief Turns the TWI off and fails the transaction on the bus with I2C_TIMEOUT
+ */
+void I2C::abortI(void) {
+
+	_recovering = true;
+	TWCR = 0;
+
+	if (_head != NULL)
+		finishI(I2C_TIMEOUT);
+
+}
+
+/**
+ * @brief Takes a transaction that has not been started yet off the queue
+ * @param transaction the transaction, not the head
+ */
+void I2C::removeI(I2CTransaction* transaction) {
+
+	I2CTransaction* previous = _head;
+
+	while (previous != NULL && previous->next != transaction)
+		previous = previous->next;
+
+	if (previous == NULL)
+		return;
+
+	previous->next = transaction->next;
+
+	if (_tail == transaction)
+		_tail = previous;
+
+	_errorCount++;
+	transaction->status = I2C_TIMEOUT;
+
+}
+
+/**
+ * @brief TWI interrupt: moves the transaction at the head of the queue one step forward
+ *
+ * A read is START, SLA+W, register, repeated START, SLA+R, bytes (the last one NACKed), STOP.
+ * A write is START, SLA+W, register, bytes, STOP.
+ */
+CH_IRQ_HANDLER(TWI_vect) {
+
+	CH_IRQ_PROLOGUE();
+
+	chSysLockFromIsr();
+
+	I2CTransaction* transaction = I2C::_head;
+
+	if (transaction == NULL) {
+		TWCR = I2C_TWCR & ~_BV(TWIE);
+	}
+	else {
+		switch (TW_STATUS) {
+			case TW_START:
+				TWDR = (transaction->address << 1) | TW_WRITE;
+				TWCR = I2C_TWCR | _BV(TWINT);
+				break;
+
+			case TW_REP_START:
+				TWDR = (transaction->address << 1) | TW_READ;
+				TWCR = I2C_TWCR | _BV(TWINT);
+				break;
+
+			case TW_MT_SLA_ACK:
+				TWDR = transaction->reg;
+				TWCR = I2C_TWCR | _BV(TWINT);
+				break;
+
+			case TW_MT_DATA_ACK:
+				if (transaction->read) {
+					TWCR = I2C_TWCR | _BV(TWINT) | _BV(TWSTA);
+				}
+				else if (transaction->index < transaction->length) {
+					TWDR = transaction->data[transaction->index++];
+					TWCR = I2C_TWCR | _BV(TWINT);
+				}
+				else {
+					I2C::stopI(I2C_OK);
+				}
+				break;
+
+			case TW_MR_SLA_ACK:
+				TWCR = I2C_TWCR | _BV(TWINT) | (transaction->length > 1 ? _BV(TWEA) : 0);
+				break;
+
+			case TW_MR_DATA_ACK:
+				transaction->data[transaction->index++] = TWDR;
+				TWCR = I2C_TWCR | _BV(TWINT) | (transaction->index + 1 < transaction->length ? _BV(TWEA) : 0);
+				break;
+
+			case TW_MR_DATA_NACK:
+				transaction->data[transaction->index++] = TWDR;
+				I2C::stopI(I2C_OK);
+				break;
+
+			case TW_MT_SLA_NACK:
+			case TW_MT_DATA_NACK:
+			case TW_MR_SLA_NACK:
+				I2C::stopI(I2C_NACK);
+				break;
+
+			case TW_MT_ARB_LOST:
+				// Released without STOP, START again once the bus is free
+				I2C::finishI(I2C_BUS_ERROR);
+				TWCR = I2C_TWCR | _BV(TWINT) | (I2C::_head != NULL ? _BV(TWSTA) : 0);
+				break;
+
+			default:
+				// TW_BUS_ERROR: TWSTO resets the TWI without touching the bus
+				I2C::finishI(I2C_BUS_ERROR);
+				TWCR = I2C_TWCR | _BV(TWINT) | _BV(TWSTO);
+				I2C::startI();
+				break;
+		}
+	}
+
+	chSysUnlockFromIsr();
+
+	CH_IRQ_EPILOGUE();
+
+}
@@ -0,0 +1,89 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_MODULE_I2C_H_
+#define LEKA_MOTI_MODULE_I2C_H_
+
+/**
+ * @file I2C.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include <Arduino.h>
+#include "ChibiOS_AVR.h"
+
+/*! Bus frequency used by I2C::init() */
+#ifndef I2C_DEFAULT_FREQUENCY
+#define I2C_DEFAULT_FREQUENCY 400000L
+#endif
+
+/*! Longest wait for one transaction, in ms: a 32 bytes read takes under 1 ms at 400 kHz */
+#ifndef I2C_DEFAULT_TIMEOUT
+#define I2C_DEFAULT_TIMEOUT 10
+#endif
+
+/*! Outcome of a transaction */
+typedef enum {
+	I2C_OK,
+	I2C_PENDING,	// queued or on the bus
+	I2C_NACK,		// address or data not acknowledged
+	I2C_BUS_ERROR,	// arbitration lost or illegal START/STOP
+	I2C_TIMEOUT		// gave up waiting, the bus has been recovered
+} I2CStatus;
+
+/**
+ * @brief One register access, queued by I2C::submit and completed by the TWI interrupt
+ *
+ * It must stay alive (and untouched) until I2C::wait returned, it is usually on the stack
+ * of the thread that submitted it.
+ */
+typedef struct I2CTransaction {
+	uint8_t address;		// 7 bits slave address
+	uint8_t reg;			// first register
+	uint8_t* data;			// bytes to write or buffer to read into
+	uint8_t length;
+	bool read;
+
+	volatile I2CStatus status;
+	uint8_t index;			// bytes transferred so far
+	BinarySemaphore done;
+	struct I2CTransaction* next;
+} I2CTransaction;
+
+namespace I2C {
+
+	void init(uint32_t frequency = I2C_DEFAULT_FREQUENCY);
+	void setFrequency(uint32_t frequency);
+
+	void submit(I2CTransaction* transaction);
+	I2CStatus wait(I2CTransaction* transaction, uint16_t timeout = I2C_DEFAULT_TIMEOUT);
+
+	I2CStatus readRegisters(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length);
+	I2CStatus writeRegister(uint8_t address, uint8_t reg, uint8_t value);
+
+	void recover(void);
+
+	uint16_t getErrorCount(void);
+	uint16_t getRecoveryCount(void);
+
+}
+
+#endif
@@ -26,7 +26,7 @@
 * VIO & VDD -> pin 3.3V                                                     *
 *****************************************************************************/
 #include "ITG3200.h"
-#include <Wire.h>
+#include "I2C.h"
 
 ITG3200::ITG3200() {
   setOffsets(0,0,0);
@@ -176,14 +176,14 @@ bool ITG3200::isRawDataReady() {
 
 void ITG3200::readTemp(float *_Temp) {
   readmem(TEMP_OUT,2,_buff);
-  *_Temp = 35 + ((_buff[0] << 8 | _buff[1]) + 13200) / 280.0;    // F=C*9/5+32
+  *_Temp = 35 + ((int16_t)(_buff[0] << 8 | _buff[1]) + 13200) / 280.0;    // F=C*9/5+32
 }
 
 void ITG3200::readGyroRaw( int *_GyroX, int *_GyroY, int *_GyroZ){
   readmem(GYRO_XOUT, 6, _buff);
-  *_GyroX = _buff[0] << 8 | _buff[1];
-  *_GyroY = _buff[2] << 8 | _buff[3]; 
-  *_GyroZ = _buff[4] << 8 | _buff[5];
+  *_GyroX = (int16_t)(_buff[0] << 8 | _buff[1]);
+  *_GyroY = (int16_t)(_buff[2] << 8 | _buff[3]); 
+  *_GyroZ = (int16_t)(_buff[4] << 8 | _buff[5]);
 }
 
 void ITG3200::readGyroRaw( int *_GyroXYZ){
@@ -301,29 +301,13 @@ void ITG3200::setClockSource(byte _CLKsource) {
 }
 
 void ITG3200::writemem(uint8_t _addr, uint8_t _val) {
-  Wire.beginTransmission(_dev_address);   // start transmission to device 
-  //Wire.send(_addr); // send register address
-  //Wire.send(_val); // send value to write
-  Wire.write(_addr); // send register address
-  Wire.write(_val); // send value to write
-  Wire.endTransmission(); // end transmission
+  I2C::writeRegister(_dev_address, _addr, _val);
 }
 
 void ITG3200::readmem(uint8_t _addr, uint8_t _nbytes, uint8_t __buff[]) {
-  Wire.beginTransmission(_dev_address); // start transmission to device 
-  //Wire.send(_addr); // sends register address to read from
-  Wire.write(_addr); // sends register address to read from
-  Wire.endTransmission(); // end transmission
-  
-  Wire.beginTransmission(_dev_address); // start transmission to device 
-  Wire.requestFrom(_dev_address, _nbytes);// send data n-bytes read
-  uint8_t i = 0; 
-  while (Wire.available()) {
-    //__buff[i] = Wire.receive(); // receive DATA
-    __buff[i] = Wire.read(); // receive DATA
-    i++;
-  }
-  Wire.endTransmission(); // end transmission
+  // a failed read leaves zeros rather than the previous register contents
+  if (I2C::readRegisters(_dev_address, _addr, __buff, _nbytes) != I2C_OK)
+    memset(__buff, 0, _nbytes);
 }
 
 
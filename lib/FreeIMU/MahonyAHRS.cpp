@@ -0,0 +1,340 @@
+/*
+MahonyAHRS.cpp - Mahony AHRS filter kernels used by FreeIMU
+Copyright (C) 2011-2012 Fabio Varesano <fabio at varesano dot net>
+
+Development of this code has been supported by the Department of Computer Science,
+Universita' degli Studi di Torino, Italy within the Piemonte Project
+http://www.piemonte.di.unito.it/
+
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the version 3 GNU General Public License as
+published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "MahonyAHRS.h"
+
+
+MahonyAHRS::MahonyAHRS(float twoKp, float twoKi) {
+	setGains(twoKp, twoKi);
+
+	// initialize quaternion
+	q0 = 1.0f;
+	q1 = 0.0f;
+	q2 = 0.0f;
+	q3 = 0.0f;
+	integralFBx = 0.0f, integralFBy = 0.0f, integralFBz = 0.0f;
+}
+
+
+/**
+ * Changes the gains, the attitude and the integral feedback are kept.
+*/
+void MahonyAHRS::setGains(float twoKp, float twoKi) {
+	this->twoKp = twoKp;
+	this->twoKi = twoKi;
+}
+
+
+/**
+ * Quaternion implementation of the 'DCM filter' [Mayhony et al].  Incorporates the magnetic distortion
+ * compensation algorithms from Sebastian Madgwick's filter which eliminates the need for a reference
+ * direction of flux (bx bz) to be predefined and limits the effect of magnetic distortions to yaw
+ * axis only.
+ *
+ * @see: http://www.x-io.co.uk/node/8#open_source_ahrs_and_imu_algorithms
+*/
+void MahonyAHRS::update(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+	float recipNorm;
+	float q0q0, q0q1, q0q2, q1q3, q2q3, q3q3;
+	float halfex = 0.0f, halfey = 0.0f, halfez = 0.0f;
+	float qa, qb, qc;
+
+	// Auxiliary variables to avoid repeated arithmetic
+	q0q0 = q0 * q0;
+	q0q1 = q0 * q1;
+	q0q2 = q0 * q2;
+	q1q3 = q1 * q3;
+	q2q3 = q2 * q3;
+	q3q3 = q3 * q3;
+
+	// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
+	if((ax != 0.0f) && (ay != 0.0f) && (az != 0.0f)) {
+	float halfvx, halfvy, halfvz;
+
+	// Normalise accelerometer measurement
+	recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+	ax *= recipNorm;
+	ay *= recipNorm;
+	az *= recipNorm;
+
+	// Estimated direction of gravity
+	halfvx = q1q3 - q0q2;
+	halfvy = q0q1 + q2q3;
+	halfvz = q0q0 - 0.5f + q3q3;
+
+	// Error is sum of cross product between estimated direction and measured direction of field vectors
+	halfex += (ay * halfvz - az * halfvy);
+	halfey += (az * halfvx - ax * halfvz);
+	halfez += (ax * halfvy - ay * halfvx);
+	}
+
+	// Apply feedback only when valid data has been gathered from the accelerometer or magnetometer
+	if(halfex != 0.0f && halfey != 0.0f && halfez != 0.0f) {
+	// Compute and apply integral feedback if enabled
+	if(twoKi > 0.0f) {
+		integralFBx += twoKi * halfex * dt;  // integral error scaled by Ki
+		integralFBy += twoKi * halfey * dt;
+		integralFBz += twoKi * halfez * dt;
+		gx += integralFBx;  // apply integral feedback
+		gy += integralFBy;
+		gz += integralFBz;
+	}
+	else {
+		integralFBx = 0.0f; // prevent integral windup
+		integralFBy = 0.0f;
+		integralFBz = 0.0f;
+	}
+
+	// Apply proportional feedback
+	gx += twoKp * halfex;
+	gy += twoKp * halfey;
+	gz += twoKp * halfez;
+	}
+
+	// Integrate rate of change of quaternion
+	gx *= (0.5f * dt);   // pre-multiply common factors
+	gy *= (0.5f * dt);
+	gz *= (0.5f * dt);
+	qa = q0;
+	qb = q1;
+	qc = q2;
+	q0 += (-qb * gx - qc * gy - q3 * gz);
+	q1 += (qa * gx + qc * gz - q3 * gy);
+	q2 += (qa * gy - qb * gz + q3 * gx);
+	q3 += (qa * gz + qb * gy - qc * gx);
+
+	// Normalise quaternion
+	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+	q0 *= recipNorm;
+	q1 *= recipNorm;
+	q2 *= recipNorm;
+	q3 *= recipNorm;
+}
+
+
+/**
+ * Populates array q with the current quaternion
+*/
+void MahonyAHRS::getQ(float * q) {
+	q[0] = q0;
+	q[1] = q1;
+	q[2] = q2;
+	q[3] = q3;
+}
+
+
+/**
+ * Returns (a * b) >> shift for 0 <= shift <= 16, with two 16x16 -> 32 bit multiplies
+ * instead of a 32x32 -> 64 bit one. The caller makes sure the result fits.
+*/
+static inline int32_t mul32x16(int32_t a, int16_t b, uint8_t shift) {
+	int16_t ah = (int16_t)(a >> 16);
+	uint16_t al = (uint16_t)a;
+
+	return ((int32_t)ah * b << (16 - shift)) + (((int32_t)al * b) >> shift);
+}
+
+
+/**
+ * Returns a Q30 value rounded to Q14
+*/
+static inline int16_t q30ToQ14(int32_t x) {
+	return (int16_t)((x + 0x8000L) >> 16);
+}
+
+
+/**
+ * Returns floor(sqrt(x)), bit by bit
+*/
+static uint16_t isqrt32(uint32_t x) {
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while (bit > x)
+		bit >>= 2;
+
+	while (bit != 0) {
+		if (x >= root + bit) {
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return (uint16_t)root;
+}
+
+
+static inline int16_t saturate16(int32_t x) {
+	if (x > 32767L)
+		return 32767;
+	if (x < -32767L)
+		return -32767;
+	return (int16_t)x;
+}
+
+
+MahonyAHRSFixed::MahonyAHRSFixed(float twoKp, float twoKi) {
+	setGains(twoKp, twoKi);
+
+	q0 = 1L << 30;
+	q1 = 0;
+	q2 = 0;
+	q3 = 0;
+	integralFBx = 0, integralFBy = 0, integralFBz = 0;
+}
+
+
+/**
+ * Changes the gains, converted to Q12: both must stay under 2.
+*/
+void MahonyAHRSFixed::setGains(float twoKp, float twoKi) {
+	this->twoKp = (int16_t)(twoKp * 4096.0f + 0.5f);
+	this->twoKi = (int16_t)(twoKi * 4096.0f + 0.5f);
+}
+
+
+/**
+ * Same steps as MahonyAHRS::update, in fixed point
+*/
+void MahonyAHRSFixed::update(int16_t gx, int16_t gy, int16_t gz, int16_t ax, int16_t ay, int16_t az, uint16_t dt) {
+	int32_t halfex = 0, halfey = 0, halfez = 0; // Q30
+	int32_t rx, ry, rz; // Q20 rad/s
+	int32_t hx, hy, hz; // half rotation of this step, Q30 rad
+	int16_t h0, h1, h2, h3; // quaternion, Q14
+	int16_t dt19; // Q19 s
+	int32_t n2, r;
+
+	if (dt > MAHONY_FIXED_MAX_DT)
+		dt = MAHONY_FIXED_MAX_DT;
+	dt19 = (int16_t)(((uint32_t)dt * 17180UL) >> 15); // 2^19 / 10^6 in Q15
+
+	rx = ((int32_t)gx * MAHONY_FIXED_GYRO_SCALE) >> 4;
+	ry = ((int32_t)gy * MAHONY_FIXED_GYRO_SCALE) >> 4;
+	rz = ((int32_t)gz * MAHONY_FIXED_GYRO_SCALE) >> 4;
+
+	h0 = q30ToQ14(q0);
+	h1 = q30ToQ14(q1);
+	h2 = q30ToQ14(q2);
+	h3 = q30ToQ14(q3);
+
+	// Compute feedback only if accelerometer measurement valid (avoids dividing by zero in accelerometer normalisation)
+	if ((ax != 0) && (ay != 0) && (az != 0)) {
+		int16_t anx, any, anz; // Q15
+		int16_t halfvx, halfvy, halfvz; // Q15
+		int32_t recipNorm;
+
+		// Normalise accelerometer measurement, one division for the three axes
+		recipNorm = (1L << 30) / isqrt32((uint32_t)((int32_t)ax * ax) + (uint32_t)((int32_t)ay * ay) + (uint32_t)((int32_t)az * az));
+		anx = saturate16(mul32x16(recipNorm, ax, 15));
+		any = saturate16(mul32x16(recipNorm, ay, 15));
+		anz = saturate16(mul32x16(recipNorm, az, 15));
+
+		// Estimated direction of gravity
+		halfvx = (int16_t)(((int32_t)h1 * h3 - (int32_t)h0 * h2) >> 13);
+		halfvy = (int16_t)(((int32_t)h0 * h1 + (int32_t)h2 * h3) >> 13);
+		halfvz = (int16_t)(((int32_t)h0 * h0 + (int32_t)h3 * h3 - (1L << 27)) >> 13);
+
+		// Error is sum of cross product between estimated direction and measured direction of field vectors
+		halfex = (int32_t)any * halfvz - (int32_t)anz * halfvy;
+		halfey = (int32_t)anz * halfvx - (int32_t)anx * halfvz;
+		halfez = (int32_t)anx * halfvy - (int32_t)any * halfvx;
+	}
+
+	// Apply feedback only when valid data has been gathered from the accelerometer
+	if (halfex != 0 && halfey != 0 && halfez != 0) {
+		// Compute and apply integral feedback if enabled
+		if (twoKi > 0) {
+			integralFBx += mul32x16(mul32x16(halfex, twoKi, 12) >> 5, dt19, 16);
+			integralFBy += mul32x16(mul32x16(halfey, twoKi, 12) >> 5, dt19, 16);
+			integralFBz += mul32x16(mul32x16(halfez, twoKi, 12) >> 5, dt19, 16);
+			rx += integralFBx >> 8;
+			ry += integralFBy >> 8;
+			rz += integralFBz >> 8;
+		}
+		else {
+			integralFBx = 0; // prevent integral windup
+			integralFBy = 0;
+			integralFBz = 0;
+		}
+
+		// Apply proportional feedback
+		rx += mul32x16(halfex >> 10, twoKp, 12);
+		ry += mul32x16(halfey >> 10, twoKp, 12);
+		rz += mul32x16(halfez >> 10, twoKp, 12);
+	}
+
+	// Integrate rate of change of quaternion
+	hx = mul32x16(rx, dt19, 10);
+	hy = mul32x16(ry, dt19, 10);
+	hz = mul32x16(rz, dt19, 10);
+	q0 += -mul32x16(hx, h1, 14) - mul32x16(hy, h2, 14) - mul32x16(hz, h3, 14);
+	q1 += mul32x16(hx, h0, 14) + mul32x16(hz, h2, 14) - mul32x16(hy, h3, 14);
+	q2 += mul32x16(hy, h0, 14) - mul32x16(hz, h1, 14) + mul32x16(hx, h3, 14);
+	q3 += mul32x16(hz, h0, 14) + mul32x16(hy, h1, 14) - mul32x16(hx, h2, 14);
+
+	// Normalise quaternion, two Newton steps of 1 / sqrt(n2) starting from 1
+	h0 = q30ToQ14(q0);
+	h1 = q30ToQ14(q1);
+	h2 = q30ToQ14(q2);
+	h3 = q30ToQ14(q3);
+	n2 = (int32_t)h0 * h0 + (int32_t)h1 * h1 + (int32_t)h2 * h2 + (int32_t)h3 * h3; // Q28
+	r = ((3L << 28) - n2) >> 15; // Q14
+	r = (((3L << 28) - mul32x16(mul32x16(n2, (int16_t)r, 14), (int16_t)r, 14)) >> 14) * r >> 15;
+	q0 = mul32x16(q0, (int16_t)r, 14);
+	q1 = mul32x16(q1, (int16_t)r, 14);
+	q2 = mul32x16(q2, (int16_t)r, 14);
+	q3 = mul32x16(q3, (int16_t)r, 14);
+}
+
+
+/**
+ * Populates array q with the current quaternion
+*/
+void MahonyAHRSFixed::getQ(float * q) {
+	q[0] = q0 * (1.0f / 1073741824.0f);
+	q[1] = q1 * (1.0f / 1073741824.0f);
+	q[2] = q2 * (1.0f / 1073741824.0f);
+	q[3] = q3 * (1.0f / 1073741824.0f);
+}
+
+
+/**
+ * Fast inverse square root implementation
+ * @see http://en.wikipedia.org/wiki/Fast_inverse_square_root
+*/
+float invSqrt(float number) {
+	union {
+		float f;
+		int32_t i;
+	} y;
+	float x = number * 0.5f;
+
+	y.f = number;
+	y.i = 0x5f375a86 - ( y.i >> 1 );
+	y.f = y.f * ( 1.5f - ( x * y.f * y.f ) );
+	return y.f;
+}
@@ -0,0 +1,80 @@
+/*
+MahonyAHRS.h - Mahony AHRS filter kernels used by FreeIMU
+Copyright (C) 2011-2012 Fabio Varesano <fabio at varesano dot net>
+
+Development of this code has been supported by the Department of Computer Science,
+Universita' degli Studi di Torino, Italy within the Piemonte Project
+http://www.piemonte.di.unito.it/
+
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the version 3 GNU General Public License as
+published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef MahonyAHRS_h
+#define MahonyAHRS_h
+
+#include <stdint.h>
+
+// ITG3200 sensitivity, in rad/s per LSB and Q24 (0.0174532925 / 14.375)
+#define MAHONY_FIXED_GYRO_SCALE 20370L
+
+// Longest step the fixed point kernel integrates, in microseconds (dt is kept as a Q19 int16_t)
+#define MAHONY_FIXED_MAX_DT 62000U
+
+/**
+ * Float implementation, the reference one.
+ * Rates in rad/s, accelerations in any unit, dt in seconds.
+*/
+class MahonyAHRS
+{
+  public:
+	MahonyAHRS(float twoKp, float twoKi);
+	void setGains(float twoKp, float twoKi);
+	void update(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+	void getQ(float * q);
+
+	volatile float twoKp; // 2 * proportional gain (Kp)
+	volatile float twoKi; // 2 * integral gain (Ki)
+
+  private:
+	volatile float q0, q1, q2, q3; // quaternion of sensor frame relative to auxiliary frame
+	volatile float integralFBx, integralFBy, integralFBz;
+};
+
+/**
+ * Fixed point implementation of the same filter, for CPUs without an FPU.
+ * Rates in ITG3200 LSB (offsets removed), accelerations in any unit, dt in microseconds.
+ *
+ * Formats: quaternion Q30, rates Q20 rad/s, integral feedback Q28 rad/s, gains Q12 (must stay
+ * under 2). All products go through 16x16 -> 32 bit multiplies, which the AVR does in hardware.
+*/
+class MahonyAHRSFixed
+{
+  public:
+	MahonyAHRSFixed(float twoKp, float twoKi);
+	void setGains(float twoKp, float twoKi);
+	void update(int16_t gx, int16_t gy, int16_t gz, int16_t ax, int16_t ay, int16_t az, uint16_t dt);
+	void getQ(float * q);
+
+	int16_t twoKp; // 2 * proportional gain (Kp), Q12
+	int16_t twoKi; // 2 * integral gain (Ki), Q12
+
+  private:
+	int32_t q0, q1, q2, q3;
+	int32_t integralFBx, integralFBy, integralFBz;
+};
+
+float invSqrt(float number);
+
+#endif // MahonyAHRS_h
@@ -0,0 +1,169 @@
+/*
+Orientation.cpp - Quaternion with lazily derived angles, used by FreeIMU
+Copyright (C) 2011-2012 Fabio Varesano <fabio at varesano dot net>
+
+Development of this code has been supported by the Department of Computer Science,
+Universita' degli Studi di Torino, Italy within the Piemonte Project
+http://www.piemonte.di.unito.it/
+
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the version 3 GNU General Public License as
+published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <math.h>
+
+#include "Orientation.h"
+
+
+Orientation::Orientation() {
+	q0 = 1.0f;
+	q1 = 0.0f;
+	q2 = 0.0f;
+	q3 = 0.0f;
+	heading = 0.0f, pitch = 0.0f, roll = 0.0f, theta = 0.0f, phi = 0.0f;
+	valid = ORIENTATION_HEADING | ORIENTATION_PITCH_ROLL | ORIENTATION_THETA | ORIENTATION_PHI;
+}
+
+
+/**
+ * Stores the quaternion of a new filter step and forgets the angles of the previous one
+*/
+void Orientation::setQ(const float * q) {
+	q0 = q[0];
+	q1 = q[1];
+	q2 = q[2];
+	q3 = q[3];
+	valid = 0;
+}
+
+
+void Orientation::getQ(float * q) const {
+	q[0] = q0;
+	q[1] = q1;
+	q[2] = q2;
+	q[3] = q3;
+}
+
+
+/**
+ * Whether other holds the same quaternion, and so the same angles
+*/
+bool Orientation::hasSameQ(const Orientation & other) const {
+	return q0 == other.q0 && q1 == other.q1 && q2 == other.q2 && q3 == other.q3;
+}
+
+
+/**
+ * Computes the angles of the ORIENTATION_* flags in angles that are not up to date yet
+*/
+void Orientation::compute(uint8_t angles) {
+	if (angles & ORIENTATION_HEADING)
+		getYawRad();
+
+	if (angles & ORIENTATION_PITCH_ROLL)
+		getPitchRad();
+
+	if (angles & ORIENTATION_THETA)
+		getThetaRad();
+
+	if (angles & ORIENTATION_PHI)
+		getPhiRad();
+}
+
+
+/**
+ * Direction of gravity in the sensor frame, a unit vector (in g)
+*/
+void Orientation::getGravity(float * g) const {
+	g[0] = 2 * (q1*q3 - q0*q2);
+	g[1] = 2 * (q0*q1 + q2*q3);
+	g[2] = q0*q0 - q1*q1 - q2*q2 + q3*q3;
+}
+
+
+/**
+ * Yaw and psi are the same angle, computed once for both
+*/
+float Orientation::getYawRad() {
+	if (!(valid & ORIENTATION_HEADING)) {
+		heading = atan2(2 * q1 * q2 - 2 * q0 * q3, 2 * q0*q0 + 2 * q1 * q1 - 1);
+		valid |= ORIENTATION_HEADING;
+	}
+
+	return heading;
+}
+
+
+/**
+ * Pitch and roll both come from the estimated gravity direction, computed once for both
+*/
+float Orientation::getPitchRad() {
+	if (!(valid & ORIENTATION_PITCH_ROLL)) {
+		float g[3]; // estimated gravity direction
+
+		getGravity(g);
+
+		pitch = atan(g[0] / sqrt(g[1]*g[1] + g[2]*g[2]));
+		roll = atan(g[1] / sqrt(g[0]*g[0] + g[2]*g[2]));
+		valid |= ORIENTATION_PITCH_ROLL;
+	}
+
+	return pitch;
+}
+
+
+float Orientation::getRollRad() {
+	getPitchRad();
+
+	return roll;
+}
+
+
+void Orientation::getYawPitchRollRad(float * ypr) {
+	ypr[0] = getYawRad();
+	ypr[1] = getPitchRad();
+	ypr[2] = roll;
+}
+
+
+float Orientation::getPsiRad() {
+	return getYawRad();
+}
+
+
+float Orientation::getThetaRad() {
+	if (!(valid & ORIENTATION_THETA)) {
+		theta = -asin(2 * q1 * q3 + 2 * q0 * q2);
+		valid |= ORIENTATION_THETA;
+	}
+
+	return theta;
+}
+
+
+float Orientation::getPhiRad() {
+	if (!(valid & ORIENTATION_PHI)) {
+		phi = atan2(2 * q2 * q3 - 2 * q0 * q1, 2 * q0 * q0 + 2 * q3 * q3 - 1);
+		valid |= ORIENTATION_PHI;
+	}
+
+	return phi;
+}
+
+
+void Orientation::getEulerRad(float * angles) {
+	angles[0] = getPsiRad();
+	angles[1] = getThetaRad();
+	angles[2] = getPhiRad();
+}
@@ -0,0 +1,71 @@
+/*
+Orientation.h - Quaternion with lazily derived angles, used by FreeIMU
+Copyright (C) 2011-2012 Fabio Varesano <fabio at varesano dot net>
+
+Development of this code has been supported by the Department of Computer Science,
+Universita' degli Studi di Torino, Italy within the Piemonte Project
+http://www.piemonte.di.unito.it/
+
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the version 3 GNU General Public License as
+published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef Orientation_h
+#define Orientation_h
+
+#include <stdint.h>
+
+// Which derived angles are up to date with the quaternion
+#define ORIENTATION_HEADING    0x01 // yaw, which is also psi
+#define ORIENTATION_PITCH_ROLL 0x02
+#define ORIENTATION_THETA      0x04
+#define ORIENTATION_PHI        0x08
+
+/**
+ * Holds the quaternion of one filter step and computes each angle the first
+ * time it is asked for after setQ, so nobody pays for the angles nobody reads.
+ * Copies are independent: each keeps its own cache. To share one cache between
+ * readers, keep a copy, compute() on it and refresh it when hasSameQ() fails.
+*/
+class Orientation
+{
+  public:
+	Orientation();
+	void setQ(const float * q);
+	void getQ(float * q) const;
+	void getGravity(float * g) const;
+	bool hasSameQ(const Orientation & other) const;
+	void compute(uint8_t angles);
+
+	// Yaw, pitch and roll, see FreeIMU::getYawPitchRollRad
+	float getYawRad();
+	float getPitchRad();
+	float getRollRad();
+	void getYawPitchRollRad(float * ypr);
+
+	// Euler angles, see FreeIMU::getEulerRad
+	float getPsiRad();
+	float getThetaRad();
+	float getPhiRad();
+	void getEulerRad(float * angles);
+
+	uint8_t getValid() const { return valid; }
+
+  private:
+	float q0, q1, q2, q3;
+	float heading, pitch, roll, theta, phi;
+	uint8_t valid;
+};
+
+#endif // Orientation_h
@@ -3,19 +3,20 @@
 
 #include <Arduino.h>
 #include "ChibiOS_AVR.h"
+#include "Tasks.h"
 #include "Light.h"
 
 namespace Heart {
 
-	// Thread methods
-	static WORKING_AREA(behaviorThreadArea, 400);
-	static msg_t thread(void* arg);
+	// Task methods
+	static uint32_t tick(Task* task);
 
-	void init(void* arg = NULL, tprio_t priority = NORMALPRIO);
+	void init(void);
 	void start(void);
 	void stop(void);
 
 	// Variables
+	Task _task;
 	bool _isInitialized = false;
 	bool _isStarted = false;
 	uint16_t _behaviorThreadDelay = 2000;
@@ -25,14 +26,14 @@ namespace Heart {
 
 }
 
-void Heart::init(void* arg, tprio_t priority) {
+void Heart::init(void) {
 	if (!_isInitialized) {
 		_isInitialized = true;
 		_isStarted = false;
 
-		(void)chThdCreateStatic(behaviorThreadArea,
-				sizeof(behaviorThreadArea),
-				priority, thread, arg);
+		Tasks::init();
+		Tasks::create(&_task, "heart", tick);
+		Tasks::start(&_task);
 	}
 }
 
@@ -42,6 +43,8 @@ void Heart::start(void) {
 	_isStarted = true;
 
 	chMtxUnlock();
+
+	Tasks::wake(&_task);
 }
 
 void Heart::stop(void) {
@@ -50,21 +53,26 @@ void Heart::stop(void) {
 	_isStarted = false;
 
 	chMtxUnlock();
+
+	Tasks::wake(&_task);
+
 	Light::fade(HEART, Color::Black, Color::Black, 100);
 }
 
-msg_t Heart::thread(void* arg) {
-
-	(void) arg;
+uint32_t Heart::tick(Task* task) {
 
 	volatile uint8_t basePwm = 10; // divided by ten to have a wait delay higher than 1ms
 	volatile uint8_t P = 70;
 	volatile uint8_t Q = 0;
 	volatile uint8_t R = 230;
 
-	while (!chThdShouldTerminate()) {
+	TASK_BEGIN(task);
+
+	while (TRUE) {
 
 		if (_isStarted) {
+			Tasks::clearWake(task); // the start that got us here
+
 			Light::fade(HEART, Color(basePwm, 0, 0), Color(P, 0, 0), 100);
 			Light::fade(HEART, Color(P, 0, 0), Color(basePwm, 0, 0), 100);
 
@@ -73,13 +81,15 @@ msg_t Heart::thread(void* arg) {
 			Light::fade(HEART, Color(Q, 0, 0), Color(R, 0, 0), 120);
 			Light::fade(HEART, Color(R, 0, 0), Color(basePwm, 0, 0), 140);
 
-			waitMs(2000);
+			// The pause between two beats, cut short by stop
+			TASK_WAIT(task, _behaviorThreadDelay);
 		}
 		else {
-			waitMs(100);
+			TASK_WAIT(task, TASK_FOREVER);
 		}
 	}
-	return (msg_t)0;
+
+	TASK_END(task);
 }
 
 #endif
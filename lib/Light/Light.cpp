@@ -30,10 +30,11 @@ namespace Light {
 	// VARIABLES
 
 	// Thread states
-	static WORKING_AREA(lightThreadArea, 256);
+	static WORKING_AREA(lightThreadArea, LIGHT_THREAD_STACK);
 	bool _isStarted     = false;
 	bool _isInitialized = false;
 	uint8_t _threadDelay = 20;
+	PeriodicLoop _loop;
 
 	// Led objects
 	uint8_t HEART_LED_RED_PIN = 11;
@@ -154,26 +155,47 @@ void Light::init(void* arg, tprio_t priority) {
 	if (!_isStarted) {
 		start();
 
+		Periodic::init(&_loop, "light", _threadDelay);
 
 		(void)chThdCreateStatic(lightThreadArea,
 				sizeof(lightThreadArea),
 				priority, moduleThread, arg);
 
+		StackMonitor::watch("light", lightThreadArea, sizeof(lightThreadArea));
+
 		for (uint8_t i = 0; i < N_LEDS; ++i)
 			for (uint16_t j = 0; j < QUEUE_MAX_SIZE; ++j)
 				data[i].fill(j, new LedData);
 	}
 }
 
+/**
+ * @brief Computes the color of a fade for its current step and moves it to the next one
+ * @param state the fade, its current color is updated
+ * @return true if it was the last step
+ */
+bool Light::stepFade(LedData* state) {
+	state->current.setRGB(state->startColor.getR() + state->diff.getR() * state->steps / state->totalSteps,
+			state->startColor.getG() + state->diff.getG() * state->steps / state->totalSteps,
+			state->startColor.getB() + state->diff.getB() * state->steps / state->totalSteps
+			);
+
+	state->steps++;
+
+	return state->steps == state->totalSteps;
+}
+
 msg_t Light::moduleThread(void* arg) {
 
 	(void) arg;
+	chRegSetThreadName("light");
 
 	bool noRecall = true;
 	LedData* state;
 
 	while (!chThdShouldTerminate()) {
 		chSemWait(&_sem);
+		Periodic::pause(&_loop);
 
 		while (TRUE) {
 			noRecall = true;
@@ -184,24 +206,18 @@ msg_t Light::moduleThread(void* arg) {
 
 					switch (state->state) {
 						case FADE:
-							state->current.setRGB(state->startColor.getR() + state->diff.getR() * state->steps / state->totalSteps,
-									state->startColor.getG() + state->diff.getG() * state->steps / state->totalSteps,
-									state->startColor.getB() + state->diff.getB() * state->steps / state->totalSteps
-									);
-
-							leds[i].shine(state->current);
-
-							state->steps++;
-
-							if (state->steps == state->totalSteps) {
+							// The last step ends on endColor
+							if (stepFade(state)) {
 								leds[i].shine(state->endColor);
 								data[i].pop();
 
 								if (!data[i].isEmpty())
 									noRecall = false;
 							}
-							else
+							else {
+								leds[i].shine(state->current);
 								noRecall = false;
+							}
 
 							break;
 
@@ -214,7 +230,7 @@ msg_t Light::moduleThread(void* arg) {
 				}
 			}
 
-			waitMs(_threadDelay);
+			Periodic::wait(&_loop);
 
 			if (noRecall)
 				break;
@@ -29,11 +29,18 @@
 #include <Arduino.h>
 
 #include "ChibiOS_AVR.h"
+#include "StackMonitor.h"
+#include "Periodic.h"
 #include "Color.h"
 #include "Led.h"
 #include "Toolbox.h"
 #include "Queue.h"
 
+/*! Size of the light thread's working area, the n of its WORKING_AREA (see StackMonitor) */
+#ifndef LIGHT_THREAD_STACK
+#define LIGHT_THREAD_STACK 256
+#endif
+
 /*! Indicators for the leds in the device */
 typedef enum {
 	HEART
@@ -72,6 +79,9 @@ namespace Light {
 	void turnOff(LedIndicator led);
 	void turnOff(Led led);
 
+	// One step of the thread
+	bool stepFade(LedData* state);
+
 	// Get methods
 	LedState getState(LedIndicator led);
 	Color getColor(LedIndicator led);
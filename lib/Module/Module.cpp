@@ -29,8 +29,8 @@ namespace ModuleName {
 
 	// VARIABLES
 
-	// Thread
-	static WORKING_AREA(threadArea, 128);
+	// Task
+	Task _task;
 	bool _isInitialized = false;
 	bool _isStarted = false;
 	uint16_t _threadDelay = 50;
@@ -44,14 +44,15 @@ namespace ModuleName {
 }
 
 /**
- * @brief Start DriveSystem's chThread
+ * @brief Adds the module's task to the tasks thread
  */
-void ModuleName::init(void* arg, tprio_t priority) {
+void ModuleName::init(void) {
 	if (!_isInitialized) {
 		_isInitialized = true;
 
-		(void)chThdCreateStatic(threadArea, sizeof(threadArea),
-				priority, moduleThread, arg);
+		Tasks::init();
+		Tasks::create(&_task, "module", moduleTick);
+		Tasks::start(&_task);
 	}
 }
 
@@ -77,22 +78,17 @@ void ModuleName::aModuleMethod(void) {
 }
 
 /**
- * @brief Main module thread
+ * @brief Main module task, called every _threadDelay ms
  */
-msg_t ModuleName::moduleThread(void* arg) {
-	(void) arg;
+uint32_t ModuleName::moduleTick(Task* task) {
+	(void) task;
 
-	while (!chThdShouldTerminate()) {
-
-		if(_isStarted) {
-			aModuleMethod();
-			// and everything else you want
-		}
-
-		waitMs(_threadDelay);
+	if(_isStarted) {
+		aModuleMethod();
+		// and everything else you want
 	}
 
-	return (msg_t)0;
+	return _threadDelay;
 }
 
 
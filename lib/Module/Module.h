@@ -28,6 +28,7 @@
 
 #include <Arduino.h>
 #include "ChibiOS_AVR.h"
+#include "Tasks.h"
 #include "Toolbox.h"
 
 /**
@@ -36,9 +37,9 @@
  */
 namespace ModuleName {
 
-	// Thread
-	msg_t moduleThread(void* arg);
-	void init(void* arg = NULL, tprio_t priority = NORMALPRIO + 2);
+	// Task
+	uint32_t moduleTick(Task* task);
+	void init(void);
 	void start(void);
 	void stop(void);
 
@@ -26,12 +26,17 @@
  * @version 1.0
  */
 
+/*! Events of the Moti thread */
+#define MOTI_SAMPLE_EVENT EVENT_MASK(0) // Sensors published a sample
+#define MOTI_WAKE_EVENT   EVENT_MASK(1) // start or stop
+
 namespace Moti {
 
 	// VARIABLES
 
 	// Thread states
-	static WORKING_AREA(motiModuleThreadArea, 256);
+	static WORKING_AREA(motiModuleThreadArea, MOTI_MODULE_THREAD_STACK);
+	Thread* _thread = NULL;
 	bool _isInitialized = false;
 	bool _isStarted     = false;
 	uint8_t _threadDelay = 100;
@@ -57,8 +62,11 @@ namespace Moti {
 
 	// Spin variables
 	int16_t _nLaps   = 0;
-	float _spinAngle = 0.f;
+	float _spinThreshold = 15.f; // heading change over HISTORY_SIZE steps (deg)
+	float _spinAngle = 0.f; // heading when the spin started
 	float _spinHistory[HISTORY_SIZE] = {0.f};
+	uint8_t _spinIndex = 0;
+	bool _isSpinHistoryFilled = false; // cleared on restart: the heading may have moved while stopped
 
 	// Shake variables
 	int16_t _lastXYZ[3]          = {0, 0, 0};
@@ -69,6 +77,10 @@ namespace Moti {
 	double _alphaXYZ[3]          = {0.1, 0.1, 0.1};
 	double _shakeThresholdXYZ[3] = {120, 120, 120};
 	uint32_t _startShakeTime     = 0;
+
+	// Events
+	EVENTSOURCE_DECL(_stateEvent); // the states that changed as flags
+	uint8_t _states = 0;           // last broadcast
 }
 
 /**
@@ -78,9 +90,11 @@ void Moti::init(void* arg, tprio_t priority) {
 	if (!_isInitialized) {
 		_isInitialized = true;
 
-		(void)chThdCreateStatic(motiModuleThreadArea,
+		_thread = chThdCreateStatic(motiModuleThreadArea,
 				sizeof(motiModuleThreadArea),
 				priority, moduleThread, arg);
+
+		StackMonitor::watch("moti", motiModuleThreadArea, sizeof(motiModuleThreadArea));
 	}
 }
 
@@ -88,7 +102,13 @@ void Moti::init(void* arg, tprio_t priority) {
  * @brief Tells the Moti thread to run and check for events
  */
 void Moti::start(void) {
+	if (!_isStarted)
+		_isSpinHistoryFilled = false;
+
 	_isStarted = true;
+
+	if (_thread != NULL)
+		chEvtSignal(_thread, MOTI_WAKE_EVENT);
 }
 
 /**
@@ -97,6 +117,57 @@ void Moti::start(void) {
 void Moti::stop(void) {
 	_isStarted = false;
 	_isStuck = false;
+
+	// The Moti thread alone publishes, it broadcasts the stuck state stop cleared
+	if (_thread != NULL)
+		chEvtSignal(_thread, MOTI_WAKE_EVENT);
+	else
+		publishStates();
+}
+
+/**
+ * @brief Runs every detector once and broadcasts the states that changed
+ */
+void Moti::step(void) {
+	detectStuck();
+	detectSpin();
+	detectShake();
+	detectFall();
+
+	publishStates();
+}
+
+/**
+ * @brief Gets the event source broadcast when a state changes, with the MOTI_ states that
+ * changed as flags (chEvtGetAndClearFlags): behaviors wake up on it instead of polling
+ * @return the event source
+ */
+EventSource* Moti::getStateEvent(void) {
+	return &_stateEvent;
+}
+
+/**
+ * @brief Gets every state at once
+ * @return the MOTI_ states that are true
+ */
+uint8_t Moti::getStates(void) {
+	return (isStuck() ? MOTI_STUCK : 0) | (isShaken() ? MOTI_SHAKEN : 0) | (isSpinning() ? MOTI_SPINNING : 0)
+		| (isFalling() ? MOTI_FALLING : 0);
+}
+
+/**
+ * @brief Broadcasts the state event if a state changed since the last time
+ *
+ * _states is not guarded: only the Moti thread calls it, or whoever steps Moti when there is no thread.
+ */
+void Moti::publishStates(void) {
+	uint8_t states = getStates();
+	uint8_t changed = states ^ _states;
+
+	_states = states;
+
+	if (changed != 0)
+		chEvtBroadcastFlags(&_stateEvent, changed);
 }
 
 /**
@@ -166,6 +237,33 @@ uint8_t Moti::getLapsZ(void) {
 	return (uint8_t)abs(_nLaps);
 }
 
+/**
+ * @brief Sets when Moti is stuck: the X acceleration above a threshold for some time
+ * @param threshold the acceleration (in ADXL345 counts, 120 by default)
+ * @param time how long it lasts (in ms, 750 by default)
+ */
+void Moti::setStuckThreshold(uint8_t threshold, uint16_t time) {
+	_stuckThreshold = threshold;
+	_stuckTime = time;
+}
+
+/**
+ * @brief Sets when Moti is shaken, on every axis
+ * @param threshold the average change of acceleration between two steps (in ADXL345 counts, 120 by default)
+ */
+void Moti::setShakeThreshold(double threshold) {
+	for (uint8_t i = 0; i < 3; i++)
+		_shakeThresholdXYZ[i] = threshold;
+}
+
+/**
+ * @brief Sets when Moti is spinning
+ * @param threshold the heading change over HISTORY_SIZE steps (in degrees, 15 by default)
+ */
+void Moti::setSpinThreshold(float threshold) {
+	_spinThreshold = threshold;
+}
+
 void Moti::detectStuck(void) {
 	if (abs(Sensors::getAccX()) > _stuckThreshold) {
 		if (!_isStuck) {
@@ -179,40 +277,42 @@ void Moti::detectStuck(void) {
 }
 
 void Moti::detectSpin(void) {
-	uint8_t i = 0;
+	float heading = Sensors::getHeadingDeg();
 
-	float currentAngle = 0.f;
-	float oldAngle = 0.f;
+	if (!_isSpinHistoryFilled) {
+		for (uint8_t i = 0; i < HISTORY_SIZE; i++)
+			_spinHistory[i] = heading;
 
-	oldAngle = currentAngle;
-	currentAngle = Sensors::getEulerPhiDeg();
+		_isSpinHistoryFilled = true;
+	}
 
-	_spinHistory[i] = currentAngle;
-	i = (i + 1) % HISTORY_SIZE;
+	// The heading is unwrapped: the oldest entry is simply subtracted
+	_spinHistory[_spinIndex] = heading;
+	_spinIndex = (_spinIndex + 1) % HISTORY_SIZE;
 
-	if (abs(Toolbox::arrayDeltaSum(_spinHistory, HISTORY_SIZE)) > 15.f) {
-		_isSpinning = true;
+	if (abs(heading - _spinHistory[_spinIndex]) > _spinThreshold) {
+		if (!_isSpinning) {
+			_isSpinning = true;
+			_spinAngle = _spinHistory[_spinIndex];
+		}
 	}
 	else {
 		_isSpinning = false;
 		_nLaps = 0;
 	}
 
-	if (_isSpinning) {
-		if ((currentAngle * oldAngle < 0.f) && (currentAngle * oldAngle > -8000.f)) {
-			if (currentAngle > 0.f)
-				_nLaps++;
-			else
-				_nLaps--;
-		}
-	}
+	if (_isSpinning)
+		_nLaps = (int16_t)((heading - _spinAngle) / 360.f);
 }
 
 void Moti::detectShake(void) {
 	uint8_t i = 0;
 
+	float acc[3];
+	Sensors::getAccXYZ(&acc[0], &acc[1], &acc[2]);
+
 	for (i = 0; i < 3; i++) {
-		_currentXYZ[i] = (int)Sensors::getAccXYZ(i);
+		_currentXYZ[i] = (int)acc[i];
 		_deltaXYZ[i]   = _lastXYZ[i] - _currentXYZ[i];
 		_lastXYZ[i]    = _currentXYZ[i];
 		_sqrtXYZ[i]    = sqrt(sq((double)_deltaXYZ[i]));
@@ -250,18 +350,33 @@ void Moti::detectFall(void) {
 msg_t Moti::moduleThread(void* arg) {
 
 	(void) arg;
+	chRegSetThreadName("moti");
 
-	while (!chThdShouldTerminate()) {
+	EventListener sampleListener;
+	uint16_t samples = 0;
+
+	chEvtRegisterMask(Sensors::getSampleEvent(), &sampleListener, MOTI_SAMPLE_EVENT);
 
-		if (_isStarted) {
-			Moti::detectStuck();
-			Moti::detectSpin();
-			Moti::detectShake();
-			Moti::detectFall();
+	while (!chThdShouldTerminate()) {
 
+		if (!_isStarted) {
+			publishStates();
+			chEvtWaitAny(MOTI_WAKE_EVENT);
+			continue;
 		}
 
-		waitMs(_threadDelay);
+		// One step every _threadDelay worth of new samples. The timeout only matters if Sensors
+		// stops publishing: stuck and shaken still time out
+		eventmask_t events = chEvtWaitAnyTimeout(MOTI_SAMPLE_EVENT | MOTI_WAKE_EVENT, MS2ST(2 * _threadDelay));
+
+		if (!_isStarted || (events & MOTI_WAKE_EVENT))
+			continue;
+
+		if ((events & MOTI_SAMPLE_EVENT) && ++samples < Sensors::getSamplesPerPeriod(_threadDelay))
+			continue;
+
+		samples = 0;
+		Moti::step();
 	}
 
 	return (msg_t)0;
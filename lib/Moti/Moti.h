@@ -29,11 +29,23 @@
 
 #include <Arduino.h>
 #include "ChibiOS_AVR.h"
+#include "StackMonitor.h"
 #include "Toolbox.h"
 #include "Sensors.h"
 
 #define HISTORY_SIZE 6
 
+/*! Size of the Moti thread's working area, the n of its WORKING_AREA (see StackMonitor) */
+#ifndef MOTI_MODULE_THREAD_STACK
+#define MOTI_MODULE_THREAD_STACK 256
+#endif
+
+/*! Moti states, as getStates returns them and as the flags of the state event */
+#define MOTI_STUCK    0x01
+#define MOTI_SHAKEN   0x02
+#define MOTI_SPINNING 0x04
+#define MOTI_FALLING  0x08
+
 namespace Moti {
 
 	// Thread
@@ -41,10 +53,21 @@ namespace Moti {
 	void init(void* arg = NULL, tprio_t priority = NORMALPRIO + 1);
 	void start(void);
 	void stop(void);
+	void step(void);
+
+	// Events
+	EventSource* getStateEvent(void);
+	uint8_t getStates(void);
+	void publishStates(void);
 
 	// Methods
 	uint8_t getLapsZ(void);
 
+	// Settings
+	void setStuckThreshold(uint8_t threshold, uint16_t time);
+	void setShakeThreshold(double threshold);
+	void setSpinThreshold(float threshold);
+
 	// States
 	void detectStuck(void);
 	bool isStuck(void);
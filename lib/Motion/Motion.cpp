@@ -30,8 +30,9 @@ namespace Motion {
 	// VARIABLES
 
 	// Thread states
-	static WORKING_AREA(motionThreadArea, 256);
+	static WORKING_AREA(motionThreadArea, MOTION_THREAD_STACK);
 	bool _isInitialized = false;
+	PeriodicLoop _loop;
 
 	// Motion
 	uint8_t _speed     = 0;
@@ -39,7 +40,6 @@ namespace Motion {
 	uint16_t _goDelay  = 0;
 	float _angle       = 0.f;
 	float _originAngle = 0.f;
-	bool _jump         = false;
 
 	MotionState _action    = NONE;
 	MotionState _oldAction = NONE;
@@ -92,8 +92,7 @@ void Motion::spin(Rotation rotation, uint8_t speed, float angle) {
 	_rotation = rotation;
 	_speed = speed;
 	_angle = angle;
-	_originAngle = Sensors::getEulerPhi();
-	_jump = false;
+	_originAngle = Sensors::getHeading();
 	_oldAction = _action;
 	_action = SPIN;
 
@@ -175,53 +174,46 @@ void Motion::init(void* arg, tprio_t priority) {
 	if (!_isInitialized) {
 		_isInitialized = true;
 
+		Periodic::init(&_loop, "motion", DRIVESYSTEM_THREAD_DELAY);
+
 		(void)chThdCreateStatic(motionThreadArea,
 				sizeof(motionThreadArea),
 				priority, moduleThread, arg);
+
+		StackMonitor::watch("motion", motionThreadArea, sizeof(motionThreadArea));
 	}
 }
 
+/**
+ * @brief Computes the heading a spin ends at, the heading being unwrapped it may be past +/- pi
+ * @param rotation the rotation direction (LEFT | RIGHT)
+ * @param originAngle the heading when the spin started (in radians)
+ * @param angle the angle to spin, any number of turns (in radians)
+ * @return the heading to reach (in radians)
+ */
 float Motion::computeAimAngle(Rotation rotation, float originAngle, float angle) {
-	float aimAngle = originAngle;
-
 	switch (rotation) {
 		case LEFT:
-			aimAngle -= angle;
-			break;
+			return originAngle - angle;
 
 		case RIGHT:
-			aimAngle += angle;
-			break;
+			return originAngle + angle;
 	}
 
-	if (aimAngle < -M_PI) {
-		_jump = true;
-		return aimAngle + 2 * M_PI;
-	}
-	else if (aimAngle > M_PI) {
-		_jump = true;
-		return aimAngle - 2 * M_PI;
-	}
-
-	return aimAngle;
+	return originAngle;
 }
 
-bool Motion::rotationEnded(Rotation rotation, float aimAngle, float* lastAngle) {
+bool Motion::rotationEnded(Rotation rotation, float aimAngle) {
 	if (_action != SPIN) /* The action changed, maybe we need to stop */
 		return true;
 
-	float currentAngle = Sensors::getEulerPhi();
-
-	if (_jump && ((*lastAngle) * currentAngle < -3.0f))
-		_jump = false;
-
-	*lastAngle = currentAngle;
+	float currentAngle = Sensors::getHeading();
 
 	switch (rotation) {
 		case LEFT:
-			return (!_jump && (currentAngle < aimAngle));
+			return currentAngle < aimAngle;
 		case RIGHT:
-			return (!_jump && (currentAngle > aimAngle));
+			return currentAngle > aimAngle;
 	}
 
 	return false;
@@ -230,11 +222,11 @@ bool Motion::rotationEnded(Rotation rotation, float aimAngle, float* lastAngle)
 msg_t Motion::moduleThread(void* arg) {
 
 	(void) arg;
+	chRegSetThreadName("motion");
 
 	uint16_t count = 0;
 	uint16_t nSteps = 0;
 
-	float lastAngle = 0.0f;
 	float aimAngle = 0.0f;
 	uint32_t spinStart = 0;
 
@@ -242,6 +234,7 @@ msg_t Motion::moduleThread(void* arg) {
 
 	while (!chThdShouldTerminate()) {
 		chSemWait(&_sem);
+		Periodic::pause(&_loop);
 
 		if (_action == GO) {
 			count = 0;
@@ -251,7 +244,7 @@ msg_t Motion::moduleThread(void* arg) {
 				else
 					DriveSystem::go(_direction, _speed);
 
-				waitMs(delay);
+				Periodic::wait(&_loop);
 			}
 
 			if (_action == GO) {
@@ -268,21 +261,14 @@ msg_t Motion::moduleThread(void* arg) {
 		if (_action == SPIN) {
 			spinStart = millis();
 
-			while (_angle > 0.0f) {
-				aimAngle = computeAimAngle(_rotation, _originAngle, fmod(_angle, 2 * M_PI));
-				lastAngle = 0.0f;
+			aimAngle = computeAimAngle(_rotation, _originAngle, _angle);
 
-				while (!rotationEnded(_rotation, aimAngle, &lastAngle)) {
-					DriveSystem::spin(_rotation, _speed);
-					waitMs(delay);
+			while (!rotationEnded(_rotation, aimAngle)) {
+				DriveSystem::spin(_rotation, _speed);
+				Periodic::wait(&_loop);
 
-					if (abs(millis() - spinStart) > 2500) /* Security, prevent infinite spinning */
-						break;
-				}
-
-				chMtxLock(&_dataMutex);
-				_angle -= 2 * M_PI;
-				chMtxUnlock();
+				if (abs(millis() - spinStart) > 2500) /* Security, prevent infinite spinning */
+					break;
 			}
 
 			if (_action == SPIN) {
@@ -308,7 +294,7 @@ msg_t Motion::moduleThread(void* arg) {
 				while ((count++) * delay < _duration) {
 					_speed = _speed - _speed / nSteps;
 					DriveSystem::go(_direction, _speed);
-					waitMs(delay);
+					Periodic::wait(&_loop);
 				}
 			}
 
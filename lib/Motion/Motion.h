@@ -30,9 +30,16 @@
 #include <math.h>
 
 #include "ChibiOS_AVR.h"
+#include "StackMonitor.h"
+#include "Periodic.h"
 #include "DriveSystem.h"
 #include "Sensors.h"
 
+/*! Size of the motion thread's working area, the n of its WORKING_AREA (see StackMonitor) */
+#ifndef MOTION_THREAD_STACK
+#define MOTION_THREAD_STACK 256
+#endif
+
 typedef enum {
 	GO,
 	SPIN,
@@ -74,7 +81,7 @@ namespace Motion {
 
 	// Helpers methods
 	float computeAimAngle(Rotation rotation, float originAngle, float angle);
-	bool rotationEnded(Rotation rotation, float aimAngle, float* lastAngle);
+	bool rotationEnded(Rotation rotation, float aimAngle);
 
 }
 
@@ -0,0 +1,200 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file Periodic.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include "Periodic.h"
+
+namespace Periodic {
+
+	// VARIABLES
+
+	PeriodicLoop* _loops[PERIODIC_LOOPS];
+	uint8_t _count = 0;
+
+	// METHODS
+
+	/**
+	 * @brief Counts the start of a cycle
+	 * @param loop the loop
+	 * @param lateness how long after its deadline it started (in ticks)
+	 */
+	static void count(PeriodicLoop* loop, systime_t lateness) {
+		uint8_t bin = 0;
+
+		while (bin < PERIODIC_BINS - 1 && (systime_t)(1 << bin) <= lateness)
+			bin++;
+
+		if (loop->histogram[bin] < 0xFFFF)
+			loop->histogram[bin]++;
+
+		loop->maxLateness = max(loop->maxLateness, lateness);
+		loop->cycles++;
+	}
+
+	/**
+	 * @brief Sets a loop up and makes it queryable, before its thread uses it
+	 * @param loop the loop, it must outlive the thread (static)
+	 * @param name what the reports call it
+	 * @param period (in ms)
+	 */
+	void init(PeriodicLoop* loop, const char* name, uint16_t period) {
+		memset(loop, 0, sizeof(PeriodicLoop));
+
+		loop->name = name;
+		loop->period = MS2ST(period);
+		loop->isPaused = true;
+
+		for (uint8_t i = 0; i < _count; i++)
+			if (_loops[i] == loop)
+				return;
+
+		if (_count < PERIODIC_LOOPS)
+			_loops[_count++] = loop;
+	}
+
+	/**
+	 * @brief Changes the period of a loop, its next cycle starts the deadlines over
+	 * @param loop the loop
+	 * @param period (in ms)
+	 */
+	void setPeriod(PeriodicLoop* loop, uint16_t period) {
+		loop->period = MS2ST(period);
+		loop->isPaused = true;
+	}
+
+	/**
+	 * @brief Sleeps until the next deadline, in place of the waitMs that ends a cycle. After
+	 * an overrun the next cycle starts at once, and if a whole period was missed the deadlines
+	 * start over from now
+	 *
+	 * ChibiOS takes a deadline in the past for one 65 s ahead, so the time left is checked and
+	 * slept with the system locked: a higher priority thread cannot run in between and make
+	 * the deadline pass.
+	 * @param loop the loop
+	 */
+	void wait(PeriodicLoop* loop) {
+		systime_t now = chTimeNow();
+
+		if (loop->isPaused) {
+			loop->isPaused = false;
+			loop->deadline = now + loop->period;
+		}
+		else if ((int16_t)(now - loop->deadline) >= 0) {
+			loop->overruns++;
+		}
+
+		chSysLock();
+
+		systime_t left = (systime_t)(loop->deadline - chTimeNow());
+
+		if ((int16_t)left > 0)
+			chThdSleepS(left);
+
+		chSysUnlock();
+
+		now = chTimeNow();
+
+		systime_t lateness = (systime_t)max(0, (int16_t)(now - loop->deadline));
+
+		count(loop, lateness);
+
+		if (lateness >= loop->period)
+			loop->deadline = now;
+
+		loop->deadline += loop->period;
+	}
+
+	/**
+	 * @brief Counts the start of a cycle of a loop paced by something else
+	 * @param loop the loop
+	 */
+	void mark(PeriodicLoop* loop) {
+		systime_t now = chTimeNow();
+
+		if (loop->isPaused) {
+			loop->isPaused = false;
+		}
+		else {
+			systime_t lateness = (systime_t)max(0, (int16_t)(now - loop->deadline));
+
+			if (lateness >= loop->period)
+				loop->overruns++;
+
+			count(loop, lateness);
+		}
+
+		loop->deadline = now + loop->period;
+	}
+
+	/**
+	 * @brief Tells a loop it stops for a while (idle, waiting for an order): its next cycle
+	 * starts the deadlines over instead of counting an overrun
+	 * @param loop the loop
+	 */
+	void pause(PeriodicLoop* loop) {
+		loop->isPaused = true;
+	}
+
+	/**
+	 * @brief Clears the counters of a loop
+	 * @param loop the loop
+	 */
+	void reset(PeriodicLoop* loop) {
+		loop->cycles = 0;
+		loop->overruns = 0;
+		loop->maxLateness = 0;
+		memset(loop->histogram, 0, sizeof(loop->histogram));
+	}
+
+	uint8_t getCount(void) {
+		return _count;
+	}
+
+	/**
+	 * @brief Gets a loop, to read its counters
+	 * @param index in the order they were set up
+	 * @return the loop
+	 */
+	PeriodicLoop* get(uint8_t index) {
+		return _loops[index];
+	}
+
+	/**
+	 * @param loop the loop
+	 * @return its period (in ms)
+	 */
+	uint16_t getPeriod(PeriodicLoop* loop) {
+		return (uint32_t)loop->period * 1000 / CH_FREQUENCY;
+	}
+
+	/**
+	 * @param loop the loop
+	 * @return the latest a cycle started (in ms)
+	 */
+	uint16_t getMaxLateness(PeriodicLoop* loop) {
+		return (uint32_t)loop->maxLateness * 1000 / CH_FREQUENCY;
+	}
+
+}
@@ -0,0 +1,78 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_MODULE_PERIODIC_H_
+#define LEKA_MOTI_MODULE_PERIODIC_H_
+
+/**
+ * @file Periodic.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief Periodic loops on absolute deadlines, and how well they keep their period.
+ *
+ * A loop that calls Periodic::wait instead of waitMs starts each cycle one period after the
+ * deadline of the previous one, not one period after its work ended, so the length of the
+ * work does not add up. A loop paced by something else (a data ready line, the samples of
+ * Sensors) calls Periodic::mark when a cycle starts, and its deadline is one period after
+ * the previous start.
+ *
+ * Per loop: the cycles, the overruns, the maximum lateness and a histogram of the lateness
+ * of every cycle start (bin 0 on time, bin i 2^(i-1) to 2^i - 1 ticks late, the last one
+ * 2^(PERIODIC_BINS - 2) ticks late or more).
+ * An overrun is, for wait, a cycle whose work ran past the next deadline, and for mark, a
+ * cycle that started a period or more late.
+ */
+
+#include <Arduino.h>
+#include "ChibiOS_AVR.h"
+
+#define PERIODIC_LOOPS 8
+#define PERIODIC_BINS  8
+
+typedef struct {
+	const char* name;
+	systime_t period;          // (in ticks)
+	systime_t deadline;        // of the next cycle
+	bool isPaused;             // the next cycle starts the deadlines over
+	uint32_t cycles;
+	uint16_t overruns;
+	systime_t maxLateness;     // (in ticks)
+	uint16_t histogram[PERIODIC_BINS]; // stops at 0xFFFF
+} PeriodicLoop;
+
+namespace Periodic {
+
+	// Loops
+	void init(PeriodicLoop* loop, const char* name, uint16_t period);
+	void setPeriod(PeriodicLoop* loop, uint16_t period);
+	void wait(PeriodicLoop* loop);
+	void mark(PeriodicLoop* loop);
+	void pause(PeriodicLoop* loop);
+	void reset(PeriodicLoop* loop);
+
+	// Reports
+	uint8_t getCount(void);
+	PeriodicLoop* get(uint8_t index);
+	uint16_t getPeriod(PeriodicLoop* loop);
+	uint16_t getMaxLateness(PeriodicLoop* loop);
+
+}
+
+#endif
@@ -0,0 +1,81 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com> and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include "Calibration.h"
+
+/**
+ * @file Calibration.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+/**
+ * @brief Reads the calibration record from EEPROM
+ * @param data pointer that will receive the record
+ * @return true if the record has the current version and a matching checksum, false otherwise
+ */
+bool Calibration::load(CalibrationData* data) {
+
+	eeprom_read_block(data, (const void*)CALIBRATION_EEPROM_ADDRESS, sizeof(CalibrationData));
+
+	return data->version == CALIBRATION_VERSION && data->checksum == checksum(data);
+
+}
+
+/**
+ * @brief Writes the calibration record to EEPROM, only the bytes that changed are written
+ * @param data the record to write, its version and checksum are filled in
+ */
+void Calibration::save(CalibrationData* data) {
+
+	data->version = CALIBRATION_VERSION;
+	data->checksum = checksum(data);
+
+	eeprom_update_block(data, (void*)CALIBRATION_EEPROM_ADDRESS, sizeof(CalibrationData));
+
+}
+
+/**
+ * @brief Invalidates the calibration record, the next boot does the full gyro zeroing again
+ */
+void Calibration::erase(void) {
+
+	eeprom_update_byte((uint8_t*)CALIBRATION_EEPROM_ADDRESS, 0xFF);
+
+}
+
+/**
+ * @brief Computes the Fletcher-16 checksum of a record, its checksum field excluded
+ * @param data the record
+ * @return the checksum
+ */
+uint16_t Calibration::checksum(const CalibrationData* data) {
+
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint16_t sum1 = 0;
+	uint16_t sum2 = 0;
+
+	for (uint8_t i = 0; i < offsetof(CalibrationData, checksum); i++) {
+		sum1 = (sum1 + bytes[i]) % 255;
+		sum2 = (sum2 + sum1) % 255;
+	}
+
+	return (sum2 << 8) | sum1;
+
+}
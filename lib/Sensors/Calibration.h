@@ -0,0 +1,60 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_MODULE_CALIBRATION_H_
+#define LEKA_MOTI_MODULE_CALIBRATION_H_
+
+/**
+ * @file Calibration.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <avr/eeprom.h>
+
+/*! Where the record lives in EEPROM */
+#ifndef CALIBRATION_EEPROM_ADDRESS
+#define CALIBRATION_EEPROM_ADDRESS 0
+#endif
+
+/*! Bump it whenever CalibrationData changes, older records are then ignored */
+#define CALIBRATION_VERSION 1
+
+/*! IMU offsets, in raw counts, as Sensors::calibrate measured them */
+typedef struct {
+	uint8_t version;
+	int16_t gyrOffset[3]; // added to the ITG3200 readings, see ITG3200::setOffsets
+	int16_t accOffset[3]; // subtracted from the ADXL345 readings, see FreeIMU::acc_off_x
+	uint16_t checksum;
+} CalibrationData;
+
+namespace Calibration {
+
+	bool load(CalibrationData* data);
+	void save(CalibrationData* data);
+	void erase(void);
+
+	uint16_t checksum(const CalibrationData* data);
+
+}
+
+#endif
@@ -0,0 +1,306 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com> and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include "GyroBias.h"
+
+/**
+ * @file GyroBias.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+namespace GyroBias {
+
+	// Estimate
+	float _offset[3] = { 0.f, 0.f, 0.f }; // counts added to the raw readings
+	float _variance = GYROBIAS_STORED_VARIANCE;
+	float _scale[3] = { 14.375f, 14.375f, 14.375f }; // counts per deg/s
+	int _applied[3] = { 0, 0, 0 };
+	unsigned long _lastPredict = 0;
+
+	// Window
+	uint8_t _count = 0;
+	float _sum[3] = { 0.f, 0.f, 0.f };
+	float _sumSquares[3] = { 0.f, 0.f, 0.f };
+	bool _isStill = false;
+
+	// Temperature model
+	bool _hasTemperature = false;
+	float _temperature = 0.f; // the one _offset is for
+	bool _hasSlope = false;
+	float _slope[3] = { 0.f, 0.f, 0.f }; // counts per degree Celsius
+	bool _hasAnchor = false;
+	float _anchorOffset[3] = { 0.f, 0.f, 0.f };
+	float _anchorTemperature = 0.f;
+
+}
+
+/**
+ * @brief Starts over from the offsets in use, forgets the learned temperature slope
+ * @param offsets the ITG3200 offsets in use (in counts)
+ * @param scale the ITG3200 scale factors (in counts per deg/s)
+ * @param variance how much the offsets are trusted (in counts^2), see GYROBIAS_ZEROED_VARIANCE
+ */
+void GyroBias::init(const int* offsets, const float* scale, float variance) {
+
+	for (uint8_t i = 0; i < 3; i++) {
+		_offset[i] = offsets[i];
+		_applied[i] = offsets[i];
+		_scale[i] = scale[i];
+	}
+
+	_variance = variance;
+	_lastPredict = millis();
+
+	_hasTemperature = false;
+	_hasSlope = false;
+	_hasAnchor = false;
+
+	restartWindow();
+
+}
+
+/**
+ * @brief Adds a reading to the current window, a full still window corrects the estimate
+ * @param gyr the calibrated rates (in deg/s), the current offsets applied
+ * @param acc the acceleration (in g)
+ * @return true if the offsets changed, see GyroBias::getOffsets
+ */
+bool GyroBias::update(const float* gyr, const float* acc) {
+
+	float norm = sqrt(acc[0] * acc[0] + acc[1] * acc[1] + acc[2] * acc[2]);
+	bool still = fabs(norm - 1.f) < GYROBIAS_STILL_ACC;
+
+	for (uint8_t i = 0; i < 3; i++)
+		if (fabs(gyr[i]) > GYROBIAS_STILL_RATE)
+			still = false;
+
+	if (!still) {
+		_isStill = false;
+		restartWindow();
+		return false;
+	}
+
+	for (uint8_t i = 0; i < 3; i++) {
+		_sum[i] += gyr[i];
+		_sumSquares[i] += gyr[i] * gyr[i];
+	}
+
+	if (++_count < GYROBIAS_WINDOW)
+		return false;
+
+	float measured[3];
+	float variance = 0.f;
+
+	for (uint8_t i = 0; i < 3; i++) {
+		float mean = _sum[i] / GYROBIAS_WINDOW;
+		float spread = _sumSquares[i] / GYROBIAS_WINDOW - mean * mean;
+
+		// Slow and steady rotation, not stillness
+		if (spread > GYROBIAS_STILL_NOISE * GYROBIAS_STILL_NOISE) {
+			_isStill = false;
+			restartWindow();
+			return false;
+		}
+
+		measured[i] = _applied[i] - mean * _scale[i];
+		variance = max(variance, spread * _scale[i] * _scale[i] / GYROBIAS_WINDOW);
+	}
+
+	restartWindow();
+	_isStill = true;
+
+	predict();
+	correct(measured, variance);
+	learnSlope();
+
+	return apply();
+
+}
+
+/**
+ * @brief Gives the gyroscope temperature, the offsets follow it along the learned slope
+ * @param celsius the temperature (in degrees Celsius), see ITG3200::readTemp
+ * @return true if the offsets changed, see GyroBias::getOffsets
+ */
+bool GyroBias::setTemperature(float celsius) {
+
+	if (!_hasTemperature) {
+		_hasTemperature = true;
+		_temperature = celsius;
+		return false;
+	}
+
+	float delta = celsius - _temperature;
+
+	if (fabs(delta) < GYROBIAS_TEMPERATURE_STEP)
+		return false;
+
+	_temperature = celsius;
+
+	if (_hasSlope)
+		for (uint8_t i = 0; i < 3; i++)
+			_offset[i] += _slope[i] * delta;
+
+	_variance += GYROBIAS_TEMPERATURE_DRIFT * delta * delta;
+
+	if (!apply())
+		return false;
+
+	// The window so far was read with the old offsets, its mean would mix both
+	restartWindow();
+
+	return true;
+
+}
+
+/**
+ * @brief Gets the offsets to give the ITG3200
+ * @param offsets array that will receive the offsets (in counts)
+ */
+void GyroBias::getOffsets(int* offsets) {
+
+	for (uint8_t i = 0; i < 3; i++)
+		offsets[i] = _applied[i];
+
+}
+
+/**
+ * @brief Gets the estimated bias, what the gyroscope reads when still
+ * @param bias array that will receive the bias (in deg/s)
+ */
+void GyroBias::getBias(float* bias) {
+
+	for (uint8_t i = 0; i < 3; i++)
+		bias[i] = -_offset[i] / _scale[i];
+
+}
+
+/**
+ * @brief Gets how much the estimate can be trusted, it decays with time and temperature
+ * @return 0 (no idea) to 1 (well under a count), one half at GYROBIAS_TARGET_VARIANCE
+ */
+float GyroBias::getConfidence(void) {
+
+	float variance = _variance + GYROBIAS_DRIFT * (millis() - _lastPredict) / 1000.f;
+
+	return GYROBIAS_TARGET_VARIANCE / (GYROBIAS_TARGET_VARIANCE + variance);
+
+}
+
+/**
+ * @brief Checks whether the last window was still
+ * @return true from the end of a still window to the first moving reading
+ */
+bool GyroBias::isStill(void) {
+
+	return _isStill;
+
+}
+
+/**
+ * @brief Empties the window
+ */
+void GyroBias::restartWindow(void) {
+
+	_count = 0;
+
+	for (uint8_t i = 0; i < 3; i++)
+		_sum[i] = _sumSquares[i] = 0.f;
+
+}
+
+/**
+ * @brief Grows the variance by the random walk since the last call
+ */
+void GyroBias::predict(void) {
+
+	unsigned long now = millis();
+
+	_variance += GYROBIAS_DRIFT * (now - _lastPredict) / 1000.f;
+	_lastPredict = now;
+
+}
+
+/**
+ * @brief Merges a measurement of the offsets with the estimate
+ * @param measured the offsets that would have zeroed the window (in counts)
+ * @param variance the variance of the measurement (in counts^2)
+ */
+void GyroBias::correct(const float* measured, float variance) {
+
+	float gain = _variance / (_variance + variance);
+
+	for (uint8_t i = 0; i < 3; i++)
+		_offset[i] += gain * (measured[i] - _offset[i]);
+
+	_variance *= 1.f - gain;
+
+}
+
+/**
+ * @brief Learns the bias/temperature slope from two still estimates far enough apart
+ */
+void GyroBias::learnSlope(void) {
+
+	if (!_hasTemperature)
+		return;
+
+	if (_hasAnchor) {
+		float span = _temperature - _anchorTemperature;
+
+		if (fabs(span) < GYROBIAS_SLOPE_SPAN)
+			return;
+
+		for (uint8_t i = 0; i < 3; i++) {
+			float slope = (_offset[i] - _anchorOffset[i]) / span;
+			_slope[i] = _hasSlope ? _slope[i] + GYROBIAS_SLOPE_GAIN * (slope - _slope[i]) : slope;
+		}
+
+		_hasSlope = true;
+	}
+
+	for (uint8_t i = 0; i < 3; i++)
+		_anchorOffset[i] = _offset[i];
+
+	_anchorTemperature = _temperature;
+	_hasAnchor = true;
+
+}
+
+/**
+ * @brief Rounds the estimate to the offsets to apply
+ * @return true if they changed
+ */
+bool GyroBias::apply(void) {
+
+	bool changed = false;
+
+	for (uint8_t i = 0; i < 3; i++) {
+		int offset = (int)lround(_offset[i]);
+
+		if (offset != _applied[i]) {
+			_applied[i] = offset;
+			changed = true;
+		}
+	}
+
+	return changed;
+
+}
@@ -0,0 +1,97 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_MODULE_GYROBIAS_H_
+#define LEKA_MOTI_MODULE_GYROBIAS_H_
+
+/**
+ * @file GyroBias.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include <Arduino.h>
+#include <math.h>
+
+/*! Still readings averaged into one bias measurement */
+#define GYROBIAS_WINDOW 64
+
+/*! Rate (in deg/s) above which a reading counts as motion */
+#define GYROBIAS_STILL_RATE 5.0f
+
+/*! Standard deviation (in deg/s) of the rates over a window above which it counts as motion */
+#define GYROBIAS_STILL_NOISE 1.0f
+
+/*! Distance (in g) of the acceleration norm from 1 g above which a reading counts as motion */
+#define GYROBIAS_STILL_ACC 0.1f
+
+/*! Random walk of the bias, variance (in counts^2) added every second */
+#define GYROBIAS_DRIFT 0.01f
+
+/*! Variance (in counts^2) added per squared degree Celsius of temperature change */
+#define GYROBIAS_TEMPERATURE_DRIFT 4.0f
+
+/*! Temperature change (in degrees Celsius) that moves the offsets along the learned slope */
+#define GYROBIAS_TEMPERATURE_STEP 0.5f
+
+/*! Temperature span (in degrees Celsius) between two still measurements to learn a slope from */
+#define GYROBIAS_SLOPE_SPAN 2.0f
+
+/*! Weight of a new slope against the learned one */
+#define GYROBIAS_SLOPE_GAIN 0.25f
+
+/*! Variance (in counts^2) at which the confidence is one half */
+#define GYROBIAS_TARGET_VARIANCE 1.0f
+
+/*! Starting variances (in counts^2): offsets just zeroed, or read back from EEPROM */
+#define GYROBIAS_ZEROED_VARIANCE 1.0f
+#define GYROBIAS_STORED_VARIANCE 25.0f
+
+/**
+ * Tracks the gyroscope bias while the robot is still.
+ *
+ * The estimate is kept in raw counts, as the ITG3200 offsets it replaces. Every window of
+ * still readings is one measurement of it, merged with the estimate by a scalar Kalman
+ * filter whose variance grows with time and temperature. With the gyroscope temperature,
+ * a bias/temperature slope is learned from still windows far enough apart and moves the
+ * estimate while the robot is moving.
+ */
+namespace GyroBias {
+
+	void init(const int* offsets, const float* scale, float variance);
+
+	bool update(const float* gyr, const float* acc);
+	bool setTemperature(float celsius);
+
+	void getOffsets(int* offsets);
+	void getBias(float* bias);
+	float getConfidence(void);
+	bool isStill(void);
+
+	// Helper methods
+	void restartWindow(void);
+	void predict(void);
+	void correct(const float* measured, float variance);
+	void learnSlope(void);
+	bool apply(void);
+
+}
+
+#endif
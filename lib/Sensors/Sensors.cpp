@@ -28,10 +28,21 @@
 namespace Sensors {
 
 	// Thread
-	static WORKING_AREA(sensorsThreadArea, 230);
+	static WORKING_AREA(sensorsThreadArea, SENSORS_THREAD_STACK);
 	bool _isInitialized = false;
 	bool _isStarted = false;
 	uint16_t _threadDelay = 50;
+	PeriodicLoop _loop;
+
+	// Sampling
+	SensorsSampling _sampling = SENSORS_POLLING;
+	uint16_t _sampleRate = 20; // output data rate of the parts
+	uint16_t _fusionRate = 20; // fusion steps per second, 1000 / _threadDelay when polling
+
+	// Publishing
+	uint16_t _publishRate = 0; // 0 publishes every fusion step
+	systime_t _publishPeriod = 0;
+	systime_t _lastPublish = 0;
 
 	// FreeIMU object
 	FreeIMU _imu = FreeIMU();
@@ -43,46 +54,77 @@ namespace Sensors {
 	uint8_t SENSORS_INACTIVITY_Y = 1;
 	uint8_t SENSORS_INACTIVITY_Z = 1;
 
-	// Variables
-	float _XYZ[3] = { 0.f, 0.f, 0.f };
-	float _YPR[3] = { 0.f, 0.f, 0.f };
-	float _PTP[3] = { 0.f, 0.f, 0.f }; // PSI THETA PHI
+	// Calibration
+	uint8_t _temperatureSteps = 0;
 
-	float _returnXYZ = 0.f;
-	float _returnYPR = 0.f;
-	float _returnPTP = 0.f; // PSI THETA PHI
+	// Variables
+	Sample _next = Sample();   // built by the sensors thread only
+	Sample _sample = Sample(); // last published, read through _version
+	volatile uint8_t _version = 0;
+	float _lastYaw = 0.f; // yaw of the previous fusion step, to unwrap the heading
+	Orientation _angles = Orientation(); // angles of the published quaternion, shared by the readers
 
 	// ChibiOS
-	MUTEX_DECL(_SensorsDataMutex);
+	MUTEX_DECL(_SensorsDataMutex); // I2C transactions
+	MUTEX_DECL(_anglesMutex); // _angles
+	BSEMAPHORE_DECL(_dataReadySem, TRUE);
+	EVENTSOURCE_DECL(_sampleEvent); // broadcast on every publication
 
 }
 
 void Sensors::init(void* arg, tprio_t priority) {
 
 	if (!_isInitialized) {
-		_isInitialized = true;
+		setup();
 
-		_imu.init();
+		(void)chThdCreateStatic(sensorsThreadArea, sizeof(sensorsThreadArea),
+				priority, thread, arg);
 
-		_imu.acc.setInactivityThreshold(SENSORS_INACTIVITY_THRESHOLD);
-		_imu.acc.setTimeInactivity(SENSORS_INACTIVITY_TIME);
-		_imu.acc.setInactivityX(SENSORS_INACTIVITY_X);
-		_imu.acc.setInactivityY(SENSORS_INACTIVITY_Y);
-		_imu.acc.setInactivityZ(SENSORS_INACTIVITY_Z);
+		StackMonitor::watch("sensors", sensorsThreadArea, sizeof(sensorsThreadArea));
+	}
 
-		_imu.acc.setInterruptMapping(ADXL345_INT_INACTIVITY_BIT, ADXL345_INT1_PIN);
-		_imu.acc.setInterrupt(ADXL345_INT_INACTIVITY_BIT, 1);
+}
 
-		_imu.acc.setFreeFallThreshold(8);
-		_imu.acc.setFreeFallDuration(3);
+/**
+ * @brief Sets the IMU up, as Sensors::init does, without creating the thread
+ *
+ * For the host replay, which then runs Sensors::step itself, see host/replay.
+ */
+void Sensors::setup(void) {
 
-		_imu.acc.setInterruptMapping(ADXL345_INT_FREE_FALL_BIT, ADXL345_INT1_PIN);
-		_imu.acc.setInterrupt(ADXL345_INT_FREE_FALL_BIT, 1);
+	_isInitialized = true;
 
-		(void)chThdCreateStatic(sensorsThreadArea, sizeof(sensorsThreadArea),
-				priority, thread, arg);
+	Periodic::init(&_loop, "sensors", _threadDelay);
+
+	CalibrationData calibration;
 
+	if (Calibration::load(&calibration)) {
+		// Known offsets: skip the blocking gyro zeroing, the thread tracks the bias in the background
+		_imu.init(FIMU_ACC_ADDR, FIMU_ITG3200_DEF_ADDR, true, false);
+		applyCalibration(&calibration);
+		GyroBias::init(_imu.gyro.offsets, _imu.gyro.scalefactor, GYROBIAS_STORED_VARIANCE);
 	}
+	else {
+		_imu.init(true);
+		GyroBias::init(_imu.gyro.offsets, _imu.gyro.scalefactor, GYROBIAS_ZEROED_VARIANCE);
+	}
+
+	_imu.acc.setInactivityThreshold(SENSORS_INACTIVITY_THRESHOLD);
+	_imu.acc.setTimeInactivity(SENSORS_INACTIVITY_TIME);
+	_imu.acc.setInactivityX(SENSORS_INACTIVITY_X);
+	_imu.acc.setInactivityY(SENSORS_INACTIVITY_Y);
+	_imu.acc.setInactivityZ(SENSORS_INACTIVITY_Z);
+
+	_imu.acc.setInterruptMapping(ADXL345_INT_INACTIVITY_BIT, ADXL345_INT1_PIN);
+	_imu.acc.setInterrupt(ADXL345_INT_INACTIVITY_BIT, 1);
+
+	_imu.acc.setFreeFallThreshold(8);
+	_imu.acc.setFreeFallDuration(3);
+
+	_imu.acc.setInterruptMapping(ADXL345_INT_FREE_FALL_BIT, ADXL345_INT1_PIN);
+	_imu.acc.setInterrupt(ADXL345_INT_FREE_FALL_BIT, 1);
+
+	configureSampling();
 
 }
 
@@ -104,23 +146,304 @@ void Sensors::stop(void) {
 
 }
 
+/**
+ * @brief Measures the IMU offsets and stores them in EEPROM for the next boots
+ *
+ * The robot has to stay still and flat (Z up) during the second or so it takes.
+ * @return true if the offsets were stored, false if the robot was not flat enough
+ */
+bool Sensors::calibrate(void) {
+
+	CalibrationData calibration;
+	int32_t sum[3] = { 0, 0, 0 };
+	int xyz[3];
+
+	chMtxLock(&_SensorsDataMutex);
+
+	_imu.gyro.zeroCalibrate(SENSORS_CALIBRATION_SAMPLES, 5);
+
+	for (uint8_t i = 0; i < SENSORS_CALIBRATION_SAMPLES; i++) {
+		_imu.acc.readAccel(xyz);
+
+		for (uint8_t j = 0; j < 3; j++)
+			sum[j] += xyz[j];
+
+		waitMs(5);
+	}
+
+	chMtxUnlock();
+
+	for (uint8_t i = 0; i < 3; i++) {
+		calibration.gyrOffset[i] = _imu.gyro.offsets[i];
+		calibration.accOffset[i] = sum[i] / SENSORS_CALIBRATION_SAMPLES;
+	}
+
+	calibration.accOffset[2] -= SENSORS_ACC_1G;
+
+	GyroBias::init(_imu.gyro.offsets, _imu.gyro.scalefactor, GYROBIAS_ZEROED_VARIANCE);
+
+	if (abs(calibration.accOffset[0]) > SENSORS_ACC_1G / 4 || abs(calibration.accOffset[1]) > SENSORS_ACC_1G / 4
+			|| abs(calibration.accOffset[2]) > SENSORS_ACC_1G / 4)
+		return false;
+
+	applyCalibration(&calibration);
+	Calibration::save(&calibration);
+
+	return true;
+
+}
+
+/**
+ * @brief Hands stored offsets over to the IMU
+ * @param calibration the offsets
+ */
+void Sensors::applyCalibration(const CalibrationData* calibration) {
+
+	_imu.gyro.setOffsets(calibration->gyrOffset[0], calibration->gyrOffset[1], calibration->gyrOffset[2]);
+
+	_imu.acc_off_x = calibration->accOffset[0];
+	_imu.acc_off_y = calibration->accOffset[1];
+	_imu.acc_off_z = calibration->accOffset[2];
+
+}
+
+/**
+ * @brief Feeds the bias tracker with a reading, hands new offsets over to the gyroscope
+ *
+ * Stored or zeroed offsets drift with temperature and age, every still second corrects them.
+ * @param values the calibrated readings of the fusion step, acceleration then rates (in deg/s)
+ */
+void Sensors::trackGyroBias(const float* values) {
+
+	float acc[3];
+
+	for (uint8_t i = 0; i < 3; i++)
+		acc[i] = values[i] / SENSORS_ACC_1G;
+
+	bool changed = GyroBias::update(values + 3, acc);
+
+#if SENSORS_TEMPERATURE_STEPS > 0
+	if (++_temperatureSteps >= SENSORS_TEMPERATURE_STEPS) {
+		float celsius;
+
+		_temperatureSteps = 0;
+
+		chMtxLock(&_SensorsDataMutex);
+		_imu.gyro.readTemp(&celsius);
+		chMtxUnlock();
+
+		changed = GyroBias::setTemperature(celsius) || changed;
+	}
+#endif
+
+	if (changed) {
+		int offsets[3];
+
+		GyroBias::getOffsets(offsets);
+
+		chMtxLock(&_SensorsDataMutex);
+		_imu.gyro.setOffsets(offsets[0], offsets[1], offsets[2]);
+		chMtxUnlock();
+	}
+
+	GyroBias::getBias(_next.gyrBias);
+	_next.gyrBiasConfidence = GyroBias::getConfidence();
+
+}
+
+/**
+ * @brief Chooses what wakes the sensors thread up, each wake up being one fusion step
+ * @param sampling SENSORS_POLLING to read every 1000 / rate ms, one of the data ready
+ * interrupts to read each new sample as soon as the part has it, or SENSORS_ACC_FIFO
+ * to read the accelerometer by batches of SENSORS_FIFO_WATERMARK samples
+ * @param rate the output data rate of the parts (in Hz), which is also the fusion rate
+ * except with SENSORS_ACC_FIFO where fusion runs once per batch; 0, the default, keeps the current one
+ */
+void Sensors::setSampling(SensorsSampling sampling, uint16_t rate) {
+
+	chMtxLock(&_SensorsDataMutex);
+
+	_sampling = sampling;
+
+	if (rate != 0)
+		_sampleRate = constrain(rate, 1, 800);
+
+	_fusionRate = _sampling == SENSORS_ACC_FIFO ? max(1, _sampleRate / SENSORS_FIFO_WATERMARK) : _sampleRate;
+	_threadDelay = max(1, 1000 / _fusionRate);
+	Periodic::setPeriod(&_loop, _threadDelay);
+
+	if (_isInitialized)
+		configureSampling();
+
+	chMtxUnlock();
+
+}
+
+/**
+ * @brief Gets what wakes the sensors thread up
+ * @return the current SensorsSampling
+ */
+SensorsSampling Sensors::getSampling(void) {
+
+	return _sampling;
+
+}
+
+/**
+ * @brief Gets the output data rate of the parts
+ * @return the rate (in Hz)
+ */
+uint16_t Sensors::getSampleRate(void) {
+
+	return _sampleRate;
+
+}
+
+/**
+ * @brief Gets the fusion rate
+ * @return the rate (in Hz)
+ */
+uint16_t Sensors::getFusionRate(void) {
+
+	return _fusionRate;
+
+}
+
+/**
+ * @brief Sets how often the fusion results are published to the getters, independently of the fusion rate
+ *
+ * The filter wants a small time step, the modules reading it don't need one:
+ * e.g. setSampling(SENSORS_GYR_DATA_READY, 400) then setPublishRate(20).
+ * @param rate the publish rate (in Hz), 0 to publish every fusion step
+ */
+void Sensors::setPublishRate(uint16_t rate) {
+
+	_publishRate = rate;
+	_publishPeriod = rate == 0 ? 0 : (systime_t)((CH_FREQUENCY + rate / 2) / rate); // rounded, in ticks
+
+}
+
+/**
+ * @brief Gets how often the fusion results are published
+ * @return the rate (in Hz), 0 when every fusion step is published
+ */
+uint16_t Sensors::getPublishRate(void) {
+
+	return _publishRate;
+
+}
+
+/**
+ * @brief Sets the output data rate and data ready interrupt of both parts for the current sampling
+ */
+void Sensors::configureSampling(void) {
+
+	detachInterrupt(SENSORS_ACC_INTERRUPT);
+	detachInterrupt(SENSORS_GYR_INTERRUPT);
+	_imu.acc.setInterrupt(ADXL345_INT_DATA_READY_BIT, 0);
+	_imu.acc.setInterrupt(ADXL345_INT_WATERMARK_BIT, 0);
+	_imu.acc.setFifoMode(ADXL345_FIFO_BYPASS);
+	_imu.setAccFifo(false);
+
+	if (_sampling == SENSORS_POLLING)
+		return;
+
+	// ADXL345: power of two multiple of 6.25 Hz, bandwidth is half of it
+	_imu.acc.setRate(_sampleRate);
+
+	// ITG3200: 1 kHz internal rate once the low pass filter is on, keep the bandwidth
+	// under Nyquist of what is actually read, once per fusion step
+	if (_fusionRate >= 400)
+		_imu.gyro.setFilterBW(BW188_SR1);
+	else if (_fusionRate >= 200)
+		_imu.gyro.setFilterBW(BW098_SR1);
+	else if (_fusionRate >= 100)
+		_imu.gyro.setFilterBW(BW042_SR1);
+	else if (_fusionRate >= 50)
+		_imu.gyro.setFilterBW(BW020_SR1);
+	else if (_fusionRate >= 20)
+		_imu.gyro.setFilterBW(BW010_SR1);
+	else
+		_imu.gyro.setFilterBW(BW005_SR1);
+
+	_imu.gyro.setSampleRateDiv((uint8_t)min(255, 1000 / _fusionRate - 1));
+
+	if (_sampling == SENSORS_ACC_FIFO) {
+		// Raises INT2 once SENSORS_FIFO_WATERMARK samples wait, readAcc drains them all
+		_imu.acc.setFifoWatermark(SENSORS_FIFO_WATERMARK);
+		_imu.acc.setFifoMode(ADXL345_FIFO_STREAM);
+		_imu.setAccFifo(true);
+
+		_imu.acc.setInterruptMapping(ADXL345_INT_WATERMARK_BIT, ADXL345_INT2_PIN);
+		_imu.acc.setInterrupt(ADXL345_INT_WATERMARK_BIT, 1);
+
+		attachInterrupt(SENSORS_ACC_INTERRUPT, dataReadyISR, RISING);
+	}
+	else if (_sampling == SENSORS_ACC_DATA_READY) {
+		// INT1 already carries inactivity and free fall
+		_imu.acc.setInterruptMapping(ADXL345_INT_DATA_READY_BIT, ADXL345_INT2_PIN);
+		_imu.acc.setInterrupt(ADXL345_INT_DATA_READY_BIT, 1);
+
+		attachInterrupt(SENSORS_ACC_INTERRUPT, dataReadyISR, RISING);
+	}
+	else {
+		// Hold the line until the next register read instead of a 50us pulse
+		_imu.gyro.setINTLogiclvl(ACTIVE_ONHIGH);
+		_imu.gyro.setINTDriveType(PUSH_PULL);
+		_imu.gyro.setLatchMode(UNTIL_INT_CLEARED);
+		_imu.gyro.setLatchClearMode(READ_ANYREG);
+		_imu.gyro.setRawDataReady(true);
+
+		attachInterrupt(SENSORS_GYR_INTERRUPT, dataReadyISR, RISING);
+	}
+
+}
+
+/**
+ * @brief Data ready interrupt handler, wakes the sensors thread up
+ */
+void Sensors::dataReadyISR(void) {
+
+	CH_IRQ_PROLOGUE();
+
+	chSysLockFromIsr();
+	chBSemSignalI(&_dataReadySem);
+	chSysUnlockFromIsr();
+
+	CH_IRQ_EPILOGUE();
+
+}
+
 /**
  * @brief Main module thread
  */
 msg_t Sensors::thread(void* arg) {
 
 	(void) arg;
+	chRegSetThreadName("sensors");
 
 	while (!chThdShouldTerminate()) {
 
 		if(_isStarted) {
 
-			readXYZ();
-			readYPR();
+			// The timeout only matters if an edge was missed: reading the data
+			// registers releases the line so that the next sample raises it again
+			if (_sampling != SENSORS_POLLING) {
+				(void)chBSemWaitTimeout(&_dataReadySem, MS2ST(2000 / _fusionRate + 1));
+				Periodic::mark(&_loop);
+			}
+
+			step();
 
 		}
 
-		waitMs(_threadDelay);
+		if (!_isStarted) {
+			Periodic::pause(&_loop);
+			waitMs(_threadDelay);
+		}
+		else if (_sampling == SENSORS_POLLING) {
+			Periodic::wait(&_loop);
+		}
 
 	}
 
@@ -128,22 +451,289 @@ msg_t Sensors::thread(void* arg) {
 
 }
 
+/**
+ * @brief One fusion step: reads the sensors, runs the filter and publishes if it is time to
+ */
+void Sensors::step(void) {
+
+	readXYZ();
+	readYPR();
+
+	systime_t now = chTimeNow();
+	systime_t elapsed = (systime_t)(now - _lastPublish);
+
+	if (elapsed >= _publishPeriod) {
+		// Publications keep their phase, the fusion step that happens to fire does not delay the
+		// next one. More than one period behind, they start over from now
+		if (_publishPeriod == 0 || elapsed >= 2 * _publishPeriod)
+			_lastPublish = now;
+		else
+			_lastPublish += _publishPeriod;
+
+		publish();
+	}
+
+}
+
+/**
+ * @brief Reads the sensors and runs the fusion step, keeps the readings in the sample being built
+ */
 void Sensors::readXYZ(void) {
 
+	float values[6];
+
 	chMtxLock(&_SensorsDataMutex);
-	_imu.getValues(_XYZ);
+	_imu.update(values);
 	chMtxUnlock();
 
+	trackGyroBias(values);
+
+	_next.timestamp = micros();
+
+	for (uint8_t i = 0; i < 3; i++) {
+		_next.acc[i] = values[i];
+		_next.gyr[i] = values[i + 3];
+	}
+
 }
 
+/**
+ * @brief Puts the quaternion of the fusion step and the vectors derived from it in the sample being built
+ *
+ * The angles are left to the readers: the first one to need an angle computes it for all of
+ * them, see computeAngles. Yaw is the exception, the heading needs it anyway.
+ */
 void Sensors::readYPR(void) {
 
-	chMtxLock(&_SensorsDataMutex);
-	_imu.getYawPitchRollEulerRad(_YPR, _PTP);
+	float q[4];
+
+	_imu.orientation.getQ(q);
+	_next.orientation.setQ(q);
+	_next.orientation.getGravity(_next.gravity);
+
+	for (uint8_t i = 0; i < 3; i++)
+		_next.linearAcc[i] = _next.acc[i] / SENSORS_ACC_1G;
+
+	_imu.gravityCompensateAcc(_next.linearAcc, q);
+
+	// Steps are far below half a turn, a larger one is yaw wrapping around
+	float yaw = _next.orientation.getYawRad();
+	float delta = yaw - _lastYaw;
+
+	if (delta > M_PI)
+		delta -= 2 * M_PI;
+	else if (delta < -M_PI)
+		delta += 2 * M_PI;
+
+	_next.heading += delta;
+	_lastYaw = yaw;
+
+}
+
+/**
+ * @brief Publishes the sample being built to the readers
+ *
+ * Only the sensors thread writes, so it never waits: an odd _version tells the
+ * readers a copy is in progress and that they have to try again.
+ */
+void Sensors::publish(void) {
+
+	_next.sequence++;
+
+	_version++;
+	SENSORS_BARRIER();
+
+	_sample = _next;
+
+	SENSORS_BARRIER();
+	_version++;
+
+	chEvtBroadcast(&_sampleEvent);
+
+}
+
+/**
+ * @brief Gets a consistent copy of the last published sample
+ * @param sample pointer that will receive the sample
+ */
+void Sensors::getSample(Sample* sample) {
+
+	readField(sample, &_sample, sizeof(Sample));
+
+}
+
+/**
+ * @brief Gets a consistent copy of the orientation of the last published sample
+ * @param orientation pointer that will receive the orientation, computeAngles then gets its angles
+ */
+void Sensors::getOrientation(Orientation* orientation) {
+
+	readField(orientation, &_sample.orientation, sizeof(Orientation));
+
+}
+
+/**
+ * @brief Computes some angles of an orientation copied from a published sample
+ *
+ * Each angle is computed once per published quaternion, by the first reader that asks for it,
+ * and the other readers copy it.
+ * @param orientation the orientation, from getOrientation or getSample
+ * @param angles the ORIENTATION_* flags of the angles needed
+ */
+void Sensors::computeAngles(Orientation* orientation, uint8_t angles) {
+
+	chMtxLock(&_anglesMutex);
+
+	if (!_angles.hasSameQ(*orientation))
+		_angles = *orientation;
+
+	_angles.compute(angles);
+	*orientation = _angles;
+
 	chMtxUnlock();
 
 }
 
+/**
+ * @brief Gets the gyroscope bias the offsets currently remove
+ * @param bias array that will receive the X, Y, Z bias (in deg/s)
+ */
+void Sensors::getGyrBias(float* bias) {
+
+	readField(bias, _sample.gyrBias, sizeof(_sample.gyrBias));
+
+}
+
+/**
+ * @brief Gets how much the gyroscope bias estimate can be trusted
+ * @return 0 (not at all) to 1, it rises while the robot is still and decays otherwise
+ */
+float Sensors::getGyrBiasConfidence(void) {
+
+	float confidence;
+	readField(&confidence, &_sample.gyrBiasConfidence, sizeof(confidence));
+
+	return confidence;
+
+}
+
+/**
+ * @brief Gets the sequence number of the last published sample
+ * @return the sequence number, incremented on every fusion step
+ */
+uint16_t Sensors::getSequence(void) {
+
+	uint16_t sequence;
+	readField(&sequence, &_sample.sequence, sizeof(sequence));
+
+	return sequence;
+
+}
+
+/**
+ * @brief Gets the event source broadcast every time a sample is published, for the module threads
+ * to wake up on new readings instead of polling: chEvtRegisterMask(Sensors::getSampleEvent(), &listener, mask)
+ * @return the event source
+ */
+EventSource* Sensors::getSampleEvent(void) {
+
+	return &_sampleEvent;
+
+}
+
+/**
+ * @brief Gets how many published samples make up a period, for a thread stepping on the sample
+ * event every that many samples
+ * @param period the period of the thread (in ms)
+ * @return the number of samples, at least 1
+ */
+uint16_t Sensors::getSamplesPerPeriod(uint16_t period) {
+
+	uint32_t rate = _publishRate != 0 ? _publishRate : _fusionRate;
+
+	return (uint16_t)max(1UL, ((uint32_t)period * rate + 500) / 1000);
+
+}
+
+/**
+ * @brief Copies part of the last published sample, trying again if a publication happened meanwhile
+ * @param out pointer that will receive the copy
+ * @param field pointer to the part of _sample to copy
+ * @param size size of the part in bytes
+ */
+void Sensors::readField(void* out, const void* field, uint8_t size) {
+
+	uint8_t version;
+
+	do {
+		version = _version;
+		SENSORS_BARRIER();
+
+		memcpy(out, field, size);
+
+		SENSORS_BARRIER();
+	} while ((version & 1) || version != _version);
+
+}
+
+/**
+ * @brief Gets the quaternion of the last published sample
+ * @param q array that will receive q0 (the scalar part), q1, q2 and q3
+ */
+void Sensors::getQuaternion(float* q) {
+
+	Orientation orientation;
+	getOrientation(&orientation);
+
+	orientation.getQ(q);
+
+}
+
+/**
+ * @brief Gets the direction of gravity in the sensor frame
+ * @param g array that will receive the X, Y, Z components of the unit vector (in g)
+ */
+void Sensors::getGravity(float* g) {
+
+	readField(g, _sample.gravity, sizeof(_sample.gravity));
+
+}
+
+/**
+ * @brief Gets the acceleration of the robot itself, gravity removed
+ * @param acc array that will receive the X, Y, Z acceleration (in g)
+ */
+void Sensors::getLinearAcc(float* acc) {
+
+	readField(acc, _sample.linearAcc, sizeof(_sample.linearAcc));
+
+}
+
+/**
+ * @brief Gets the heading, yaw without the jump at +/- pi: a full turn adds or removes 2 pi
+ *
+ * Spins are measured as differences of headings, whatever the number of turns.
+ * @return the heading (in radians)
+ */
+float Sensors::getHeading(void) {
+
+	float heading;
+	readField(&heading, &_sample.heading, sizeof(heading));
+
+	return heading;
+
+}
+
+/**
+ * @brief Gets the heading (in degrees), see Sensors::getHeading
+ * @return the heading (in degrees)
+ */
+float Sensors::getHeadingDeg(void) {
+
+	return radToDeg(getHeading());
+
+}
+
 /**
  * @brief Reads the values XYZ of the accelerometer
  * @param x pointer that will receive the content of the X-axis
@@ -152,21 +742,21 @@ void Sensors::readYPR(void) {
  */
 void Sensors::getAccXYZ(float* x, float* y, float* z) {
 
-	chMtxLock(&_SensorsDataMutex);
-	*x = _XYZ[0];
-	*y = _XYZ[1];
-	*z = _XYZ[2];
-	chMtxUnlock();
+	float acc[3];
+	readField(acc, _sample.acc, sizeof(acc));
+
+	*x = acc[0];
+	*y = acc[1];
+	*z = acc[2];
 
 }
 
 float Sensors::getAccXYZ(uint8_t index) {
 
-	chMtxLock(&_SensorsDataMutex);
-	_returnXYZ = _XYZ[index];
-	chMtxUnlock();
+	float value;
+	readField(&value, &_sample.acc[index], sizeof(value));
 
-	return _returnXYZ;
+	return value;
 
 }
 
@@ -208,11 +798,13 @@ float Sensors::getAccZ() {
  */
 void Sensors::getGyrYPR(float* y, float* p, float* r) {
 
-	chMtxLock(&_SensorsDataMutex);
-	*y = _YPR[0];
-	*p = _YPR[1];
-	*r = _YPR[2];
-	chMtxUnlock();
+	Orientation orientation;
+	getOrientation(&orientation);
+	computeAngles(&orientation, ORIENTATION_HEADING | ORIENTATION_PITCH_ROLL);
+
+	*y = orientation.getYawRad();
+	*p = orientation.getPitchRad();
+	*r = orientation.getRollRad();
 
 }
 
@@ -222,11 +814,18 @@ void Sensors::getGyrYPR(float* y, float* p, float* r) {
  */
 float Sensors::getGyrYPR(uint8_t index) {
 
-	chMtxLock(&_SensorsDataMutex);
-	_returnYPR = _YPR[index];
-	chMtxUnlock();
-
-	return _returnYPR;
+	Orientation orientation;
+	getOrientation(&orientation);
+	computeAngles(&orientation, index == 0 ? ORIENTATION_HEADING : ORIENTATION_PITCH_ROLL);
+
+	switch (index) {
+		case 0:
+			return orientation.getYawRad();
+		case 1:
+			return orientation.getPitchRad();
+		default:
+			return orientation.getRollRad();
+	}
 
 }
 
@@ -270,11 +869,9 @@ void Sensors::getGyrYPRDeg(float* y, float* p, float* r) {
 
 	getGyrYPR(y, p, r);
 
-	chMtxLock(&_SensorsDataMutex);
 	*y = radToDeg(*y);
 	*p = radToDeg(*p);
 	*r = radToDeg(*r);
-	chMtxUnlock();
 
 }
 
@@ -326,11 +923,13 @@ float Sensors::getGyrRDeg() {
  */
 void Sensors::getEuler(float* psi, float* theta, float* phi) {
 
-	chMtxLock(&_SensorsDataMutex);
-	*psi = _PTP[0];
-	*theta = _PTP[1];
-	*phi = _PTP[2];
-	chMtxUnlock();
+	Orientation orientation;
+	getOrientation(&orientation);
+	computeAngles(&orientation, ORIENTATION_HEADING | ORIENTATION_THETA | ORIENTATION_PHI);
+
+	*psi = orientation.getPsiRad();
+	*theta = orientation.getThetaRad();
+	*phi = orientation.getPhiRad();
 
 }
 
@@ -340,11 +939,18 @@ void Sensors::getEuler(float* psi, float* theta, float* phi) {
  */
 float Sensors::getEulerPTP(uint8_t index) {
 
-	chMtxLock(&_SensorsDataMutex);
-	_returnPTP = _PTP[index];
-	chMtxUnlock();
-
-	return _returnPTP;
+	Orientation orientation;
+	getOrientation(&orientation);
+	computeAngles(&orientation, index == 0 ? ORIENTATION_HEADING : index == 1 ? ORIENTATION_THETA : ORIENTATION_PHI);
+
+	switch (index) {
+		case 0:
+			return orientation.getPsiRad();
+		case 1:
+			return orientation.getThetaRad();
+		default:
+			return orientation.getPhiRad();
+	}
 
 }
 
@@ -388,11 +994,9 @@ void Sensors::getEulerDeg(float* phi, float* theta, float* psi) {
 
 	getEuler(phi, theta, psi);
 
-	chMtxLock(&_SensorsDataMutex);
 	*phi = radToDeg(*phi);
 	*theta = radToDeg(*theta);
 	*psi = radToDeg(*psi);
-	chMtxUnlock();
 
 }
 
@@ -436,6 +1040,24 @@ float Sensors::getEulerPsiDeg() {
 
 }
 
+/**
+ * @brief Sets the gains of the fusion filter, twoKpDef and twoKiDef of FreeIMU.h by default
+ *
+ * A larger twoKp follows the accelerometer more closely, a larger twoKi removes the gyroscope
+ * bias faster, both at the cost of more accelerometer noise in the angles.
+ * @param twoKp 2 * proportional gain
+ * @param twoKi 2 * integral gain
+ */
+void Sensors::setFusionGains(float twoKp, float twoKi) {
+
+	chMtxLock(&_SensorsDataMutex);
+
+	_imu.setGains(twoKp, twoKi);
+
+	chMtxUnlock();
+
+}
+
 /**
  * @brief Checks whether the device is falling (see Configuration for threshold)
  * @return true if it is falling, flase otherwise
@@ -32,17 +32,114 @@
 #include <math.h>
 
 #include "ChibiOS_AVR.h"
+#include "StackMonitor.h"
+#include "Periodic.h"
 #include "FreeIMU.h"
+#include "Calibration.h"
+#include "GyroBias.h"
 #include "Moti.h"
 
+/*! Arduino external interrupts wired to the IMU lines (Mega: 4 is pin 19, 5 is pin 18) */
+#ifndef SENSORS_ACC_INTERRUPT
+#define SENSORS_ACC_INTERRUPT 4
+#endif
+
+#ifndef SENSORS_GYR_INTERRUPT
+#define SENSORS_GYR_INTERRUPT 5
+#endif
+
+/*! Size of the sensors thread's working area, the n of its WORKING_AREA (see StackMonitor) */
+#ifndef SENSORS_THREAD_STACK
+#define SENSORS_THREAD_STACK 256
+#endif
+
+/*! Readings averaged by Sensors::calibrate */
+#define SENSORS_CALIBRATION_SAMPLES 128
+
+/*! ADXL345 reading for 1 g, in the default +/- 2 g range */
+#define SENSORS_ACC_1G 256
+
+/*! Fusion steps between two readings of the gyroscope temperature, 0 disables the temperature model */
+#ifndef SENSORS_TEMPERATURE_STEPS
+#define SENSORS_TEMPERATURE_STEPS 64
+#endif
+
+/*! Accelerometer samples per batch in SENSORS_ACC_FIFO mode (at most 31) */
+#ifndef SENSORS_FIFO_WATERMARK
+#define SENSORS_FIFO_WATERMARK 16
+#endif
+
+/*! What wakes the sensors thread up */
+typedef enum {
+	SENSORS_POLLING,
+	SENSORS_ACC_DATA_READY,
+	SENSORS_GYR_DATA_READY,
+	SENSORS_ACC_FIFO
+} SensorsSampling;
+
+/*! Keeps the compiler (and the host CPU) from moving memory accesses across the seqlock */
+#ifdef __AVR__
+#define SENSORS_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define SENSORS_BARRIER() __sync_synchronize()
+#endif
+
 namespace Sensors {
 
+	/*! Everything one fusion step produces, published as a whole */
+	typedef struct {
+		uint32_t timestamp; // micros() when the sensors were read
+		uint16_t sequence;  // incremented on every publication
+		float acc[3];       // X, Y, Z
+		float gyr[3];       // X, Y, Z rates (deg/s)
+		Orientation orientation; // yaw, pitch, roll and psi, theta, phi computed on first access, see computeAngles
+		float gravity[3];   // X, Y, Z direction of gravity, a unit vector (g)
+		float linearAcc[3]; // X, Y, Z acceleration once gravity is removed (g)
+		float heading;      // yaw, unwrapped: keeps counting past +/- pi (rad)
+		float gyrBias[3];   // X, Y, Z gyroscope bias being removed (deg/s)
+		float gyrBiasConfidence; // 0 to 1, see GyroBias::getConfidence
+	} Sample;
+
 	// Initialization
 	msg_t thread(void* arg);
 	void init(void* arg = NULL, tprio_t priority = NORMALPRIO + 2);
 	void start(void);
 	void stop(void);
 
+	// Without the thread
+	void setup(void);
+	void step(void);
+
+	// Calibration
+	bool calibrate(void);
+	void getGyrBias(float* bias);
+	float getGyrBiasConfidence(void);
+
+	// Sampling
+	void setSampling(SensorsSampling sampling, uint16_t rate = 0);
+	SensorsSampling getSampling(void);
+	uint16_t getSampleRate(void);
+	uint16_t getFusionRate(void);
+	void setPublishRate(uint16_t rate);
+	uint16_t getPublishRate(void);
+
+	// Sample
+	void getSample(Sample* sample);
+	void getOrientation(Orientation* orientation);
+	void computeAngles(Orientation* orientation, uint8_t angles);
+	uint16_t getSequence(void);
+
+	// Events
+	EventSource* getSampleEvent(void);
+	uint16_t getSamplesPerPeriod(uint16_t period);
+
+	// Vectors, no angle wrapping to care about
+	void getQuaternion(float* q);
+	void getGravity(float* g);
+	void getLinearAcc(float* acc);
+	float getHeading(void);
+	float getHeadingDeg(void);
+
 	// Accelerometer
 	void getAccXYZ(float* x, float* y, float* z);
 	float getAccXYZ(uint8_t index);
@@ -77,12 +174,19 @@ namespace Sensors {
 	float getEulerPsiDeg();
 
 	// Sensor fusion
+	void setFusionGains(float twoKp, float twoKi);
 	bool isFalling();
 	bool isInactive();
 
 	// Helper methods
 	void readXYZ(void);
 	void readYPR(void);
+	void publish(void);
+	void readField(void* out, const void* field, uint8_t size);
+	void configureSampling(void);
+	void applyCalibration(const CalibrationData* calibration);
+	void trackGyroBias(const float* values);
+	void dataReadyISR(void);
 
 	float radToDeg(float rad);
 	float degToRad(float deg);
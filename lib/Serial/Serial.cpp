@@ -50,14 +50,14 @@ void ReadCommand::resetHeader(void) {
 }
 
 /**
- * @brief Read a control command (GO, SPIN, STOP, FADE LED)
+ * @brief Read a control command (GO, SPIN, STOP, FADE LED, STACKS, PERIODS)
  */
 void ReadCommand::readControlCommand(void) {
 	type = COMMAND_NONE;
 
 	uint8_t actionByte = readByte();
 
-	if (actionByte > 0x03)
+	if (actionByte > 0x03 && actionByte != COMMAND_STACKS && actionByte != COMMAND_PERIODS)
 		return;
 
 	type = (COMMAND_TYPE)actionByte;
@@ -76,6 +76,8 @@ void ReadCommand::readControlCommand(void) {
 			break;
 
 		case COMMAND_STOP:
+		case COMMAND_STACKS:
+		case COMMAND_PERIODS:
 			break;
 
 		case COMMAND_FADE:
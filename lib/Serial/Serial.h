@@ -39,6 +39,8 @@ typedef enum {
 	COMMAND_STOP,
 	COMMAND_FADE,
 	COMMAND_TOGGLE,
+	COMMAND_STACKS,
+	COMMAND_PERIODS,
 	COMMAND_NONE
 } COMMAND_TYPE;
 
@@ -3,22 +3,34 @@
 
 #include <Arduino.h>
 #include "ChibiOS_AVR.h"
+#include "StackMonitor.h"
+#include "Periodic.h"
 #include "Sensors.h"
 #include "DriveSystem.h"
 #include "Motion.h"
 
 #include "Filters.h"
 
+/*! Events of the Stabilization thread */
+#define STABILIZATION_SAMPLE_EVENT EVENT_MASK(0) // Sensors published a sample
+#define STABILIZATION_WAKE_EVENT   EVENT_MASK(1) // start or stop
+
+/*! Size of the Stabilization thread's working area, the n of its WORKING_AREA (see StackMonitor) */
+#ifndef STABILIZATION_THREAD_STACK
+#define STABILIZATION_THREAD_STACK 256
+#endif
+
 namespace Stabilization {
 
 	// Thread methods
-	static WORKING_AREA(stabilizationThreadArea, 256);
+	static WORKING_AREA(stabilizationThreadArea, STABILIZATION_THREAD_STACK);
 	static msg_t thread(void* arg);
 
 
 	void init(void* arg = NULL, tprio_t priority = NORMALPRIO);
 	void start(void);
 	void stop(void);
+	void step(void);
 	void wiggle(void);
 
 	void orientateLeft(void);
@@ -32,11 +44,18 @@ namespace Stabilization {
 	float _PIDOutputTheta = 0.0;
 	float _PIDOutputPhi = 0.0;
 
+	// Angles, only read 2 s after start
+	float _currentAnglePsi = 0.0;
+	float _currentAngleTheta = 0.0;
+	float _currentAnglePhi = 0.0;
+
 	// Variables
+	Thread* _thread = NULL;
 	bool _isInitialized = false;
 	bool _isStarted = false;
-	uint8_t _threadDelay = 100;
+	uint16_t _threadDelay = 100;
 	uint32_t _runStartTime = 0;
+	PeriodicLoop _loop;
 
 
 	// Misc
@@ -48,9 +67,13 @@ void Stabilization::init(void* arg, tprio_t priority) {
 	if (!_isInitialized) {
 		_isInitialized = true;
 
-		(void)chThdCreateStatic(stabilizationThreadArea,
+		Periodic::init(&_loop, "stabilization", _threadDelay);
+
+		_thread = chThdCreateStatic(stabilizationThreadArea,
 				sizeof(stabilizationThreadArea),
 				priority, thread, arg);
+
+		StackMonitor::watch("stabilization", stabilizationThreadArea, sizeof(stabilizationThreadArea));
 	}
 }
 
@@ -61,6 +84,9 @@ void Stabilization::start(void) {
 	_runStartTime = millis();
 
 	chMtxUnlock();
+
+	if (_thread != NULL)
+		chEvtSignal(_thread, STABILIZATION_WAKE_EVENT);
 }
 
 void Stabilization::stop(void) {
@@ -69,6 +95,9 @@ void Stabilization::stop(void) {
 	_isStarted = false;
 
 	chMtxUnlock();
+
+	if (_thread != NULL)
+		chEvtSignal(_thread, STABILIZATION_WAKE_EVENT);
 }
 
 void Stabilization::wiggle(void){
@@ -92,110 +121,116 @@ _filterPsi.SetInitialAngle(_filterPsi.GetInitialAngle()-(PI/12));
 
 msg_t Stabilization::thread(void* arg) {
 
-	// PI/9 = 20°
-	// PI/4 = 45°
-
 	(void) arg;
+	chRegSetThreadName("stabilization");
 
-	float currentAnglePsi = 0.0;
-	float currentAngleTheta = 0.0;
-	float currentAnglePhi = 0.0;
+	EventListener sampleListener;
+	uint16_t samples = 0;
 
+	chEvtRegisterMask(Sensors::getSampleEvent(), &sampleListener, STABILIZATION_SAMPLE_EVENT);
+
+	while (!chThdShouldTerminate()) {
+		if (!_isStarted) {
+			Periodic::pause(&_loop);
+			chEvtWaitAny(STABILIZATION_WAKE_EVENT);
+			continue;
+		}
+
+		// One step every _threadDelay worth of new angles, the timeout only matters if Sensors
+		// stops publishing
+		eventmask_t events = chEvtWaitAnyTimeout(STABILIZATION_SAMPLE_EVENT | STABILIZATION_WAKE_EVENT,
+				MS2ST(2 * _threadDelay));
+
+		if (!_isStarted || (events & STABILIZATION_WAKE_EVENT))
+			continue;
+
+		if ((events & STABILIZATION_SAMPLE_EVENT) && ++samples < Sensors::getSamplesPerPeriod(_threadDelay))
+			continue;
+
+		samples = 0;
+		Periodic::mark(&_loop);
+		step();
+	}
+
+	return (msg_t)0;
+}
 
-	float input = 0.0;
-	int16_t output = 0.0;
+/**
+ * @brief One step of the thread: reads the angles and drives towards the set points
+ */
+void Stabilization::step(void) {
+
+	// PI/9 = 20°
+	// PI/4 = 45°
 
 	uint8_t speedPsi = 0;
 	uint8_t speedTheta = 0;
-	uint8_t speedPhi = 0;
-	
-	int16_t accY = 0;
 
-	uint32_t currentTime = 0;
+	uint32_t currentTime = abs(millis() - _runStartTime);
 
-	while (!chThdShouldTerminate()) {
-		if (_isStarted) {
-
-			currentTime = abs(millis() - _runStartTime);
-
-
-			if (currentTime > 2000) {
-				currentAnglePsi = Sensors::getEulerPsi();
-				currentAngleTheta = Sensors::getEulerTheta();
-				currentAnglePhi = Sensors::getEulerPhi();
-
-			}
-
-			
-
-			//Code for New Stab implementation
-
-			_PIDOutputPsi = _filterPsi.CalculatePID(currentAnglePsi);
-			_PIDOutputTheta = _filterTheta.CalculatePID(currentAngleTheta);
-			//_PIDOutputPhi = _filterPhi.CalculatePID(currentAnglePhi);
-
-			//Perform anti-reset windup?
-
-			speedPsi = (uint8_t)min(230,abs(_PIDOutputPsi));
-			speedTheta = (uint8_t)min(230,abs(_PIDOutputTheta));
-			//speedPhi = (uint8_t)min(230,abs(_PIDOutputPhi));
-
-			if((currentTime > 2000) && abs(currentAnglePsi) > PI/9)
-			{
-				//DriveSystem::spin(_PIDOutputPhi > 0 ? RIGHT : LEFT,speedPsi);
-				if(_PIDOutputPsi > 0)
-				{
-					DriveSystem::spin(RIGHT,speedPsi);
-				}
-				else if(_PIDOutputPsi < 0)
-				{
-					DriveSystem::spin(LEFT,speedPsi);	
-				}
-			}
-
-			else if((currentTime > 2000) && abs(currentAngleTheta) > PI/9){
-				//DriveSystem::go(_PIDOutputTheta > 0 ? FORWARD : BACKWARD, speedTheta);
-				if(_PIDOutputTheta > 0)
-				{
-					DriveSystem::go(FORWARD,speedTheta);
-				}
-				else if(_PIDOutputTheta < 0)
-				{
-					DriveSystem::go(BACKWARD,speedTheta);	
-				}
-			}
-
-			//  else if ((currentTime > 2000) && abs(currentAnglePhi) > 0.40){
-			// // DriveSystem::turn(_PIDOutputPhi > 0 ? FORWARD : BACKWARD,)
-			//  	if(_PIDOutputPhi > 0){
-			//  		DriveSystem::turn(FORWARD,150,0);
-			//  	}
-			//  	else if(_PIDOutputPhi < 0){
-			//  		DriveSystem::turn(FORWARD,0,150);
-			//  	}
-				// DriveSystem::go(FORWARD,120);
-			//}
-
-			else if((currentTime > 2000) && abs(currentAnglePhi) > PI/4){
-			
-				wiggle();
-				waitMs(50);
-
-			}
-
-
-			else {
-				DriveSystem::stop();
-			}
-
-			//End of new implementation;
+	if (currentTime > 2000) {
+		Sensors::getEuler(&_currentAnglePsi, &_currentAngleTheta, &_currentAnglePhi);
+	}
+
+	//Code for New Stab implementation
+
+	_PIDOutputPsi = _filterPsi.CalculatePID(_currentAnglePsi);
+	_PIDOutputTheta = _filterTheta.CalculatePID(_currentAngleTheta);
+	//_PIDOutputPhi = _filterPhi.CalculatePID(_currentAnglePhi);
+
+	//Perform anti-reset windup?
+
+	speedPsi = (uint8_t)min(230,abs(_PIDOutputPsi));
+	speedTheta = (uint8_t)min(230,abs(_PIDOutputTheta));
+	//speedPhi = (uint8_t)min(230,abs(_PIDOutputPhi));
+
+	if((currentTime > 2000) && abs(_currentAnglePsi) > PI/9)
+	{
+		//DriveSystem::spin(_PIDOutputPhi > 0 ? RIGHT : LEFT,speedPsi);
+		if(_PIDOutputPsi > 0)
+		{
+			DriveSystem::spin(RIGHT,speedPsi);
 		}
+		else if(_PIDOutputPsi < 0)
+		{
+			DriveSystem::spin(LEFT,speedPsi);	
+		}
+	}
+
+	else if((currentTime > 2000) && abs(_currentAngleTheta) > PI/9){
+		//DriveSystem::go(_PIDOutputTheta > 0 ? FORWARD : BACKWARD, speedTheta);
+		if(_PIDOutputTheta > 0)
+		{
+			DriveSystem::go(FORWARD,speedTheta);
+		}
+		else if(_PIDOutputTheta < 0)
+		{
+			DriveSystem::go(BACKWARD,speedTheta);	
+		}
+	}
 
-		waitMs(_threadDelay);
+	//  else if ((currentTime > 2000) && abs(_currentAnglePhi) > 0.40){
+	// // DriveSystem::turn(_PIDOutputPhi > 0 ? FORWARD : BACKWARD,)
+	//  	if(_PIDOutputPhi > 0){
+	//  		DriveSystem::turn(FORWARD,150,0);
+	//  	}
+	//  	else if(_PIDOutputPhi < 0){
+	//  		DriveSystem::turn(FORWARD,0,150);
+	//  	}
+		// DriveSystem::go(FORWARD,120);
+	//}
+
+	else if((currentTime > 2000) && abs(_currentAnglePhi) > PI/4){
+	
+		wiggle();
+		waitMs(50);
 
 	}
 
-	return (msg_t)0;
+
+	else {
+		DriveSystem::stop();
+	}
 }
 
 #endif
@@ -0,0 +1,136 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file StackMonitor.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include "StackMonitor.h"
+
+/*! What THD_WA_SIZE adds to the stack a WORKING_AREA asks for: the saved contexts and the
+ * room kept for interrupts, on top of the Thread structure */
+#define STACK_MONITOR_OVERHEAD (THD_WA_SIZE(0) - sizeof(Thread))
+
+namespace StackMonitor {
+
+	// VARIABLES
+
+	typedef struct {
+		const char* name;
+		void* wsp;
+		size_t size;
+		size_t unused; // at the last update
+	} Area;
+
+	Area _areas[STACK_MONITOR_THREADS];
+	uint8_t _count = 0;
+	uint16_t _low = 0; // bit i set while area i is low
+
+	// METHODS
+
+	/**
+	 * @brief Registers the working area of a thread, once it is created
+	 * @param name what the reports call it
+	 * @param wsp the working area given to chThdCreateStatic
+	 * @param size its size, sizeof the WORKING_AREA
+	 */
+	void watch(const char* name, void* wsp, size_t size) {
+		for (uint8_t i = 0; i < _count; i++)
+			if (_areas[i].wsp == wsp)
+				return;
+
+		if (_count >= STACK_MONITOR_THREADS)
+			return;
+
+		_areas[_count].name = name;
+		_areas[_count].wsp = wsp;
+		_areas[_count].size = size;
+		_areas[_count].unused = size - sizeof(Thread);
+		_count++;
+	}
+
+	/**
+	 * @brief Measures every registered stack again
+	 * @return the number of threads that turned low since the previous update
+	 */
+	uint8_t update(void) {
+		uint8_t turnedLow = 0;
+
+		for (uint8_t i = 0; i < _count; i++) {
+			_areas[i].unused = chUnusedStack(_areas[i].wsp, _areas[i].size);
+
+			if (_areas[i].unused < STACK_MONITOR_MARGIN && !(_low & (1 << i))) {
+				_low |= 1 << i;
+				turnedLow++;
+			}
+		}
+
+		return turnedLow;
+	}
+
+	uint8_t getCount(void) {
+		return _count;
+	}
+
+	const char* getName(uint8_t index) {
+		return _areas[index].name;
+	}
+
+	/**
+	 * @brief Gets the stack of a thread, its working area less the Thread structure
+	 * @param index of the thread, in the order they were registered
+	 * @return the size (in bytes)
+	 */
+	size_t getSize(uint8_t index) {
+		return _areas[index].size - sizeof(Thread);
+	}
+
+	/**
+	 * @brief Gets the deepest the stack of a thread went, as of the last update
+	 * @param index of the thread
+	 * @return the high-water mark (in bytes)
+	 */
+	size_t getUsed(uint8_t index) {
+		return getSize(index) - _areas[index].unused;
+	}
+
+	size_t getFree(uint8_t index) {
+		return _areas[index].unused;
+	}
+
+	/**
+	 * @brief Gets the size to give the WORKING_AREA of a thread, STACK_MONITOR_MARGIN above
+	 * its high-water mark
+	 * @param index of the thread
+	 * @return the n of WORKING_AREA(name, n)
+	 */
+	size_t getSuggested(uint8_t index) {
+		size_t needed = getUsed(index) + STACK_MONITOR_MARGIN;
+
+		return needed > STACK_MONITOR_OVERHEAD ? needed - STACK_MONITOR_OVERHEAD : 0;
+	}
+
+	bool isLow(uint8_t index) {
+		return _low & (1 << index);
+	}
+
+}
@@ -0,0 +1,59 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_MODULE_STACK_MONITOR_H_
+#define LEKA_MOTI_MODULE_STACK_MONITOR_H_
+
+/**
+ * @file StackMonitor.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief High-water mark of the working area of every thread.
+ *
+ * ChibiOS fills each working area with CH_STACK_FILL_VALUE when the thread is created
+ * (CH_DBG_FILL_THREADS), so the bytes still holding it at the bottom of the stack are the
+ * ones the thread never reached. The modules register their area once created, update
+ * counts them and flags the threads left with less than STACK_MONITOR_MARGIN bytes.
+ */
+
+#include <Arduino.h>
+#include "ChibiOS_AVR.h"
+
+#define STACK_MONITOR_THREADS 12
+#define STACK_MONITOR_MARGIN  32 // free bytes under which a stack is low
+
+namespace StackMonitor {
+
+	// Threads
+	void watch(const char* name, void* wsp, size_t size);
+	uint8_t update(void);
+
+	// Reports
+	uint8_t getCount(void);
+	const char* getName(uint8_t index);
+	size_t getSize(uint8_t index);
+	size_t getUsed(uint8_t index);
+	size_t getFree(uint8_t index);
+	size_t getSuggested(uint8_t index);
+	bool isLow(uint8_t index);
+
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file SystemStats.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include "SystemStats.h"
+
+namespace SystemStats {
+
+	// VARIABLES
+
+	typedef struct {
+		Thread* thread;
+		systime_t time; // p_time at the last update
+		systime_t ticks[SYSTEM_STATS_SLOTS]; // the thread got between two updates
+	} Load;
+
+	Load _loads[SYSTEM_STATS_THREADS];
+	uint8_t _count = 0;
+
+	systime_t _lastUpdate = 0;
+	systime_t _elapsed[SYSTEM_STATS_SLOTS] = {0}; // ticks between two updates
+	uint8_t _slot = 0;
+	bool _isStarted = false;
+
+	// METHODS
+
+	/**
+	 * @brief Finds the load of a thread, the first time it is seen takes a new one
+	 * @param thread the thread
+	 * @return its load, NULL when every one is taken
+	 */
+	static Load* getLoadOf(Thread* thread) {
+		for (uint8_t i = 0; i < _count; i++)
+			if (_loads[i].thread == thread)
+				return &_loads[i];
+
+		if (_count >= SYSTEM_STATS_THREADS)
+			return NULL;
+
+		Load* load = &_loads[_count++];
+
+		memset(load, 0, sizeof(Load));
+		load->thread = thread;
+		load->time = thread->p_time;
+
+		return load;
+	}
+
+	/**
+	 * @brief Reads the ticks of every thread, to call at a steady period: the window is
+	 * SYSTEM_STATS_SLOTS of them. The first call only starts the count
+	 */
+	void update(void) {
+		systime_t now = chTimeNow();
+
+		if (_isStarted) {
+			_slot = (_slot + 1) % SYSTEM_STATS_SLOTS;
+			_elapsed[_slot] = (systime_t)(now - _lastUpdate);
+		}
+
+		for (uint8_t i = 0; i < _count; i++)
+			_loads[i].ticks[_slot] = 0;
+
+		Thread* thread = chRegFirstThread();
+
+		while (thread != NULL) {
+			Load* load = getLoadOf(thread);
+
+			if (load != NULL) {
+				if (_isStarted)
+					load->ticks[_slot] = (systime_t)(thread->p_time - load->time);
+
+				load->time = thread->p_time;
+			}
+
+			thread = chRegNextThread(thread);
+		}
+
+		_lastUpdate = now;
+		_isStarted = true;
+	}
+
+	/**
+	 * @brief Forgets the window and the threads, the next update starts the count again
+	 */
+	void reset(void) {
+		_count = 0;
+		_slot = 0;
+		_isStarted = false;
+		memset(_elapsed, 0, sizeof(_elapsed));
+	}
+
+	uint8_t getCount(void) {
+		return _count;
+	}
+
+	/**
+	 * @brief Gets the name of a thread
+	 * @param index of the thread, in the order update first saw them
+	 * @return the name it gave chRegSetThreadName, or "?"
+	 */
+	const char* getName(uint8_t index) {
+		const char* name = chRegGetThreadName(_loads[index].thread);
+
+		return name != NULL ? name : "?";
+	}
+
+	static uint32_t getElapsed(void) {
+		uint32_t elapsed = 0;
+
+		for (uint8_t i = 0; i < SYSTEM_STATS_SLOTS; i++)
+			elapsed += _elapsed[i];
+
+		return elapsed;
+	}
+
+	/**
+	 * @brief Gets the share of the CPU a thread got over the window
+	 * @param index of the thread
+	 * @return the load (in per mille)
+	 */
+	uint16_t getLoad(uint8_t index) {
+		uint32_t ticks = 0;
+		uint32_t elapsed = getElapsed();
+
+		for (uint8_t i = 0; i < SYSTEM_STATS_SLOTS; i++)
+			ticks += _loads[index].ticks[i];
+
+		if (elapsed == 0)
+			return 0;
+
+		return min(ticks * 1000 / elapsed, (uint32_t)1000);
+	}
+
+	/**
+	 * @brief Gets the load of the idle thread, what the other threads leave
+	 * @return the load (in per mille), 0 where there is no idle thread (host)
+	 */
+	uint16_t getIdleLoad(void) {
+		for (uint8_t i = 0; i < _count; i++)
+			if (_loads[i].thread->p_prio == IDLEPRIO)
+				return getLoad(i);
+
+		return 0;
+	}
+
+	/**
+	 * @brief Gets how long the window covers, it grows up to SYSTEM_STATS_SLOTS updates
+	 * @return the window (in ms)
+	 */
+	uint32_t getWindow(void) {
+		return getElapsed() * 1000 / CH_FREQUENCY;
+	}
+
+}
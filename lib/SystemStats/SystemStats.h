@@ -0,0 +1,58 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_MODULE_SYSTEM_STATS_H_
+#define LEKA_MOTI_MODULE_SYSTEM_STATS_H_
+
+/**
+ * @file SystemStats.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief CPU load of every thread, idle included, over a sliding window.
+ *
+ * With CH_DBG_THREADS_PROFILING, ChibiOS adds one to p_time of the thread running at each
+ * system tick. update walks the registry and keeps what each thread got since the previous
+ * update, for the last SYSTEM_STATS_SLOTS updates: the load of a thread is its share of the
+ * ticks of that window. The threads are named by chRegSetThreadName, the module threads
+ * name themselves when they start.
+ */
+
+#include <Arduino.h>
+#include "ChibiOS_AVR.h"
+
+#define SYSTEM_STATS_THREADS 12
+#define SYSTEM_STATS_SLOTS   5  // updates the window covers
+
+namespace SystemStats {
+
+	// Sampling
+	void update(void);
+	void reset(void);
+
+	// Reports
+	uint8_t getCount(void);
+	const char* getName(uint8_t index);
+	uint16_t getLoad(uint8_t index);
+	uint16_t getIdleLoad(void);
+	uint32_t getWindow(void);
+
+}
+
+#endif
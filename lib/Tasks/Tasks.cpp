@@ -0,0 +1,299 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+/**
+ * @file Tasks.cpp
+ * @author Ladislas de Toldi
+ * @version 1.0
+ */
+
+#include "Tasks.h"
+
+/*! Events of the tasks thread, the listeners of the tasks take the next ones */
+#define TASKS_WAKE_EVENT EVENT_MASK(0) // a task was started, stopped or woken
+
+/*! Longest the thread sleeps at once (in ms), MS2ST of more would not fit a systime_t */
+#define TASKS_MAX_SLEEP 10000
+
+namespace Tasks {
+
+	// VARIABLES
+
+	// Thread
+	static WORKING_AREA(tasksThreadArea, TASKS_THREAD_STACK);
+	Thread* _thread = NULL;
+	bool _isInitialized = false;
+
+	// Tasks
+	Task* _tasks = NULL;
+	Task* _lastTask = NULL;
+	uint8_t _listeners = 0;
+
+	// Misc
+	MUTEX_DECL(_tasksMutex);
+
+	// METHODS
+
+	static void signal(void) {
+		if (_thread != NULL)
+			chEvtSignal(_thread, TASKS_WAKE_EVENT);
+	}
+
+	/**
+	 * @brief Starts the tasks thread, the tasks can be created before
+	 * @param priority of the thread, every task runs at it
+	 */
+	void init(tprio_t priority) {
+		if (!_isInitialized) {
+			_isInitialized = true;
+
+			_thread = chThdCreateStatic(tasksThreadArea, sizeof(tasksThreadArea),
+					priority, thread, NULL);
+
+			StackMonitor::watch("tasks", tasksThreadArea, sizeof(tasksThreadArea));
+		}
+	}
+
+	/**
+	 * @brief Adds a task, stopped
+	 * @param task the task, it must outlive the thread (static)
+	 * @param name what it is called
+	 * @param tick called at each deadline, see Tasks.h
+	 */
+	void create(Task* task, const char* name, TaskTick tick) {
+		memset(task, 0, sizeof(Task));
+
+		task->name = name;
+		task->tick = tick;
+
+		chMtxLock(&_tasksMutex);
+
+		if (_lastTask != NULL)
+			_lastTask->next = task;
+		else
+			_tasks = task;
+
+		_lastTask = task;
+
+		chMtxUnlock();
+	}
+
+	/**
+	 * @brief Wakes a task each time an event source is broadcast
+	 * @param task the task
+	 * @param source the event source
+	 * @return false if TASKS_LISTENERS tasks already listen
+	 */
+	bool listen(Task* task, EventSource* source) {
+		bool ok = false;
+
+		chMtxLock(&_tasksMutex);
+
+		if (task->mask == 0 && _listeners < TASKS_LISTENERS) {
+			task->source = source;
+			task->mask = EVENT_MASK(1 + _listeners++);
+			ok = true;
+		}
+
+		chMtxUnlock();
+
+		signal();
+
+		return ok;
+	}
+
+	/**
+	 * @brief Starts a task, from the beginning of its tick
+	 * @param task the task
+	 */
+	void start(Task* task) {
+		chMtxLock(&_tasksMutex);
+
+		if (!task->isStarted) {
+			task->isStarted = true;
+			task->line = 0;
+			task->isWaiting = false;
+			task->isWoken = false;
+			task->isForever = false;
+			task->deadline = millis();
+		}
+
+		chMtxUnlock();
+
+		signal();
+	}
+
+	/**
+	 * @brief Stops a task, its tick is not called again until it starts
+	 * @param task the task
+	 */
+	void stop(Task* task) {
+		chMtxLock(&_tasksMutex);
+
+		task->isStarted = false;
+		task->line = 0;
+
+		chMtxUnlock();
+
+		signal();
+	}
+
+	/**
+	 * @brief Wakes a task waiting in TASK_WAIT, else keeps the wake for its next one
+	 * @param task the task
+	 */
+	void wake(Task* task) {
+		chMtxLock(&_tasksMutex);
+
+		if (task->isWaiting) {
+			task->isWaiting = false;
+			task->isForever = false;
+			task->deadline = millis();
+		}
+		else {
+			task->isWoken = true;
+		}
+
+		chMtxUnlock();
+
+		signal();
+	}
+
+	/**
+	 * @brief Forgets a wake kept for the next TASK_WAIT
+	 * @param task the task
+	 */
+	void clearWake(Task* task) {
+		chMtxLock(&_tasksMutex);
+
+		task->isWoken = false;
+
+		chMtxUnlock();
+	}
+
+	bool isStarted(Task* task) {
+		return task->isStarted;
+	}
+
+	/**
+	 * @brief Registers the listeners of the tasks, on the tasks thread as ChibiOS wants
+	 */
+	static void registerListeners(void) {
+		chMtxLock(&_tasksMutex);
+
+		for (Task* task = _tasks; task != NULL; task = task->next) {
+			if (task->mask != 0 && !task->isListening) {
+				chEvtRegisterMask(task->source, &task->listener, task->mask);
+				task->isListening = true;
+			}
+		}
+
+		chMtxUnlock();
+	}
+
+	/**
+	 * @brief Gets the task with the earliest deadline, the first created of them on a tie
+	 * @param now millis()
+	 * @return the task, NULL when every task is stopped or waits for a wake
+	 */
+	static Task* getNext(uint32_t now) {
+		Task* next = NULL;
+
+		chMtxLock(&_tasksMutex);
+
+		for (Task* task = _tasks; task != NULL; task = task->next)
+			if (task->isStarted && !task->isForever &&
+					(next == NULL || (int32_t)(task->deadline - now) < (int32_t)(next->deadline - now)))
+				next = task;
+
+		chMtxUnlock();
+
+		return next;
+	}
+
+	/**
+	 * @brief Calls the tick of a task and sets its next deadline
+	 * @param task the task
+	 * @param now millis(), the deadline counts from it
+	 */
+	static void run(Task* task, uint32_t now) {
+		chMtxLock(&_tasksMutex);
+
+		task->isWaiting = false;
+
+		chMtxUnlock();
+
+		uint32_t delay = task->tick(task);
+
+		chMtxLock(&_tasksMutex);
+
+		if (delay == TASK_DONE)
+			task->isStarted = false;
+
+		if (!task->isStarted) {
+			task->line = 0;
+		}
+		else if (task->isWakeable && task->isWoken) {
+			task->isWoken = false;
+			task->isForever = false;
+			task->deadline = now;
+		}
+		else {
+			task->isWaiting = task->isWakeable;
+			task->isForever = delay == TASK_FOREVER;
+			task->deadline = now + delay;
+		}
+
+		chMtxUnlock();
+	}
+
+}
+
+/**
+ * @brief Tasks thread: runs the task whose deadline came, else sleeps until the next one
+ * or a wake
+ */
+msg_t Tasks::thread(void* arg) {
+
+	(void) arg;
+	chRegSetThreadName("tasks");
+
+	while (!chThdShouldTerminate()) {
+
+		registerListeners();
+
+		uint32_t now = millis();
+		Task* task = getNext(now);
+
+		if (task != NULL && (int32_t)(task->deadline - now) <= 0) {
+			run(task, now);
+			continue;
+		}
+
+		systime_t timeout = task != NULL ? MS2ST(min(task->deadline - now, (uint32_t)TASKS_MAX_SLEEP)) : TIME_INFINITE;
+		eventmask_t events = chEvtWaitAnyTimeout(ALL_EVENTS, timeout);
+
+		for (Task* listener = _tasks; listener != NULL; listener = listener->next)
+			if (listener->mask & events)
+				wake(listener);
+	}
+
+	return (msg_t)0;
+}
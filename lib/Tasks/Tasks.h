@@ -0,0 +1,104 @@
+/*
+   Copyright (C) 2013-2014 Ladislas de Toldi <ladislas at weareleka dot com>
+   and Leka <http://weareleka.com>
+
+   This file is part of Moti, a spherical robotic smart toy for autistic children.
+
+   Moti is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Moti is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Moti. If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef LEKA_MOTI_MODULE_TASKS_H_
+#define LEKA_MOTI_MODULE_TASKS_H_
+
+/**
+ * @file Tasks.h
+ * @author Ladislas de Toldi
+ * @version 1.0
+ * @brief Many lightweight tasks on one ChibiOS thread, the earliest deadline first.
+ *
+ * A task is a tick function the tasks thread calls when its deadline comes. The tick returns
+ * how long to wait before the next call (in ms), TASK_FOREVER to wait for Tasks::wake or
+ * TASK_DONE to stop. Between TASK_BEGIN and TASK_END a tick is a protothread: TASK_WAIT_MS
+ * returns from it and the next tick resumes right after, so a thread loop with waitMs
+ * becomes a tick with TASK_WAIT_MS. As in any protothread, the locals of a tick do not
+ * survive a wait (keep that state in the namespace) and are declared before TASK_BEGIN, the
+ * waits cannot be in a function the tick calls nor in a switch of its own, and a tick must
+ * never block: it holds every other task while it runs.
+ *
+ * TASK_WAIT also returns early when the task is woken, by Tasks::wake or a broadcast of
+ * the event source it listens to: a wake that comes while the task runs or sleeps in
+ * TASK_WAIT_MS is kept for its next TASK_WAIT, as a ChibiOS event would.
+ */
+
+#include <Arduino.h>
+#include "ChibiOS_AVR.h"
+#include "StackMonitor.h"
+
+#define TASK_FOREVER 0xFFFFFFFFUL // wait for a wake
+#define TASK_DONE    0xFFFFFFFEUL // stop the task
+
+/*! Event sources the tasks can listen to, one event flag each next to the wake of the thread */
+#define TASKS_LISTENERS 7
+
+/*! Size of the tasks thread's working area, the n of its WORKING_AREA (see StackMonitor) */
+#ifndef TASKS_THREAD_STACK
+#define TASKS_THREAD_STACK 400
+#endif
+
+/*! Protothread of a tick */
+#define TASK_BEGIN(task) switch ((task)->line) { case 0:
+#define TASK_END(task) } (task)->line = 0; return TASK_DONE
+#define TASK_WAIT_MS(task, ms) do { (task)->line = __LINE__; (task)->isWakeable = false; return (ms); \
+	case __LINE__:; } while (0)
+#define TASK_WAIT(task, ms) do { (task)->line = __LINE__; (task)->isWakeable = true; return (ms); \
+	case __LINE__:; } while (0)
+
+typedef struct Task Task;
+typedef uint32_t (*TaskTick)(Task* task);
+
+struct Task {
+	const char* name;
+	TaskTick tick;
+	EventSource* source;    // wakes the task when broadcast, NULL for none
+	uint16_t line;          // where the tick resumes
+	uint32_t deadline;      // millis() of the next tick
+	bool isStarted;
+	bool isWakeable;        // the tick returned from TASK_WAIT
+	bool isWaiting;         // in TASK_WAIT, a wake makes it due
+	bool isWoken;           // a wake kept for the next TASK_WAIT
+	bool isForever;         // waits for a wake only
+	eventmask_t mask;       // of its listener, 0 for none
+	bool isListening;
+	EventListener listener;
+	Task* next;             // in the order they were created
+};
+
+namespace Tasks {
+
+	// Thread
+	msg_t thread(void* arg);
+	void init(tprio_t priority = NORMALPRIO);
+
+	// Tasks
+	void create(Task* task, const char* name, TaskTick tick);
+	bool listen(Task* task, EventSource* source);
+	void start(Task* task);
+	void stop(Task* task);
+	void wake(Task* task);
+	void clearWake(Task* task);
+	bool isStarted(Task* task);
+
+}
+
+#endif
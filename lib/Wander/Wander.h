@@ -3,41 +3,47 @@
 
 #include <Arduino.h>
 #include "ChibiOS_AVR.h"
+#include "Tasks.h"
 #include "Sensors.h"
 #include "Motion.h"
 #include "DriveSystem.h"
 #include "Light.h"
+#include "Moti.h"
+
+/*! How long a move goes on before being stuck counts (in ms) */
+#define WANDER_STUCK_GUARD 2000
 
 namespace Wander {
 
-	// Thread methods
-	static WORKING_AREA(behaviorThreadArea, 256);
-	static msg_t thread(void* arg);
+	// Task methods
+	static uint32_t tick(Task* task);
 
-	void init(void* arg = NULL, tprio_t priority = NORMALPRIO);
+	void init(void);
 	void start(void);
 	void stop(void);
-	uint16_t _threadDelay = 50;
 
 	// Variables
+	Task _task;
 	bool _isInitialized = false;
 	bool _isStarted = false;
 
 	bool _isMoving = false;
+	uint32_t _moveStart = 0;
 
 	// Misc
 	MUTEX_DECL(_behaviorMutex);
 
 }
 
-void Wander::init(void* arg, tprio_t priority) {
+void Wander::init(void) {
 	if (!_isInitialized) {
 		_isInitialized = true;
 		_isStarted = false;
 
-		(void)chThdCreateStatic(behaviorThreadArea,
-				sizeof(behaviorThreadArea),
-				priority, thread, arg);
+		Tasks::init();
+		Tasks::create(&_task, "wander", tick);
+		Tasks::listen(&_task, Moti::getStateEvent());
+		Tasks::start(&_task);
 	}
 }
 
@@ -48,6 +54,8 @@ void Wander::start(void) {
 	_isMoving = false;
 
 	chMtxUnlock();
+
+	Tasks::wake(&_task);
 }
 
 void Wander::stop(void) {
@@ -57,53 +65,56 @@ void Wander::stop(void) {
 	_isMoving = false;
 
 	chMtxUnlock();
-}
 
-msg_t Wander::thread(void* arg) {
+	Tasks::wake(&_task);
+}
 
-	(void) arg;
+uint32_t Wander::tick(Task* task) {
 
-	uint16_t moveStart = 0;
+	uint32_t elapsed;
 
-	while (!chThdShouldTerminate()) {
+	TASK_BEGIN(task);
 
-		if (_isStarted) {
+	while (TRUE) {
 
-			if (!_isMoving) {
-				chMtxLock(&_behaviorMutex);
-				_isMoving = true;
-				moveStart = millis();
-				DriveSystem::go(FORWARD, 150);
-				chMtxUnlock();
-			}
+		if (!_isStarted) {
+			TASK_WAIT(task, TASK_FOREVER);
+			continue;
+		}
 
-			waitMs(_threadDelay);
+		if (!_isMoving) {
+			chMtxLock(&_behaviorMutex);
+			_isMoving = true;
+			_moveStart = millis();
+			DriveSystem::go(FORWARD, 150);
+			chMtxUnlock();
+		}
 
-			if (Moti::isStuck() && (moveStart + 2000 < millis())) {
+		// Until Moti's stuck changes, or the guard ends if it is still on
+		elapsed = millis() - _moveStart;
 
-				DriveSystem::stop();
+		TASK_WAIT(task, elapsed < WANDER_STUCK_GUARD ? WANDER_STUCK_GUARD - elapsed + 1 : TASK_FOREVER);
 
-				waitMs(1000);
+		if (_isStarted && Moti::isStuck() && (_moveStart + WANDER_STUCK_GUARD < millis())) {
 
-				Motion::spinDeg(rand() % 2 == 0 ? LEFT : RIGHT, 125, 100);
+			DriveSystem::stop();
 
-				waitMs(1000);
+			TASK_WAIT_MS(task, 1000);
 
-				Motion::stop(0);
+			Motion::spinDeg(rand() % 2 == 0 ? LEFT : RIGHT, 125, 100);
 
-				waitMs(1000);
+			TASK_WAIT_MS(task, 1000);
 
-				_isMoving = false;
-			}
+			Motion::stop(0);
 
-			waitMs(_threadDelay);
+			TASK_WAIT_MS(task, 1000);
 
+			_isMoving = false;
 		}
 
-		waitMs(_threadDelay);
 	}
 
-	return (msg_t)0;
+	TASK_END(task);
 }
 
 #endif
@@ -3,29 +3,31 @@
 
 #include <Arduino.h>
 #include "ChibiOS_AVR.h"
+#include "Tasks.h"
 #include "Moti.h"
 #include "Led.h"
 #include "Color.h"
 
 namespace ColorChanger {
 
-	// Thread methods
-	static WORKING_AREA(behaviorThreadArea, 256);
-	static msg_t thread(void * arg);
+	// Task methods
+	static uint32_t tick(Task* task);
 	
-	//Thread
-	void init(void* arg = NULL, tprio_t priority = NORMALPRIO);
+	//Task
+	void init(void);
 	void start(void);
 	void stop(void);
 	uint16_t _threadDelay = 50;
 
 	//Methods
-	void FadeFromBlack(uint8_t r, uint8_t g, uint8_t b);
-	void FadeToBlack(uint8_t r, uint8_t g, uint8_t b);
-	void FadeFromWhite(uint8_t r, uint8_t g, uint8_t b);
-	void FadeToWhite(uint8_t r, uint8_t g, uint8_t b);
+	void FadeFromBlack(uint8_t r, uint8_t g, uint8_t b, uint8_t i);
+	void FadeToBlack(uint8_t r, uint8_t g, uint8_t b, uint8_t i);
+	void FadeFromWhite(uint8_t r, uint8_t g, uint8_t b, uint8_t i);
+	void FadeToWhite(uint8_t r, uint8_t g, uint8_t b, uint8_t i);
    
 	// Variables
+	Task _task;
+	uint8_t _step = 0; // of the fade going on, 0 to 100
 	bool _isInitialized = false;
 	bool _isStarted = false;
 
@@ -38,14 +40,14 @@ namespace ColorChanger {
 
 
 
-void ColorChanger::init(void* arg, tprio_t priority) {
+void ColorChanger::init(void) {
 	if (!_isInitialized) {
 		_isInitialized = true;
 		_isStarted = false;
 
-		(void)chThdCreateStatic(behaviorThreadArea,
-				sizeof(behaviorThreadArea),
-				priority, thread, arg);
+		Tasks::init();
+		Tasks::create(&_task, "colorchanger", tick);
+		Tasks::start(&_task);
 	}
 }
 
@@ -64,71 +66,75 @@ void ColorChanger::stop(void) {
 }
 
 
-void ColorChanger::FadeFromBlack(uint8_t r, uint8_t g, uint8_t b){
+void ColorChanger::FadeFromBlack(uint8_t r, uint8_t g, uint8_t b, uint8_t i){
 	uint8_t myShadeRed, myShadeBlue, myShadeGreen;
-	Serial.println("Fade from Black");
-	for (int i=0; i<101; i++){
-		myShadeRed= r *i*0.01;
-		myShadeGreen= g *i*0.01;
-		myShadeBlue=b *i*0.01;
-		myLed.shine((myShadeRed), (myShadeGreen), (myShadeBlue));
-		waitMs(50);
-	}
+	if (i == 0)
+		Serial.println("Fade from Black");
+	myShadeRed= r *i*0.01;
+	myShadeGreen= g *i*0.01;
+	myShadeBlue=b *i*0.01;
+	myLed.shine((myShadeRed), (myShadeGreen), (myShadeBlue));
 }
 
-void ColorChanger::FadeToBlack(uint8_t r, uint8_t g, uint8_t b){
+void ColorChanger::FadeToBlack(uint8_t r, uint8_t g, uint8_t b, uint8_t i){
 	uint8_t myShadeRed, myShadeBlue, myShadeGreen;
-	Serial.println("Fade to Black");
-	for (int i=0; i<101; i++){
-		myShadeRed=r *(100-i)*0.01;
-		myShadeGreen=g *(100-i)*0.01;
-		myShadeBlue=b *(100-i)*0.01;
-		myLed.shine((myShadeRed), (myShadeGreen), (myShadeBlue));
-		waitMs(50);
-	}
+	if (i == 0)
+		Serial.println("Fade to Black");
+	myShadeRed=r *(100-i)*0.01;
+	myShadeGreen=g *(100-i)*0.01;
+	myShadeBlue=b *(100-i)*0.01;
+	myLed.shine((myShadeRed), (myShadeGreen), (myShadeBlue));
 }
 
-void ColorChanger::FadeFromWhite(uint8_t r, uint8_t g, uint8_t b){
+void ColorChanger::FadeFromWhite(uint8_t r, uint8_t g, uint8_t b, uint8_t i){
 	uint8_t myShadeRed, myShadeBlue, myShadeGreen;
-	Serial.println("Fade from white");
-	for (int i=0; i<101; i++){
-		myShadeRed = r + ((255- r)* (100-i) *0.01);
-		myShadeGreen=g+((255- g)* (100-i) *0.01);
-		myShadeBlue=b+((255- b)* (100-i) *0.01);
-		myLed.shine((myShadeRed), (myShadeGreen), (myShadeBlue));
-		waitMs(50);
-	}
+	if (i == 0)
+		Serial.println("Fade from white");
+	myShadeRed = r + ((255- r)* (100-i) *0.01);
+	myShadeGreen=g+((255- g)* (100-i) *0.01);
+	myShadeBlue=b+((255- b)* (100-i) *0.01);
+	myLed.shine((myShadeRed), (myShadeGreen), (myShadeBlue));
 }
 
-void ColorChanger::FadeToWhite(uint8_t r, uint8_t g, uint8_t b){
+void ColorChanger::FadeToWhite(uint8_t r, uint8_t g, uint8_t b, uint8_t i){
 	uint8_t myShadeRed, myShadeBlue, myShadeGreen;
+	if (i == 0)
 		Serial.println("Fade to White");
-	for (int i=0; i<101; i++){
-		myShadeRed = r + ((255- r )* i *0.01);
-		myShadeGreen= g +((255- g )* i *0.01);
-		myShadeBlue= b +((255- b )* i *0.01);
-		myLed.shine((myShadeRed), (myShadeGreen), (myShadeBlue));
-		waitMs(50);
-	}
+	myShadeRed = r + ((255- r )* i *0.01);
+	myShadeGreen= g +((255- g )* i *0.01);
+	myShadeBlue= b +((255- b )* i *0.01);
+	myLed.shine((myShadeRed), (myShadeGreen), (myShadeBlue));
 }
 
-msg_t ColorChanger::thread(void* arg) {
+uint32_t ColorChanger::tick(Task* task) {
 
-	(void) arg;
+	TASK_BEGIN(task);
  	// mettre fonction ici
-	while (!chThdShouldTerminate()) {
+	while (TRUE) {
 
 		if (_isStarted) {
-		FadeToWhite(176,202,18);
-		FadeFromWhite(231,15,96);
-		FadeToBlack(240,42,0);
-		FadeFromBlack(97,174,214);
+			for (_step = 0; _step < 101; _step++) {
+				FadeToWhite(176,202,18, _step);
+				TASK_WAIT_MS(task, 50);
+			}
+			for (_step = 0; _step < 101; _step++) {
+				FadeFromWhite(231,15,96, _step);
+				TASK_WAIT_MS(task, 50);
+			}
+			for (_step = 0; _step < 101; _step++) {
+				FadeToBlack(240,42,0, _step);
+				TASK_WAIT_MS(task, 50);
+			}
+			for (_step = 0; _step < 101; _step++) {
+				FadeFromBlack(97,174,214, _step);
+				TASK_WAIT_MS(task, 50);
+			}
 		}
 
-		waitMs(_threadDelay);
+		TASK_WAIT_MS(task, _threadDelay);
 	}
 
-	return (msg_t)0;
+	TASK_END(task);
 }
 
 #endif
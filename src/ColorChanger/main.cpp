@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <Wire.h>
 
 #include "Moti.h"
 #include "ColorChanger.h"
@@ -31,7 +30,6 @@ int main(void) {
 	// Serial1.begin(115200);
 	// while (!Serial1);
 
-	Wire.begin();
 	// delay(5000);
 
 	chBegin(mainThread);
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include "ChibiOS_AVR.h"
+#include "Tasks.h"
 #include "Sensors.h"
 // #include "Motion.h"
 #include "DriveSystem.h"
@@ -10,16 +11,16 @@
 
 namespace Mover {
 
-	// Thread methods
-	static WORKING_AREA(behaviorThreadArea, 256);
-	static msg_t thread(void* arg);
+	// Task methods
+	static uint32_t tick(Task* task);
 
-	void init(void* arg = NULL, tprio_t priority = NORMALPRIO);
+	void init(void);
 	void start(void);
 	void stop(void);
 	uint16_t _threadDelay = 50;
 
 	// Variables
+	Task _task;
 	bool _isInitialized = false;
 	bool _isStarted = false;
 
@@ -28,14 +29,14 @@ namespace Mover {
 
 }
 
-void Mover::init(void* arg, tprio_t priority) {
+void Mover::init(void) {
 	if (!_isInitialized) {
 		_isInitialized = true;
 		_isStarted = false;
 
-		(void)chThdCreateStatic(behaviorThreadArea,
-				sizeof(behaviorThreadArea),
-				priority, thread, arg);
+		Tasks::init();
+		Tasks::create(&_task, "mover", tick);
+		Tasks::start(&_task);
 	}
 }
 
@@ -55,30 +56,30 @@ void Mover::stop(void) {
 	chMtxUnlock();
 }
 
-msg_t Mover::thread(void* arg) {
+uint32_t Mover::tick(Task* task) {
 
-	(void) arg;
+	TASK_BEGIN(task);
 
-	while (!chThdShouldTerminate()) {
+	while (TRUE) {
 
 		if (_isStarted) {
 
 			Serial.println(F("M1"));
 			DriveSystem::go(FORWARD, 190);
-			waitMs(10000);
+			TASK_WAIT_MS(task, 10000);
 			DriveSystem::stop();
-			waitMs(5000);
+			TASK_WAIT_MS(task, 5000);
 			DriveSystem::spin(LEFT, 190);
-			waitMs(500);
+			TASK_WAIT_MS(task, 500);
 			DriveSystem::stop();
-			waitMs(5000);
+			TASK_WAIT_MS(task, 5000);
 			Serial.println(F("M2"));
 		}
 
-		waitMs(_threadDelay);
+		TASK_WAIT_MS(task, _threadDelay);
 	}
 
-	return (msg_t)0;
+	TASK_END(task);
 }
 
 #endif
@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <Wire.h>
 
 #include "Sensors.h"
 #include "Motion.h"
@@ -68,7 +67,6 @@ int main(void) {
 	// Serial1.begin(115200);
 	// while (!Serial1);
 
-	Wire.begin();
 	delay(500);
 
 	chBegin(mainThread);
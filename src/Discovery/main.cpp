@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <Wire.h>
 
 #include "Motion.h"
 #include "Moti.h"
@@ -44,7 +43,6 @@ int main(void) {
 	// Serial1.begin(115200);
 	// while (!Serial1);
 
-	Wire.begin();
 	delay(5000);
 
 	chBegin(mainThread);
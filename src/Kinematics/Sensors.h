@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include "ChibiOS_AVR.h"
+#include "Tasks.h"
 #include "Sensors.h"
 #include "DriveSystem.h"
 #include "Light.h"
@@ -10,16 +11,16 @@
 
 namespace Spinner {
 
-	// Thread methods
-	static WORKING_AREA(behaviorThreadArea, 256);
-	static msg_t thread(void* arg);
+	// Task methods
+	static uint32_t tick(Task* task);
 
-	void init(void* arg = NULL, tprio_t priority = NORMALPRIO);
+	void init(void);
 	void start(void);
 	void stop(void);
 	uint16_t _threadDelay = 50;
 
 	// Variables
+	Task _task;
 	bool _isInitialized = false;
 	bool _isStarted = false;
 
@@ -28,14 +29,14 @@ namespace Spinner {
 
 }
 
-void Spinner::init(void* arg, tprio_t priority) {
+void Spinner::init(void) {
 	if (!_isInitialized) {
 		_isInitialized = true;
 		_isStarted = false;
 
-		(void)chThdCreateStatic(behaviorThreadArea,
-				sizeof(behaviorThreadArea),
-				priority, thread, arg);
+		Tasks::init();
+		Tasks::create(&_task, "spinner", tick);
+		Tasks::start(&_task);
 	}
 }
 
@@ -55,25 +56,25 @@ void Spinner::stop(void) {
 	chMtxUnlock();
 }
 
-msg_t Spinner::thread(void* arg) {
+uint32_t Spinner::tick(Task* task) {
 
-	(void) arg;
+	TASK_BEGIN(task);
 
-	while (!chThdShouldTerminate()) {
+	while (TRUE) {
 
 		if (_isStarted) {
 
 			Serial.println(F("S1"));
 			DriveSystem::stop();
-			waitMs(1000);
+			TASK_WAIT_MS(task, 1000);
 			DriveSystem::spin(LEFT, 190);
-			waitMs(random(2000, 5000));
+			TASK_WAIT_MS(task, random(2000, 5000));
 			DriveSystem::stop();
-			waitMs(random(2000, 5000));
+			TASK_WAIT_MS(task, random(2000, 5000));
 			DriveSystem::spin(RIGHT, 190);
-			waitMs(random(2000, 5000));
+			TASK_WAIT_MS(task, random(2000, 5000));
 			DriveSystem::stop();
-			waitMs(2000);
+			TASK_WAIT_MS(task, 2000);
 
 			stop();
 
@@ -81,10 +82,10 @@ msg_t Spinner::thread(void* arg) {
 			Serial.println(F("S2"));
 		}
 
-		waitMs(_threadDelay);
+		TASK_WAIT_MS(task, _threadDelay);
 	}
 
-	return (msg_t)0;
+	TASK_END(task);
 }
 
 #endif
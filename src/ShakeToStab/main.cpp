@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <Wire.h>
 
 #include "Motion.h"
 #include "Moti.h"
@@ -76,7 +75,6 @@ int main(void) {
 	// Serial1.begin(115200);
 	// while (!Serial1);
 
-	Wire.begin();
 	delay(500);
 
 	chBegin(mainThread);
@@ -3,8 +3,25 @@
 
 #include <Arduino.h>
 #include "ChibiOS_AVR.h"
+#include "StackMonitor.h"
 #include "Moti.h"
 
+/*! Events of the Arbitrer thread */
+#define ARBITRER_STATE_EVENT EVENT_MASK(0) // a Moti state changed
+#define ARBITRER_WAKE_EVENT  EVENT_MASK(1) // stop
+
+/*! How long cruising goes on before being stuck counts, and the heart color while cruising (in ms) */
+#define ARBITRER_STUCK_GUARD 1000
+#define ARBITRER_CRUISE_FADE 1500
+
+/*! Polling period of the states that wait on Motion (in ms) */
+#define ARBITRER_POLL_PERIOD 50
+
+/*! Size of the Arbitrer thread's working area, the n of its WORKING_AREA (see StackMonitor) */
+#ifndef ARBITRER_THREAD_STACK
+#define ARBITRER_THREAD_STACK 512
+#endif
+
 
 typedef enum {
 	SLEEPING = 0x01,
@@ -24,10 +41,11 @@ namespace Arbitrer {
 }
 
 
-static WORKING_AREA(arbitrerThreadArea, 512);
+static WORKING_AREA(arbitrerThreadArea, ARBITRER_THREAD_STACK);
 
 namespace Arbitrer {
 
+	Thread* _thread = NULL;
 	bool _isStarted = false;
 	bool _isRunning = false;
 	bool _isCruising = false;
@@ -70,6 +88,9 @@ namespace Arbitrer {
 		}
 
 		chMtxUnlock();
+
+		if (_thread != NULL)
+			chEvtSignal(_thread, ARBITRER_WAKE_EVENT);
 	}
 
 
@@ -77,14 +98,40 @@ namespace Arbitrer {
 		if (!_isStarted) {
 			_isStarted = true;
 
-			(void)chThdCreateStatic(arbitrerThreadArea, sizeof(arbitrerThreadArea),
+			_thread = chThdCreateStatic(arbitrerThreadArea, sizeof(arbitrerThreadArea),
 					priority, thread, arg);
+
+			StackMonitor::watch("arbitrer", arbitrerThreadArea, sizeof(arbitrerThreadArea));
 		}
 	}
 
+	/**
+	 * @brief Waits while cruising: until a Moti state changes or stop, at the latest when the
+	 * stuck guard or the heart fade ends
+	 */
+	void waitCruising(uint32_t cruiseStart, uint32_t fadeEnd) {
+		uint32_t now = millis();
+		uint32_t wakeAt = fadeEnd;
+
+		if (now < cruiseStart + ARBITRER_STUCK_GUARD)
+			wakeAt = min(wakeAt, cruiseStart + ARBITRER_STUCK_GUARD + 1);
+
+		// Light may take a few ms to see the fade end
+		systime_t timeout = wakeAt > now ? MS2ST(wakeAt - now) : MS2ST(ARBITRER_POLL_PERIOD);
+
+		(void)chEvtWaitAnyTimeout(ARBITRER_STATE_EVENT | ARBITRER_WAKE_EVENT, timeout);
+	}
+
 	msg_t thread(void* arg) {
-		uint16_t spinStart = 0;
-		uint16_t cruiseStart = 0;
+		chRegSetThreadName("arbitrer");
+
+		uint32_t spinStart = 0;
+		uint32_t cruiseStart = 0;
+		uint32_t fadeEnd = 0;
+
+		EventListener stateListener;
+
+		chEvtRegisterMask(Moti::getStateEvent(), &stateListener, ARBITRER_STATE_EVENT);
 
 		while (!chThdShouldTerminate()) {
 			chSemWait(&_sem);
@@ -114,8 +161,10 @@ namespace Arbitrer {
 						break;
 
 					case CRUISING:
-						if (Light::getState(HEART) == INACTIVE)
-							Light::fade(HEART, Color::GreenPure, Color::GreenPure, 1500);
+						if (Light::getState(HEART) == INACTIVE) {
+							Light::fade(HEART, Color::GreenPure, Color::GreenPure, ARBITRER_CRUISE_FADE);
+							fadeEnd = millis() + ARBITRER_CRUISE_FADE;
+						}
 
 						chMtxLock(&_arbitrerMutex);
 
@@ -128,7 +177,7 @@ namespace Arbitrer {
 						chMtxUnlock();
 
 
-						if (Moti::isStuck() && (cruiseStart + 1000 < millis())) {
+						if (Moti::isStuck() && (cruiseStart + ARBITRER_STUCK_GUARD < millis())) {
 							Motion::stop(0);
 							while ((_state == CRUISING) && (Motion::getState() != NONE))
 								waitMs(15);
@@ -164,7 +213,11 @@ namespace Arbitrer {
 						break;
 				}
 
-				waitMs(50);
+				// Cruising waits for Moti, the other states poll Motion, which has no event
+				if (_state == CRUISING && _isCruising)
+					waitCruising(cruiseStart, fadeEnd);
+				else
+					waitMs(ARBITRER_POLL_PERIOD);
 			}
 		}
 
@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <Wire.h>
 
 #include "Motion.h"
 #include "Moti.h"
@@ -9,6 +8,14 @@
 
 #include "Arbitrer.h"
 #include "Stabilization.h"
+#include "StackMonitor.h"
+#include "SystemStats.h"
+
+/*! How often the stacks are measured again, a LOW report is sent as soon as one runs short */
+#define STACK_CHECK_PERIOD 1000
+
+/*! How often the thread loads are sampled and sent, SystemStats averages them over SYSTEM_STATS_SLOTS */
+#define LOAD_REPORT_PERIOD 1000
 
 void mainThread() {
 	Serial1.println(F("Starting..."));
@@ -23,6 +30,8 @@ void mainThread() {
 
 	ReadCommand readCmd;
 	COMMAND cmd;
+	uint32_t stackCheck = millis();
+	uint32_t loadReport = millis();
 
 	Stabilization::start();
 
@@ -76,6 +85,14 @@ void mainThread() {
 								cmd.fade.duration);
 						break;
 
+					case COMMAND_STACKS:
+						Communication::sendStackData();
+						break;
+
+					case COMMAND_PERIODS:
+						Communication::sendPeriodData();
+						break;
+
 					default:
 						break;
 				}
@@ -83,6 +100,21 @@ void mainThread() {
 		}
 
 		Communication::sendAllData();
+
+		if (millis() - stackCheck >= STACK_CHECK_PERIOD) {
+			stackCheck = millis();
+
+			if (StackMonitor::update())
+				Communication::sendStackData();
+		}
+
+		if (millis() - loadReport >= LOAD_REPORT_PERIOD) {
+			loadReport = millis();
+
+			SystemStats::update();
+			Communication::sendLoadData();
+		}
+
 		waitMs(50);
 	}
 }
@@ -98,9 +130,6 @@ int main(void) {
 	Serial1.begin(115200);
 	while (!Serial1);
 
-	Wire.begin();
-	delay(500);
-
 	chBegin(mainThread);
 
 	while(1);
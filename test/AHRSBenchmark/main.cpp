@@ -0,0 +1,111 @@
+#include <Arduino.h>
+
+#include "ChibiOS_AVR.h"
+#include "FreeIMU.h"
+
+/*
+ * Counts the CPU cycles of one AHRS update, float against fixed point.
+ * Timer1 runs without prescaler so that TCNT1 counts cycles directly.
+ */
+
+#define BENCHMARK_RUNS 256
+#define BENCHMARK_DT 2500 // us, 400 Hz
+
+// A few lines of test/simulationMotor/data1.txt: acc (raw), gyro (deg/s * 14.375, raw)
+const int16_t _samples[][6] = {
+	{  -93, -59, 221, -224, -319, -192 },
+	{ -126, -58, 202, -255, -386, -207 },
+	{  -49, -64, 239, -152, -211, -197 },
+	{  -63, -57, 236, -140, -216, -199 },
+	{  -62, -60, 232, -118, -199, -200 },
+	{   -1, -64, 238,  -25,  -48, -212 },
+	{  -50, -61, 235,  -52, -156, -205 },
+	{  -17, -62, 238,    2,  -58, -215 }
+};
+
+#define SAMPLES_COUNT (sizeof(_samples) / sizeof(_samples[0]))
+
+MahonyAHRS _float(twoKpDef, twoKiDef);
+MahonyAHRSFixed _fixed(twoKpDef, twoKiDef);
+
+uint32_t _floatMin = 0xFFFFFFFF, _floatMax = 0, _floatSum = 0;
+uint32_t _fixedMin = 0xFFFFFFFF, _fixedMax = 0, _fixedSum = 0;
+
+uint16_t _overhead = 0;
+
+uint32_t stopTimer(void) {
+	uint32_t cycles = TCNT1;
+
+	if (TIFR1 & _BV(TOV1))
+		cycles += 65536UL;
+
+	return cycles;
+}
+
+void startTimer(void) {
+	TIFR1 = _BV(TOV1);
+	TCNT1 = 0;
+}
+
+void record(uint32_t cycles, uint32_t* minimum, uint32_t* maximum, uint32_t* sum) {
+	cycles -= _overhead;
+
+	if (cycles < *minimum)
+		*minimum = cycles;
+	if (cycles > *maximum)
+		*maximum = cycles;
+	*sum += cycles;
+}
+
+void printResult(const __FlashStringHelper* name, uint32_t minimum, uint32_t maximum, uint32_t sum) {
+	Serial.print(name);
+	Serial.print(F(" min "));
+	Serial.print(minimum);
+	Serial.print(F(" avg "));
+	Serial.print(sum / BENCHMARK_RUNS);
+	Serial.print(F(" max "));
+	Serial.print(maximum);
+	Serial.println(F(" cycles"));
+}
+
+void setup() {
+	Serial.begin(115200);
+
+	TCCR1A = 0;
+	TCCR1B = _BV(CS10);
+
+	noInterrupts();
+	startTimer();
+	_overhead = stopTimer();
+	interrupts();
+
+	for (uint16_t i = 0; i < BENCHMARK_RUNS; i++) {
+		const int16_t* s = _samples[i % SAMPLES_COUNT];
+		float gx = s[3] / 14.375f * M_PI / 180;
+		float gy = s[4] / 14.375f * M_PI / 180;
+		float gz = s[5] / 14.375f * M_PI / 180;
+		uint32_t cycles;
+
+		noInterrupts();
+		startTimer();
+		_float.update(gx, gy, gz, s[0], s[1], s[2], BENCHMARK_DT / 1000000.0f);
+		cycles = stopTimer();
+		interrupts();
+		record(cycles, &_floatMin, &_floatMax, &_floatSum);
+
+		noInterrupts();
+		startTimer();
+		_fixed.update(s[3], s[4], s[5], s[0], s[1], s[2], BENCHMARK_DT);
+		cycles = stopTimer();
+		interrupts();
+		record(cycles, &_fixedMin, &_fixedMax, &_fixedSum);
+	}
+
+	printResult(F("float"), _floatMin, _floatMax, _floatSum);
+	printResult(F("fixed"), _fixedMin, _fixedMax, _fixedSum);
+
+	Serial.print(F("speedup x"));
+	Serial.println((float)_floatSum / _fixedSum);
+}
+
+void loop() { }
@@ -1,7 +1,6 @@
 #define serio Serial
 
 #include <Arduino.h>
-#include <Wire.h>
 
 #include "Moti.h"
 #include "Color.h"
@@ -0,0 +1,64 @@
+#include <Arduino.h>
+
+#include "ChibiOS_AVR.h"
+#include "Moti.h"
+#include "Sensors.h"
+#include "Motion.h"
+#include "DriveSystem.h"
+#include "Communication.h"
+
+/*
+ * Measures the IMU offsets and stores them in EEPROM.
+ * Put the robot still and flat (Z up) before resetting it.
+ */
+
+void mainThread() {
+
+	CalibrationData calibration;
+
+	Serial.println(F("Calibrating, do not move..."));
+
+	Sensors::init();
+
+	if (!Sensors::calibrate()) {
+		Serial.println(F("Not flat enough, nothing stored"));
+		return;
+	}
+
+	Calibration::load(&calibration);
+
+	Serial.print(F("Gyroscope offsets: "));
+	for (uint8_t i = 0; i < 3; i++) {
+		Serial.print(calibration.gyrOffset[i]);
+		Serial.print(F(" "));
+	}
+	Serial.println();
+
+	Serial.print(F("Accelerometer offsets: "));
+	for (uint8_t i = 0; i < 3; i++) {
+		Serial.print(calibration.accOffset[i]);
+		Serial.print(F(" "));
+	}
+	Serial.println();
+
+	Serial.println(F("Stored, next boots skip the gyroscope zeroing"));
+
+	while (TRUE)
+		waitMs(1000);
+
+}
+
+void loop() { }
+
+int main(void) {
+	init();
+
+	Serial.begin(115200);
+	while (!Serial);
+
+	chBegin(mainThread);
+
+	while(1);
+
+	return 0;
+}
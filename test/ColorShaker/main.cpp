@@ -1,7 +1,6 @@
 #define serio Serial
 
 #include <Arduino.h>
-#include <Wire.h>
 
 #include "Moti.h"
 #include "Color.h"
@@ -41,7 +40,6 @@ int main(void) {
 
 	serio.begin(115200);
 
-	Wire.begin();
 	delay(500);
 
 	chBegin(mainThread);
@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <Wire.h>
 
 #include "ChibiOS_AVR.h"
 #include "Moti.h"
@@ -33,7 +32,6 @@ int main(void) {
 	// Serial1.begin(115200);
 	// while (!Serial1);
 
-	Wire.begin();
 	delay(5000);
 
 	chBegin(mainThread);
@@ -0,0 +1,172 @@
+#ifndef LEKA_MOTI_TEST_KERNELS_H_
+#define LEKA_MOTI_TEST_KERNELS_H_
+
+/**
+ * @file Kernels.h
+ * @brief The kernels the firmware runs every cycle, one call each, shared by the ATmega2560
+ * benchmark (main.cpp, in cycles) and the host one (host/bench, in ns).
+ *
+ * A kernel takes the run number and goes through the inputs below so that every data
+ * dependent path is taken. What it computes goes to _sink so that nothing is optimised away.
+ */
+
+#include "FreeIMU.h"
+#include "MahonyAHRS.h"
+#include "Orientation.h"
+#include "Color.h"
+#include "Light.h"
+#include "Filters.h"
+#include "RunningAverage.h"
+#include "Toolbox.h"
+
+#define KERNEL_AHRS_DT 2500 // us, 400 Hz
+#define KERNEL_AVERAGE_SIZE 10 // as the Sensors and Moti averages
+#define KERNEL_FADE_STEPS 200
+
+typedef struct {
+	const char* name;
+	void (*run)(uint8_t i);
+} Kernel;
+
+// A few lines of test/simulationMotor/data1.txt: acc (raw), gyro (deg/s * 14.375, raw)
+const int16_t _kernelImu[][6] = {
+	{  -93, -59, 221, -224, -319, -192 },
+	{ -126, -58, 202, -255, -386, -207 },
+	{  -49, -64, 239, -152, -211, -197 },
+	{  -63, -57, 236, -140, -216, -199 },
+	{  -62, -60, 232, -118, -199, -200 },
+	{   -1, -64, 238,  -25,  -48, -212 },
+	{  -50, -61, 235,  -52, -156, -205 },
+	{  -17, -62, 238,    2,  -58, -215 }
+};
+
+// Unit quaternions, upright, tilted, upside down and turned
+const float _kernelQ[][4] = {
+	{ 1.f, 0.f, 0.f, 0.f },
+	{ 0.9962f, 0.0872f, 0.f, 0.f },
+	{ 0.9659f, 0.f, 0.2588f, 0.f },
+	{ 0.7071f, 0.f, 0.f, 0.7071f },
+	{ 0.f, 1.f, 0.f, 0.f },
+	{ 0.5f, 0.5f, 0.5f, 0.5f },
+	{ 0.9239f, -0.2209f, 0.2209f, -0.2209f },
+	{ -0.3827f, 0.f, 0.f, 0.9239f }
+};
+
+#define KERNEL_INPUTS 8
+
+volatile float _sink;
+
+MahonyAHRS _kernelFloat(twoKpDef, twoKiDef);
+MahonyAHRSFixed _kernelFixed(twoKpDef, twoKiDef);
+Orientation _kernelOrientation;
+Color _kernelColor;
+LedData _kernelFade;
+PID _kernelPid(3.f, 0.5f, 0.1f);
+RunningAverage _kernelAverage(KERNEL_AVERAGE_SIZE);
+float _kernelHistory[KERNEL_AVERAGE_SIZE];
+
+static float kernelAngle(uint8_t i) {
+	return (int16_t)(i * 47) * (float)M_PI / 180.f;
+}
+
+static void runMahony(uint8_t i) {
+	const int16_t* s = _kernelImu[i % KERNEL_INPUTS];
+	float gx = s[3] / 14.375f * (float)M_PI / 180.f;
+	float gy = s[4] / 14.375f * (float)M_PI / 180.f;
+	float gz = s[5] / 14.375f * (float)M_PI / 180.f;
+
+	_kernelFloat.update(gx, gy, gz, s[0], s[1], s[2], KERNEL_AHRS_DT / 1000000.f);
+}
+
+static void runMahonyFixed(uint8_t i) {
+	const int16_t* s = _kernelImu[i % KERNEL_INPUTS];
+
+	_kernelFixed.update(s[3], s[4], s[5], s[0], s[1], s[2], KERNEL_AHRS_DT);
+}
+
+static void runInvSqrt(uint8_t i) {
+	_sink = invSqrt(1.f + i * 0.37f);
+}
+
+static void runYawPitchRoll(uint8_t i) {
+	float ypr[3];
+
+	_kernelOrientation.setQ(_kernelQ[i % KERNEL_INPUTS]);
+	_kernelOrientation.getYawPitchRollRad(ypr);
+	_sink = ypr[0] + ypr[1] + ypr[2];
+}
+
+static void runEuler(uint8_t i) {
+	float angles[3];
+
+	_kernelOrientation.setQ(_kernelQ[i % KERNEL_INPUTS]);
+	_kernelOrientation.getEulerRad(angles);
+	_sink = angles[0] + angles[1] + angles[2];
+}
+
+static void runSetRGB(uint8_t i) {
+	_kernelColor.setRGB(i, 255 - i, i * 3);
+	_sink = _kernelColor.getR();
+}
+
+static void runSetHSV(uint8_t i) {
+	_kernelColor.setHSV(i * 3 % 360, 1.f - i / 512.f, 0.5f + i / 512.f);
+	_sink = _kernelColor.getR();
+}
+
+static void runFadeStep(uint8_t i) {
+	if (_kernelFade.steps >= _kernelFade.totalSteps) {
+		_kernelFade.startColor = Color(i, 20, 200);
+		_kernelFade.endColor = Color(255, i, 0);
+		_kernelFade.diff = Color(_kernelFade.endColor.getR() - _kernelFade.startColor.getR(),
+				_kernelFade.endColor.getG() - _kernelFade.startColor.getG(),
+				_kernelFade.endColor.getB() - _kernelFade.startColor.getB());
+		_kernelFade.totalSteps = KERNEL_FADE_STEPS;
+		_kernelFade.steps = 0;
+	}
+
+	_sink = Light::stepFade(&_kernelFade);
+}
+
+static void runPid(uint8_t i) {
+	_sink = _kernelPid.CalculatePID(kernelAngle(i));
+}
+
+static void runAddValue(uint8_t i) {
+	_kernelAverage.addValue(kernelAngle(i));
+}
+
+static void runGetAverage(uint8_t i) {
+	(void)i;
+
+	_sink = _kernelAverage.getAverage();
+}
+
+static void runArrayDeltaSum(uint8_t i) {
+	_kernelHistory[i % KERNEL_AVERAGE_SIZE] = kernelAngle(i);
+	_sink = Toolbox::arrayDeltaSum(_kernelHistory, KERNEL_AVERAGE_SIZE);
+}
+
+static void runDiffAngle(uint8_t i) {
+	_sink = Toolbox::diffAngle(kernelAngle(i), kernelAngle(i + 5));
+}
+
+const Kernel _kernels[] = {
+	{ "MahonyAHRS::update", runMahony },
+	{ "MahonyAHRSFixed::update", runMahonyFixed },
+	{ "invSqrt", runInvSqrt },
+	{ "Orientation::getYawPitchRollRad", runYawPitchRoll },
+	{ "Orientation::getEulerRad", runEuler },
+	{ "Color::setRGB", runSetRGB },
+	{ "Color::setHSV", runSetHSV },
+	{ "Light::stepFade", runFadeStep },
+	{ "PID::CalculatePID", runPid },
+	{ "RunningAverage::addValue", runAddValue },
+	{ "RunningAverage::getAverage", runGetAverage },
+	{ "Toolbox::arrayDeltaSum", runArrayDeltaSum },
+	{ "Toolbox::diffAngle", runDiffAngle }
+};
+
+#define KERNELS_COUNT (sizeof(_kernels) / sizeof(_kernels[0]))
+
+#endif
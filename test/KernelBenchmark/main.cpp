@@ -0,0 +1,87 @@
+#include <Arduino.h>
+#include <avr/sleep.h>
+
+#include "ChibiOS_AVR.h"
+#include "Kernels.h"
+
+/*
+ * Counts the CPU cycles of each kernel of Kernels.h, one call at a time.
+ * Timer1 runs without prescaler so that TCNT1 counts cycles directly.
+ *
+ * Prints one line per kernel, read back by host/bench (make -C host bench-avr):
+ *     name min X avg Y max Z cycles
+ * then stops the CPU, which also ends a simavr run.
+ */
+
+#define BENCHMARK_RUNS 256
+
+uint16_t _overhead = 0;
+
+uint32_t stopTimer(void) {
+	uint32_t cycles = TCNT1;
+
+	if (TIFR1 & _BV(TOV1))
+		cycles += 65536UL;
+
+	return cycles;
+}
+
+void startTimer(void) {
+	TIFR1 = _BV(TOV1);
+	TCNT1 = 0;
+}
+
+void benchmark(const Kernel& kernel) {
+	uint32_t minimum = 0xFFFFFFFF, maximum = 0, sum = 0;
+
+	for (uint16_t i = 0; i < BENCHMARK_RUNS; i++) {
+		uint32_t cycles;
+
+		noInterrupts();
+		startTimer();
+		kernel.run(i);
+		cycles = stopTimer();
+		interrupts();
+
+		cycles -= _overhead;
+
+		if (cycles < minimum)
+			minimum = cycles;
+		if (cycles > maximum)
+			maximum = cycles;
+		sum += cycles;
+	}
+
+	Serial.print(kernel.name);
+	Serial.print(F(" min "));
+	Serial.print(minimum);
+	Serial.print(F(" avg "));
+	Serial.print(sum / BENCHMARK_RUNS);
+	Serial.print(F(" max "));
+	Serial.print(maximum);
+	Serial.println(F(" cycles"));
+}
+
+void setup() {
+	Serial.begin(115200);
+
+	TCCR1A = 0;
+	TCCR1B = _BV(CS10);
+
+	noInterrupts();
+	startTimer();
+	_overhead = stopTimer();
+	interrupts();
+
+	for (uint8_t k = 0; k < KERNELS_COUNT; k++)
+		benchmark(_kernels[k]);
+
+	Serial.println(F("done"));
+	Serial.flush();
+
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	cli();
+	sleep_mode();
+}
+
+void loop() { }
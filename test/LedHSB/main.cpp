@@ -66,7 +66,6 @@ int main(void) {
 	// Serial1.begin(115200);
 	// while (!Serial1);
 
-	Wire.begin();
 	delay(5000);
 
 	chBegin(mainThread);
@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <Wire.h>
 #include "Motor.h"
 #include "Led.h"
 
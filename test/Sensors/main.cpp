@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <Wire.h>
 
 // #include "Sensors.h"
 #include "DriveSystem.h"
@@ -94,7 +93,6 @@ void setup() {
 	Serio.begin(115200);
 	while (!Serio);
 
-	Wire.begin();
 	delay(500);
 
 	chBegin(chSetup);
@@ -1,7 +1,6 @@
 #define serio Serial
 
 #include <Arduino.h>
-#include <Wire.h>
 
 #include "Moti.h"
 #include "Color.h"
@@ -42,7 +41,6 @@ int main(void) {
 
 	serio.begin(115200);
 
-	Wire.begin();
 	delay(500);
 
 	chBegin(mainThread);
@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <Wire.h>
 
 #include "ChibiOS_AVR.h"
 //#include "Moti.h"
@@ -135,7 +134,6 @@ int main(void) {
 	Serial.begin(115200);
 	while (!Serial);
 
-	Wire.begin();
 	delay(2000);
 
 	chBegin(mainThread);
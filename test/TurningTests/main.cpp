@@ -1,7 +1,6 @@
 
 
 #include <Arduino.h>
-#include <Wire.h>
 
 #include "Sensors.h"
 #include "Motion.h"
@@ -49,7 +48,6 @@ int main(void) {
 
 	while(!Serial);
 
-	Wire.begin();
 	delay(500);
 
 	chBegin(mainThread);